@@ -294,6 +294,7 @@ jsg::Promise<jsg::JsRef<jsg::JsValue>> DurableObjectStorageOperations::list(
   kj::Maybe<kj::String> end;
   bool reverse = false;
   kj::Maybe<uint> limit;
+  bool isContinuation = false;
 
   auto makeEmptyResult = [&]() {
     return js.resolvedPromise(jsg::JsValue(js.map()).addRef(js));
@@ -322,6 +323,7 @@ jsg::Promise<jsg::JsRef<jsg::JsValue>> DurableObjectStorageOperations::list(
       // to make it stick in the final string.
       startAfterKey[startAfterKey.size()-1] = '\0';
       start = kj::String(kj::mv(startAfterKey));
+      isContinuation = true;
     }
     KJ_IF_SOME(e, o.end) {
       end = kj::mv(e);
@@ -390,6 +392,11 @@ jsg::Promise<jsg::JsRef<jsg::JsValue>> DurableObjectStorageOperations::list(
 
   auto options = configureOptions(kj::mv(maybeOptions).orDefault(ListOptions{}));
   ActorCacheOps::ReadOptions readOptions = options;
+  if (isContinuation && !reverse) {
+    // A forward list() that uses `startAfter` is most likely paging through a range, so read the
+    // next page into cache along with this one.
+    readOptions.readAhead = limit.orDefault(0);
+  }
 
   auto result = reverse
       ? getCache(OP_LIST).listReverse(kj::mv(start), kj::mv(end), limit, readOptions)
@@ -852,7 +859,8 @@ void DurableObjectState::acceptWebSocket(
   if (a.getHibernationManager() == kj::none) {
     a.setHibernationManager(
         kj::refcounted<HibernationManagerImpl>(
-            a.getLoopback(), KJ_REQUIRE_NONNULL(a.getHibernationEventType())));
+            a.getLoopback(), KJ_REQUIRE_NONNULL(a.getHibernationEventType()),
+            a.getHibernatableWebSocketLimit()));
   }
   // HibernationManager's acceptWebSocket() will throw if the websocket is in an incompatible state.
   // Note that not providing a tag is equivalent to providing an empty tag array.
@@ -891,6 +899,17 @@ kj::Array<jsg::Ref<api::WebSocket>> DurableObjectState::getWebSockets(
   return kj::Array<jsg::Ref<api::WebSocket>>();
 }
 
+uint32_t DurableObjectState::broadcastWebSocketMessage(
+    jsg::Lock& js,
+    kj::OneOf<kj::Array<kj::byte>, kj::String> message,
+    jsg::Optional<kj::String> tag) {
+  auto& a = KJ_REQUIRE_NONNULL(IoContext::current().getActor());
+  KJ_IF_SOME(manager, a.getHibernationManager()) {
+    return manager.broadcast(js, kj::mv(message), tag.map([](kj::StringPtr t) { return t; }));
+  }
+  return 0;
+}
+
 void DurableObjectState::setWebSocketAutoResponse(
       jsg::Optional<jsg::Ref<WebSocketRequestResponsePair>> maybeReqResp) {
   auto& a = KJ_REQUIRE_NONNULL(IoContext::current().getActor());
@@ -917,7 +936,8 @@ void DurableObjectState::setWebSocketAutoResponse(
 
   if (a.getHibernationManager() == kj::none) {
     a.setHibernationManager(kj::refcounted<HibernationManagerImpl>(
-            a.getLoopback(), KJ_REQUIRE_NONNULL(a.getHibernationEventType())));
+            a.getLoopback(), KJ_REQUIRE_NONNULL(a.getHibernationEventType()),
+            a.getHibernatableWebSocketLimit()));
     // If there's no hibernation manager created yet, we should create one and
     // set its auto response.
   }
@@ -447,6 +447,13 @@ public:
   // Disconnected WebSockets are automatically removed from the list.
   kj::Array<jsg::Ref<api::WebSocket>> getWebSockets(jsg::Lock& js, jsg::Optional<kj::String> tag);
 
+  // Sends `message` to every accepted WebSocket matching the given tag, or to all accepted
+  // WebSockets if no tag is provided. Unlike calling send() on each result of getWebSockets(),
+  // this does not wake hibernating WebSockets. Returns the number of WebSockets the message was
+  // sent to.
+  uint32_t broadcastWebSocketMessage(jsg::Lock& js,
+      kj::OneOf<kj::Array<kj::byte>, kj::String> message, jsg::Optional<kj::String> tag);
+
   // Sets an object-wide websocket auto response message for a specific
   // request string. All websockets belonging to the same object must
   // reply to the request with the matching response, then store the timestamp at which
@@ -476,6 +483,9 @@ public:
       //   useful to apps in actual production? It's a convenient way to bail out when you discover
       //   your state is inconsistent.
       JSG_METHOD(abort);
+
+      // Experimental until we've settled on the shape of this API.
+      JSG_METHOD(broadcastWebSocketMessage);
     }
 
     JSG_TS_ROOT();
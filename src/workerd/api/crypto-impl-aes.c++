@@ -671,7 +671,8 @@ CryptoKeyUsageSet validateAesUsages(CryptoKeyUsageSet::Context ctx, kj::StringPt
 
 }  // namespace
 
-kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateAes(
+jsg::Promise<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>>
+CryptoKey::Impl::generateAes(
       jsg::Lock& js, kj::StringPtr normalizedName,
       SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
       kj::ArrayPtr<const kj::String> keyUsages) {
@@ -698,18 +699,23 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateAes(
   kj::Own<CryptoKey::Impl> keyImpl;
 
   if (normalizedName == "AES-GCM") {
-    keyImpl = kj::heap<AesGcmKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+    keyImpl = kj::atomicRefcounted<AesGcmKey>(
+        kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
   } else if (normalizedName == "AES-CBC") {
-    keyImpl = kj::heap<AesCbcKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+    keyImpl = kj::atomicRefcounted<AesCbcKey>(
+        kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
   } else if (normalizedName == "AES-CTR") {
-    keyImpl = kj::heap<AesCtrKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+    keyImpl = kj::atomicRefcounted<AesCtrKey>(
+        kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
   } else if (normalizedName == "AES-KW") {
-    keyImpl = kj::heap<AesKwKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+    keyImpl = kj::atomicRefcounted<AesKwKey>(
+        kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
   } else {
     JSG_FAIL_REQUIRE(DOMNotSupportedError, normalizedName, " key generation not supported.");
   }
 
-  return jsg::alloc<CryptoKey>(kj::mv(keyImpl));
+  return js.resolvedPromise(kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>(
+      jsg::alloc<CryptoKey>(kj::mv(keyImpl))));
 }
 
 kj::Own<CryptoKey::Impl> CryptoKey::Impl::importAes(
@@ -808,13 +814,17 @@ kj::Own<CryptoKey::Impl> CryptoKey::Impl::importAes(
   auto keyAlgorithm = CryptoKey::AesKeyAlgorithm{normalizedName, static_cast<uint16_t>(keySize)};
 
   if (normalizedName == "AES-GCM") {
-    return kj::heap<AesGcmKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+    return kj::atomicRefcounted<AesGcmKey>(
+        kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
   } else if (normalizedName == "AES-CBC") {
-    return kj::heap<AesCbcKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+    return kj::atomicRefcounted<AesCbcKey>(
+        kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
   } else if (normalizedName == "AES-CTR") {
-    return kj::heap<AesCtrKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+    return kj::atomicRefcounted<AesCtrKey>(
+        kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
   } else if (normalizedName == "AES-KW") {
-    return kj::heap<AesKwKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+    return kj::atomicRefcounted<AesKwKey>(
+        kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
   }
 
   JSG_FAIL_REQUIRE(DOMNotSupportedError, "Unsupported algorithm \"", normalizedName,
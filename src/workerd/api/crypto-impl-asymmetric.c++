@@ -902,21 +902,22 @@ CryptoKeyPair generateRsaPair(jsg::Lock& js, kj::StringPtr normalizedName,
 
   if (normalizedName == "RSASSA-PKCS1-v1_5") {
     return CryptoKeyPair {
-      .publicKey =  jsg::alloc<CryptoKey>(kj::heap<RsassaPkcs1V15Key>(kj::mv(publicEvpPKey),
-          kj::mv(keyAlgorithm), "public"_kj, true, publicKeyUsages)),
-      .privateKey = jsg::alloc<CryptoKey>(kj::heap<RsassaPkcs1V15Key>(kj::mv(privateEvpPKey),
-          kj::mv(privateKeyAlgorithm), "private"_kj, privateKeyExtractable, privateKeyUsages))};
+      .publicKey =  jsg::alloc<CryptoKey>(kj::atomicRefcounted<RsassaPkcs1V15Key>(
+          kj::mv(publicEvpPKey), kj::mv(keyAlgorithm), "public"_kj, true, publicKeyUsages)),
+      .privateKey = jsg::alloc<CryptoKey>(kj::atomicRefcounted<RsassaPkcs1V15Key>(
+          kj::mv(privateEvpPKey), kj::mv(privateKeyAlgorithm), "private"_kj,
+          privateKeyExtractable, privateKeyUsages))};
   } else if (normalizedName == "RSA-PSS") {
     return CryptoKeyPair {
-      .publicKey =  jsg::alloc<CryptoKey>(kj::heap<RsaPssKey>(kj::mv(publicEvpPKey),
+      .publicKey =  jsg::alloc<CryptoKey>(kj::atomicRefcounted<RsaPssKey>(kj::mv(publicEvpPKey),
           kj::mv(keyAlgorithm), "public"_kj, true, publicKeyUsages)),
-      .privateKey = jsg::alloc<CryptoKey>(kj::heap<RsaPssKey>(kj::mv(privateEvpPKey),
+      .privateKey = jsg::alloc<CryptoKey>(kj::atomicRefcounted<RsaPssKey>(kj::mv(privateEvpPKey),
           kj::mv(privateKeyAlgorithm), "private"_kj, privateKeyExtractable, privateKeyUsages))};
   } else if (normalizedName == "RSA-OAEP") {
     return CryptoKeyPair {
-      .publicKey =  jsg::alloc<CryptoKey>(kj::heap<RsaOaepKey>(kj::mv(publicEvpPKey),
+      .publicKey =  jsg::alloc<CryptoKey>(kj::atomicRefcounted<RsaOaepKey>(kj::mv(publicEvpPKey),
           kj::mv(keyAlgorithm), "public"_kj, true, publicKeyUsages)),
-      .privateKey = jsg::alloc<CryptoKey>(kj::heap<RsaOaepKey>(kj::mv(privateEvpPKey),
+      .privateKey = jsg::alloc<CryptoKey>(kj::atomicRefcounted<RsaOaepKey>(kj::mv(privateEvpPKey),
           kj::mv(privateKeyAlgorithm), "private"_kj, privateKeyExtractable, privateKeyUsages))};
   } else {
     JSG_FAIL_REQUIRE(DOMNotSupportedError, "Unimplemented RSA generation \"", normalizedName,
@@ -983,7 +984,8 @@ void validateRsaParams(jsg::Lock& js, int modulusLength, kj::ArrayPtr<kj::byte>
 
 } // namespace
 
-kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateRsa(
+jsg::Promise<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>>
+CryptoKey::Impl::generateRsa(
     jsg::Lock& js, kj::StringPtr normalizedName,
     SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
     kj::ArrayPtr<const kj::String> keyUsages) {
@@ -1021,24 +1023,36 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateRsa(
   auto bnExponent = OSSLCALL_OWN(BIGNUM, BN_bin2bn(publicExponent.begin(),
       publicExponent.size(), nullptr), InternalDOMOperationError, "Error setting up RSA keygen.");
 
-  auto rsaPrivateKey = OSSL_NEW(RSA);
-  OSSLCALL(RSA_generate_key_ex(rsaPrivateKey, modulusLength, bnExponent.get(), 0));
-  auto privateEvpPKey = OSSL_NEW(EVP_PKEY);
-  OSSLCALL(EVP_PKEY_set1_RSA(privateEvpPKey.get(), rsaPrivateKey.get()));
-  kj::Own<RSA> rsaPublicKey = OSSLCALL_OWN(RSA, RSAPublicKey_dup(rsaPrivateKey.get()),
-      InternalDOMOperationError, "Error finalizing RSA keygen", internalDescribeOpensslErrors());
-  auto publicEvpPKey = OSSL_NEW(EVP_PKEY);
-  OSSLCALL(EVP_PKEY_set1_RSA(publicEvpPKey.get(), rsaPublicKey));
-
-  auto keyAlgorithm = CryptoKey::RsaKeyAlgorithm {
-    .name = normalizedName,
-    .modulusLength = static_cast<uint16_t>(modulusLength),
-    .publicExponent = kj::mv(publicExponent),
-    .hash = KeyAlgorithm { normalizedHashName }
+  // Generating the key takes long enough (hundreds of milliseconds for 4096 bits) that it's done on
+  // a background thread. Only wrapping it in CryptoKeys needs the isolate.
+  struct EvpKeyPair {
+    kj::Own<EVP_PKEY> privateKey;
+    kj::Own<EVP_PKEY> publicKey;
   };
+  return runOnThreadPool(js, [modulusLength, bnExponent = kj::mv(bnExponent)]() {
+    auto rsaPrivateKey = OSSL_NEW(RSA);
+    OSSLCALL(RSA_generate_key_ex(rsaPrivateKey, modulusLength, bnExponent.get(), 0));
+    auto privateEvpPKey = OSSL_NEW(EVP_PKEY);
+    OSSLCALL(EVP_PKEY_set1_RSA(privateEvpPKey.get(), rsaPrivateKey.get()));
+    kj::Own<RSA> rsaPublicKey = OSSLCALL_OWN(RSA, RSAPublicKey_dup(rsaPrivateKey.get()),
+        InternalDOMOperationError, "Error finalizing RSA keygen", internalDescribeOpensslErrors());
+    auto publicEvpPKey = OSSL_NEW(EVP_PKEY);
+    OSSLCALL(EVP_PKEY_set1_RSA(publicEvpPKey.get(), rsaPublicKey));
+    return EvpKeyPair { kj::mv(privateEvpPKey), kj::mv(publicEvpPKey) };
+  }).then(js, [normalizedName, normalizedHashName = normalizedHashName, modulusLength,
+               publicExponent = kj::mv(publicExponent), extractable, usages]
+              (jsg::Lock& js, EvpKeyPair keys) mutable
+              -> kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> {
+    auto keyAlgorithm = CryptoKey::RsaKeyAlgorithm {
+      .name = normalizedName,
+      .modulusLength = static_cast<uint16_t>(modulusLength),
+      .publicExponent = kj::mv(publicExponent),
+      .hash = KeyAlgorithm { normalizedHashName }
+    };
 
-  return generateRsaPair(js, normalizedName, kj::mv(privateEvpPKey), kj::mv(publicEvpPKey),
-      kj::mv(keyAlgorithm), extractable, usages);
+    return generateRsaPair(js, normalizedName, kj::mv(keys.privateKey), kj::mv(keys.publicKey),
+        kj::mv(keyAlgorithm), extractable, usages);
+  });
 }
 
 kj::Own<EVP_PKEY> rsaJwkReader(SubtleCrypto::JsonWebKey&& keyDataJwk) {
@@ -1205,12 +1219,13 @@ kj::Own<CryptoKey::Impl> CryptoKey::Impl::importRsa(
     .hash = KeyAlgorithm { normalizedHashName }
   };
   if (normalizedName == "RSASSA-PKCS1-v1_5") {
-    return kj::heap<RsassaPkcs1V15Key>(
+    return kj::atomicRefcounted<RsassaPkcs1V15Key>(
         kj::mv(evpPkey), kj::mv(keyAlgorithm), keyType, extractable, usages);
   } else if (normalizedName == "RSA-PSS") {
-    return kj::heap<RsaPssKey>(kj::mv(evpPkey), kj::mv(keyAlgorithm), keyType, extractable, usages);
+    return kj::atomicRefcounted<RsaPssKey>(
+        kj::mv(evpPkey), kj::mv(keyAlgorithm), keyType, extractable, usages);
   } else if (normalizedName == "RSA-OAEP") {
-    return kj::heap<RsaOaepKey>(
+    return kj::atomicRefcounted<RsaOaepKey>(
         kj::mv(evpPkey), kj::mv(keyAlgorithm), keyType, extractable, usages);
   } else {
     JSG_FAIL_REQUIRE(DOMNotSupportedError, "Unrecognized RSA variant \"", normalizedName, "\".");
@@ -1275,7 +1290,8 @@ kj::Own<CryptoKey::Impl> CryptoKey::Impl::importRsaRaw(
     .publicExponent = kj::mv(publicExponent)
   };
 
-  return kj::heap<RsaRawKey>(kj::mv(evpPkey), kj::mv(keyAlgorithm), extractable, usages);
+  return kj::atomicRefcounted<RsaRawKey>(
+      kj::mv(evpPkey), kj::mv(keyAlgorithm), extractable, usages);
 }
 
 // =====================================================================================
@@ -1676,9 +1692,9 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> EllipticKey::generateElliptic(
   auto publicEvpPKey = OSSL_NEW(EVP_PKEY);
   OSSLCALL(EVP_PKEY_set1_EC_KEY(publicEvpPKey.get(), ecPublicKey.get()));
 
-  auto privateKey = jsg::alloc<CryptoKey>(kj::heap<EllipticKey>(kj::mv(privateEvpPKey),
+  auto privateKey = jsg::alloc<CryptoKey>(kj::atomicRefcounted<EllipticKey>(kj::mv(privateEvpPKey),
       keyAlgorithm, "private"_kj, rsSize, extractable, privateKeyUsages));
-  auto publicKey = jsg::alloc<CryptoKey>(kj::heap<EllipticKey>(kj::mv(publicEvpPKey),
+  auto publicKey = jsg::alloc<CryptoKey>(kj::atomicRefcounted<EllipticKey>(kj::mv(publicEvpPKey),
       keyAlgorithm, "public"_kj, rsSize, true, publicKeyUsages));
 
   return CryptoKeyPair {.publicKey =  kj::mv(publicKey), .privateKey = kj::mv(privateKey)};
@@ -1834,7 +1850,8 @@ kj::Own<EVP_PKEY> ellipticJwkReader(int curveId, SubtleCrypto::JsonWebKey&& keyD
   return evpPkey;
 }
 
-kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateEcdsa(
+jsg::Promise<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>>
+CryptoKey::Impl::generateEcdsa(
     jsg::Lock& js, kj::StringPtr normalizedName,
     SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
     kj::ArrayPtr<const kj::String> keyUsages) {
@@ -1844,8 +1861,8 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateEcdsa(
   auto privateKeyUsages = usages & CryptoKeyUsageSet::privateKeyMask();
   auto publicKeyUsages = usages & CryptoKeyUsageSet::publicKeyMask();
 
-  return EllipticKey::generateElliptic(normalizedName, kj::mv(algorithm), extractable,
-      privateKeyUsages, publicKeyUsages);
+  return js.resolvedPromise(EllipticKey::generateElliptic(normalizedName, kj::mv(algorithm),
+      extractable, privateKeyUsages, publicKeyUsages));
 }
 
 kj::Own<CryptoKey::Impl> CryptoKey::Impl::importEcdsa(
@@ -1887,18 +1904,20 @@ kj::Own<CryptoKey::Impl> CryptoKey::Impl::importEcdsa(
     normalizedNamedCurve,
   };
 
-  return kj::heap<EllipticKey>(kj::mv(evpPkey), kj::mv(keyAlgorithm), keyType, rsSize, extractable,
-                               usages);
+  return kj::atomicRefcounted<EllipticKey>(
+      kj::mv(evpPkey), kj::mv(keyAlgorithm), keyType, rsSize, extractable, usages);
 }
 
-kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateEcdh(
+jsg::Promise<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>>
+CryptoKey::Impl::generateEcdh(
     jsg::Lock& js, kj::StringPtr normalizedName,
     SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
     kj::ArrayPtr<const kj::String> keyUsages) {
   auto usages =
       CryptoKeyUsageSet::validate(normalizedName, CryptoKeyUsageSet::Context::generate, keyUsages,
                                   CryptoKeyUsageSet::derivationKeyMask());
-  return EllipticKey::generateElliptic(normalizedName, kj::mv(algorithm), extractable, usages, {});
+  return js.resolvedPromise(EllipticKey::generateElliptic(normalizedName, kj::mv(algorithm),
+      extractable, usages, {}));
 }
 
 kj::Own<CryptoKey::Impl> CryptoKey::Impl::importEcdh(
@@ -1948,8 +1967,8 @@ kj::Own<CryptoKey::Impl> CryptoKey::Impl::importEcdh(
     normalizedNamedCurve,
   };
 
-  return kj::heap<EllipticKey>(kj::mv(evpPkey), kj::mv(keyAlgorithm), keyType, rsSize, extractable,
-                               usages);
+  return kj::atomicRefcounted<EllipticKey>(
+      kj::mv(evpPkey), kj::mv(keyAlgorithm), keyType, rsSize, extractable, usages);
 }
 
 // =====================================================================================
@@ -2220,9 +2239,9 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> EdDsaKey::generateKey(
       rawPublicKey, keylen), InternalDOMOperationError, "Internal error construct ", curveName,
       "public key", internalDescribeOpensslErrors());
 
-  auto privateKey = jsg::alloc<CryptoKey>(kj::heap<EdDsaKey>(kj::mv(privateEvpPKey),
+  auto privateKey = jsg::alloc<CryptoKey>(kj::atomicRefcounted<EdDsaKey>(kj::mv(privateEvpPKey),
       normalizedName, "private"_kj, extractablePrivateKey, privateKeyUsages));
-  auto publicKey = jsg::alloc<CryptoKey>(kj::heap<EdDsaKey>(kj::mv(publicEvpPKey),
+  auto publicKey = jsg::alloc<CryptoKey>(kj::atomicRefcounted<EdDsaKey>(kj::mv(publicEvpPKey),
       normalizedName, "public"_kj, true, publicKeyUsages));
 
   return CryptoKeyPair {.publicKey =  kj::mv(publicKey), .privateKey = kj::mv(privateKey)};
@@ -2230,7 +2249,8 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> EdDsaKey::generateKey(
 
 }  // namespace
 
-kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateEddsa(
+jsg::Promise<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>>
+CryptoKey::Impl::generateEddsa(
     jsg::Lock& js, kj::StringPtr normalizedName,
     SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
     kj::ArrayPtr<const kj::String> keyUsages) {
@@ -2249,8 +2269,9 @@ kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> CryptoKey::Impl::generateEddsa(
         "EDDSA curve \"", namedCurve, "\" isn't supported.");
   }
 
-  return EdDsaKey::generateKey(normalizedName, normalizedName == "X25519" ? NID_X25519 :
-                               NID_ED25519, privateKeyUsages, publicKeyUsages, extractable);
+  return js.resolvedPromise(EdDsaKey::generateKey(normalizedName,
+      normalizedName == "X25519" ? NID_X25519 : NID_ED25519, privateKeyUsages, publicKeyUsages,
+      extractable));
 }
 
 kj::Own<CryptoKey::Impl> CryptoKey::Impl::importEddsa(
@@ -2286,6 +2307,7 @@ kj::Own<CryptoKey::Impl> CryptoKey::Impl::importEddsa(
   }();
 
   // In X25519 we ignore the id-X25519 identifier, as with id-ecDH above.
-  return kj::heap<EdDsaKey>(kj::mv(evpPkey), normalizedName, keyType, extractable, usages);
+  return kj::atomicRefcounted<EdDsaKey>(
+      kj::mv(evpPkey), normalizedName, keyType, extractable, usages);
 }
 }  // namespace workerd::api
@@ -20,13 +20,19 @@ private:
   kj::Array<kj::byte> deriveBits(
       jsg::Lock& js, SubtleCrypto::DeriveKeyAlgorithm&& algorithm,
       kj::Maybe<uint32_t> maybeLength) const override {
+    return KJ_ASSERT_NONNULL(prepareDeriveBits(js, kj::mv(algorithm), maybeLength))();
+  }
+
+  kj::Maybe<DeriveBitsJob> prepareDeriveBits(
+      jsg::Lock& js, SubtleCrypto::DeriveKeyAlgorithm&& algorithm,
+      kj::Maybe<uint32_t> maybeLength) const override {
     kj::StringPtr hashName = api::getAlgorithmName(JSG_REQUIRE_NONNULL(algorithm.hash, TypeError,
         "Missing field \"hash\" in \"algorithm\"."));
     const EVP_MD* hashType = lookupDigestAlgorithm(hashName).second;
 
-    const auto& salt = JSG_REQUIRE_NONNULL(algorithm.salt, TypeError,
+    auto salt = JSG_REQUIRE_NONNULL(kj::mv(algorithm.salt), TypeError,
         "Missing field \"salt\" in \"algorithm\".");
-    const auto& info = JSG_REQUIRE_NONNULL(algorithm.info, TypeError,
+    auto info = JSG_REQUIRE_NONNULL(kj::mv(algorithm.info), TypeError,
         "Missing field \"info\" in \"algorithm\".");
 
     uint32_t length = JSG_REQUIRE_NONNULL(maybeLength, DOMOperationError,
@@ -36,19 +42,21 @@ private:
         "HKDF requires a derived key length that is a non-zero multiple of eight (requested ",
         length, ").");
 
-    auto derivedLengthBytes = length / 8;
-
-    kj::Vector<kj::byte> result(derivedLengthBytes);
-    result.resize(derivedLengthBytes);
+    return DeriveBitsJob([self = kj::atomicAddRef(*this), hashType, salt = kj::mv(salt),
+                          info = kj::mv(info), derivedLengthBytes = length / 8]() {
+      auto& keyData = self->keyData;
+      kj::Vector<kj::byte> result(derivedLengthBytes);
+      result.resize(derivedLengthBytes);
 
-    auto operationSucceed = HKDF(result.begin(), result.size(), hashType, keyData.begin(),
-        keyData.size(), salt.begin(), salt.size(), info.begin(), info.size());
+      auto operationSucceed = HKDF(result.begin(), result.size(), hashType, keyData.begin(),
+          keyData.size(), salt.begin(), salt.size(), info.begin(), info.size());
 
-    if (operationSucceed != 1) {
-      JSG_FAIL_REQUIRE(DOMOperationError, "HKDF deriveBits failed.");
-    }
+      if (operationSucceed != 1) {
+        JSG_FAIL_REQUIRE(DOMOperationError, "HKDF deriveBits failed.");
+      }
 
-    return result.releaseAsArray();
+      return result.releaseAsArray();
+    });
   }
 
   kj::StringPtr getAlgorithmName() const override { return "HKDF"; }
@@ -86,7 +94,8 @@ kj::Own<CryptoKey::Impl> CryptoKey::Impl::importHkdf(
   auto keyDataArray = kj::mv(keyData.get<kj::Array<kj::byte>>());
 
   auto keyAlgorithm = CryptoKey::KeyAlgorithm{normalizedName};
-  return kj::heap<HkdfKey>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+  return kj::atomicRefcounted<HkdfKey>(
+      kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
 }
 
 }  // namespace workerd::api
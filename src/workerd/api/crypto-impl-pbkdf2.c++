@@ -19,10 +19,18 @@ private:
   kj::Array<kj::byte> deriveBits(
       jsg::Lock& js, SubtleCrypto::DeriveKeyAlgorithm&& algorithm,
       kj::Maybe<uint32_t> maybeLength) const override {
+    return KJ_ASSERT_NONNULL(prepareDeriveBits(js, kj::mv(algorithm), maybeLength))();
+  }
+
+  // Up to 100000 iterations of the hash makes this one of the slowest WebCrypto operations, so it
+  // is worth running on a background thread.
+  kj::Maybe<DeriveBitsJob> prepareDeriveBits(
+      jsg::Lock& js, SubtleCrypto::DeriveKeyAlgorithm&& algorithm,
+      kj::Maybe<uint32_t> maybeLength) const override {
     kj::StringPtr hashName = api::getAlgorithmName(JSG_REQUIRE_NONNULL(algorithm.hash, TypeError,
         "Missing field \"hash\" in \"algorithm\"."));
     auto hashType = lookupDigestAlgorithm(hashName).second;
-    kj::ArrayPtr<kj::byte> salt = JSG_REQUIRE_NONNULL(algorithm.salt, TypeError,
+    kj::Array<kj::byte> salt = JSG_REQUIRE_NONNULL(kj::mv(algorithm.salt), TypeError,
         "Missing field \"salt\" in \"algorithm\".");
     int iterations = JSG_REQUIRE_NONNULL(algorithm.iterations, TypeError,
         "Missing field \"iterations\" in \"algorithm\".");
@@ -45,11 +53,15 @@ private:
     JSG_REQUIRE(iterations <= 100000, DOMNotSupportedError,
         "PBKDF2 iteration counts above 100000 are not supported (requested ", iterations, ").");
 
-    auto output = kj::heapArray<kj::byte>(length / 8);
-    OSSLCALL(PKCS5_PBKDF2_HMAC(keyData.asPtr().asChars().begin(), keyData.size(),
-                               salt.begin(), salt.size(),
-                               iterations, hashType, output.size(), output.begin()));
-    return kj::mv(output);
+    return DeriveBitsJob([self = kj::atomicAddRef(*this), hashType, salt = kj::mv(salt),
+                          iterations, length]() {
+      auto& keyData = self->keyData;
+      auto output = kj::heapArray<kj::byte>(length / 8);
+      OSSLCALL(PKCS5_PBKDF2_HMAC(keyData.asPtr().asChars().begin(), keyData.size(),
+                                 salt.begin(), salt.size(),
+                                 iterations, hashType, output.size(), output.begin()));
+      return kj::mv(output);
+    });
   }
 
   // TODO(bug): Possibly by mistake, PBKDF2 was historically not on the allow list of
@@ -99,7 +111,8 @@ kj::Own<CryptoKey::Impl> CryptoKey::Impl::importPbkdf2(
   auto keyDataArray = kj::mv(keyData.get<kj::Array<kj::byte>>());
 
   auto keyAlgorithm = CryptoKey::KeyAlgorithm{normalizedName};
-  return kj::heap<Pbkdf2Key>(kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
+  return kj::atomicRefcounted<Pbkdf2Key>(
+      kj::mv(keyDataArray), kj::mv(keyAlgorithm), extractable, usages);
 }
 
 }  // namespace workerd::api
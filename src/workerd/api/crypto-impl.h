@@ -9,9 +9,12 @@
 
 #include "crypto.h"
 #include <workerd/api/util.h>
+#include <workerd/io/io-context.h>
+#include <workerd/util/thread-pool.h>
 #include <kj/encoding.h>
 #include <openssl/evp.h>
 #include <openssl/bio.h>
+#include <openssl/err.h>
 
 // Wrap calls to OpenSSL's EVP_* interface (and similar APIs) in this macro to
 // deal with errors.
@@ -94,7 +97,7 @@ kj::StringPtr getAlgorithmName(const kj::OneOf<kj::String, T>& param) {
   }
 }
 
-class CryptoKey::Impl {
+class CryptoKey::Impl: public kj::AtomicRefcounted {
 public:
   // C++ API
 
@@ -114,7 +117,9 @@ public:
   static ImportFunc importEddsa;
   static ImportFunc importRsaRaw;
 
-  using GenerateFunc = kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>(
+  // Returns a promise so that generators for which it is slow, such as RSA's, can do the work on
+  // a background thread.
+  using GenerateFunc = jsg::Promise<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>>(
       jsg::Lock& js, kj::StringPtr normalizedName,
       SubtleCrypto::GenerateKeyAlgorithm&& algorithm, bool extractable,
       kj::ArrayPtr<const kj::String> keyUsages);
@@ -165,6 +170,17 @@ public:
         getAlgorithmName(), "\".");
   }
 
+  // Validates the arguments as deriveBits() would, then returns a function that computes the
+  // same result without touching the isolate, so that it can run on a background thread.
+  // Algorithms whose derivation is cheap don't override this, and return null without consuming
+  // `algorithm`; the caller then uses deriveBits().
+  using DeriveBitsJob = kj::Function<kj::Array<kj::byte>()>;
+  virtual kj::Maybe<DeriveBitsJob> prepareDeriveBits(
+      jsg::Lock& js,
+      SubtleCrypto::DeriveKeyAlgorithm&& algorithm, kj::Maybe<uint32_t> length) const {
+    return kj::none;
+  }
+
   virtual kj::Array<kj::byte> wrapKey(SubtleCrypto::EncryptAlgorithm&& algorithm,
       kj::ArrayPtr<const kj::byte> unwrappedKey) const {
     // For many algorithms, wrapKey() is the same as encrypt(), so as a convenience the default
@@ -311,6 +327,39 @@ struct ClearErrorOnReturn {
   KJ_DISALLOW_COPY_AND_MOVE(ClearErrorOnReturn);
 };
 
+// Calls `func()` on ThreadPool::getDefault() and returns its result to the isolate thread. Argument
+// validation must already be done: `func` must not touch the isolate, and must own everything it
+// captures. The time `func` takes is charged to the current request's CPU limit (see
+// LimitEnforcer::chargeBackgroundCpu()); it is CPU-bound, so its running time is its CPU time.
+//
+// Outside of a request, `func` runs right away on the calling thread.
+template <typename Func>
+auto runOnThreadPool(jsg::Lock& js, Func&& func) -> jsg::Promise<decltype(func())> {
+  using T = decltype(func());
+  if (!IoContext::hasCurrent()) {
+    return js.evalNow([&]() { return func(); });
+  }
+
+  struct Timed {
+    T result;
+    kj::Duration time;
+  };
+  return IoContext::current().awaitIo(js, ThreadPool::getDefault().run(
+      [func = kj::fwd<Func>(func)]() mutable {
+    // BoringSSL's error queue is per-thread, and nothing on this thread will look at it, so make
+    // sure errors left by one job can't show up in the next.
+    ERR_clear_error();
+    KJ_DEFER(ERR_clear_error());
+    auto& clock = kj::systemPreciseMonotonicClock();
+    auto start = clock.now();
+    T result = func();
+    return Timed { kj::mv(result), clock.now() - start };
+  }), [](jsg::Lock&, Timed timed) {
+    IoContext::current().getLimitEnforcer().chargeBackgroundCpu(timed.time);
+    return kj::mv(timed.result);
+  });
+}
+
 // Returns ceil(a / b) for integers (std::ceil always returns a floating point result).
 template <typename T>
 static inline T integerCeilDivision(T a, T b) {
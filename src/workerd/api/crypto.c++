@@ -10,6 +10,7 @@
 #include <workerd/jsg/jsg.h>
 #include "util.h"
 #include <workerd/io/io-context.h>
+#include <workerd/util/thread-pool.h>
 #include <workerd/util/uuid.h>
 #include <set>
 #include <algorithm>
@@ -264,6 +265,30 @@ template <typename T, typename = kj::EnableIf<kj::isSameType<
   });
 }
 
+// Operations on at least this many bytes of input run on a background thread, so that hashing or
+// encrypting a large buffer doesn't hold up everything else waiting on the isolate. Below this,
+// handing the work to another thread costs more than it saves.
+constexpr size_t OFFLOAD_THRESHOLD = 64 * 1024;
+
+// Calls `func(inputs...)` to compute the result of a key or digest operation, either right away or,
+// for large inputs, through runOnThreadPool(). Validation must already be done. Since `func` may
+// run on another thread, it must not touch the isolate and must own everything it captures; it is
+// passed copies of the inputs in that case, since the caller may modify their buffers while the
+// operation is in progress.
+template <typename Func, typename... Inputs>
+auto runCryptoOperation(jsg::Lock& js, Func&& func, const Inputs&... inputs)
+    -> jsg::Promise<decltype(func(inputs.asPtr()...))> {
+  size_t size = (inputs.size() + ...);
+  if (size < OFFLOAD_THRESHOLD) {
+    return js.evalNow([&]() { return func(inputs.asPtr()...); });
+  }
+
+  return runOnThreadPool(js,
+      [func = kj::fwd<Func>(func), ...copies = kj::heapArray(inputs.asPtr())]() mutable {
+    return func(copies.asPtr()...);
+  });
+}
+
 }  // namespace
 
 // =======================================================================================
@@ -304,7 +329,11 @@ jsg::Promise<kj::Array<kj::byte>> SubtleCrypto::encrypt(
 
   return js.evalNow([&] {
     validateOperation(key, algorithm.name, CryptoKeyUsageSet::encrypt());
-    return key.impl->encrypt(kj::mv(algorithm), plainText);
+    return runCryptoOperation(js,
+        [impl = kj::atomicAddRef(*key.impl), algorithm = kj::mv(algorithm)](
+            kj::ArrayPtr<const kj::byte> plainText) mutable {
+      return impl->encrypt(kj::mv(algorithm), plainText);
+    }, plainText);
   });
 }
 
@@ -319,7 +348,11 @@ jsg::Promise<kj::Array<kj::byte>> SubtleCrypto::decrypt(
 
   return js.evalNow([&] {
     validateOperation(key, algorithm.name, CryptoKeyUsageSet::decrypt());
-    return key.impl->decrypt(kj::mv(algorithm), cipherText);
+    return runCryptoOperation(js,
+        [impl = kj::atomicAddRef(*key.impl), algorithm = kj::mv(algorithm)](
+            kj::ArrayPtr<const kj::byte> cipherText) mutable {
+      return impl->decrypt(kj::mv(algorithm), cipherText);
+    }, cipherText);
   });
 }
 
@@ -334,7 +367,11 @@ jsg::Promise<kj::Array<kj::byte>> SubtleCrypto::sign(
 
   return js.evalNow([&] {
     validateOperation(key, algorithm.name, CryptoKeyUsageSet::sign());
-    return key.impl->sign(kj::mv(algorithm), data);
+    return runCryptoOperation(js,
+        [impl = kj::atomicAddRef(*key.impl), algorithm = kj::mv(algorithm)](
+            kj::ArrayPtr<const kj::byte> data) mutable {
+      return impl->sign(kj::mv(algorithm), data);
+    }, data);
   });
 }
 
@@ -350,7 +387,11 @@ jsg::Promise<bool> SubtleCrypto::verify(
 
   return js.evalNow([&] {
     validateOperation(key, algorithm.name, CryptoKeyUsageSet::verify());
-    return key.impl->verify(kj::mv(algorithm), signature, data);
+    return runCryptoOperation(js,
+        [impl = kj::atomicAddRef(*key.impl), algorithm = kj::mv(algorithm)](
+            kj::ArrayPtr<const kj::byte> signature, kj::ArrayPtr<const kj::byte> data) mutable {
+      return impl->verify(kj::mv(algorithm), signature, data);
+    }, signature, data);
   });
 }
 
@@ -365,17 +406,19 @@ jsg::Promise<kj::Array<kj::byte>> SubtleCrypto::digest(
   return js.evalNow([&] {
     auto type = lookupDigestAlgorithm(algorithm.name).second;
 
-    auto digestCtx = makeDigestContext();
-    KJ_ASSERT(digestCtx != nullptr);
+    return runCryptoOperation(js, [type](kj::ArrayPtr<const kj::byte> data) {
+      auto digestCtx = makeDigestContext();
+      KJ_ASSERT(digestCtx != nullptr);
 
-    OSSLCALL(EVP_DigestInit_ex(digestCtx.get(), type, nullptr));
-    OSSLCALL(EVP_DigestUpdate(digestCtx.get(), data.begin(), data.size()));
-    auto messageDigest = kj::heapArray<kj::byte>(EVP_MD_CTX_size(digestCtx.get()));
-    uint messageDigestSize = 0;
-    OSSLCALL(EVP_DigestFinal_ex(digestCtx.get(), messageDigest.begin(), &messageDigestSize));
+      OSSLCALL(EVP_DigestInit_ex(digestCtx.get(), type, nullptr));
+      OSSLCALL(EVP_DigestUpdate(digestCtx.get(), data.begin(), data.size()));
+      auto messageDigest = kj::heapArray<kj::byte>(EVP_MD_CTX_size(digestCtx.get()));
+      uint messageDigestSize = 0;
+      OSSLCALL(EVP_DigestFinal_ex(digestCtx.get(), messageDigest.begin(), &messageDigestSize));
 
-    KJ_ASSERT(messageDigestSize == messageDigest.size());
-    return kj::mv(messageDigest);
+      KJ_ASSERT(messageDigestSize == messageDigest.size());
+      return kj::mv(messageDigest);
+    }, data);
   });
 }
 
@@ -393,22 +436,24 @@ jsg::Promise<kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair>> SubtleCrypto::genera
     JSG_REQUIRE(algoImpl.generateFunc != nullptr, DOMNotSupportedError,
         "Unrecognized key generation algorithm \"", algorithm.name, "\" requested.");
 
-    auto cryptoKeyOrPair = algoImpl.generateFunc(js, algoImpl.name, kj::mv(algorithm), extractable,
-                                                 keyUsages);
-    KJ_SWITCH_ONEOF(cryptoKeyOrPair) {
-      KJ_CASE_ONEOF(cryptoKey, jsg::Ref<CryptoKey>) {
-        if (keyUsages.size() == 0) {
-          auto type = cryptoKey->getType();
-          JSG_REQUIRE(type != "secret" && type != "private", DOMSyntaxError,
-              "Secret/private CryptoKeys must have at least one usage.");
+    return algoImpl.generateFunc(js, algoImpl.name, kj::mv(algorithm), extractable, keyUsages)
+        .then(js, [noUsages = keyUsages.size() == 0](jsg::Lock& js,
+            kj::OneOf<jsg::Ref<CryptoKey>, CryptoKeyPair> cryptoKeyOrPair) {
+      KJ_SWITCH_ONEOF(cryptoKeyOrPair) {
+        KJ_CASE_ONEOF(cryptoKey, jsg::Ref<CryptoKey>) {
+          if (noUsages) {
+            auto type = cryptoKey->getType();
+            JSG_REQUIRE(type != "secret" && type != "private", DOMSyntaxError,
+                "Secret/private CryptoKeys must have at least one usage.");
+          }
+        }
+        KJ_CASE_ONEOF(keyPair, CryptoKeyPair) {
+          JSG_REQUIRE(keyPair.privateKey->getUsageSet().size() != 0, DOMSyntaxError,
+            "Attempt to generate asymmetric keys with no valid private key usages.");
         }
       }
-      KJ_CASE_ONEOF(keyPair, CryptoKeyPair) {
-        JSG_REQUIRE(keyPair.privateKey->getUsageSet().size() != 0, DOMSyntaxError,
-          "Attempt to generate asymmetric keys with no valid private key usages.");
-      }
-    }
-    return cryptoKeyOrPair;
+      return kj::mv(cryptoKeyOrPair);
+    });
   });
 }
 
@@ -429,13 +474,21 @@ jsg::Promise<jsg::Ref<CryptoKey>> SubtleCrypto::deriveKey(
 
     auto length = getKeyLength(derivedKeyAlgorithm);
 
-    auto secret = baseKey.impl->deriveBits(js, kj::mv(algorithm), length);
-
     // TODO(perf): For conformance, importKey() makes a copy of `secret`. In this case we really
     //   don't need to, but rather we ought to call the appropriate CryptoKey::Impl::import*()
     //   function directly.
-    return importKeySync(
-        js, "raw", kj::mv(secret), kj::mv(derivedKeyAlgorithm), extractable, kj::mv(keyUsages));
+    KJ_IF_SOME(job, baseKey.impl->prepareDeriveBits(js, kj::mv(algorithm), length)) {
+      return runOnThreadPool(js, kj::mv(job)).then(js,
+          [self = JSG_THIS, derivedKeyAlgorithm = kj::mv(derivedKeyAlgorithm), extractable,
+           keyUsages = kj::mv(keyUsages)](jsg::Lock& js, kj::Array<kj::byte> secret) mutable {
+        return self->importKeySync(
+            js, "raw", kj::mv(secret), kj::mv(derivedKeyAlgorithm), extractable, keyUsages);
+      });
+    }
+
+    auto secret = baseKey.impl->deriveBits(js, kj::mv(algorithm), length);
+    return js.resolvedPromise(importKeySync(
+        js, "raw", kj::mv(secret), kj::mv(derivedKeyAlgorithm), extractable, kj::mv(keyUsages)));
   });
 }
 
@@ -456,7 +509,10 @@ jsg::Promise<kj::Array<kj::byte>> SubtleCrypto::deriveBits(
 
   return js.evalNow([&] {
     validateOperation(baseKey, algorithm.name, CryptoKeyUsageSet::deriveBits());
-    return baseKey.impl->deriveBits(js, kj::mv(algorithm), length);
+    KJ_IF_SOME(job, baseKey.impl->prepareDeriveBits(js, kj::mv(algorithm), length)) {
+      return runOnThreadPool(js, kj::mv(job));
+    }
+    return js.resolvedPromise(baseKey.impl->deriveBits(js, kj::mv(algorithm), length));
   });
 }
 
@@ -670,8 +726,9 @@ DigestStreamSink::DigestStreamSink(
     HashAlgorithm algorithm,
     kj::Own<kj::PromiseFulfiller<kj::Array<kj::byte>>> fulfiller)
     : algorithm(kj::mv(algorithm)),
-      state(initContext(this->algorithm)),
-      fulfiller(kj::mv(fulfiller)) {}
+      state(kj::atomicRefcounted<Context>(initContext(this->algorithm))),
+      fulfiller(kj::mv(fulfiller)),
+      ioContext(IoContext::tryGetWeakRefForCurrent()) {}
 
 DigestStreamSink::~DigestStreamSink() {
   if (fulfiller && fulfiller->isWaiting()) {
@@ -682,45 +739,86 @@ DigestStreamSink::~DigestStreamSink() {
 }
 
 kj::Promise<void> DigestStreamSink::write(const void* buffer, size_t size) {
+  auto piece = kj::arrayPtr(reinterpret_cast<const kj::byte*>(buffer), size);
+  co_await write(kj::arrayPtr(&piece, 1));
+}
+
+kj::Promise<void> DigestStreamSink::write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) {
+  co_await kj::mv(pending);
+  pending = kj::READY_NOW;
+
   KJ_SWITCH_ONEOF(state) {
     KJ_CASE_ONEOF(closed, Closed) {
-      return kj::READY_NOW;
+      co_return;
     }
     KJ_CASE_ONEOF(errored, Errored) {
-      return kj::cp(errored);
+      kj::throwFatalException(kj::cp(errored));
     }
-    KJ_CASE_ONEOF(context, DigestContextPtr) {
-      auto checkErrorsOnFinish = webCryptoOperationBegin(__func__, algorithm.name);
-      OSSLCALL(EVP_DigestUpdate(context.get(), buffer, size));
-      return kj::READY_NOW;
+    KJ_CASE_ONEOF(context, kj::Own<Context>) {
+      size_t size = 0;
+      for (auto& piece: pieces) {
+        size += piece.size();
+      }
+
+      if (size < OFFLOAD_THRESHOLD) {
+        auto checkErrorsOnFinish = webCryptoOperationBegin(__func__, algorithm.name);
+        for (auto& piece: pieces) {
+          OSSLCALL(EVP_DigestUpdate(context->ptr.get(), piece.begin(), piece.size()));
+        }
+        co_return;
+      }
+
+      // Hash on the thread pool, which lets several streams be hashed on separate cores. We have
+      // to copy the data, since the caller may reuse its buffers once we return.
+      auto data = kj::heapArray<kj::byte>(size);
+      auto pos = data.begin();
+      for (auto& piece: pieces) {
+        memcpy(pos, piece.begin(), piece.size());
+        pos += piece.size();
+      }
+      pending = ThreadPool::getDefault().run(
+          [context = kj::atomicAddRef(*context), data = kj::mv(data)]() {
+        ERR_clear_error();
+        KJ_DEFER(ERR_clear_error());
+        auto& clock = kj::systemPreciseMonotonicClock();
+        auto start = clock.now();
+        OSSLCALL(EVP_DigestUpdate(context->ptr.get(), data.begin(), data.size()));
+        return clock.now() - start;
+      }).then([this](kj::Duration time) {
+        KJ_IF_SOME(ref, ioContext) {
+          ref->runIfAlive([&](IoContext& context) {
+            context.getLimitEnforcer().chargeBackgroundCpu(time);
+          });
+        }
+      }, [this](kj::Exception&& exception) {
+        abort(kj::mv(exception));
+      });
+      co_return;
     }
   }
   KJ_UNREACHABLE;
 }
 
-kj::Promise<void> DigestStreamSink::write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) {
-  for (auto& piece : pieces) {
-    co_await write(piece.begin(), piece.size());
-  }
-}
-
 kj::Promise<void> DigestStreamSink::end() {
+  co_await kj::mv(pending);
+  pending = kj::READY_NOW;
+
   KJ_SWITCH_ONEOF(state) {
     KJ_CASE_ONEOF(closed, Closed) {
-      return kj::READY_NOW;
+      co_return;
     }
     KJ_CASE_ONEOF(errored, Errored) {
-      return kj::cp(errored);
+      kj::throwFatalException(kj::cp(errored));
     }
-    KJ_CASE_ONEOF(context, DigestContextPtr) {
+    KJ_CASE_ONEOF(context, kj::Own<Context>) {
       auto checkErrorsOnFinish = webCryptoOperationBegin(__func__, algorithm.name);
       uint size = 0;
-      auto digest = kj::heapArray<kj::byte>(EVP_MD_CTX_size(context.get()));
-      OSSLCALL(EVP_DigestFinal_ex(context.get(), digest.begin(), &size));
+      auto digest = kj::heapArray<kj::byte>(EVP_MD_CTX_size(context->ptr.get()));
+      OSSLCALL(EVP_DigestFinal_ex(context->ptr.get(), digest.begin(), &size));
       KJ_ASSERT(size, digest.size());
       state.init<Closed>();
       fulfiller->fulfill(kj::mv(digest));
-      return kj::READY_NOW;
+      co_return;
     }
   }
   KJ_UNREACHABLE;
@@ -613,9 +613,24 @@ private:
   struct Closed {};
   using Errored = kj::Exception;
 
+  // The hash state, shared with a background thread while a large write is hashed there.
+  struct Context: public kj::AtomicRefcounted {
+    explicit Context(DigestContextPtr ptr): ptr(kj::mv(ptr)) {}
+    DigestContextPtr ptr;
+  };
+
   SubtleCrypto::HashAlgorithm algorithm;
-  kj::OneOf<DigestContextPtr, Closed, Errored> state;
+  kj::OneOf<kj::Own<Context>, Closed, Errored> state;
   kj::Own<kj::PromiseFulfiller<kj::Array<kj::byte>>> fulfiller;
+
+  // The request that created the stream, which is charged for the time spent hashing on the
+  // background thread.
+  kj::Maybe<kj::Own<IoContext::WeakRef>> ioContext;
+
+  // Resolves once the background thread has finished hashing the last large write. The write
+  // itself completes as soon as its data has been copied, so that the stream can fetch the next
+  // chunk while this one is hashed; the next write waits here to keep updates in order.
+  kj::Promise<void> pending = kj::READY_NOW;
 };
 
 // DigestStream is a non-standard extension that provides a way of generating
@@ -15,9 +15,11 @@
 #include <workerd/util/http-util.h>
 #include <workerd/util/mimetype.h>
 #include <workerd/util/stream-utils.h>
+#include <workerd/util/strings.h>
 #include <workerd/util/thread-scopes.h>
 #include <workerd/jsg/ser.h>
 #include <workerd/io/io-context.h>
+#include <algorithm>
 #include <set>
 
 namespace workerd::api {
@@ -109,35 +111,127 @@ void requireValidHeaderValue(kj::StringPtr value) {
   }
 }
 
+struct BuiltinHeader {
+  kj::HttpHeaderId id;
+  kj::String key;  // lower-cased name
+};
+
+// Returns the headers that have a builtin kj::HttpHeaderId, ordered by lower-cased name.
+// Headers::Storage::builtins is indexed by position in this list.
+kj::ArrayPtr<const BuiltinHeader> builtinHeaders() {
+  static const kj::Array<BuiltinHeader> headers = []() {
+    kj::Vector<BuiltinHeader> unsorted;
+#define ADD_HEADER(id, name) \
+    unsorted.add(BuiltinHeader { kj::HttpHeaderId::id, toLowerCopy(kj::StringPtr(name)) });
+    KJ_HTTP_FOR_EACH_BUILTIN_HEADER(ADD_HEADER)
+#undef ADD_HEADER
+
+    auto order = KJ_MAP(header, unsorted) -> const BuiltinHeader* { return &header; };
+    std::sort(order.begin(), order.end(), [](const BuiltinHeader* a, const BuiltinHeader* b) {
+      return kj::StringPtr(a->key) < kj::StringPtr(b->key);
+    });
+    return KJ_MAP(header, order) { return BuiltinHeader { header->id, kj::str(header->key) }; };
+  }();
+  return headers;
+}
+
+kj::Maybe<size_t> findBuiltinHeader(kj::StringPtr key) {
+  auto headers = builtinHeaders();
+  auto iter = std::lower_bound(headers.begin(), headers.end(), key,
+      [](const BuiltinHeader& header, kj::StringPtr target) {
+    return kj::StringPtr(header.key) < target;
+  });
+  if (iter == headers.end() || iter->key != key) {
+    return kj::none;
+  }
+  return static_cast<size_t>(iter - headers.begin());
+}
+
+kj::Maybe<size_t> findBuiltinHeader(kj::HttpHeaderId id) {
+  auto headers = builtinHeaders();
+  for (auto i: kj::indices(headers)) {
+    if (headers[i].id == id) {
+      return i;
+    }
+  }
+  return kj::none;
+}
+
 }  // namespace
 
 Headers::Headers(jsg::Dict<jsg::ByteString, jsg::ByteString> dict)
-    : guard(Guard::NONE) {
+    : guard(Guard::NONE), storage(kj::refcounted<Storage>()) {
   for (auto& field: dict.fields) {
     append(kj::mv(field.name), kj::mv(field.value));
   }
 }
 
 Headers::Headers(const Headers& other)
-    : guard(Guard::NONE) {
-  for (auto& header: other.headers) {
+    : guard(Guard::NONE), storage(kj::addRef(*other.storage)) {}
+
+Headers::Headers(const kj::HttpHeaders& other, Guard guard)
+    : guard(guard), storage(kj::refcounted<Storage>()) {
+  other.forEach([this](kj::HttpHeaderId id, kj::StringPtr value) {
+    KJ_IF_SOME(i, findBuiltinHeader(id)) {
+      auto normalized = normalizeHeaderValue(jsg::ByteString(kj::str(value)));
+      requireValidHeaderValue(normalized);
+      storage->builtins[i].add(kj::mv(normalized));
+    } else {
+      addFromKj(id.toString(), value);
+    }
+  }, [this](kj::StringPtr name, kj::StringPtr value) {
+    addFromKj(name, value);
+  });
+}
+
+void Headers::addFromKj(kj::StringPtr name, kj::StringPtr value) {
+  jsg::ByteString nameCopy(kj::str(name));
+  requireValidHeaderName(nameCopy);
+  auto key = toLower(nameCopy);
+  auto normalized = normalizeHeaderValue(jsg::ByteString(kj::str(value)));
+  requireValidHeaderValue(normalized);
+  appendUnguarded(kj::mv(key), kj::mv(nameCopy), kj::mv(normalized));
+}
+
+kj::Own<Headers::Storage> Headers::Storage::clone() const {
+  auto result = kj::refcounted<Storage>();
+  for (auto i: kj::indices(builtins)) {
+    for (auto& value: builtins[i]) {
+      result->builtins[i].add(jsg::ByteString(kj::str(value)));
+    }
+  }
+  for (auto& header: headers) {
     Header copy {
       jsg::ByteString(kj::str(header.second.key)),
       jsg::ByteString(kj::str(header.second.name)),
       KJ_MAP(value, header.second.values) { return jsg::ByteString(kj::str(value)); },
     };
     kj::StringPtr keyRef = copy.key;
-    KJ_ASSERT(headers.insert(std::make_pair(keyRef, kj::mv(copy))).second);
+    KJ_ASSERT(result->headers.insert(std::make_pair(keyRef, kj::mv(copy))).second);
   }
+  return result;
 }
 
-Headers::Headers(const kj::HttpHeaders& other, Guard guard)
-    : guard(Guard::NONE) {
-  other.forEach([this](auto name, auto value) {
-    append(jsg::ByteString(kj::str(name)), jsg::ByteString(kj::str(value)));
-  });
+Headers::Storage& Headers::mutableStorage() {
+  if (storage->isShared()) {
+    storage = storage->clone();
+  }
+  return *storage;
+}
 
-  this->guard = guard;
+kj::Maybe<const kj::Vector<jsg::ByteString>&> Headers::findLowerCase(kj::StringPtr key) const {
+  KJ_IF_SOME(i, findBuiltinHeader(key)) {
+    auto& values = storage->builtins[i];
+    if (values.size() == 0) {
+      return kj::none;
+    }
+    return values;
+  }
+  auto iter = storage->headers.find(key);
+  if (iter == storage->headers.end()) {
+    return kj::none;
+  }
+  return iter->second.values;
 }
 
 jsg::Ref<Headers> Headers::clone() const {
@@ -148,8 +242,22 @@ jsg::Ref<Headers> Headers::clone() const {
 
 // Fill in the given HttpHeaders with these headers. Note that strings are inserted by
 // reference, so the output must be consumed immediately.
+//
+// Headers with a builtin id are written under the name kj gives that id (e.g. "Content-Type"),
+// rather than the casing they were set with. This is no change on the wire: kj::HttpHeaders looks
+// names up in its table, and serializes any header it finds there under the table's name.
 void Headers::shallowCopyTo(kj::HttpHeaders& out) {
-  for (auto& entry: headers) {
+  auto builtins = builtinHeaders();
+  for (auto i: kj::indices(builtins)) {
+    auto& values = storage->builtins[i];
+    if (values.size() == 1) {
+      out.set(builtins[i].id, values[0]);
+    } else if (values.size() > 1) {
+      // kj::HttpHeaders holds a single, comma-concatenated value for each header with an id.
+      out.set(builtins[i].id, kj::strArray(values, ", "));
+    }
+  }
+  for (auto& entry: storage->headers) {
     for (auto& value: entry.second.values) {
       out.add(entry.second.name, value);
     }
@@ -162,41 +270,23 @@ bool Headers::hasLowerCase(kj::StringPtr name) {
     KJ_DREQUIRE(!('A' <= c && c <= 'Z'));
   }
 #endif
-  return headers.find(name) != headers.end();
+  return findLowerCase(name) != kj::none;
 }
 
 kj::Array<Headers::DisplayedHeader> Headers::getDisplayedHeaders(jsg::Lock& js) {
-  if (FeatureFlags::get(js).getHttpHeadersGetSetCookie()) {
-    kj::Vector<Headers::DisplayedHeader> copy;
-    for (auto& entry : headers) {
-      if (entry.first == "set-cookie") {
-        // For set-cookie entries, we iterate each individually without
-        // combining them.
-        for (auto& value : entry.second.values) {
-          copy.add(Headers::DisplayedHeader {
-            .key = jsg::ByteString(kj::str(entry.first)),
-            .value = jsg::ByteString(kj::str(value)),
-          });
-        }
-      } else {
-        copy.add(Headers::DisplayedHeader {
-          .key = jsg::ByteString(kj::str(entry.first)),
-          .value = jsg::ByteString(kj::strArray(entry.second.values, ", "))
-        });
-      }
+  kj::Vector<Headers::DisplayedHeader> copy;
+  IteratorState state(kj::addRef(*storage), FeatureFlags::get(js).getHttpHeadersGetSetCookie());
+  while (true) {
+    KJ_IF_SOME(ref, iteratorAdvance(state)) {
+      copy.add(Headers::DisplayedHeader {
+        .key = jsg::ByteString(kj::str(ref.key)),
+        .value = ref.displayValue(),
+      });
+    } else {
+      break;
     }
-    return copy.releaseAsArray();
-  } else {
-    // The old behavior before the standard getSetCookie() API was introduced...
-    auto headersCopy = KJ_MAP(mapEntry, headers) {
-      const auto& header = mapEntry.second;
-      return DisplayedHeader {
-        jsg::ByteString(kj::str(header.key)),
-        jsg::ByteString(kj::strArray(header.values, ", "))
-      };
-    };
-    return headersCopy;
   }
+  return copy.releaseAsArray();
 }
 
 jsg::Ref<Headers> Headers::constructor(jsg::Lock& js, jsg::Optional<Initializer> init) {
@@ -246,17 +336,16 @@ jsg::Ref<Headers> Headers::constructor(jsg::Lock& js, jsg::Optional<Initializer>
 
 kj::Maybe<jsg::ByteString> Headers::get(jsg::ByteString name) {
   requireValidHeaderName(name);
-  auto iter = headers.find(toLower(kj::mv(name)));
-  if (iter == headers.end()) {
-    return kj::none;
-  } else {
-    return jsg::ByteString(kj::strArray(iter->second.values, ", "));
+  KJ_IF_SOME(values, findLowerCase(toLower(kj::mv(name)))) {
+    return jsg::ByteString(kj::strArray(values, ", "));
   }
+  return kj::none;
 }
 
 kj::ArrayPtr<jsg::ByteString> Headers::getSetCookie() {
-  auto iter = headers.find("set-cookie");
-  if (iter == headers.end()) {
+  // Set-Cookie has no builtin id, so it is always in the map.
+  auto iter = storage->headers.find("set-cookie");
+  if (iter == storage->headers.end()) {
     return nullptr;
   } else {
     return iter->second.values.asPtr();
@@ -278,7 +367,7 @@ kj::ArrayPtr<jsg::ByteString> Headers::getAll(jsg::ByteString name) {
 
 bool Headers::has(jsg::ByteString name) {
   requireValidHeaderName(name);
-  return headers.find(toLower(kj::mv(name))) != headers.end();
+  return findLowerCase(toLower(kj::mv(name))) != kj::none;
 }
 
 void Headers::set(jsg::ByteString name, jsg::ByteString value) {
@@ -291,7 +380,15 @@ void Headers::setUnguarded(jsg::ByteString name, jsg::ByteString value) {
   auto key = toLower(name);
   value = normalizeHeaderValue(kj::mv(value));
   requireValidHeaderValue(value);
-  auto [iter, emplaced] = headers.try_emplace(key, kj::mv(key), kj::mv(name), kj::mv(value));
+  auto& target = mutableStorage();
+  KJ_IF_SOME(i, findBuiltinHeader(key)) {
+    auto& values = target.builtins[i];
+    values.clear();
+    values.add(kj::mv(value));
+    return;
+  }
+  auto [iter, emplaced] =
+      target.headers.try_emplace(key, kj::mv(key), kj::mv(name), kj::mv(value));
   if (!emplaced) {
     // Overwrite existing value(s).
     iter->second.values.clear();
@@ -305,7 +402,17 @@ void Headers::append(jsg::ByteString name, jsg::ByteString value) {
   auto key = toLower(name);
   value = normalizeHeaderValue(kj::mv(value));
   requireValidHeaderValue(value);
-  auto [iter, emplaced] = headers.try_emplace(key, kj::mv(key), kj::mv(name), kj::mv(value));
+  appendUnguarded(kj::mv(key), kj::mv(name), kj::mv(value));
+}
+
+void Headers::appendUnguarded(jsg::ByteString key, jsg::ByteString name, jsg::ByteString value) {
+  auto& target = mutableStorage();
+  KJ_IF_SOME(i, findBuiltinHeader(key)) {
+    target.builtins[i].add(kj::mv(value));
+    return;
+  }
+  auto [iter, emplaced] =
+      target.headers.try_emplace(key, kj::mv(key), kj::mv(name), kj::mv(value));
   if (!emplaced) {
     iter->second.values.add(kj::mv(value));
   }
@@ -314,83 +421,82 @@ void Headers::append(jsg::ByteString name, jsg::ByteString value) {
 void Headers::delete_(jsg::ByteString name) {
   checkGuard();
   requireValidHeaderName(name);
-  headers.erase(toLower(kj::mv(name)));
+  auto key = toLower(kj::mv(name));
+  if (findLowerCase(key) == kj::none) {
+    return;
+  }
+  auto& target = mutableStorage();
+  KJ_IF_SOME(i, findBuiltinHeader(key)) {
+    target.builtins[i].clear();
+  } else {
+    target.headers.erase(key);
+  }
 }
 
-// There are a couple implementation details of the Headers iterators worth calling out.
-//
-// 1. Each iterator gets its own copy of the keys and/or values of the headers. While nauseating
-//    from a performance perspective, this solves both the iterator -> iterable lifetime dependence
-//    and the iterator invalidation issue: i.e., it's impossible for a user to unsafely modify the
-//    Headers data structure while iterating over it, because they are simply two separate data
-//    structures. By empirical testing, this seems to be how Chrome implements Headers iteration.
-//
-//    Other alternatives bring their own pitfalls. We could store a Ref of the parent Headers
-//    object, solving the lifetime issue. To solve the iterator invalidation issue, we could store a
-//    copy of the currently-iterated-over key and use std::upper_bound() to find the next entry
-//    every time we want to increment the iterator (making the increment operation O(lg n) rather
-//    than O(1)); or we could make each Header entry in the map store a set of back-pointers to all
-//    live iterators pointing to it, with delete_() incrementing all iterators in the set whenever
-//    it deletes a header entry. Neither hack appealed to me.
-//
-// 2. Notice that the next() member function of the iterator classes moves the string(s) they
-//    contain, rather than making a copy of them as in the FormData iterators. This is safe to do
-//    because, unlike FormData, these iterators have their own copies of the strings, and since they
-//    are forward-only iterators, we know we won't need the strings again.
-//
-// TODO(perf): On point 1, perhaps we could avoid most copies by using a copy-on-write strategy
-//   applied to the header map elements? We'd still copy the whole data structure to avoid iterator
-//   invalidation, but the elements would be cheaper to copy.
+// The Headers iterators hold a reference to the headers as they were when iteration started,
+// which solves both the iterator -> iterable lifetime dependence and the iterator invalidation
+// issue: if the Headers object is modified during iteration, mutableStorage() gives it a fresh
+// copy of the headers, and the iterator carries on over the old one. This matches what users
+// observe in Chrome, which copies the headers up front. Starting an iteration is therefore O(1),
+// and strings are only copied as each entry is yielded.
 
-jsg::Ref<Headers::EntryIterator> Headers::entries(jsg::Lock& js) {
-  return jsg::alloc<EntryIterator>(IteratorState<DisplayedHeader> {
-    getDisplayedHeaders(js)
-  });
+jsg::ByteString Headers::DisplayedHeaderRef::displayValue() const {
+  KJ_IF_SOME(v, value) {
+    return jsg::ByteString(kj::str(v));
+  }
+  return jsg::ByteString(kj::strArray(values, ", "));
 }
-jsg::Ref<Headers::KeyIterator> Headers::keys(jsg::Lock& js) {
-  if (FeatureFlags::get(js).getHttpHeadersGetSetCookie()) {
-    kj::Vector<jsg::ByteString> keysCopy;
-    for (auto& entry : headers) {
-      // Set-Cookie headers must be handled specially. They should never be combined into a
-      // single value, so the values iterator must separate them. It seems a bit silly, but
-      // the keys iterator can end up having multiple set-cookie instances.
-      if (entry.first == "set-cookie") {
-        for (auto n = 0; n < entry.second.values.size(); n++) {
-          keysCopy.add(jsg::ByteString(kj::str(entry.first)));
-        }
-      } else {
-        keysCopy.add(jsg::ByteString(kj::str(entry.first)));
-      }
-    }
-    return jsg::alloc<KeyIterator>(IteratorState<jsg::ByteString> { keysCopy.releaseAsArray() });
-  } else {
-    auto keysCopy = KJ_MAP(mapEntry, headers) {
-      return jsg::ByteString(kj::str(mapEntry.second.key));
+
+kj::Maybe<Headers::DisplayedHeaderRef> Headers::iteratorAdvance(IteratorState& state) {
+  auto builtins = builtinHeaders();
+  auto& snapshot = *state.snapshot;
+  while (state.builtinIndex < builtins.size() &&
+         snapshot.builtins[state.builtinIndex].size() == 0) {
+    ++state.builtinIndex;
+  }
+
+  bool mapDone = state.cursor == snapshot.headers.end();
+  if (state.builtinIndex < builtins.size() &&
+      (mapDone || kj::StringPtr(builtins[state.builtinIndex].key) < state.cursor->first)) {
+    // Set-Cookie has no builtin id, so builtin headers are always shown comma-concatenated.
+    auto i = state.builtinIndex++;
+    return DisplayedHeaderRef {
+      .key = builtins[i].key,
+      .values = snapshot.builtins[i],
+      .value = kj::none,
     };
-    return jsg::alloc<KeyIterator>(IteratorState<jsg::ByteString> { kj::mv(keysCopy) });
   }
-}
-jsg::Ref<Headers::ValueIterator> Headers::values(jsg::Lock& js) {
-  if (FeatureFlags::get(js).getHttpHeadersGetSetCookie()) {
-    kj::Vector<jsg::ByteString> values;
-    for (auto& entry : headers) {
-      // Set-Cookie headers must be handled specially. They should never be combined into a
-      // single value, so the values iterator must separate them.
-      if (entry.first == "set-cookie") {
-        for (auto& value : entry.second.values) {
-          values.add(jsg::ByteString(kj::str(value)));
-        }
-      } else {
-        values.add(jsg::ByteString(kj::strArray(entry.second.values, ", ")));
-      }
+  if (mapDone) {
+    return kj::none;
+  }
+
+  auto& header = state.cursor->second;
+  if (state.splitSetCookie && state.cursor->first == "set-cookie") {
+    // Set-Cookie headers must be handled specially. They should never be combined into a single
+    // value, so each value is visited separately. It seems a bit silly, but this means the keys
+    // iterator can end up yielding multiple set-cookie instances.
+    auto& value = header.values[state.valueIndex];
+    if (++state.valueIndex == header.values.size()) {
+      state.valueIndex = 0;
+      ++state.cursor;
     }
-    return jsg::alloc<ValueIterator>(IteratorState<jsg::ByteString> { values.releaseAsArray() });
-  } else {
-    auto valuesCopy = KJ_MAP(mapEntry, headers) {
-      return jsg::ByteString(kj::strArray(mapEntry.second.values, ", "));
-    };
-    return jsg::alloc<ValueIterator>(IteratorState<jsg::ByteString> { kj::mv(valuesCopy) });
+    return DisplayedHeaderRef { .key = header.key, .values = header.values, .value = value };
   }
+  ++state.cursor;
+  return DisplayedHeaderRef { .key = header.key, .values = header.values, .value = kj::none };
+}
+
+jsg::Ref<Headers::EntryIterator> Headers::entries(jsg::Lock& js) {
+  return jsg::alloc<EntryIterator>(IteratorState(
+      kj::addRef(*storage), FeatureFlags::get(js).getHttpHeadersGetSetCookie()));
+}
+jsg::Ref<Headers::KeyIterator> Headers::keys(jsg::Lock& js) {
+  return jsg::alloc<KeyIterator>(IteratorState(
+      kj::addRef(*storage), FeatureFlags::get(js).getHttpHeadersGetSetCookie()));
+}
+jsg::Ref<Headers::ValueIterator> Headers::values(jsg::Lock& js) {
+  return jsg::alloc<ValueIterator>(IteratorState(
+      kj::addRef(*storage), FeatureFlags::get(js).getHttpHeadersGetSetCookie()));
 }
 
 void Headers::forEach(
@@ -406,8 +512,14 @@ void Headers::forEach(
   }
   callback.setReceiver(js.v8Ref(receiver));
 
-  for (auto& entry: getDisplayedHeaders(js)) {
-    callback(js, entry.value, entry.key, JSG_THIS);
+  // Iterate over a snapshot, so that the callback may modify the headers.
+  IteratorState state(kj::addRef(*storage), FeatureFlags::get(js).getHttpHeadersGetSetCookie());
+  while (true) {
+    KJ_IF_SOME(ref, iteratorAdvance(state)) {
+      callback(js, ref.displayValue(), ref.key, JSG_THIS);
+    } else {
+      break;
+    }
   }
 }
 
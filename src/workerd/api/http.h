@@ -25,10 +25,74 @@ struct QueueResponse;
 
 class Headers: public jsg::Object {
 private:
-  template <typename T>
+  struct Header {
+    jsg::ByteString key;   // lower-cased name
+    jsg::ByteString name;
+
+    // We intentionally do not comma-concatenate header values of the same name, as we need to be
+    // able to re-serialize them separately. This is particularly important for the Set-Cookie
+    // header, which uses a date format that requires a comma. This would normally suggest using a
+    // std::multimap, but we also need to be able to display the values in comma-concatenated form
+    // via Headers.entries()[1] in order to be Fetch-conformant. Storing a vector of strings in a
+    // std::map makes this easier, and also makes it easy to honor the "first header name casing is
+    // used for all duplicate header names" rule[2] that the Fetch spec mandates.
+    //
+    // See: 1: https://fetch.spec.whatwg.org/#concept-header-list-sort-and-combine
+    //      2: https://fetch.spec.whatwg.org/#concept-header-list-append
+    kj::Vector<jsg::ByteString> values;
+
+    explicit Header(jsg::ByteString key, jsg::ByteString name,
+                    kj::Vector<jsg::ByteString> values)
+        : key(kj::mv(key)), name(kj::mv(name)), values(kj::mv(values)) {}
+    explicit Header(jsg::ByteString key, jsg::ByteString name, jsg::ByteString value)
+        : key(kj::mv(key)), name(kj::mv(name)), values(1) {
+      values.add(kj::mv(value));
+    }
+  };
+
+  using HeaderMap = std::map<kj::StringPtr, Header>;
+
+  // Number of headers with an id predefined by kj::HttpHeaderId (Host, Content-Type, ...). These
+  // ids are the same in every kj::HttpHeaderTable.
+#define WORKERD_COUNT_HEADER(id, name) + 1
+  static constexpr size_t BUILTIN_HEADER_COUNT =
+      0 KJ_HTTP_FOR_EACH_BUILTIN_HEADER(WORKERD_COUNT_HEADER);
+#undef WORKERD_COUNT_HEADER
+
+  // The headers, shared copy-on-write between Headers objects created from one another and
+  // the iterators created from them. Storage that is shared is never modified; mutating a Headers
+  // object whose storage is shared first gives it a private copy (see mutableStorage()). This way
+  // copying a Headers object or starting an iteration is O(1), and iterators see a snapshot no
+  // matter what happens to the Headers object afterwards.
+  //
+  // Headers with a builtin id are kept in a fixed array rather than in the map, so converting them
+  // to and from kj::HttpHeaders is an index copy instead of a lower-casing and a lookup by name.
+  struct Storage: public kj::Refcounted {
+    // Values of the headers with a builtin id, indexed by their position in builtinHeaders()
+    // (i.e. ordered by lower-cased name). An empty vector means the header is absent.
+    kj::FixedArray<kj::Vector<jsg::ByteString>, BUILTIN_HEADER_COUNT> builtins;
+
+    // All other headers, keyed by lower-cased name.
+    HeaderMap headers;
+
+    kj::Own<Storage> clone() const;
+  };
+
+  // Position of an iterator within a snapshot of the headers. Iteration merges the builtin
+  // headers with the map, so that all headers are visited in order of their lower-cased name.
   struct IteratorState {
-    kj::Array<T> copy;
-    decltype(copy.begin()) cursor = copy.begin();
+    kj::Own<Storage> snapshot;
+    size_t builtinIndex = 0;
+    HeaderMap::const_iterator cursor;
+
+    // Whether each Set-Cookie value is visited separately (per the `getSetCookie()` compat
+    // flag), and if so, which of the current header's values is next.
+    bool splitSetCookie;
+    size_t valueIndex = 0;
+
+    IteratorState(kj::Own<Storage> snapshot, bool splitSetCookie)
+        : snapshot(kj::mv(snapshot)), cursor(this->snapshot->headers.begin()),
+          splitSetCookie(splitSetCookie) {}
   };
 
 public:
@@ -45,7 +109,7 @@ public:
     jsg::ByteString value; // comma-concatenation of all values seen
   };
 
-  Headers(): guard(Guard::NONE) {}
+  Headers(): guard(Guard::NONE), storage(kj::refcounted<Storage>()) {}
   explicit Headers(jsg::Dict<jsg::ByteString, jsg::ByteString> dict);
   explicit Headers(const Headers& other);
   explicit Headers(const kj::HttpHeaders& other, Guard guard);
@@ -117,16 +181,16 @@ public:
 
   JSG_ITERATOR(EntryIterator, entries,
                 kj::Array<jsg::ByteString>,
-                IteratorState<DisplayedHeader>,
+                IteratorState,
                 entryIteratorNext)
   JSG_ITERATOR(KeyIterator, keys,
                 jsg::ByteString,
-                IteratorState<jsg::ByteString>,
-                keyOrValueIteratorNext)
+                IteratorState,
+                keyIteratorNext)
   JSG_ITERATOR(ValueIterator, values,
                 jsg::ByteString,
-                IteratorState<jsg::ByteString>,
-                keyOrValueIteratorNext)
+                IteratorState,
+                valueIteratorNext)
 
   // JavaScript API.
 
@@ -164,52 +228,57 @@ public:
   }
 
 private:
-  struct Header {
-    jsg::ByteString key;   // lower-cased name
-    jsg::ByteString name;
-
-    // We intentionally do not comma-concatenate header values of the same name, as we need to be
-    // able to re-serialize them separately. This is particularly important for the Set-Cookie
-    // header, which uses a date format that requires a comma. This would normally suggest using a
-    // std::multimap, but we also need to be able to display the values in comma-concatenated form
-    // via Headers.entries()[1] in order to be Fetch-conformant. Storing a vector of strings in a
-    // std::map makes this easier, and also makes it easy to honor the "first header name casing is
-    // used for all duplicate header names" rule[2] that the Fetch spec mandates.
-    //
-    // See: 1: https://fetch.spec.whatwg.org/#concept-header-list-sort-and-combine
-    //      2: https://fetch.spec.whatwg.org/#concept-header-list-append
-    kj::Vector<jsg::ByteString> values;
-
-    explicit Header(jsg::ByteString key, jsg::ByteString name,
-                    kj::Vector<jsg::ByteString> values)
-        : key(kj::mv(key)), name(kj::mv(name)), values(kj::mv(values)) {}
-    explicit Header(jsg::ByteString key, jsg::ByteString name, jsg::ByteString value)
-        : key(kj::mv(key)), name(kj::mv(name)), values(1) {
-      values.add(kj::mv(value));
-    }
+  // A header as displayed by the iterators and forEach(): the header's lower-cased name and
+  // values, plus which of its values to show if it is a Set-Cookie header being shown one value at
+  // a time. Otherwise, all values are shown comma-concatenated.
+  struct DisplayedHeaderRef {
+    kj::StringPtr key;
+    const kj::Vector<jsg::ByteString>& values;
+    kj::Maybe<const jsg::ByteString&> value;
+
+    jsg::ByteString displayValue() const;
   };
 
   Guard guard;
-  std::map<kj::StringPtr, Header> headers;
+  kj::Own<Storage> storage;
+
+  // Returns the storage for modification, first copying it if it is shared.
+  Storage& mutableStorage();
+
+  // Returns the values of the header with the given lower-cased name, or none if it is absent.
+  kj::Maybe<const kj::Vector<jsg::ByteString>&> findLowerCase(kj::StringPtr key) const;
+
+  // Appends `value` to the header, which must already be validated and normalized.
+  void appendUnguarded(jsg::ByteString key, jsg::ByteString name, jsg::ByteString value);
+
+  // Appends a header from a kj::HttpHeaders that has no builtin id.
+  void addFromKj(kj::StringPtr name, kj::StringPtr value);
 
   void checkGuard() {
     JSG_REQUIRE(guard == Guard::NONE, TypeError, "Can't modify immutable headers.");
   }
 
+  static kj::Maybe<DisplayedHeaderRef> iteratorAdvance(IteratorState& state);
+
   static kj::Maybe<kj::Array<jsg::ByteString>> entryIteratorNext(jsg::Lock& js, auto& state) {
-    if (state.cursor == state.copy.end()) {
-      return kj::none;
+    KJ_IF_SOME(ref, iteratorAdvance(state)) {
+      return kj::arr(jsg::ByteString(kj::str(ref.key)), ref.displayValue());
+    }
+    return kj::none;
+  }
+
+  static kj::Maybe<jsg::ByteString> keyIteratorNext(jsg::Lock& js, auto& state) {
+    KJ_IF_SOME(ref, iteratorAdvance(state)) {
+      return jsg::ByteString(kj::str(ref.key));
     }
-    auto& ret = *state.cursor++;
-    return kj::arr(kj::mv(ret.key), kj::mv(ret.value));
+    return kj::none;
   }
 
-  static kj::Maybe<jsg::ByteString> keyOrValueIteratorNext(jsg::Lock& js, auto& state) {
-    if (state.cursor == state.copy.end()) {
-      return kj::none;
+  static kj::Maybe<jsg::ByteString> valueIteratorNext(jsg::Lock& js, auto& state) {
+    KJ_IF_SOME(ref, iteratorAdvance(state)) {
+      return ref.displayValue();
     }
-    auto& ret = *state.cursor++;
-    return kj::mv(ret);
+    return kj::none;
   }
 };
 
@@ -0,0 +1,99 @@
+// Copyright (c) 2017-2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "kv.h"
+#include <kj/test.h>
+
+namespace workerd::api {
+namespace {
+
+kj::Array<const kj::byte> bytes(kj::StringPtr s) {
+  return kj::heapArray(s.asBytes());
+}
+
+kj::String valueOf(kj::Own<KvReadCache::Entry>& entry) {
+  KJ_IF_SOME(v, entry->value) {
+    return kj::str(v.asChars());
+  }
+  return kj::str("<none>");
+}
+
+KJ_TEST("KvReadCache hits and misses") {
+  KvReadCache cache(1 << 20);
+  auto now = kj::UNIX_EPOCH + 1000 * kj::SECONDS;
+
+  KJ_EXPECT(cache.find("kv", "foo", now, 60 * kj::SECONDS) == kj::none);
+
+  cache.insert("kv", "foo", bytes("bar"), kj::str("{\"a\":1}"), now, cache.getEraseCount());
+  cache.insert("kv", "missing", kj::none, kj::none, now, cache.getEraseCount());
+
+  {
+    auto entry = KJ_ASSERT_NONNULL(cache.find("kv", "foo", now + 10 * kj::SECONDS, 60 * kj::SECONDS));
+    KJ_EXPECT(valueOf(entry) == "bar");
+    KJ_EXPECT(KJ_ASSERT_NONNULL(entry->metadata) == "{\"a\":1}");
+  }
+  {
+    auto entry = KJ_ASSERT_NONNULL(cache.find("kv", "missing", now, 60 * kj::SECONDS));
+    KJ_EXPECT(entry->value == kj::none);
+  }
+
+  // Namespaces are separate.
+  KJ_EXPECT(cache.find("other", "foo", now, 60 * kj::SECONDS) == kj::none);
+  cache.insert("a", "bc", bytes("1"), kj::none, now, cache.getEraseCount());
+  KJ_EXPECT(cache.find("ab", "c", now, 60 * kj::SECONDS) == kj::none);
+
+  // Each read decides how stale an entry it accepts.
+  KJ_EXPECT(cache.find("kv", "foo", now + 10 * kj::SECONDS, 5 * kj::SECONDS) == kj::none);
+  KJ_EXPECT(cache.find("kv", "foo", now + 61 * kj::SECONDS, 60 * kj::SECONDS) == kj::none);
+
+  auto stats = cache.getStats();
+  KJ_EXPECT(stats.hits == 2);
+  KJ_EXPECT(stats.misses == 5);
+  KJ_EXPECT(stats.entries == 3);
+}
+
+KJ_TEST("KvReadCache evicts least recently used entries") {
+  // Room for two small entries, but not three.
+  KvReadCache cache(2 * (sizeof(KvReadCache::Entry) + 64 + 10) + 10);
+  auto now = kj::UNIX_EPOCH;
+  auto ttl = 60 * kj::SECONDS;
+
+  cache.insert("kv", "a", bytes("1"), kj::none, now, cache.getEraseCount());
+  cache.insert("kv", "b", bytes("2"), kj::none, now, cache.getEraseCount());
+  KJ_EXPECT(cache.find("kv", "a", now, ttl) != kj::none);
+
+  cache.insert("kv", "c", bytes("3"), kj::none, now, cache.getEraseCount());
+  KJ_EXPECT(cache.getStats().entries == 2);
+  KJ_EXPECT(cache.find("kv", "a", now, ttl) != kj::none);
+  KJ_EXPECT(cache.find("kv", "b", now, ttl) == kj::none);
+  KJ_EXPECT(cache.find("kv", "c", now, ttl) != kj::none);
+
+  // Entries too large to fit are returned but not cached.
+  kj::Array<const kj::byte> big = kj::heapArray<kj::byte>(cache.getStats().bytes * 4);
+  auto entry = cache.insert("kv", "big", kj::mv(big), kj::none, now, cache.getEraseCount());
+  KJ_EXPECT(entry->value != kj::none);
+  KJ_EXPECT(cache.find("kv", "big", now, ttl) == kj::none);
+  KJ_EXPECT(cache.getStats().entries == 2);
+}
+
+KJ_TEST("KvReadCache erase") {
+  KvReadCache cache(1 << 20);
+  auto now = kj::UNIX_EPOCH;
+  auto ttl = 60 * kj::SECONDS;
+
+  cache.insert("kv", "foo", bytes("old"), kj::none, now, cache.getEraseCount());
+  cache.erase("kv", "foo");
+  KJ_EXPECT(cache.find("kv", "foo", now, ttl) == kj::none);
+  KJ_EXPECT(cache.getStats().bytes == 0);
+
+  // A fetch that started before a write isn't cached.
+  auto before = cache.getEraseCount();
+  cache.erase("kv", "foo");
+  auto entry = cache.insert("kv", "foo", bytes("old"), kj::none, now, before);
+  KJ_EXPECT(valueOf(entry) == "old");
+  KJ_EXPECT(cache.find("kv", "foo", now, ttl) == kj::none);
+}
+
+}  // namespace
+}  // namespace workerd::api
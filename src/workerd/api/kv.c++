@@ -9,6 +9,8 @@
 #include <workerd/io/limit-enforcer.h>
 #include <workerd/util/http-util.h>
 #include <workerd/util/mimetype.h>
+#include <workerd/util/sqlite-kv-namespace.h>
+#include <workerd/util/stream-utils.h>
 #include <workerd/io/io-context.h>
 #include <kj/encoding.h>
 #include <kj/compat/http.h>
@@ -17,6 +19,8 @@ namespace workerd::api {
 
 // As documented in Cloudflare's Worker KV limits.
 static constexpr size_t kMaxKeyLength = 512;
+static constexpr size_t kMaxValueLength = 25 * 1024 * 1024;
+static constexpr size_t kMaxMetadataLength = 1024;
 
 static void checkForErrorStatus(kj::StringPtr method, const kj::HttpClient::Response& response) {
   if (response.statusCode < 200 || response.statusCode >= 300) {
@@ -61,6 +65,235 @@ static void parseListMetadata(jsg::Lock& js,
   });
 }
 
+// As documented in Cloudflare's Worker KV limits.
+static constexpr uint kMaxListLimit = 1000;
+static constexpr size_t kMaxBulkKeys = 100;
+
+// Accounts for the bookkeeping of each KvReadCache entry, beyond its key, value, and metadata.
+static constexpr size_t kCacheEntryOverhead = sizeof(KvReadCache::Entry) + 64;
+
+// Namespace names may contain any character, so the name's length is included to keep keys of
+// different namespaces apart.
+static kj::String cacheKey(kj::StringPtr ns, kj::StringPtr key) {
+  return kj::str(ns.size(), ':', ns, key);
+}
+
+KvReadCache::~KvReadCache() noexcept(false) {
+  while (!lru.empty()) {
+    lru.remove(*lru.begin());
+  }
+  entries.clear();
+}
+
+kj::Maybe<kj::Own<KvReadCache::Entry>> KvReadCache::find(
+    kj::StringPtr ns, kj::StringPtr key, kj::Date now, kj::Duration ttl) {
+  auto mapKey = cacheKey(ns, key);
+  KJ_IF_SOME(e, entries.find(mapKey)) {
+    auto& entry = *e;
+    if (now - entry.fetched <= ttl) {
+      ++hits;
+      lru.remove(entry);
+      lru.add(entry);
+      return kj::addRef(entry);
+    }
+  }
+  ++misses;
+  return kj::none;
+}
+
+kj::Own<KvReadCache::Entry> KvReadCache::insert(
+    kj::StringPtr ns, kj::StringPtr key, kj::Maybe<kj::Array<const kj::byte>> value,
+    kj::Maybe<kj::String> metadata, kj::Date fetched, uint64_t eraseCountBeforeFetch) {
+  auto entry = kj::refcounted<Entry>();
+  entry->value = kj::mv(value);
+  entry->metadata = kj::mv(metadata);
+  entry->key = cacheKey(ns, key);
+  entry->fetched = fetched;
+  entry->size = kCacheEntryOverhead + entry->key.size();
+  KJ_IF_SOME(v, entry->value) {
+    entry->size += v.size();
+  }
+  KJ_IF_SOME(m, entry->metadata) {
+    entry->size += m.size();
+  }
+
+  if (eraseCountBeforeFetch != eraseCount || entry->size > maxBytes) {
+    return entry;
+  }
+
+  KJ_IF_SOME(existing, entries.find(entry->key)) {
+    remove(*existing);
+  }
+  while (usedBytes + entry->size > maxBytes) {
+    remove(*lru.begin());
+  }
+
+  usedBytes += entry->size;
+  lru.add(*entry);
+  entries.insert(kj::str(entry->key), kj::addRef(*entry));
+  return entry;
+}
+
+void KvReadCache::erase(kj::StringPtr ns, kj::StringPtr key) {
+  ++eraseCount;
+  KJ_IF_SOME(entry, entries.find(cacheKey(ns, key))) {
+    remove(*entry);
+  }
+}
+
+void KvReadCache::remove(Entry& entry) {
+  lru.remove(entry);
+  usedBytes -= entry.size;
+  // The map holds a reference, so look up by a copy of the key rather than by the entry's own key,
+  // which is freed along with the entry if this was the last reference.
+  auto key = kj::mv(entry.key);
+  KJ_ASSERT(entries.erase(key));
+}
+
+// Converts a cached value to the requested type.
+static KvNamespace::GetWithMetadataResult getCached(jsg::Lock& js, IoContext& context,
+    kj::Own<KvReadCache::Entry> entry, kj::StringPtr typeName) {
+  KvNamespace::GetResult value;
+  KJ_IF_SOME(bytes, entry->value) {
+    if (typeName == "stream") {
+      auto input = newMemoryInputStream(bytes).attach(kj::addRef(*entry));
+      value = KvNamespace::GetResult(jsg::alloc<ReadableStream>(context,
+          newSystemStream(kj::mv(input), StreamEncoding::IDENTITY, context)));
+    } else if (typeName == "text") {
+      value = KvNamespace::GetResult(kj::str(bytes.asChars()));
+    } else if (typeName == "arrayBuffer") {
+      // JavaScript may modify the ArrayBuffer, so it needs its own copy.
+      value = KvNamespace::GetResult(kj::heapArray(bytes));
+    } else if (typeName == "json") {
+      value = KvNamespace::GetResult(
+          jsg::JsRef(js, jsg::JsValue::fromJson(js, bytes.asChars())));
+    } else {
+      JSG_FAIL_REQUIRE(TypeError,
+          "Unknown response type. Possible types are \"text\", \"arrayBuffer\", "
+          "\"json\", and \"stream\".");
+    }
+  }
+
+  return KvNamespace::GetWithMetadataResult {
+    .value = kj::mv(value),
+    .metadata = entry->metadata.map([&](kj::String& m) {
+      return jsg::JsRef(js, jsg::JsValue::fromJson(js, m));
+    }),
+    .cacheStatus = kj::none,
+  };
+}
+
+// The following implement KV operations against a namespace stored in this process (see
+// IoChannelFactory::getLocalKvNamespace()), producing the same results the HTTP protocol would.
+
+static KvNamespace::GetWithMetadataResult getLocal(jsg::Lock& js, IoContext& context,
+    SqliteKvNamespace& ns, kj::StringPtr name, kj::StringPtr typeName) {
+  auto maybeEntry = ns.get(name);
+  auto entry = KJ_UNWRAP_OR(maybeEntry, {
+    return KvNamespace::GetWithMetadataResult {
+      .value = kj::none,
+      .metadata = kj::none,
+      .cacheStatus = kj::none,
+    };
+  });
+
+  KvNamespace::GetResult value;
+  if (typeName == "stream") {
+    auto input = newMemoryInputStream(entry.value).attach(kj::mv(entry.value));
+    value = KvNamespace::GetResult(jsg::alloc<ReadableStream>(context,
+        newSystemStream(kj::mv(input), StreamEncoding::IDENTITY, context)));
+  } else if (typeName == "text") {
+    value = KvNamespace::GetResult(kj::str(entry.value.asChars()));
+  } else if (typeName == "arrayBuffer") {
+    value = KvNamespace::GetResult(kj::mv(entry.value));
+  } else if (typeName == "json") {
+    value = KvNamespace::GetResult(
+        jsg::JsRef(js, jsg::JsValue::fromJson(js, entry.value.asChars())));
+  } else {
+    JSG_FAIL_REQUIRE(TypeError,
+        "Unknown response type. Possible types are \"text\", \"arrayBuffer\", "
+        "\"json\", and \"stream\".");
+  }
+
+  return KvNamespace::GetWithMetadataResult {
+    .value = kj::mv(value),
+    .metadata = entry.metadata.map([&](kj::String& m) {
+      return jsg::JsRef(js, jsg::JsValue::fromJson(js, m));
+    }),
+    .cacheStatus = kj::none,
+  };
+}
+
+static jsg::JsRef<jsg::JsValue> listLocal(jsg::Lock& js, SqliteKvNamespace& ns,
+    kj::StringPtr prefix, uint limit, kj::Maybe<kj::StringPtr> cursor) {
+  auto result = ns.list(prefix, limit, cursor);
+
+  return js.withinHandleScope([&] {
+    auto keys = KJ_MAP(key, result.keys) -> jsg::JsValue {
+      auto obj = js.obj();
+      obj.set(js, "name"_kjc, js.str(key.name));
+      KJ_IF_SOME(e, key.expiration) {
+        obj.set(js, "expiration"_kjc, js.num(static_cast<double>(e)));
+      }
+      KJ_IF_SOME(m, key.metadata) {
+        obj.set(js, "metadata"_kjc, jsg::JsValue::fromJson(js, m));
+      }
+      return obj;
+    };
+
+    auto obj = js.obj();
+    obj.set(js, "keys"_kjc, js.arr(keys.asPtr()));
+    obj.set(js, "list_complete"_kjc, js.boolean(result.cursor == kj::none));
+    KJ_IF_SOME(c, result.cursor) {
+      obj.set(js, "cursor"_kjc, js.str(c));
+    }
+    obj.set(js, "cacheStatus"_kjc, js.null());
+    return jsg::JsRef<jsg::JsValue>(js, obj);
+  });
+}
+
+static jsg::Promise<void> putLocal(jsg::Lock& js, SqliteKvNamespace& ns, kj::String name,
+    KvNamespace::PutSupportedTypes body, kj::Maybe<kj::String> metadata,
+    kj::Maybe<int64_t> expiration) {
+  // The remote namespace enforces these limits on its end, so a local one has to check them here.
+  KJ_IF_SOME(m, metadata) {
+    JSG_REQUIRE(m.size() <= kMaxMetadataLength, Error, "KV PUT failed: 413 Metadata length of ",
+        m.size(), " exceeds limit of ", kMaxMetadataLength, ".");
+  }
+
+  // `value` is either a kj::String or a kj::Array<byte>.
+  auto write = [&ns, name = kj::mv(name), metadata = kj::mv(metadata), expiration]
+      (jsg::Lock& js, auto value) mutable {
+    JSG_REQUIRE(value.size() <= kMaxValueLength, Error, "KV PUT failed: 413 Value length of ",
+        value.size(), " exceeds limit of ", kMaxValueLength, ".");
+    auto& context = IoContext::current();
+    return context.awaitIo(js, context.waitForOutputLocks(),
+        [&ns, name = kj::mv(name), metadata = kj::mv(metadata), expiration,
+         value = kj::mv(value)](jsg::Lock&) {
+      ns.put(name, value.asBytes(),
+             metadata.map([](kj::String& m) -> kj::StringPtr { return m; }), expiration);
+    });
+  };
+
+  KJ_SWITCH_ONEOF(body) {
+    KJ_CASE_ONEOF(text, kj::String) {
+      return write(js, kj::mv(text));
+    }
+    KJ_CASE_ONEOF(data, kj::Array<byte>) {
+      return write(js, kj::mv(data));
+    }
+    KJ_CASE_ONEOF(stream, jsg::Ref<ReadableStream>) {
+      auto& context = IoContext::current();
+      return stream->getController()
+          .readAllBytes(js, context.getLimitEnforcer().getBufferingLimit())
+          .then(js, [write = kj::mv(write)](jsg::Lock& js, kj::Array<byte> data) mutable {
+        return write(js, kj::mv(data));
+      });
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
 constexpr auto FLPROD_405_HEADER = "CF-KV-FLPROD-405"_kj;
 
 kj::Own<kj::HttpClient> KvNamespace::getHttpClient(
@@ -103,44 +336,141 @@ kj::Own<kj::HttpClient> KvNamespace::getHttpClient(
 }
 
 
+kj::Promise<void> KvNamespace::invalidateCached(kj::StringPtr name, kj::Promise<void> write) {
+  KJ_IF_SOME(rc, readCache) {
+    rc.cache->erase(rc.ns, name);
+    return write.then([cache = kj::addRef(*rc.cache), ns = kj::str(rc.ns),
+                       key = kj::str(name)]() {
+      cache->erase(ns, key);
+    });
+  }
+  return kj::mv(write);
+}
+
+struct ParsedGetOptions {
+  kj::Maybe<kj::String> type;
+  kj::Maybe<int> cacheTtl;
+};
+
+static ParsedGetOptions parseGetOptions(
+    jsg::Optional<kj::OneOf<kj::String, KvNamespace::GetOptions>> options) {
+  ParsedGetOptions result;
+  KJ_IF_SOME(oneOfOptions, options) {
+    KJ_SWITCH_ONEOF(oneOfOptions) {
+      KJ_CASE_ONEOF(t, kj::String) {
+        result.type = kj::mv(t);
+      }
+      KJ_CASE_ONEOF(options, KvNamespace::GetOptions) {
+        KJ_IF_SOME(t, options.type) {
+          result.type = kj::mv(t);
+        }
+        result.cacheTtl = options.cacheTtl;
+      }
+    }
+  }
+  return result;
+}
+
 jsg::Promise<KvNamespace::GetResult> KvNamespace::get(
-    jsg::Lock& js, kj::String name, jsg::Optional<kj::OneOf<kj::String, GetOptions>> options,
+    jsg::Lock& js, GetKeys name, jsg::Optional<kj::OneOf<kj::String, GetOptions>> options,
     CompatibilityFlags::Reader flags) {
   return js.evalNow([&] {
-    auto resp = getWithMetadata(js, kj::mv(name), kj::mv(options));
-    return resp.then(js, [](jsg::Lock&, KvNamespace::GetWithMetadataResult result) {
-      return kj::mv(result.value);
-    });
+    KJ_SWITCH_ONEOF(name) {
+      KJ_CASE_ONEOF(names, kj::Array<kj::String>) {
+        auto resp = getBulk(js, kj::mv(names), kj::mv(options), false);
+        return resp.then(js, [](jsg::Lock&, jsg::JsRef<jsg::JsValue> map) {
+          return KvNamespace::GetResult(kj::mv(map));
+        });
+      }
+      KJ_CASE_ONEOF(n, kj::String) {
+        auto resp = getOne(js, kj::mv(n), kj::mv(options));
+        return resp.then(js, [](jsg::Lock&, KvNamespace::GetWithMetadataResult result) {
+          return kj::mv(result.value);
+        });
+      }
+    }
+    KJ_UNREACHABLE;
   });
 }
 
-jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
+jsg::Promise<kj::OneOf<KvNamespace::GetWithMetadataResult, jsg::JsRef<jsg::JsValue>>>
+    KvNamespace::getWithMetadata(jsg::Lock& js, GetKeys name,
+                                 jsg::Optional<kj::OneOf<kj::String, GetOptions>> options) {
+  using Result = kj::OneOf<GetWithMetadataResult, jsg::JsRef<jsg::JsValue>>;
+  return js.evalNow([&] {
+    KJ_SWITCH_ONEOF(name) {
+      KJ_CASE_ONEOF(names, kj::Array<kj::String>) {
+        auto resp = getBulk(js, kj::mv(names), kj::mv(options), true);
+        return resp.then(js, [](jsg::Lock&, jsg::JsRef<jsg::JsValue> map) {
+          return Result(kj::mv(map));
+        });
+      }
+      KJ_CASE_ONEOF(n, kj::String) {
+        auto resp = getOne(js, kj::mv(n), kj::mv(options));
+        return resp.then(js, [](jsg::Lock&, GetWithMetadataResult result) {
+          return Result(kj::mv(result));
+        });
+      }
+    }
+    KJ_UNREACHABLE;
+  });
+}
+
+jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getOne(
     jsg::Lock& js, kj::String name, jsg::Optional<kj::OneOf<kj::String, GetOptions>> options) {
   validateKeyName("GET", name);
 
   auto& context = IoContext::current();
 
+  auto [type, cacheTtl] = parseGetOptions(kj::mv(options));
+
+  auto resultType = type.map([](const kj::String& s) -> kj::StringPtr { return s; })
+      .orDefault("text");
+
+  KJ_IF_SOME(local, context.getLocalKvNamespace(subrequestChannel)) {
+    context.getLimitEnforcer().newKvRequest(LimitEnforcer::KvOpType::GET);
+    return js.evalNow([&] {
+      return js.resolvedPromise(getLocal(js, context, local, name, resultType));
+    });
+  }
+
+  // Values read as streams aren't buffered, so they are served from the cache but not added to it.
+  struct CacheFill {
+    kj::Own<KvReadCache> cache;
+    kj::String ns;
+    kj::String key;
+    uint64_t eraseCount;
+  };
+  kj::Maybe<CacheFill> cacheFill;
+  KJ_IF_SOME(rc, readCache) {
+    auto ttl = cacheTtl.map([](int t) { return t * kj::SECONDS; })
+        .orDefault(KvReadCache::DEFAULT_TTL);
+    if (ttl > 0 * kj::SECONDS) {
+      KJ_IF_SOME(entry, rc.cache->find(rc.ns, name, context.now(), ttl)) {
+        context.getMetrics().kvReadCacheHit();
+        return js.evalNow([&] {
+          return js.resolvedPromise(getCached(js, context, kj::mv(entry), resultType));
+        });
+      }
+      context.getMetrics().kvReadCacheMiss();
+      if (resultType != "stream") {
+        cacheFill = CacheFill {
+          .cache = kj::addRef(*rc.cache),
+          .ns = kj::str(rc.ns),
+          .key = kj::str(name),
+          .eraseCount = rc.cache->getEraseCount(),
+        };
+      }
+    }
+  }
+
   kj::Url url;
   url.scheme = kj::str("https");
   url.host = kj::str("fake-host");
   url.path.add(kj::mv(name));
   url.query.add(kj::Url::QueryParam { kj::str("urlencoded"), kj::str("true") });
-
-  kj::Maybe<kj::String> type;
-  KJ_IF_SOME(oneOfOptions, options) {
-    KJ_SWITCH_ONEOF(oneOfOptions) {
-      KJ_CASE_ONEOF(t, kj::String) {
-        type = kj::mv(t);
-      }
-      KJ_CASE_ONEOF(options, GetOptions) {
-        KJ_IF_SOME(t, options.type) {
-          type = kj::mv(t);
-        }
-        KJ_IF_SOME(cacheTtl, options.cacheTtl) {
-          url.query.add(kj::Url::QueryParam { kj::str("cache_ttl"), kj::str(cacheTtl) });
-        }
-      }
-    }
+  KJ_IF_SOME(t, cacheTtl) {
+    url.query.add(kj::Url::QueryParam { kj::str("cache_ttl"), kj::str(t) });
   }
 
   auto urlStr = url.toString(kj::Url::Context::HTTP_PROXY_REQUEST);
@@ -151,7 +481,7 @@ jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
   auto request = client->request(kj::HttpMethod::GET, urlStr, headers);
   return context.awaitIo(js,
       kj::mv(request.response),
-      [type = kj::mv(type), &context, client = kj::mv(client)]
+      [type = kj::mv(type), &context, client = kj::mv(client), cacheFill = kj::mv(cacheFill)]
           (jsg::Lock& js, kj::HttpClient::Response&& response) mutable
           -> jsg::Promise<KvNamespace::GetWithMetadataResult> {
 
@@ -161,6 +491,9 @@ jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
         });
 
     if (response.statusCode == 404 || response.statusCode == 410) {
+      KJ_IF_SOME(fill, cacheFill) {
+        fill.cache->insert(fill.ns, fill.key, kj::none, kj::none, context.now(), fill.eraseCount);
+      }
       return js.resolvedPromise(KvNamespace::GetWithMetadataResult {
         .value = kj::none,
         .metadata = kj::none,
@@ -185,6 +518,23 @@ jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
         response.body.attach(kj::mv(client)), getContentEncoding(context, *response.headers,
             Response::BodyEncoding::AUTO, FeatureFlags::get(js)));
 
+    KJ_IF_SOME(fill, cacheFill) {
+      return context.awaitIo(js,
+          stream->readAllBytes(context.getLimitEnforcer().getBufferingLimit())
+              .attach(kj::mv(stream)),
+          [fill = kj::mv(fill), type = kj::mv(type), maybeMeta = kj::mv(maybeMeta),
+           cacheStatus = kj::mv(cacheStatus)](jsg::Lock& js, kj::Array<byte> bytes) mutable {
+        auto& context = IoContext::current();
+        auto entry = fill.cache->insert(fill.ns, fill.key, kj::Array<const byte>(kj::mv(bytes)),
+            kj::mv(maybeMeta), context.now(), fill.eraseCount);
+        auto typeName = type.map([](const kj::String& s) -> kj::StringPtr { return s; })
+            .orDefault("text");
+        auto result = getCached(js, context, kj::mv(entry), typeName);
+        result.cacheStatus = kj::mv(cacheStatus);
+        return result;
+      });
+    }
+
     jsg::Promise<KvNamespace::GetResult> result = nullptr;
 
     if (typeName == "stream") {
@@ -235,11 +585,280 @@ jsg::Promise<KvNamespace::GetWithMetadataResult> KvNamespace::getWithMetadata(
   });
 }
 
+// Builds what a bulk read returns for one key: the value itself, or with `withMetadata`, an object
+// like the one getWithMetadata() returns.
+static jsg::JsValue bulkResult(jsg::Lock& js, jsg::JsValue value, jsg::JsValue metadata,
+                               jsg::JsValue cacheStatus, bool withMetadata) {
+  if (!withMetadata) {
+    return value;
+  }
+  auto obj = js.obj();
+  obj.set(js, "value"_kjc, value);
+  obj.set(js, "metadata"_kjc, metadata);
+  obj.set(js, "cacheStatus"_kjc, cacheStatus);
+  return obj;
+}
+
+// Builds the Map a bulk read returns from read cache entries, one per name. `cacheStatus` is
+// reported for the names that had to be fetched.
+static jsg::JsObject cachedBulkResults(jsg::Lock& js, kj::ArrayPtr<const kj::String> names,
+    kj::ArrayPtr<kj::Maybe<kj::Own<KvReadCache::Entry>>> entries, kj::ArrayPtr<const bool> hits,
+    bool json, bool withMetadata, jsg::JsValue cacheStatus) {
+  auto map = js.map();
+  for (auto i: kj::indices(names)) {
+    auto& entry = *KJ_ASSERT_NONNULL(entries[i]);
+    jsg::JsValue value = js.null();
+    jsg::JsValue metadata = js.null();
+    KJ_IF_SOME(bytes, entry.value) {
+      auto chars = bytes.asChars();
+      value = json ? jsg::JsValue::fromJson(js, chars) : jsg::JsValue(js.str(chars));
+    }
+    KJ_IF_SOME(m, entry.metadata) {
+      metadata = jsg::JsValue::fromJson(js, m);
+    }
+    map.set(js, js.str(names[i]), bulkResult(js, value, metadata,
+        hits[i] ? jsg::JsValue(js.null()) : cacheStatus, withMetadata));
+  }
+  return map;
+}
+
+jsg::Promise<jsg::JsRef<jsg::JsValue>> KvNamespace::getBulk(
+    jsg::Lock& js, kj::Array<kj::String> names,
+    jsg::Optional<kj::OneOf<kj::String, GetOptions>> options, bool withMetadata) {
+  JSG_REQUIRE(names.size() > 0 && names.size() <= kMaxBulkKeys, TypeError,
+      "KV GET failed: Bulk reads must request between 1 and ", kMaxBulkKeys, " keys.");
+  for (auto& name: names) {
+    validateKeyName("GET", name);
+  }
+
+  auto& context = IoContext::current();
+
+  auto [type, cacheTtl] = parseGetOptions(kj::mv(options));
+
+  auto resultType = type.map([](const kj::String& s) -> kj::StringPtr { return s; })
+      .orDefault("text");
+  JSG_REQUIRE(resultType == "text" || resultType == "json", TypeError,
+      "Unsupported response type for a bulk read. Possible types are \"text\" and \"json\".");
+  bool json = resultType == "json";
+
+  KJ_IF_SOME(local, context.getLocalKvNamespace(subrequestChannel)) {
+    context.getLimitEnforcer().newKvRequest(LimitEnforcer::KvOpType::GET);
+    return js.withinHandleScope([&] {
+      auto map = js.map();
+      for (auto& name: names) {
+        jsg::JsValue value = js.null();
+        jsg::JsValue metadata = js.null();
+        auto maybeEntry = local.get(name);
+        KJ_IF_SOME(entry, maybeEntry) {
+          auto chars = entry.value.asChars();
+          value = json ? jsg::JsValue::fromJson(js, chars) : jsg::JsValue(js.str(chars));
+          KJ_IF_SOME(m, entry.metadata) {
+            metadata = jsg::JsValue::fromJson(js, m);
+          }
+        }
+        map.set(js, js.str(name), bulkResult(js, value, metadata, js.null(), withMetadata));
+      }
+      return js.resolvedPromise(jsg::JsRef<jsg::JsValue>(js, map));
+    });
+  }
+
+  // With a read cache, keys are served from it where possible and only the rest are fetched. Those
+  // are fetched as text with metadata regardless of what was asked for, so that they can be cached
+  // for any later read.
+  struct BulkCacheFill {
+    kj::Own<KvReadCache> cache;
+    kj::String ns;
+    uint64_t eraseCount;
+
+    // One per name; null until fetched for names that weren't cached.
+    kj::Array<kj::Maybe<kj::Own<KvReadCache::Entry>>> entries;
+    kj::Array<bool> hits;
+  };
+  kj::Maybe<BulkCacheFill> cacheFill;
+  kj::Vector<kj::StringPtr> toFetch;
+  KJ_IF_SOME(rc, readCache) {
+    auto ttl = cacheTtl.map([](int t) { return t * kj::SECONDS; })
+        .orDefault(KvReadCache::DEFAULT_TTL);
+    if (ttl > 0 * kj::SECONDS) {
+      auto fill = BulkCacheFill {
+        .cache = kj::addRef(*rc.cache),
+        .ns = kj::str(rc.ns),
+        .eraseCount = rc.cache->getEraseCount(),
+        .entries = kj::heapArray<kj::Maybe<kj::Own<KvReadCache::Entry>>>(names.size()),
+        .hits = kj::heapArray<bool>(names.size()),
+      };
+      for (auto i: kj::indices(names)) {
+        fill.entries[i] = rc.cache->find(rc.ns, names[i], context.now(), ttl);
+        fill.hits[i] = fill.entries[i] != kj::none;
+        if (fill.hits[i]) {
+          context.getMetrics().kvReadCacheHit();
+        } else {
+          context.getMetrics().kvReadCacheMiss();
+          toFetch.add(names[i]);
+        }
+      }
+      if (toFetch.empty()) {
+        return js.withinHandleScope([&] {
+          auto map = cachedBulkResults(js, names, fill.entries, fill.hits, json, withMetadata,
+                                       js.null());
+          return js.resolvedPromise(jsg::JsRef<jsg::JsValue>(js, map));
+        });
+      }
+      cacheFill = kj::mv(fill);
+    }
+  }
+  if (cacheFill == kj::none) {
+    for (auto& name: names) {
+      toFetch.add(name);
+    }
+  }
+
+  // The keys are fetched in one request: a POST to /bulk/get whose body is a JSON object like
+  // `{"keys": ["a", "b"], "type": "text", "withMetadata": false}`. The response is a JSON object
+  // mapping each key found to its value, or with `withMetadata`, to `{"value", "metadata"}`. Keys
+  // that weren't found are null or left out.
+  bool fetchWithMetadata = withMetadata || cacheFill != kj::none;
+  auto body = js.withinHandleScope([&] {
+    auto keys = KJ_MAP(name, toFetch) -> jsg::JsValue { return js.str(name); };
+    auto obj = js.obj();
+    obj.set(js, "keys"_kjc, js.arr(keys.asPtr()));
+    obj.set(js, "type"_kjc, js.str(cacheFill == kj::none ? resultType : "text"_kj));
+    obj.set(js, "withMetadata"_kjc, js.boolean(fetchWithMetadata));
+    return jsg::JsValue(obj).toJson(js);
+  });
+
+  kj::Url url;
+  url.scheme = kj::str("https");
+  url.host = kj::str("fake-host");
+  url.path.add(kj::str("bulk"));
+  url.path.add(kj::str("get"));
+  KJ_IF_SOME(t, cacheTtl) {
+    url.query.add(kj::Url::QueryParam { kj::str("cache_ttl"), kj::str(t) });
+  }
+
+  auto urlStr = url.toString(kj::Url::Context::HTTP_PROXY_REQUEST);
+
+  auto headers = kj::HttpHeaders(context.getHeaderTable());
+  headers.set(kj::HttpHeaderId::CONTENT_TYPE, MimeType::JSON.toString());
+  auto client = getHttpClient(context, headers, LimitEnforcer::KvOpType::GET, urlStr);
+
+  auto req = client->request(kj::HttpMethod::POST, urlStr, headers, uint64_t(body.size()));
+  auto writePromise = req.body->write(body.begin(), body.size());
+  auto response = writePromise.attach(kj::mv(req.body), kj::mv(body))
+      .then([resp = kj::mv(req.response)]() mutable { return kj::mv(resp); });
+
+  return context.awaitIo(js, kj::mv(response),
+      [&context, client = kj::mv(client), names = kj::mv(names), withMetadata, json,
+       cacheFill = kj::mv(cacheFill)]
+          (jsg::Lock& js, kj::HttpClient::Response&& response) mutable
+          -> jsg::Promise<jsg::JsRef<jsg::JsValue>> {
+    checkForErrorStatus("GET", response);
+
+    auto cacheStatus = response.headers->get(context.getHeaderIds().cfCacheStatus)
+        .map([&](kj::StringPtr cs) {
+          return jsg::JsRef<jsg::JsValue>(js, js.strIntern(cs));
+        });
+
+    auto stream = newSystemStream(
+        response.body.attach(kj::mv(client)), getContentEncoding(context, *response.headers,
+            Response::BodyEncoding::AUTO, FeatureFlags::get(js)));
+
+    return context.awaitIo(js,
+        stream->readAllText(context.getLimitEnforcer().getBufferingLimit())
+            .attach(kj::mv(stream)),
+        [&context, names = kj::mv(names), withMetadata, json, cacheFill = kj::mv(cacheFill),
+         cacheStatus = kj::mv(cacheStatus)](jsg::Lock& js, kj::String text) mutable {
+      // The values were encoded as part of the response, so "json" values are already parsed here.
+      auto results = JSG_REQUIRE_NONNULL(
+          jsg::JsValue::fromJson(js, text).tryCast<jsg::JsObject>(), Error,
+          "KV GET failed: Malformed bulk read response.");
+      auto orNull = [&](jsg::JsValue v) -> jsg::JsValue {
+        return v.isNullOrUndefined() ? jsg::JsValue(js.null()) : v;
+      };
+      auto status = cacheStatus.map([&](jsg::JsRef<jsg::JsValue>& cs) {
+        return cs.getHandle(js);
+      }).orDefault(js.null());
+
+      // Only the response's own properties count, so that a key like "toString" doesn't find
+      // something inherited from Object.prototype.
+      auto resultFor = [&](kj::StringPtr name) -> jsg::JsValue {
+        if (results.has(js, name, jsg::JsObject::HasOption::OWN)) {
+          return results.get(js, name);
+        }
+        return js.null();
+      };
+
+      KJ_IF_SOME(fill, cacheFill) {
+        for (auto i: kj::indices(names)) {
+          if (fill.hits[i]) continue;
+          kj::Maybe<kj::Array<const byte>> value;
+          kj::Maybe<kj::String> metadata;
+          KJ_IF_SOME(obj, resultFor(names[i]).tryCast<jsg::JsObject>()) {
+            auto v = obj.get(js, "value"_kjc);
+            if (!v.isNullOrUndefined()) {
+              value = kj::Array<const byte>(kj::heapArray(v.toString(js).asBytes()));
+            }
+            auto m = obj.get(js, "metadata"_kjc);
+            if (!m.isNullOrUndefined()) {
+              metadata = m.toJson(js);
+            }
+          }
+          fill.entries[i] = fill.cache->insert(fill.ns, names[i], kj::mv(value),
+              kj::mv(metadata), context.now(), fill.eraseCount);
+        }
+        auto map = cachedBulkResults(js, names, fill.entries, fill.hits, json, withMetadata,
+                                     status);
+        return jsg::JsRef<jsg::JsValue>(js, map);
+      }
+
+      auto map = js.map();
+      for (auto& name: names) {
+        jsg::JsValue result = resultFor(name);
+        jsg::JsValue value = js.null();
+        jsg::JsValue metadata = js.null();
+        if (!withMetadata) {
+          value = orNull(result);
+        } else KJ_IF_SOME(obj, result.tryCast<jsg::JsObject>()) {
+          value = orNull(obj.get(js, "value"_kjc));
+          metadata = orNull(obj.get(js, "metadata"_kjc));
+        }
+        map.set(js, js.str(name), bulkResult(js, value, metadata, status, withMetadata));
+      }
+      return jsg::JsRef<jsg::JsValue>(js, map);
+    });
+  });
+}
+
 jsg::Promise<jsg::JsRef<jsg::JsValue>> KvNamespace::list(jsg::Lock& js,
                                                          jsg::Optional<ListOptions> options) {
   return js.evalNow([&] {
     auto& context = IoContext::current();
 
+    KJ_IF_SOME(local, context.getLocalKvNamespace(subrequestChannel)) {
+      context.getLimitEnforcer().newKvRequest(LimitEnforcer::KvOpType::LIST);
+      uint limit = kMaxListLimit;
+      kj::StringPtr prefix;
+      kj::Maybe<kj::StringPtr> cursor;
+      KJ_IF_SOME(o, options) {
+        KJ_IF_SOME(l, o.limit) {
+          if (l > 0) {
+            limit = kj::min(static_cast<uint>(l), kMaxListLimit);
+          }
+        }
+        KJ_IF_SOME(maybePrefix, o.prefix) {
+          KJ_IF_SOME(p, maybePrefix) {
+            prefix = p;
+          }
+        }
+        KJ_IF_SOME(maybeCursor, o.cursor) {
+          KJ_IF_SOME(c, maybeCursor) {
+            cursor = c.asPtr();
+          }
+        }
+      }
+      return js.resolvedPromise(listLocal(js, local, prefix, limit, cursor));
+    }
+
     kj::Url url;
     url.scheme = kj::str("https");
     url.host = kj::str("fake-host");
@@ -313,6 +932,46 @@ jsg::Promise<void> KvNamespace::put(
 
     auto& context = IoContext::current();
 
+    PutSupportedTypes supportedBody;
+
+    KJ_SWITCH_ONEOF(body) {
+      KJ_CASE_ONEOF(text, kj::String) {
+        supportedBody = kj::mv(text);
+      }
+      KJ_CASE_ONEOF(object, jsg::JsObject) {
+        supportedBody = JSG_REQUIRE_NONNULL(putTypeHandler.tryUnwrap(js, object),
+            TypeError, "KV put() accepts only strings, ArrayBuffers, ArrayBufferViews, and "
+            "ReadableStreams as values.");
+        JSG_REQUIRE(!supportedBody.is<kj::String>(),
+            TypeError, "KV put() accepts only strings, ArrayBuffers, ArrayBufferViews, and "
+            "ReadableStreams as values.");
+        // TODO(someday): replace this with logic to do something smarter with Objects
+      }
+    }
+
+    KJ_IF_SOME(local, context.getLocalKvNamespace(subrequestChannel)) {
+      context.getLimitEnforcer().newKvRequest(LimitEnforcer::KvOpType::PUT);
+      kj::Maybe<int64_t> expiration;
+      kj::Maybe<kj::String> metadata;
+      KJ_IF_SOME(o, options) {
+        KJ_IF_SOME(e, o.expiration) {
+          JSG_REQUIRE(e > 0, Error, "KV PUT failed: 400 Invalid expiration of ", e, ".");
+          expiration = e;
+        }
+        KJ_IF_SOME(ttl, o.expirationTtl) {
+          JSG_REQUIRE(ttl > 0, Error, "KV PUT failed: 400 Invalid expiration_ttl of ", ttl, ".");
+          expiration = (context.now() - kj::UNIX_EPOCH) / kj::SECONDS + ttl;
+        }
+        KJ_IF_SOME(maybeMetadata, o.metadata) {
+          KJ_IF_SOME(m, maybeMetadata) {
+            metadata = m.getHandle(js).toJson(js);
+          }
+        }
+      }
+      return putLocal(js, local, kj::mv(name), kj::mv(supportedBody), kj::mv(metadata),
+                      expiration);
+    }
+
     kj::Url url;
     url.scheme = kj::str("https");
     url.host = kj::str("fake-host");
@@ -338,23 +997,6 @@ jsg::Promise<void> KvNamespace::put(
       }
     }
 
-    PutSupportedTypes supportedBody;
-
-    KJ_SWITCH_ONEOF(body) {
-      KJ_CASE_ONEOF(text, kj::String) {
-        supportedBody = kj::mv(text);
-      }
-      KJ_CASE_ONEOF(object, jsg::JsObject) {
-        supportedBody = JSG_REQUIRE_NONNULL(putTypeHandler.tryUnwrap(js, object),
-            TypeError, "KV put() accepts only strings, ArrayBuffers, ArrayBufferViews, and "
-            "ReadableStreams as values.");
-        JSG_REQUIRE(!supportedBody.is<kj::String>(),
-            TypeError, "KV put() accepts only strings, ArrayBuffers, ArrayBufferViews, and "
-            "ReadableStreams as values.");
-        // TODO(someday): replace this with logic to do something smarter with Objects
-      }
-    }
-
     kj::Maybe<uint64_t> expectedBodySize;
 
     KJ_SWITCH_ONEOF(supportedBody) {
@@ -418,7 +1060,8 @@ jsg::Promise<void> KvNamespace::put(
       });
     });
 
-    return context.awaitIo(js, kj::mv(promise));
+    // `url.path[0]` is the key name.
+    return context.awaitIo(js, invalidateCached(url.path[0], kj::mv(promise)));
   });
 }
 
@@ -428,6 +1071,14 @@ jsg::Promise<void> KvNamespace::delete_(jsg::Lock& js, kj::String name) {
 
     auto& context = IoContext::current();
 
+    KJ_IF_SOME(local, context.getLocalKvNamespace(subrequestChannel)) {
+      context.getLimitEnforcer().newKvRequest(LimitEnforcer::KvOpType::DELETE);
+      return context.awaitIo(js, context.waitForOutputLocks(),
+          [&local, name = kj::mv(name)](jsg::Lock&) {
+        local.delete_(name);
+      });
+    }
+
     auto urlStr = kj::str("https://fake-host/", kj::encodeUriComponent(name), "?urlencoded=true");
 
     kj::HttpHeaders headers(context.getHeaderTable());
@@ -443,7 +1094,7 @@ jsg::Promise<void> KvNamespace::delete_(jsg::Lock& js, kj::String name) {
       }).attach(kj::mv(client));
     });
 
-    return context.awaitIo(js, kj::mv(promise));
+    return context.awaitIo(js, invalidateCached(name, kj::mv(promise)));
   });
 }
 
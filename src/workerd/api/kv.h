@@ -7,10 +7,89 @@
 #include <workerd/jsg/jsg.h>
 #include "streams.h"
 #include <workerd/io/limit-enforcer.h>
+#include <kj/list.h>
+#include <kj/map.h>
 
 namespace workerd { class IoContext; }
 namespace workerd::api {
 
+// A bounded LRU of values read through KV bindings, so that hot keys don't go to the KV service on
+// every read. One cache is shared by all of a Worker's KV bindings within its isolate; entries are
+// keyed by the name of the namespace the binding points at and the key name, so bindings to the
+// same namespace share entries.
+//
+// Each read passes its `cacheTtl`: a cached entry is only used if it was fetched at most that long
+// ago. Missing keys are cached too. Writes made through a binding drop the key from the cache, but
+// writes made elsewhere may not be seen until the entry goes stale, as with KV's own edge caching.
+class KvReadCache: public kj::Refcounted {
+public:
+  // How long entries are used for when a read doesn't specify `cacheTtl`. This matches KV's
+  // default.
+  static constexpr kj::Duration DEFAULT_TTL = 60 * kj::SECONDS;
+
+  class Entry: public kj::Refcounted {
+  public:
+    // Null if the key was not found.
+    kj::Maybe<kj::Array<const kj::byte>> value;
+
+    // JSON-encoded metadata, if any.
+    kj::Maybe<kj::String> metadata;
+
+  private:
+    kj::String key;
+    kj::Date fetched = kj::UNIX_EPOCH;
+    size_t size = 0;
+    kj::ListLink<Entry> link;
+
+    friend class KvReadCache;
+  };
+
+  // `maxBytes` bounds the total size of the cached keys, values, and metadata.
+  explicit KvReadCache(uint64_t maxBytes): maxBytes(maxBytes) {}
+  ~KvReadCache() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(KvReadCache);
+
+  // Returns the entry for `key` if it was fetched no earlier than `ttl` before `now`.
+  kj::Maybe<kj::Own<Entry>> find(kj::StringPtr ns, kj::StringPtr key, kj::Date now,
+                                 kj::Duration ttl);
+
+  // Returns a counter that changes whenever erase() is called. Pass its value from before a fetch
+  // to insert(), so that a fetch which raced with a write doesn't leave the old value cached.
+  uint64_t getEraseCount() const { return eraseCount; }
+
+  // Records a value fetched at time `fetched`. The returned entry is valid even if it wasn't cached,
+  // e.g. because it was too large.
+  kj::Own<Entry> insert(kj::StringPtr ns, kj::StringPtr key,
+                        kj::Maybe<kj::Array<const kj::byte>> value,
+                        kj::Maybe<kj::String> metadata, kj::Date fetched,
+                        uint64_t eraseCountBeforeFetch);
+
+  // Drops the entry for `key`, if any.
+  void erase(kj::StringPtr ns, kj::StringPtr key);
+
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    size_t entries;
+    uint64_t bytes;
+  };
+  Stats getStats() const { return { hits, misses, entries.size(), usedBytes }; }
+
+private:
+  uint64_t maxBytes;
+  uint64_t usedBytes = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t eraseCount = 0;
+
+  kj::HashMap<kj::String, kj::Own<Entry>> entries;
+
+  // Least recently used at the front.
+  kj::List<Entry, &Entry::link> lru;
+
+  void remove(Entry& entry);
+};
+
 // A capability to a KV namespace.
 class KvNamespace: public jsg::Object {
 public:
@@ -22,8 +101,18 @@ public:
   // `subrequestChannel` is what to pass to IoContext::getHttpClient() to get an HttpClient
   // representing this namespace.
   // `additionalHeaders` is what gets appended to every outbound request.
-  explicit KvNamespace(kj::Array<AdditionalHeader> additionalHeaders, uint subrequestChannel)
-      : additionalHeaders(kj::mv(additionalHeaders)), subrequestChannel(subrequestChannel) {}
+  // `readCache`, if given, is used to serve get() and getWithMetadata() without going to KV.
+  struct ReadCache {
+    kj::Own<KvReadCache> cache;
+
+    // Names the namespace within the cache. Bindings to the same namespace should use the same
+    // name, so that they share entries and see each other's writes.
+    kj::String ns;
+  };
+  explicit KvNamespace(kj::Array<AdditionalHeader> additionalHeaders, uint subrequestChannel,
+                       kj::Maybe<ReadCache> readCache = kj::none)
+      : additionalHeaders(kj::mv(additionalHeaders)), subrequestChannel(subrequestChannel),
+        readCache(kj::mv(readCache)) {}
 
   struct GetOptions {
     jsg::Optional<kj::String> type;
@@ -41,9 +130,14 @@ public:
                 kj::String,
                 jsg::JsRef<jsg::JsValue>>>;
 
+  // Either a single key name, or an array of up to 100 names to read with one request. Reading an
+  // array of names produces a Map from each name to its result, and only supports the "text" and
+  // "json" types.
+  using GetKeys = kj::OneOf<kj::Array<kj::String>, kj::String>;
+
   jsg::Promise<GetResult> get(
       jsg::Lock& js,
-      kj::String name,
+      GetKeys name,
       jsg::Optional<kj::OneOf<kj::String, GetOptions>> options,
       CompatibilityFlags::Reader flags);
 
@@ -60,9 +154,10 @@ public:
     });
   };
 
-  jsg::Promise<GetWithMetadataResult> getWithMetadata(
+  // Reading an array of names returns a Map from each name to its GetWithMetadataResult.
+  jsg::Promise<kj::OneOf<GetWithMetadataResult, jsg::JsRef<jsg::JsValue>>> getWithMetadata(
       jsg::Lock& js,
-      kj::String name,
+      GetKeys name,
       jsg::Optional<kj::OneOf<kj::String, GetOptions>> options);
 
   struct ListOptions {
@@ -136,6 +231,11 @@ public:
       get<ExpectedValue = unknown>(key: Key, options?: KVNamespaceGetOptions<"json">): Promise<ExpectedValue | null>;
       get(key: Key, options?: KVNamespaceGetOptions<"arrayBuffer">): Promise<ArrayBuffer | null>;
       get(key: Key, options?: KVNamespaceGetOptions<"stream">): Promise<ReadableStream | null>;
+      get(key: Array<Key>, type?: "text"): Promise<Map<string, string | null>>;
+      get<ExpectedValue = unknown>(key: Array<Key>, type: "json"): Promise<Map<string, ExpectedValue | null>>;
+      get(key: Array<Key>, options?: Partial<KVNamespaceGetOptions<undefined>>): Promise<Map<string, string | null>>;
+      get(key: Array<Key>, options?: KVNamespaceGetOptions<"text">): Promise<Map<string, string | null>>;
+      get<ExpectedValue = unknown>(key: Array<Key>, options?: KVNamespaceGetOptions<"json">): Promise<Map<string, ExpectedValue | null>>;
 
       list<Metadata = unknown>(options?: KVNamespaceListOptions): Promise<KVNamespaceListResult<Metadata, Key>>;
 
@@ -150,6 +250,11 @@ public:
       getWithMetadata<ExpectedValue = unknown, Metadata = unknown>(key: Key, options: KVNamespaceGetOptions<"json">): Promise<KVNamespaceGetWithMetadataResult<ExpectedValue, Metadata>>;
       getWithMetadata<Metadata = unknown>(key: Key, options: KVNamespaceGetOptions<"arrayBuffer">): Promise<KVNamespaceGetWithMetadataResult<ArrayBuffer, Metadata>>;
       getWithMetadata<Metadata = unknown>(key: Key, options: KVNamespaceGetOptions<"stream">): Promise<KVNamespaceGetWithMetadataResult<ReadableStream, Metadata>>;
+      getWithMetadata<Metadata = unknown>(key: Array<Key>, type?: "text"): Promise<Map<string, KVNamespaceGetWithMetadataResult<string, Metadata>>>;
+      getWithMetadata<ExpectedValue = unknown, Metadata = unknown>(key: Array<Key>, type: "json"): Promise<Map<string, KVNamespaceGetWithMetadataResult<ExpectedValue, Metadata>>>;
+      getWithMetadata<Metadata = unknown>(key: Array<Key>, options?: Partial<KVNamespaceGetOptions<undefined>>): Promise<Map<string, KVNamespaceGetWithMetadataResult<string, Metadata>>>;
+      getWithMetadata<Metadata = unknown>(key: Array<Key>, options?: KVNamespaceGetOptions<"text">): Promise<Map<string, KVNamespaceGetWithMetadataResult<string, Metadata>>>;
+      getWithMetadata<ExpectedValue = unknown, Metadata = unknown>(key: Array<Key>, options?: KVNamespaceGetOptions<"json">): Promise<Map<string, KVNamespaceGetWithMetadataResult<ExpectedValue, Metadata>>>;
 
       delete(key: Key): Promise<void>;
     });
@@ -171,6 +276,23 @@ protected:
 private:
   kj::Array<AdditionalHeader> additionalHeaders;
   uint subrequestChannel;
+  kj::Maybe<ReadCache> readCache;
+
+  jsg::Promise<GetWithMetadataResult> getOne(
+      jsg::Lock& js,
+      kj::String name,
+      jsg::Optional<kj::OneOf<kj::String, GetOptions>> options);
+
+  // Reads all of `names` with a single request, returning a Map.
+  jsg::Promise<jsg::JsRef<jsg::JsValue>> getBulk(
+      jsg::Lock& js,
+      kj::Array<kj::String> names,
+      jsg::Optional<kj::OneOf<kj::String, GetOptions>> options,
+      bool withMetadata);
+
+  // If there is a read cache, drops `name` from it now and again once `write` completes, so that
+  // reads racing with the write don't leave the old value cached.
+  kj::Promise<void> invalidateCached(kj::StringPtr name, kj::Promise<void> write);
 };
 
 #define EW_KV_ISOLATE_TYPES                 \
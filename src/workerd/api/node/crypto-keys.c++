@@ -116,7 +116,7 @@ kj::StringPtr CryptoImpl::getAsymmetricKeyType(jsg::Lock& js, jsg::Ref<CryptoKey
 }
 
 jsg::Ref<CryptoKey> CryptoImpl::createSecretKey(jsg::Lock& js, kj::Array<kj::byte> keyData) {
-  return jsg::alloc<CryptoKey>(kj::heap<SecretKey>(kj::heapArray(keyData.asPtr())));
+  return jsg::alloc<CryptoKey>(kj::atomicRefcounted<SecretKey>(kj::heapArray(keyData.asPtr())));
 }
 
 jsg::Ref<CryptoKey> CryptoImpl::createPrivateKey(
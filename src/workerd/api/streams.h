@@ -42,7 +42,9 @@ namespace workerd::api {
   api::ReadableStream::ReadableStreamAsyncIterator,         \
   api::ReadableStream::ReadableStreamAsyncIterator::Next,   \
   api::CompressionStream,                                   \
+  api::CompressionStream::Options,                          \
   api::DecompressionStream,                                 \
+  api::DecompressionStream::Options,                        \
   api::TextEncoderStream,                                   \
   api::TextDecoderStream,                                   \
   api::TextDecoderStream::TextDecoderStreamInit,            \
@@ -0,0 +1,162 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "compression-pool.h"
+#include <workerd/io/observer.h>
+#include <brotli/encode.h>
+#include <kj/test.h>
+
+namespace workerd::api {
+namespace {
+
+class CountingObserver final: public RequestObserver {
+public:
+  void compressionPoolHit() override { ++hits; }
+  void compressionPoolMiss() override { ++misses; }
+
+  uint hits = 0;
+  uint misses = 0;
+};
+
+constexpr ZlibStream::Key GZIP_COMPRESS {
+  .mode = CompressionMode::COMPRESS,
+  .windowBits = MAX_WBITS + 16,
+  .level = Z_DEFAULT_COMPRESSION,
+};
+constexpr ZlibStream::Key GZIP_DECOMPRESS {
+  .mode = CompressionMode::DECOMPRESS,
+  .windowBits = MAX_WBITS + 16,
+  .level = Z_DEFAULT_COMPRESSION,
+};
+
+// Feeds all of `input` to `stream` and returns everything it produces until the end of the
+// compressed data.
+kj::Array<const kj::byte> runToEnd(ZlibStream& stream, kj::ArrayPtr<const kj::byte> input) {
+  auto& ctx = stream.ctx;
+  ctx.next_in = const_cast<kj::byte*>(input.begin());
+  ctx.avail_in = input.size();
+
+  kj::Vector<kj::byte> output;
+  kj::byte buffer[1024];
+  int result;
+  do {
+    ctx.next_out = buffer;
+    ctx.avail_out = sizeof(buffer);
+    result = stream.key.mode == CompressionMode::COMPRESS
+        ? deflate(&ctx, Z_FINISH) : inflate(&ctx, Z_FINISH);
+    KJ_ASSERT(result == Z_OK || result == Z_BUF_ERROR || result == Z_STREAM_END, result);
+    output.addAll(kj::arrayPtr(buffer, sizeof(buffer) - ctx.avail_out));
+  } while (result != Z_STREAM_END);
+  return output.releaseAsArray();
+}
+
+kj::String makeInput() {
+  kj::Vector<kj::String> parts;
+  for (auto i: kj::zeroTo(1000)) {
+    parts.add(kj::str("{\"id\":", i, ",\"name\":\"item ", i, "\"}"));
+  }
+  return kj::strArray(parts, ",");
+}
+
+KJ_TEST("pooled zlib streams are reset between streams") {
+  ZlibStreamPool pool;
+  CountingObserver metrics;
+  auto input = makeInput();
+
+  auto first = pool.get(GZIP_COMPRESS, metrics);
+  auto compressed = runToEnd(*first, input.asBytes());
+  pool.release(kj::mv(first));
+  KJ_EXPECT(pool.size() == 1);
+  KJ_EXPECT(metrics.hits == 0);
+  KJ_EXPECT(metrics.misses == 1);
+
+  for (auto i KJ_UNUSED: kj::zeroTo(3)) {
+    // A reused compressor produces exactly what a fresh one does.
+    auto compressor = pool.get(GZIP_COMPRESS, metrics);
+    KJ_EXPECT(runToEnd(*compressor, input.asBytes()).asPtr() == compressed.asPtr());
+    pool.release(kj::mv(compressor));
+
+    auto decompressor = pool.get(GZIP_DECOMPRESS, metrics);
+    KJ_EXPECT(runToEnd(*decompressor, compressed).asPtr() == input.asBytes());
+    pool.release(kj::mv(decompressor));
+  }
+
+  // Each round trip after the first found both of its streams in the pool.
+  KJ_EXPECT(metrics.hits == 5);
+  KJ_EXPECT(metrics.misses == 2);
+  KJ_EXPECT(pool.size() == 2);
+
+  // A stream released partway through is reset too.
+  {
+    auto compressor = pool.get(GZIP_COMPRESS, metrics);
+    auto& ctx = compressor->ctx;
+    kj::byte buffer[64];
+    ctx.next_in = const_cast<kj::byte*>(input.asBytes().begin());
+    ctx.avail_in = input.size() / 2;
+    ctx.next_out = buffer;
+    ctx.avail_out = sizeof(buffer);
+    KJ_ASSERT(deflate(&ctx, Z_NO_FLUSH) == Z_OK);
+    pool.release(kj::mv(compressor));
+  }
+  {
+    auto compressor = pool.get(GZIP_COMPRESS, metrics);
+    KJ_EXPECT(runToEnd(*compressor, input.asBytes()).asPtr() == compressed.asPtr());
+    pool.release(kj::mv(compressor));
+  }
+  KJ_EXPECT(metrics.hits == 7);
+
+  // Streams with different parameters aren't interchangeable.
+  auto otherLevel = GZIP_COMPRESS;
+  otherLevel.level = Z_BEST_SPEED;
+  auto fast = pool.get(otherLevel, metrics);
+  KJ_EXPECT(metrics.misses == 3);
+  pool.release(kj::mv(fast));
+  KJ_EXPECT(pool.size() == 3);
+}
+
+KJ_TEST("zlib stream pool is bounded") {
+  ZlibStreamPool pool;
+  CountingObserver metrics;
+
+  kj::Vector<kj::Own<ZlibStream>> streams;
+  for (auto i KJ_UNUSED: kj::zeroTo(ZlibStreamPool::MAX_POOLED + 1)) {
+    streams.add(pool.get(GZIP_DECOMPRESS, metrics));
+  }
+  for (auto& stream: streams) {
+    pool.release(kj::mv(stream));
+  }
+  KJ_EXPECT(pool.size() == ZlibStreamPool::MAX_POOLED);
+  KJ_EXPECT(metrics.misses == ZlibStreamPool::MAX_POOLED + 1);
+}
+
+KJ_TEST("brotli encoders reuse the memory of earlier encoders") {
+  auto input = makeInput();
+
+  auto compress = [&]() {
+    auto encoder = BrotliEncoderCreateInstance(
+        &BrotliMemoryPool::alloc, &BrotliMemoryPool::free, nullptr);
+    KJ_ASSERT(encoder != nullptr);
+    KJ_DEFER(BrotliEncoderDestroyInstance(encoder));
+
+    auto output = kj::heapArray<kj::byte>(BrotliEncoderMaxCompressedSize(input.size()));
+    size_t availIn = input.size();
+    auto nextIn = input.asBytes().begin();
+    size_t availOut = output.size();
+    auto nextOut = output.begin();
+    KJ_ASSERT(BrotliEncoderCompressStream(encoder, BROTLI_OPERATION_FINISH,
+        &availIn, &nextIn, &availOut, &nextOut, nullptr));
+    KJ_ASSERT(BrotliEncoderIsFinished(encoder));
+  };
+
+  compress();
+  auto pooled = BrotliMemoryPool::pooledBytes();
+  KJ_EXPECT(pooled > 0);
+
+  // The second encoder takes the same blocks back out of the pool, then returns them.
+  compress();
+  KJ_EXPECT(BrotliMemoryPool::pooledBytes() == pooled);
+}
+
+}  // namespace
+}  // namespace workerd::api
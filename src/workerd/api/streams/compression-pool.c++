@@ -0,0 +1,165 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "compression-pool.h"
+#include <workerd/io/observer.h>
+#include <workerd/jsg/jsg.h>
+#include <cstddef>
+#include <stdlib.h>
+
+namespace workerd::api {
+
+ZlibStream::ZlibStream(Key key): key(key) {
+  int result = Z_OK;
+  switch (key.mode) {
+    case CompressionMode::COMPRESS:
+      result = deflateInit2(
+          &ctx,
+          key.level,
+          Z_DEFLATED,
+          key.windowBits,
+          8,  // memLevel = 8 is the default
+          Z_DEFAULT_STRATEGY);
+      break;
+    case CompressionMode::DECOMPRESS:
+      result = inflateInit2(&ctx, key.windowBits);
+      break;
+    default:
+      KJ_UNREACHABLE;
+  }
+  JSG_REQUIRE(result == Z_OK, Error, "Failed to initialize compression context.");
+}
+
+ZlibStream::~ZlibStream() noexcept(false) {
+  switch (key.mode) {
+    case CompressionMode::COMPRESS:
+      deflateEnd(&ctx);
+      break;
+    case CompressionMode::DECOMPRESS:
+      inflateEnd(&ctx);
+      break;
+  }
+}
+
+bool ZlibStream::reset() {
+  switch (key.mode) {
+    case CompressionMode::COMPRESS:
+      return deflateReset(&ctx) == Z_OK;
+    case CompressionMode::DECOMPRESS:
+      return inflateReset(&ctx) == Z_OK;
+  }
+  KJ_UNREACHABLE;
+}
+
+kj::Own<ZlibStream> ZlibStreamPool::get(ZlibStream::Key key, RequestObserver& metrics) {
+  KJ_IF_SOME(list, streams.find(key)) {
+    if (!list.empty()) {
+      auto stream = kj::mv(list.back());
+      list.removeLast();
+      --pooledCount;
+      metrics.compressionPoolHit();
+      return kj::mv(stream);
+    }
+  }
+  metrics.compressionPoolMiss();
+  return kj::heap<ZlibStream>(key);
+}
+
+void ZlibStreamPool::release(kj::Own<ZlibStream> stream) {
+  if (pooledCount >= MAX_POOLED || !stream->reset()) {
+    return;
+  }
+  auto& list = streams.findOrCreate(stream->key, [&]() -> decltype(streams)::Entry {
+    return { stream->key, {} };
+  });
+  list.add(kj::mv(stream));
+  ++pooledCount;
+}
+
+ZlibStreamPool& ZlibStreamPool::forThread() {
+  static thread_local ZlibStreamPool pool;
+  return pool;
+}
+
+namespace {
+
+// Every block handed to brotli starts with a header recording its size, so that free() knows
+// which list to put it on.
+struct alignas(alignof(std::max_align_t)) BrotliBlockHeader {
+  size_t size;
+};
+
+class BrotliBlockCache {
+public:
+  ~BrotliBlockCache() noexcept(false) {
+    for (auto& entry: blocks) {
+      for (auto block: entry.value) {
+        ::free(block);
+      }
+    }
+  }
+
+  BrotliBlockHeader* take(size_t size) {
+    KJ_IF_SOME(list, blocks.find(size)) {
+      if (!list.empty()) {
+        auto block = list.back();
+        list.removeLast();
+        bytes -= size;
+        return block;
+      }
+    }
+    return nullptr;
+  }
+
+  // Returns false if the block doesn't fit in the cache.
+  bool put(BrotliBlockHeader* block) {
+    if (bytes + block->size > BrotliMemoryPool::MAX_POOLED_BYTES) {
+      return false;
+    }
+    blocks.findOrCreate(block->size, [&]() -> decltype(blocks)::Entry {
+      return { block->size, {} };
+    }).add(block);
+    bytes += block->size;
+    return true;
+  }
+
+  size_t bytes = 0;
+
+private:
+  kj::HashMap<size_t, kj::Vector<BrotliBlockHeader*>> blocks;
+};
+
+BrotliBlockCache& brotliBlocksForThread() {
+  static thread_local BrotliBlockCache cache;
+  return cache;
+}
+
+}  // namespace
+
+void* BrotliMemoryPool::alloc(void* opaque, size_t size) {
+  auto block = brotliBlocksForThread().take(size);
+  if (block == nullptr) {
+    block = static_cast<BrotliBlockHeader*>(::malloc(sizeof(BrotliBlockHeader) + size));
+    if (block == nullptr) {
+      // Brotli reports the failure.
+      return nullptr;
+    }
+    block->size = size;
+  }
+  return block + 1;
+}
+
+void BrotliMemoryPool::free(void* opaque, void* address) {
+  if (address == nullptr) return;
+  auto block = static_cast<BrotliBlockHeader*>(address) - 1;
+  if (!brotliBlocksForThread().put(block)) {
+    ::free(block);
+  }
+}
+
+size_t BrotliMemoryPool::pooledBytes() {
+  return brotliBlocksForThread().bytes;
+}
+
+}  // namespace workerd::api
@@ -0,0 +1,99 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+// Per-thread pools of compression state, shared by CompressionStream/DecompressionStream and by
+// the Content-Encoding streams in system-streams.c++.
+
+#include <kj/map.h>
+#include <kj/vector.h>
+#include <zlib.h>
+
+namespace workerd {
+class RequestObserver;
+}
+
+namespace workerd::api {
+
+enum class CompressionMode {
+  COMPRESS,
+  DECOMPRESS,
+};
+
+// An initialized zlib stream. Heap-allocated because zlib's internal state points back at the
+// z_stream, so it must not move.
+struct ZlibStream {
+  // Everything that deflateReset()/inflateReset() keeps, so streams with equal keys are
+  // interchangeable once reset.
+  struct Key {
+    CompressionMode mode;
+    int windowBits;  // As passed to deflateInit2()/inflateInit2(), i.e. including the format.
+    int level;       // Always Z_DEFAULT_COMPRESSION when decompressing.
+
+    bool operator==(const Key& other) const {
+      return mode == other.mode && windowBits == other.windowBits && level == other.level;
+    }
+    uint hashCode() const {
+      return kj::hashCode(static_cast<int>(mode), windowBits, level);
+    }
+  };
+
+  Key key;
+  z_stream ctx = {};
+
+  explicit ZlibStream(Key key);
+  ~ZlibStream() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(ZlibStream);
+
+  // Returns the stream to the state it had right after initialization. Returns false if zlib
+  // refuses, in which case the stream can't be reused.
+  bool reset();
+};
+
+// Per-thread cache of zlib streams that finished streams have been reset and returned to, so
+// that a new stream with the same parameters can skip allocating and initializing the zlib state
+// (which is a few hundred KB for the default window size).
+class ZlibStreamPool {
+public:
+  // Returns a stream for `key`, reporting to `metrics` whether it came from the pool.
+  kj::Own<ZlibStream> get(ZlibStream::Key key, RequestObserver& metrics);
+
+  // Resets `stream` and keeps it for reuse, unless the pool is full.
+  void release(kj::Own<ZlibStream> stream);
+
+  // Number of idle streams held. Exposed for tests.
+  size_t size() const { return pooledCount; }
+
+  static ZlibStreamPool& forThread();
+
+  // Limits the memory held by idle streams on each thread.
+  static constexpr size_t MAX_POOLED = 32;
+
+private:
+  kj::HashMap<ZlibStream::Key, kj::Vector<kj::Own<ZlibStream>>> streams;
+  size_t pooledCount = 0;
+};
+
+// Allocation functions for brotli encoders and decoders, to be passed to
+// BrotliEncoderCreateInstance()/BrotliDecoderCreateInstance().
+//
+// The brotli version we build against has no way to reset an encoder or decoder, so instances
+// can't be pooled like zlib streams. Instead, the blocks they free are kept per thread, by size,
+// and handed to the next instance that asks for the same size. Brotli's large allocations (the
+// ring buffer and hash tables) depend only on the parameters, so a stream with the same
+// parameters as a recent one reuses its memory without going back to the system allocator.
+class BrotliMemoryPool {
+public:
+  static void* alloc(void* opaque, size_t size);
+  static void free(void* opaque, void* address);
+
+  // Number of bytes held in idle blocks on this thread. Exposed for tests.
+  static size_t pooledBytes();
+
+  // Limits the memory held by idle blocks on each thread.
+  static constexpr size_t MAX_POOLED_BYTES = 16 << 20;
+};
+
+}  // namespace workerd::api
@@ -3,8 +3,11 @@
 //     https://opensource.org/licenses/Apache-2.0
 
 #include "compression.h"
+#include "compression-pool.h"
 #include <workerd/io/features.h>
 #include <zlib.h>
+#include <brotli/decode.h>
+#include <brotli/encode.h>
 #include <deque>
 #include <vector>
 #include <iterator>
@@ -13,12 +16,83 @@ namespace workerd::api {
 
 namespace {
 
+enum class Format {
+  GZIP,
+  DEFLATE,
+  DEFLATE_RAW,
+  BROTLI,
+};
+
+Format parseFormat(jsg::Lock& js, kj::StringPtr format) {
+  if (format == "gzip") return Format::GZIP;
+  if (format == "deflate") return Format::DEFLATE;
+  if (format == "deflate-raw") return Format::DEFLATE_RAW;
+  if (FeatureFlags::get(js).getCompressionStreamExtensions()) {
+    if (format == "br") return Format::BROTLI;
+    JSG_FAIL_REQUIRE(TypeError,
+        "The compression format must be either 'deflate', 'deflate-raw', 'gzip' or 'br'.");
+  }
+  JSG_FAIL_REQUIRE(TypeError,
+      "The compression format must be either 'deflate', 'deflate-raw' or 'gzip'.");
+}
+
+// The options bag is non-standard, so it's ignored unless the extensions are enabled.
+template <typename Options>
+Options getOptions(jsg::Lock& js, jsg::Optional<Options> options) {
+  if (!FeatureFlags::get(js).getCompressionStreamExtensions()) {
+    return {};
+  }
+  return kj::mv(options).orDefault({});
+}
+
+// Validated CompressionStream/DecompressionStream options, with defaults filled in.
+struct ContextOptions {
+  int level;
+  int windowBits;
+  kj::Maybe<kj::Array<kj::byte>> dictionary;
+};
+
+ContextOptions validateOptions(Format format,
+                               jsg::Optional<int> level,
+                               jsg::Optional<int> windowBits,
+                               jsg::Optional<kj::Array<kj::byte>> dictionary) {
+  ContextOptions result;
+  if (format == Format::BROTLI) {
+    result.level = level.orDefault(BROTLI_DEFAULT_QUALITY);
+    JSG_REQUIRE(result.level >= BROTLI_MIN_QUALITY && result.level <= BROTLI_MAX_QUALITY,
+        RangeError, "The compression level for 'br' must be between ", BROTLI_MIN_QUALITY,
+        " and ", BROTLI_MAX_QUALITY, ".");
+    result.windowBits = windowBits.orDefault(BROTLI_DEFAULT_WINDOW);
+    JSG_REQUIRE(result.windowBits >= BROTLI_MIN_WINDOW_BITS &&
+                result.windowBits <= BROTLI_MAX_WINDOW_BITS,
+        RangeError, "The windowBits for 'br' must be between ", BROTLI_MIN_WINDOW_BITS,
+        " and ", BROTLI_MAX_WINDOW_BITS, ".");
+  } else {
+    result.level = level.orDefault(Z_DEFAULT_COMPRESSION);
+    JSG_REQUIRE(result.level >= Z_DEFAULT_COMPRESSION && result.level <= Z_BEST_COMPRESSION,
+        RangeError, "The compression level must be between ", Z_DEFAULT_COMPRESSION, " and ",
+        Z_BEST_COMPRESSION, ".");
+    // zlib accepts 8 for the zlib and gzip wrappers but silently uses 9 instead, and rejects it
+    // for raw deflate, so we don't accept it at all.
+    result.windowBits = windowBits.orDefault(MAX_WBITS);
+    JSG_REQUIRE(result.windowBits >= 9 && result.windowBits <= MAX_WBITS,
+        RangeError, "The windowBits must be between 9 and ", MAX_WBITS, ".");
+  }
+
+  KJ_IF_SOME(dict, dictionary) {
+    // zlib only supports preset dictionaries with the zlib wrapper and raw deflate.
+    JSG_REQUIRE(format == Format::DEFLATE || format == Format::DEFLATE_RAW, TypeError,
+        "A dictionary is only supported with the 'deflate' and 'deflate-raw' formats.");
+    if (dict.size() > 0) {
+      result.dictionary = kj::mv(dict);
+    }
+  }
+  return result;
+}
+
 class Context {
 public:
-  enum class Mode {
-    COMPRESS,
-    DECOMPRESS,
-  };
+  using Mode = CompressionMode;
 
   enum class ContextFlags {
     NONE,
@@ -30,47 +104,57 @@ public:
     kj::ArrayPtr<const byte> buffer;
   };
 
-  explicit Context(Mode mode, kj::StringPtr format, ContextFlags flags) :
-      mode(mode), strictCompression(flags) {
-    int result = Z_OK;
-    switch (mode) {
-      case Mode::COMPRESS:
-        result = deflateInit2(
-            &ctx,
-            Z_DEFAULT_COMPRESSION,
-            Z_DEFLATED,
-            getWindowBits(format),
-            8,  // memLevel = 8 is the default
-            Z_DEFAULT_STRATEGY);
-        break;
-      case Mode::DECOMPRESS:
-        result = inflateInit2(&ctx, getWindowBits(format));
-        break;
-      default:
-        KJ_UNREACHABLE;
+  virtual ~Context() noexcept(false) = default;
+
+  virtual void setInput(const void* in, size_t size) = 0;
+
+  // Runs the compressor or decompressor until either the output buffer is full or it needs more
+  // input. `flush` is Z_NO_FLUSH or Z_FINISH, whatever the format. `success` is true when calling
+  // again without more input may produce more output.
+  virtual Result pumpOnce(int flush) = 0;
+
+protected:
+  kj::byte buffer[4096];
+};
+
+class ZlibContext final: public Context {
+public:
+  ZlibContext(Mode mode, Format format, ContextOptions options, ContextFlags flags,
+              RequestObserver& metrics)
+      : mode(mode),
+        stream(ZlibStreamPool::forThread().get(ZlibStream::Key {
+          .mode = mode,
+          .windowBits = getWindowBits(format, options.windowBits),
+          .level = mode == Mode::COMPRESS ? options.level : Z_DEFAULT_COMPRESSION,
+        }, metrics)),
+        ctx(stream->ctx),
+        strictCompression(flags),
+        dictionary(kj::mv(options.dictionary)) {
+    KJ_IF_SOME(dict, dictionary) {
+      int result = Z_OK;
+      if (mode == Mode::COMPRESS) {
+        result = deflateSetDictionary(&ctx, dict.begin(), dict.size());
+      } else if (format == Format::DEFLATE_RAW) {
+        // Raw deflate has no header to ask for the dictionary, so it must be set up front. With
+        // the zlib wrapper, inflate() returns Z_NEED_DICT when it gets to it instead.
+        result = inflateSetDictionary(&ctx, dict.begin(), dict.size());
+      }
+      JSG_REQUIRE(result == Z_OK, Error, "Failed to initialize compression context.");
     }
-    JSG_REQUIRE(result == Z_OK, Error, "Failed to initialize compression context.");
   }
 
-  ~Context() noexcept(false) {
-    switch (mode) {
-      case Mode::COMPRESS:
-        deflateEnd(&ctx);
-        break;
-      case Mode::DECOMPRESS:
-        inflateEnd(&ctx);
-        break;
-    }
+  ~ZlibContext() noexcept(false) {
+    ZlibStreamPool::forThread().release(kj::mv(stream));
   }
 
-  KJ_DISALLOW_COPY_AND_MOVE(Context);
+  KJ_DISALLOW_COPY_AND_MOVE(ZlibContext);
 
-  void setInput(const void* in, size_t size) {
+  void setInput(const void* in, size_t size) override {
     ctx.next_in = const_cast<byte*>(reinterpret_cast<const byte*>(in));
     ctx.avail_in = size;
   }
 
-  Result pumpOnce(int flush) {
+  Result pumpOnce(int flush) override {
     ctx.next_out = buffer;
     ctx.avail_out = sizeof(buffer);
 
@@ -85,6 +169,17 @@ public:
         break;
       case Mode::DECOMPRESS:
         result = inflate(&ctx, flush);
+        if (result == Z_NEED_DICT) {
+          auto& dict = JSG_REQUIRE_NONNULL(dictionary, Error,
+              "Decompression failed: a dictionary is required.");
+          JSG_REQUIRE(inflateSetDictionary(&ctx, dict.begin(), dict.size()) == Z_OK, Error,
+              "Decompression failed: the dictionary does not match.");
+          // Report success so that the caller pumps again to continue past the header.
+          return Result {
+            .success = true,
+            .buffer = kj::arrayPtr(buffer, sizeof(buffer) - ctx.avail_out),
+          };
+        }
         JSG_REQUIRE(result == Z_OK || result == Z_BUF_ERROR || result == Z_STREAM_END,
                      Error,
                      "Decompression failed.");
@@ -111,38 +206,139 @@ public:
   }
 
 private:
-  static int getWindowBits(kj::StringPtr format) {
-    // We use a windowBits value of 15 combined with the magic value
-    // for the compression format type. For gzip, the magic value is
-    // 16, so the value returned is 15 + 16. For deflate, the magic
-    // value is 15. For raw deflate (i.e. deflate without a zlib header)
-    // the negative windowBits value is used, so -15. See the comments for
+  static int getWindowBits(Format format, int windowBits) {
+    // The windowBits value is combined with the magic value for the compression format type. For
+    // gzip, the magic value is 16, so the value returned is windowBits + 16. For raw deflate (i.e.
+    // deflate without a zlib header) the negative windowBits value is used. See the comments for
     // deflateInit2() in zlib.h for details.
     static constexpr auto GZIP = 16;
-    static constexpr auto DEFLATE = 15;
-    static constexpr auto DEFLATE_RAW = -15;
-    if (format == "gzip") return DEFLATE + GZIP;
-    else if (format == "deflate") return DEFLATE;
-    else if (format == "deflate-raw") return DEFLATE_RAW;
+    switch (format) {
+      case Format::GZIP: return windowBits + GZIP;
+      case Format::DEFLATE: return windowBits;
+      case Format::DEFLATE_RAW: return -windowBits;
+      case Format::BROTLI: break;
+    }
     KJ_UNREACHABLE;
   }
 
   Mode mode;
-  z_stream ctx = {};
-  kj::byte buffer[4096];
+  kj::Own<ZlibStream> stream;
+  z_stream& ctx;
 
   // For the eponymous compatibility flag
   ContextFlags strictCompression;
+
+  kj::Maybe<kj::Array<kj::byte>> dictionary;
 };
 
+class BrotliContext final: public Context {
+public:
+  BrotliContext(Mode mode, ContextOptions options, ContextFlags flags)
+      : strictCompression(flags) {
+    switch (mode) {
+      case Mode::COMPRESS: {
+        auto encoder = BrotliEncoderCreateInstance(
+            &BrotliMemoryPool::alloc, &BrotliMemoryPool::free, nullptr);
+        JSG_REQUIRE(encoder != nullptr, Error, "Failed to initialize compression context.");
+        if (!BrotliEncoderSetParameter(encoder, BROTLI_PARAM_QUALITY, options.level) ||
+            !BrotliEncoderSetParameter(encoder, BROTLI_PARAM_LGWIN, options.windowBits)) {
+          BrotliEncoderDestroyInstance(encoder);
+          JSG_FAIL_REQUIRE(Error, "Failed to initialize compression context.");
+        }
+        state = encoder;
+        break;
+      }
+      case Mode::DECOMPRESS: {
+        // The decoder takes the window size from the stream header, so options.windowBits was
+        // only range-checked.
+        auto decoder = BrotliDecoderCreateInstance(
+            &BrotliMemoryPool::alloc, &BrotliMemoryPool::free, nullptr);
+        JSG_REQUIRE(decoder != nullptr, Error, "Failed to initialize compression context.");
+        state = decoder;
+        break;
+      }
+      default:
+        KJ_UNREACHABLE;
+    }
+  }
+
+  ~BrotliContext() noexcept(false) {
+    KJ_SWITCH_ONEOF(state) {
+      KJ_CASE_ONEOF(encoder, BrotliEncoderState*) {
+        BrotliEncoderDestroyInstance(encoder);
+      }
+      KJ_CASE_ONEOF(decoder, BrotliDecoderState*) {
+        BrotliDecoderDestroyInstance(decoder);
+      }
+    }
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(BrotliContext);
+
+  void setInput(const void* in, size_t size) override {
+    nextIn = reinterpret_cast<const byte*>(in);
+    availIn = size;
+  }
+
+  Result pumpOnce(int flush) override {
+    byte* nextOut = buffer;
+    size_t availOut = sizeof(buffer);
+    bool success = false;
+
+    KJ_SWITCH_ONEOF(state) {
+      KJ_CASE_ONEOF(encoder, BrotliEncoderState*) {
+        auto op = flush == Z_FINISH ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+        JSG_REQUIRE(BrotliEncoderCompressStream(
+            encoder, op, &availIn, &nextIn, &availOut, &nextOut, nullptr),
+            Error, "Compression failed.");
+        success = availIn > 0 || BrotliEncoderHasMoreOutput(encoder) ||
+            (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(encoder));
+      }
+      KJ_CASE_ONEOF(decoder, BrotliDecoderState*) {
+        auto result = BrotliDecoderDecompressStream(
+            decoder, &availIn, &nextIn, &availOut, &nextOut, nullptr);
+        JSG_REQUIRE(result != BROTLI_DECODER_RESULT_ERROR, Error, "Decompression failed.");
+
+        if (strictCompression == ContextFlags::STRICT) {
+          JSG_REQUIRE(!(result == BROTLI_DECODER_RESULT_SUCCESS && availIn > 0), TypeError,
+              "Trailing bytes after end of compressed data");
+          JSG_REQUIRE(!(flush == Z_FINISH && result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT),
+              TypeError, "Called close() on a decompression stream with incomplete data");
+        }
+        success = result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+      }
+    }
+
+    return Result {
+      .success = success,
+      .buffer = kj::arrayPtr(buffer, sizeof(buffer) - availOut),
+    };
+  }
+
+private:
+  kj::OneOf<BrotliEncoderState*, BrotliDecoderState*> state;
+  const byte* nextIn = nullptr;
+  size_t availIn = 0;
+
+  ContextFlags strictCompression;
+};
+
+kj::Own<Context> newContext(Context::Mode mode, Format format, ContextOptions options,
+                            Context::ContextFlags flags, RequestObserver& metrics) {
+  if (format == Format::BROTLI) {
+    return kj::heap<BrotliContext>(mode, kj::mv(options), flags);
+  }
+  return kj::heap<ZlibContext>(mode, format, kj::mv(options), flags, metrics);
+}
+
 // Uncompressed data goes in. Compressed data comes out.
 template <Context::Mode mode>
 class CompressionStreamImpl: public kj::Refcounted,
                              public ReadableStreamSource,
                              public WritableStreamSink {
 public:
-  explicit CompressionStreamImpl(kj::String format, Context::ContextFlags flags)
-      : context(mode, format, flags) {}
+  explicit CompressionStreamImpl(kj::Own<Context> context)
+      : context(kj::mv(context)) {}
 
   // WritableStreamSink implementation ---------------------------------------------------
 
@@ -155,7 +351,7 @@ public:
         return kj::cp(exception);
       }
       KJ_CASE_ONEOF(open, Open) {
-        context.setInput(buffer, size);
+        context->setInput(buffer, size);
         return writeInternal(Z_NO_FLUSH);
       }
     }
@@ -287,7 +483,7 @@ private:
     KJ_ASSERT(flush == Z_FINISH || state.template is<Open>());
     Context::Result result;
     KJ_IF_SOME(exception, kj::runCatchingExceptions([this, flush, &result]() {
-      result = context.pumpOnce(flush);
+      result = context->pumpOnce(flush);
     })) {
       cancelInternal(kj::cp(exception));
       return kj::mv(exception);
@@ -380,7 +576,7 @@ private:
   struct Open {};
 
   kj::OneOf<Open, Ended, kj::Exception> state = Open();
-  Context context;
+  kj::Own<Context> context;
 
   kj::Canceler canceler;
   std::vector<kj::byte> output;
@@ -388,36 +584,40 @@ private:
 };
 }  // namespace
 
-jsg::Ref<CompressionStream> CompressionStream::constructor(jsg::Lock& js, kj::String format) {
-  JSG_REQUIRE(format == "deflate" || format == "gzip" || format == "deflate-raw", TypeError,
-               "The compression format must be either 'deflate', 'deflate-raw' or 'gzip'.");
+jsg::Ref<CompressionStream> CompressionStream::constructor(jsg::Lock& js, kj::String format,
+                                                          jsg::Optional<Options> options) {
+  auto& ioContext = IoContext::current();
+  auto parsedFormat = parseFormat(js, format);
+  auto opts = getOptions(js, kj::mv(options));
+  auto context = newContext(Context::Mode::COMPRESS, parsedFormat,
+      validateOptions(parsedFormat, opts.level, opts.windowBits, kj::mv(opts.dictionary)),
+      Context::ContextFlags::NONE, ioContext.getMetrics());
 
   auto readableSide =
-      kj::refcounted<CompressionStreamImpl<Context::Mode::COMPRESS>>(kj::mv(format),
-                                                                     Context::ContextFlags::NONE);
+      kj::refcounted<CompressionStreamImpl<Context::Mode::COMPRESS>>(kj::mv(context));
   auto writableSide = kj::addRef(*readableSide);
 
-  auto& ioContext = IoContext::current();
-
   return jsg::alloc<CompressionStream>(
     jsg::alloc<ReadableStream>(ioContext, kj::mv(readableSide)),
     jsg::alloc<WritableStream>(ioContext, kj::mv(writableSide)));
 }
 
-jsg::Ref<DecompressionStream> DecompressionStream::constructor(jsg::Lock& js, kj::String format) {
-  JSG_REQUIRE(format == "deflate" || format == "gzip" || format == "deflate-raw", TypeError,
-               "The compression format must be either 'deflate', 'deflate-raw' or 'gzip'.");
+jsg::Ref<DecompressionStream> DecompressionStream::constructor(jsg::Lock& js, kj::String format,
+                                                              jsg::Optional<Options> options) {
+  auto& ioContext = IoContext::current();
+  auto parsedFormat = parseFormat(js, format);
+  auto opts = getOptions(js, kj::mv(options));
+  auto context = newContext(Context::Mode::DECOMPRESS, parsedFormat,
+      validateOptions(parsedFormat, kj::none, opts.windowBits, kj::mv(opts.dictionary)),
+      FeatureFlags::get(js).getStrictCompression() ?
+          Context::ContextFlags::STRICT :
+          Context::ContextFlags::NONE,
+      ioContext.getMetrics());
 
   auto readableSide =
-      kj::refcounted<CompressionStreamImpl<Context::Mode::DECOMPRESS>>(
-          kj::mv(format),
-          FeatureFlags::get(js).getStrictCompression() ?
-              Context::ContextFlags::STRICT :
-              Context::ContextFlags::NONE);
+      kj::refcounted<CompressionStreamImpl<Context::Mode::DECOMPRESS>>(kj::mv(context));
   auto writableSide = kj::addRef(*readableSide);
 
-  auto& ioContext = IoContext::current();
-
   return jsg::alloc<DecompressionStream>(
     jsg::alloc<ReadableStream>(ioContext, kj::mv(readableSide)),
     jsg::alloc<WritableStream>(ioContext, kj::mv(writableSide)));
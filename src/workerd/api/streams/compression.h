@@ -13,14 +13,39 @@ class CompressionStream: public TransformStream {
 public:
   using TransformStream::TransformStream;
 
-  static jsg::Ref<CompressionStream> constructor(jsg::Lock& js, kj::String format);
+  // Non-standard tuning knobs, only accepted with the `compression_stream_extensions` flag. Every
+  // field defaults to what the format uses when it is omitted.
+  struct Options {
+    // -1 (zlib's default) to 9 for the zlib formats, 0 to 11 for "br".
+    jsg::Optional<int> level;
 
-  JSG_RESOURCE_TYPE(CompressionStream) {
+    // Base 2 logarithm of the window size: 9 to 15 for the zlib formats, 10 to 24 for "br".
+    jsg::Optional<int> windowBits;
+
+    // A preset dictionary, for "deflate" and "deflate-raw" only. The DecompressionStream must be
+    // given the same dictionary.
+    jsg::Optional<kj::Array<kj::byte>> dictionary;
+
+    JSG_STRUCT(level, windowBits, dictionary);
+    JSG_STRUCT_TS_OVERRIDE(CompressionStreamOptions);
+  };
+
+  static jsg::Ref<CompressionStream> constructor(jsg::Lock& js, kj::String format,
+                                                 jsg::Optional<Options> options);
+
+  JSG_RESOURCE_TYPE(CompressionStream, CompatibilityFlags::Reader flags) {
     JSG_INHERIT(TransformStream);
 
-    JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
-      constructor(format: "gzip" | "deflate" | "deflate-raw");
-    });
+    if (flags.getCompressionStreamExtensions()) {
+      JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
+        constructor(format: "gzip" | "deflate" | "deflate-raw" | "br",
+                    options?: CompressionStreamOptions);
+      });
+    } else {
+      JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
+        constructor(format: "gzip" | "deflate" | "deflate-raw");
+      });
+    }
   }
 };
 
@@ -28,14 +53,34 @@ class DecompressionStream: public TransformStream {
 public:
   using TransformStream::TransformStream;
 
-  static jsg::Ref<DecompressionStream> constructor(jsg::Lock& js, kj::String format);
+  struct Options {
+    // Must be at least the windowBits the data was compressed with. For "br" this is only
+    // checked for range, since brotli streams declare their own window size.
+    jsg::Optional<int> windowBits;
+
+    // The dictionary the data was compressed with, for "deflate" and "deflate-raw" only.
+    jsg::Optional<kj::Array<kj::byte>> dictionary;
+
+    JSG_STRUCT(windowBits, dictionary);
+    JSG_STRUCT_TS_OVERRIDE(DecompressionStreamOptions);
+  };
+
+  static jsg::Ref<DecompressionStream> constructor(jsg::Lock& js, kj::String format,
+                                                   jsg::Optional<Options> options);
 
-  JSG_RESOURCE_TYPE(DecompressionStream) {
+  JSG_RESOURCE_TYPE(DecompressionStream, CompatibilityFlags::Reader flags) {
     JSG_INHERIT(TransformStream);
 
-    JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
-      constructor(format: "gzip" | "deflate" | "deflate-raw");
-    });
+    if (flags.getCompressionStreamExtensions()) {
+      JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
+        constructor(format: "gzip" | "deflate" | "deflate-raw" | "br",
+                    options?: DecompressionStreamOptions);
+      });
+    } else {
+      JSG_TS_OVERRIDE(extends TransformStream<ArrayBuffer | ArrayBufferView, Uint8Array> {
+        constructor(format: "gzip" | "deflate" | "deflate-raw");
+      });
+    }
   }
 };
 
@@ -8,6 +8,7 @@
 #include <workerd/jsg/jsg.h>
 #include <kj/vector.h>
 #include <workerd/api/util.h>
+#include <workerd/util/shared-tee.h>
 
 namespace workerd::api {
 
@@ -28,21 +29,145 @@ namespace {
           kj::str(JSG_EXCEPTION(TypeError) ": ", message)));
 }
 
-kj::Promise<void> pumpTo(ReadableStreamSource& input, WritableStreamSink& output, bool end) {
-  kj::byte buffer[4096];
+// Buffers used by pumpTo() start small, so that short bodies don't pay for a large allocation,
+// and double each time a read fills one completely, since that suggests the source had more data
+// ready than we asked for.
+constexpr size_t MIN_PUMP_BUFFER_SIZE = 4096;
+constexpr size_t MAX_PUMP_BUFFER_SIZE = 256 * 1024;
 
-  while (true) {
-    auto amount = co_await input.tryRead(buffer, 1, kj::size(buffer));
+// pumpTo() stops reading ahead once this many bytes are waiting to be written.
+constexpr size_t MAX_PUMP_BUFFERED_BYTES = 1024 * 1024;
 
-    if (amount == 0) {
-      if (end) {
-        co_await output.end();
+// The generic pump used when the sink has no tryPumpFrom() optimization for the source.
+//
+// Reading and writing overlap: while a write is in flight, the pump keeps reading into fresh
+// buffers, and everything that arrived in the meantime goes out in a single vectored write. Data
+// is never held back waiting for more to arrive, so streaming bodies see no added latency.
+class AdaptivePump {
+public:
+  AdaptivePump(ReadableStreamSource& input, WritableStreamSink& output)
+      : input(input), output(output) {}
+  KJ_DISALLOW_COPY_AND_MOVE(AdaptivePump);
+
+  kj::Promise<void> run(bool end) {
+    reader = readLoop().eagerlyEvaluate([this](kj::Exception&& exception) {
+      readError = kj::mv(exception);
+      wakeWriter();
+    });
+
+    while (true) {
+      if (filled.empty()) {
+        KJ_IF_SOME(exception, readError) {
+          kj::throwFatalException(kj::mv(exception));
+        }
+        if (eof) break;
+
+        auto paf = kj::newPromiseAndFulfiller<void>();
+        writerWaiting = kj::mv(paf.fulfiller);
+        co_await paf.promise;
+        continue;
+      }
+
+      auto chunks = kj::mv(filled);
+      if (chunks.size() == 1) {
+        co_await output.write(chunks[0].buffer.begin(), chunks[0].size);
+      } else {
+        auto pieces = KJ_MAP(chunk, chunks) -> kj::ArrayPtr<const kj::byte> {
+          return chunk.buffer.slice(0, chunk.size);
+        };
+        co_await output.write(pieces);
+      }
+
+      for (auto& chunk: chunks) {
+        bufferedBytes -= chunk.size;
+        // Buffers from before the last growth step are too small to be worth keeping.
+        if (chunk.buffer.size() == bufferSize) {
+          spare.add(kj::mv(chunk.buffer));
+        }
+      }
+      KJ_IF_SOME(fulfiller, readerWaiting) {
+        fulfiller->fulfill();
+        readerWaiting = kj::none;
+      }
+    }
+
+    if (end) {
+      co_await output.end();
+    }
+  }
+
+private:
+  struct Chunk {
+    kj::Array<kj::byte> buffer;
+    size_t size;
+  };
+
+  ReadableStreamSource& input;
+  WritableStreamSink& output;
+
+  size_t bufferSize = MIN_PUMP_BUFFER_SIZE;
+  size_t bufferedBytes = 0;
+  bool eof = false;
+  kj::Maybe<kj::Exception> readError;
+
+  // Chunks that have been read but not yet written, in order.
+  kj::Vector<Chunk> filled;
+
+  // Buffers of the current size that can be reused for the next read.
+  kj::Vector<kj::Array<kj::byte>> spare;
+
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> writerWaiting;
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> readerWaiting;
+
+  // Declared last so that the read loop is canceled before the state it uses is destroyed.
+  kj::Promise<void> reader = nullptr;
+
+  kj::Promise<void> readLoop() {
+    while (true) {
+      if (bufferedBytes >= MAX_PUMP_BUFFERED_BYTES) {
+        auto paf = kj::newPromiseAndFulfiller<void>();
+        readerWaiting = kj::mv(paf.fulfiller);
+        co_await paf.promise;
+        continue;
+      }
+
+      kj::Array<kj::byte> buffer = nullptr;
+      if (spare.empty()) {
+        buffer = kj::heapArray<kj::byte>(bufferSize);
+      } else {
+        buffer = kj::mv(spare.back());
+        spare.removeLast();
       }
-      co_return;
+
+      auto amount = co_await input.tryRead(buffer.begin(), 1, buffer.size());
+      if (amount == 0) {
+        eof = true;
+        wakeWriter();
+        co_return;
+      }
+
+      if (amount == buffer.size() && bufferSize < MAX_PUMP_BUFFER_SIZE) {
+        bufferSize *= 2;
+        spare.clear();
+      }
+
+      bufferedBytes += amount;
+      filled.add(Chunk { kj::mv(buffer), amount });
+      wakeWriter();
     }
+  }
 
-    co_await output.write(buffer, amount);
+  void wakeWriter() {
+    KJ_IF_SOME(fulfiller, writerWaiting) {
+      fulfiller->fulfill();
+      writerWaiting = kj::none;
+    }
   }
+};
+
+kj::Promise<void> pumpTo(ReadableStreamSource& input, WritableStreamSink& output, bool end) {
+  AdaptivePump pump(input, output);
+  co_await pump.run(end);
 }
 
 // Modified from AllReader in kj/async-io.c++.
@@ -244,7 +369,7 @@ kj::Exception reasonToException(
 
 // =======================================================================================
 
-// Adapt ReadableStreamSource to kj::AsyncInputStream's interface for use with `kj::newTee()`.
+// Adapt ReadableStreamSource to kj::AsyncInputStream's interface for use with `newSharedTee()`.
 class TeeAdapter final: public kj::AsyncInputStream {
 public:
   explicit TeeAdapter(kj::Own<ReadableStreamSource> inner)
@@ -283,7 +408,7 @@ public:
     JSG_REQUIRE(kj::dynamicDowncastIfAvailable<IdentityTransformStreamImpl>(output) == kj::none,
         TypeError, "Inter-TransformStream ReadableStream.pipeTo() is not implemented.");
 
-    // It is important we actually call `inner->pumpTo()` so that `kj::newTee()` is aware of this
+    // It is important we actually call `inner->pumpTo()` so that the tee is aware of this
     // pump operation's backpressure. So we can't use the default `ReadableStreamSource::pumpTo()`
     // implementation, and have to implement our own.
 
@@ -698,7 +823,10 @@ ReadableStreamController::Tee ReadableStreamInternalController::tee(jsg::Lock& j
         return makeTee(kj::mv(tee.branches[0]), kj::mv(tee.branches[1]));
       }
 
-      auto tee = kj::newTee(kj::heap<TeeAdapter>(kj::mv(readable)), bufferLimit);
+      auto tee = newSharedTee(kj::heap<TeeAdapter>(kj::mv(readable)), {
+        .lagLimits = { bufferLimit, bufferLimit },
+        .spillDirectory = ioContext.getTeeSpillDirectory(),
+      });
 
       return makeTee(
           kj::heap<TeeBranch>(newTeeErrorAdapter(kj::mv(tee.branches[0]))),
@@ -388,7 +388,7 @@ KJ_TEST("ByteQueue basics work") {
   KJ_ASSERT(queue.desiredSize() == 2);
   KJ_ASSERT(queue.size() == 0);
 
-  auto entry = kj::heap<ByteQueue::Entry>(jsg::BackingStore::alloc(js, 4));
+  auto entry = kj::refcounted<ByteQueue::Entry>(jsg::BackingStore::alloc(js, 4));
 
   queue.push(js, kj::mv(entry));
 
@@ -400,7 +400,7 @@ KJ_TEST("ByteQueue basics work") {
   queue.close(js);
 
   try {
-    auto entry = kj::heap<ByteQueue::Entry>(jsg::BackingStore::alloc(js, 4));
+    auto entry = kj::refcounted<ByteQueue::Entry>(jsg::BackingStore::alloc(js, 4));
     queue.push(js, kj::mv(entry));
     KJ_FAIL_ASSERT("The queue push after close should have failed.");
   } catch (kj::Exception& ex) {
@@ -422,7 +422,7 @@ KJ_TEST("ByteQueue erroring works") {
   KJ_ASSERT(queue.desiredSize() == 0);
 
   try {
-    auto entry = kj::heap<ByteQueue::Entry>(jsg::BackingStore::alloc(js, 4));
+    auto entry = kj::refcounted<ByteQueue::Entry>(jsg::BackingStore::alloc(js, 4));
     queue.push(js, kj::mv(entry));
     KJ_FAIL_ASSERT("The queue push after close should have failed.");
   } catch (kj::Exception& ex) {
@@ -443,7 +443,7 @@ KJ_TEST("ByteQueue with single consumer") {
   auto store = jsg::BackingStore::alloc(js, 4);
   memset(store.asArrayPtr().begin(), 'a', store.size());
 
-  auto entry = kj::heap<ByteQueue::Entry>(kj::mv(store));
+  auto entry = kj::refcounted<ByteQueue::Entry>(kj::mv(store));
   queue.push(js, kj::mv(entry));
 
   // The item was pushed into the consumer.
@@ -929,7 +929,7 @@ KJ_TEST("ByteQueue with default consumer with atLeast") {
 
   const auto push = [&](auto store) {
     try {
-      queue.push(js, kj::heap<ByteQueue::Entry>(kj::mv(store)));
+      queue.push(js, kj::refcounted<ByteQueue::Entry>(kj::mv(store)));
     } catch (kj::Exception& ex) {
       KJ_DBG(ex.getDescription());
     }
@@ -1020,7 +1020,7 @@ KJ_TEST("ByteQueue with multiple default consumers with atLeast (same rate)") {
 
   const auto push = [&](auto store) {
     try {
-      queue.push(js, kj::heap<ByteQueue::Entry>(kj::mv(store)));
+      queue.push(js, kj::refcounted<ByteQueue::Entry>(kj::mv(store)));
     } catch (kj::Exception& ex) {
       KJ_DBG(ex.getDescription());
     }
@@ -1130,7 +1130,7 @@ KJ_TEST("ByteQueue with multiple default consumers with atLeast (different rate)
 
   const auto push = [&](auto store) {
     try {
-      queue.push(js, kj::heap<ByteQueue::Entry>(kj::mv(store)));
+      queue.push(js, kj::refcounted<ByteQueue::Entry>(kj::mv(store)));
     } catch (kj::Exception& ex) {
       KJ_DBG(ex.getDescription());
     }
@@ -1239,6 +1239,49 @@ KJ_TEST("ByteQueue with multiple default consumers with atLeast (different rate)
   js.runMicrotasks();
 }
 
+KJ_TEST("ByteQueue coalesces small writes while no read is pending") {
+  Preamble preamble;
+  auto& js = preamble.getJs();
+
+  ByteQueue queue(2);
+  ByteQueue::Consumer consumer1(queue);
+  ByteQueue::Consumer consumer2(queue);
+
+  constexpr size_t WRITES = 1000;
+  for (auto i: kj::zeroTo(WRITES)) {
+    auto store = jsg::BackingStore::alloc(js, 1);
+    store.asArrayPtr()[0] = i % 251;
+    queue.push(js, kj::refcounted<ByteQueue::Entry>(kj::mv(store)));
+  }
+
+  KJ_ASSERT(consumer1.size() == WRITES);
+  KJ_ASSERT(consumer2.size() == WRITES);
+  KJ_ASSERT(queue.size() == WRITES);
+
+  // A single read drains every write, in order, from each consumer independently.
+  MustCall<ReadContinuation> readContinuation([&](jsg::Lock& js, auto&& result) -> auto {
+    KJ_ASSERT(!result.done);
+    auto& value = KJ_ASSERT_NONNULL(result.value);
+    jsg::BufferSource source(js, value.getHandle(js));
+    auto ptr = source.asArrayPtr();
+    KJ_ASSERT(ptr.size() == WRITES);
+    for (auto i: kj::zeroTo(WRITES)) {
+      KJ_ASSERT(ptr[i] == i % 251);
+    }
+    return js.resolvedPromise(kj::mv(result));
+  }, 2);
+
+  byobRead(js, consumer1, WRITES).then(js, readContinuation);
+  KJ_ASSERT(consumer1.size() == 0);
+  KJ_ASSERT(consumer2.size() == WRITES);
+
+  byobRead(js, consumer2, WRITES).then(js, readContinuation);
+  KJ_ASSERT(consumer2.size() == 0);
+  KJ_ASSERT(queue.size() == 0);
+
+  js.runMicrotasks();
+}
+
 #pragma endregion ByteQueue Tests
 
 }  // namespace
@@ -303,14 +303,31 @@ kj::Own<ByteQueue::ByobRequest> ByteQueue::ReadRequest::makeByobReadRequest(
 
 #pragma region ByteQueue::Entry
 
-ByteQueue::Entry::Entry(jsg::BackingStore store) : store(kj::mv(store)) {}
+ByteQueue::Entry::Entry(jsg::BackingStore store) : store(kj::mv(store)) {
+  size = this->store.size();
+}
+
+kj::Own<ByteQueue::Entry> ByteQueue::Entry::withCapacity(jsg::Lock& js, size_t capacity) {
+  auto entry = kj::refcounted<Entry>(jsg::BackingStore::alloc(js, capacity));
+  entry->size = 0;
+  return kj::mv(entry);
+}
 
-kj::ArrayPtr<kj::byte> ByteQueue::Entry::toArrayPtr() { return store.asArrayPtr(); }
+kj::ArrayPtr<kj::byte> ByteQueue::Entry::toArrayPtr() { return store.asArrayPtr().first(size); }
 
-size_t ByteQueue::Entry::getSize() const { return store.size(); }
+size_t ByteQueue::Entry::getSize() const { return size; }
+
+bool ByteQueue::Entry::tryAppend(kj::ArrayPtr<const kj::byte> bytes) {
+  if (isShared() || store.size() - size < bytes.size()) {
+    return false;
+  }
+  std::copy(bytes.begin(), bytes.end(), store.asArrayPtr().begin() + size);
+  size += bytes.size();
+  return true;
+}
 
 kj::Own<ByteQueue::Entry> ByteQueue::Entry::clone(jsg::Lock& js) {
-  return kj::heap<ByteQueue::Entry>(store.clone());
+  return kj::addRef(*this);
 }
 
 void ByteQueue::Entry::visitForGc(jsg::GcVisitor& visitor) {}
@@ -424,7 +441,7 @@ bool ByteQueue::ByobRequest::respond(jsg::Lock& js, size_t amount) {
   if (queue.getConsumerCount() > 1) {
     // Allocate the entry into which we will be copying the provided data for the
     // other consumers of the queue.
-    auto entry = kj::heap<Entry>(jsg::BackingStore::alloc(js, amount));
+    auto entry = kj::refcounted<Entry>(jsg::BackingStore::alloc(js, amount));
 
     auto start = sourcePtr.begin() + req.pullInto.filled;
 
@@ -465,7 +482,7 @@ bool ByteQueue::ByobRequest::respond(jsg::Lock& js, size_t amount) {
 
   if (unaligned > 0) {
     auto start = sourcePtr.begin() + (amount - unaligned);
-    auto excess = kj::heap<Entry>(jsg::BackingStore::alloc(js, unaligned));
+    auto excess = kj::refcounted<Entry>(jsg::BackingStore::alloc(js, unaligned));
     std::copy(start, start + unaligned, excess->toArrayPtr().begin());
     consumer.push(js, kj::mv(excess));
   }
@@ -557,6 +574,16 @@ void ByteQueue::push(jsg::Lock& js, kj::Own<Entry> entry) {
 
 size_t ByteQueue::size() const { return impl.size(); }
 
+namespace {
+// Entries no larger than this are candidates for coalescing with the entry buffered before them.
+constexpr size_t COALESCE_ENTRY_LIMIT = 256;
+
+// Capacity of the entry that small adjacent entries are copied into. Each consumer fills its own,
+// so that consumers never observe each other's appends.
+constexpr size_t COALESCE_BUFFER_SIZE = 4096;
+static_assert(COALESCE_BUFFER_SIZE >= 2 * COALESCE_ENTRY_LIMIT);
+}  // namespace
+
 void ByteQueue::handlePush(
     jsg::Lock& js,
     ConsumerImpl::Ready& state,
@@ -570,8 +597,36 @@ void ByteQueue::handlePush(
     });
   };
 
+  // Streams that write many tiny chunks (e.g. one TextEncoder.encode() per token) would otherwise
+  // leave one entry per write in the buffer. While nobody is waiting to read, copy a small entry
+  // onto the end of the small entry buffered before it, so that a later read drains a handful of
+  // larger entries instead.
+  const auto tryCoalesce = [&]() {
+    auto newSize = newEntry->getSize();
+    if (newSize > COALESCE_ENTRY_LIMIT || state.buffer.empty()) {
+      return false;
+    }
+    auto& last = KJ_UNWRAP_OR(state.buffer.back().tryGet<QueueEntry>(), return false);
+    auto bytes = newEntry->toArrayPtr();
+
+    if (!last.entry->tryAppend(bytes)) {
+      auto remaining = last.entry->toArrayPtr().slice(last.offset, last.entry->getSize());
+      if (remaining.size() > COALESCE_ENTRY_LIMIT) {
+        return false;
+      }
+      auto merged = Entry::withCapacity(js, COALESCE_BUFFER_SIZE);
+      merged->tryAppend(remaining);
+      merged->tryAppend(bytes);
+      last = QueueEntry { .entry = kj::mv(merged), .offset = 0 };
+    }
+
+    state.queueTotalSize += newSize;
+    return true;
+  };
+
   // If there are no pending reads add the entry to the buffer.
   if (state.readRequests.empty()) {
+    if (tryCoalesce()) return;
     return bufferData(0);
   }
 
@@ -732,6 +787,16 @@ void ByteQueue::handleRead(
   };
 
   const auto consume = [&](size_t amountToConsume) {
+    // Round down to whole elements of the destination view once, up front, rather than per entry,
+    // so that a read is filled from as many buffered entries as it has room for even when the
+    // individual entries are not element-aligned.
+    amountToConsume = kj::min(amountToConsume,
+                              request.pullInto.store.size() - request.pullInto.filled);
+    auto elementSize = request.pullInto.store.getElementSize();
+    if (amountToConsume > elementSize) {
+      amountToConsume -= amountToConsume % elementSize;
+    }
+
     while (amountToConsume > 0) {
       KJ_REQUIRE(!state.buffer.empty());
       // There must be at least one item in the buffer.
@@ -744,17 +809,9 @@ void ByteQueue::handleRead(
         }
         KJ_CASE_ONEOF(entry, QueueEntry) {
           // The amount to copy is the lesser of the current entry size minus
-          // offset and the data remaining in the destination to fill.
+          // offset and the amount remaining to consume.
           auto entrySize = entry.entry->getSize();
-          auto amountToCopy = kj::min(entrySize - entry.offset,
-                                      request.pullInto.store.size() - request.pullInto.filled);
-          auto elementSize = request.pullInto.store.getElementSize();
-          if (amountToCopy > elementSize) {
-            amountToCopy -= amountToCopy % elementSize;
-          }
-          if (amountToConsume > elementSize) {
-            amountToConsume -= amountToConsume % elementSize;
-          }
+          auto amountToCopy = kj::min(entrySize - entry.offset, amountToConsume);
 
           // Once we have the amount, we safely copy amountToCopy bytes from the
           // entry into the destination request, accounting properly for the offsets.
@@ -786,20 +786,36 @@ public:
 
   // A byte queue entry consists of a jsg::BackingStore containing a non-zero-length
   // sequence of bytes. The size is determined by the number of bytes in the entry.
-  class Entry {
+  //
+  // Entries are never modified once shared (consumers track how far they have read with
+  // QueueEntry::offset), so a single entry is shared by every consumer it is pushed to rather than
+  // cloned for each one. The one exception is a coalescing entry (see withCapacity()), which a
+  // consumer may append to while it is the only one holding a reference.
+  class Entry: public kj::Refcounted {
   public:
     explicit Entry(jsg::BackingStore store);
 
+    // Creates an empty entry with room for `capacity` bytes, to be filled with tryAppend().
+    static kj::Own<Entry> withCapacity(jsg::Lock& js, size_t capacity);
+
     kj::ArrayPtr<kj::byte> toArrayPtr();
 
     size_t getSize() const;
 
+    // Copies `bytes` onto the end of the entry and returns true if the entry has enough unused
+    // capacity and is not shared. Otherwise returns false and leaves the entry unchanged.
+    bool tryAppend(kj::ArrayPtr<const kj::byte> bytes);
+
     void visitForGc(jsg::GcVisitor& visitor);
 
     kj::Own<Entry> clone(jsg::Lock& js);
 
   private:
     jsg::BackingStore store;
+
+    // Number of bytes of `store` that hold data. Only less than store.size() for coalescing
+    // entries.
+    size_t size;
   };
 
   struct QueueEntry {
@@ -44,6 +44,77 @@ export const arrayBufferOfReadable = {
   }
 }
 
+async function compress(data, format, options) {
+  const cs = new CompressionStream(format, options);
+  const cw = cs.writable.getWriter();
+  await cw.write(data);
+  await cw.close();
+  return new Uint8Array(await new Response(cs.readable).arrayBuffer());
+}
+
+async function decompress(data, format, options) {
+  const ds = new DecompressionStream(format, options);
+  const dw = ds.writable.getWriter();
+  await dw.write(data);
+  await dw.close();
+  return new Uint8Array(await new Response(ds.readable).arrayBuffer());
+}
+
+export const brotliCompressionStream = {
+  async test() {
+    const input = new TextEncoder().encode("0123456789".repeat(1000));
+    const compressed = await compress(input, "br");
+    assert.ok(compressed.byteLength < 100);
+    assert.deepStrictEqual(await decompress(compressed, "br"), input);
+  }
+};
+
+export const compressionStreamOptions = {
+  async test() {
+    const input = new TextEncoder().encode(
+        JSON.stringify(Array.from({ length: 200 }, (_, i) => ({ id: i, name: `item ${i}` }))));
+
+    for (const format of ["gzip", "deflate", "deflate-raw", "br"]) {
+      const fast = await compress(input, format, { level: 1 });
+      const best = await compress(input, format, { level: 9 });
+      const smallWindow = await compress(input, format, { windowBits: 10 });
+      assert.ok(best.byteLength <= fast.byteLength, format);
+      assert.deepStrictEqual(await decompress(fast, format), input);
+      assert.deepStrictEqual(await decompress(best, format), input);
+      assert.deepStrictEqual(await decompress(smallWindow, format, { windowBits: 10 }), input);
+    }
+
+    assert.throws(() => new CompressionStream("gzip", { level: 10 }), RangeError);
+    assert.throws(() => new CompressionStream("br", { level: 12 }), RangeError);
+    assert.throws(() => new CompressionStream("deflate", { windowBits: 16 }), RangeError);
+    assert.throws(() => new DecompressionStream("br", { windowBits: 25 }), RangeError);
+    assert.throws(() => new CompressionStream("zstd"), TypeError);
+  }
+};
+
+export const compressionStreamDictionary = {
+  async test() {
+    const enc = new TextEncoder();
+    const dictionary = enc.encode('{"status":"ok","items":[{"id":');
+    const input = enc.encode('{"status":"ok","items":[{"id":1}]}');
+
+    for (const format of ["deflate", "deflate-raw"]) {
+      const plain = await compress(input, format);
+      const withDict = await compress(input, format, { dictionary });
+      assert.ok(withDict.byteLength < plain.byteLength, format);
+      assert.deepStrictEqual(await decompress(withDict, format, { dictionary }), input);
+    }
+
+    // The zlib wrapper records which dictionary was used.
+    const withDict = await compress(input, "deflate", { dictionary });
+    await assert.rejects(decompress(withDict, "deflate"));
+    await assert.rejects(decompress(withDict, "deflate", { dictionary: enc.encode("nope") }));
+
+    assert.throws(() => new CompressionStream("gzip", { dictionary }), TypeError);
+    assert.throws(() => new DecompressionStream("br", { dictionary }), TypeError);
+  }
+};
+
 export const inspect = {
   async test() {
     const inspectOpts = { breakLength: Infinity };
@@ -4,16 +4,305 @@
 
 #include "system-streams.h"
 #include "util.h"
+#include "streams/compression-pool.h"
 #include <kj/one-of.h>
-#include <kj/compat/gzip.h>
-#include <kj/compat/brotli.h>
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#include <workerd/util/shared-tee.h>
 
 namespace workerd::api {
 
+namespace {
+
 // =======================================================================================
-// EncodedAsyncInputStream
+// Content-Encoding streams
+//
+// These do the same job as kj's GzipAsyncInputStream/GzipAsyncOutputStream and
+// BrotliAsyncInputStream/BrotliAsyncOutputStream, and fail with the same messages, but take their
+// compression state from the per-thread pools in streams/compression-pool.h instead of allocating
+// it for every request or response body.
 
-namespace {
+// The largest zlib window, plus 16 for the gzip wrapper.
+constexpr int GZIP_WINDOW_BITS = MAX_WBITS + 16;
+constexpr size_t ENCODING_BUFFER_SIZE = 8192;
+
+class GzipDecodingStream final: public kj::AsyncInputStream {
+public:
+  GzipDecodingStream(kj::AsyncInputStream& inner, RequestObserver& metrics)
+      : inner(inner),
+        stream(ZlibStreamPool::forThread().get(ZlibStream::Key {
+          .mode = CompressionMode::DECOMPRESS,
+          .windowBits = GZIP_WINDOW_BITS,
+          .level = Z_DEFAULT_COMPRESSION,
+        }, metrics)),
+        ctx(stream->ctx) {}
+
+  ~GzipDecodingStream() noexcept(false) {
+    ZlibStreamPool::forThread().release(kj::mv(stream));
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(GzipDecodingStream);
+
+  kj::Promise<size_t> tryRead(void* out, size_t minBytes, size_t maxBytes) override {
+    if (maxBytes == 0) return size_t(0);
+    return readImpl(reinterpret_cast<byte*>(out), minBytes, maxBytes, 0);
+  }
+
+private:
+  kj::AsyncInputStream& inner;
+  kj::Own<ZlibStream> stream;
+  z_stream& ctx;
+  bool atValidEndpoint = false;
+  byte buffer[ENCODING_BUFFER_SIZE];
+
+  kj::Promise<size_t> readImpl(byte* out, size_t minBytes, size_t maxBytes, size_t alreadyRead) {
+    if (ctx.avail_in == 0) {
+      return inner.tryRead(buffer, 1, sizeof(buffer))
+          .then([this, out, minBytes, maxBytes, alreadyRead](size_t amount)
+              -> kj::Promise<size_t> {
+        if (amount == 0) {
+          if (!atValidEndpoint) {
+            return KJ_EXCEPTION(DISCONNECTED, "gzip compressed stream ended prematurely");
+          }
+          return alreadyRead;
+        }
+        ctx.next_in = buffer;
+        ctx.avail_in = amount;
+        return readImpl(out, minBytes, maxBytes, alreadyRead);
+      });
+    }
+
+    ctx.next_out = out;
+    ctx.avail_out = maxBytes;
+
+    auto result = inflate(&ctx, Z_NO_FLUSH);
+    atValidEndpoint = result == Z_STREAM_END;
+    if (result != Z_OK && result != Z_STREAM_END) {
+      if (ctx.msg == nullptr) {
+        KJ_FAIL_REQUIRE("gzip decompression failed", result);
+      } else {
+        KJ_FAIL_REQUIRE("gzip decompression failed", ctx.msg);
+      }
+    }
+    if (atValidEndpoint && ctx.avail_in > 0) {
+      // More data follows the end of the gzip member. Assume it's another member.
+      KJ_ASSERT(inflateReset(&ctx) == Z_OK);
+    }
+
+    size_t n = maxBytes - ctx.avail_out;
+    if (n >= minBytes) {
+      return n + alreadyRead;
+    }
+    return readImpl(out + n, minBytes - n, maxBytes - n, alreadyRead + n);
+  }
+};
+
+class BrotliDecodingStream final: public kj::AsyncInputStream {
+public:
+  explicit BrotliDecodingStream(kj::AsyncInputStream& inner)
+      : inner(inner),
+        decoder(BrotliDecoderCreateInstance(
+            &BrotliMemoryPool::alloc, &BrotliMemoryPool::free, nullptr)) {
+    KJ_REQUIRE(decoder != nullptr, "brotli state allocation failed");
+  }
+
+  ~BrotliDecodingStream() noexcept(false) {
+    BrotliDecoderDestroyInstance(decoder);
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(BrotliDecodingStream);
+
+  kj::Promise<size_t> tryRead(void* out, size_t minBytes, size_t maxBytes) override {
+    if (maxBytes == 0) return size_t(0);
+    return readImpl(reinterpret_cast<byte*>(out), minBytes, maxBytes, 0);
+  }
+
+private:
+  kj::AsyncInputStream& inner;
+  BrotliDecoderState* decoder;
+  const byte* nextIn = nullptr;
+  size_t availIn = 0;
+  bool finished = false;
+  byte buffer[ENCODING_BUFFER_SIZE];
+
+  kj::Promise<size_t> readImpl(byte* out, size_t minBytes, size_t maxBytes, size_t alreadyRead) {
+    if (finished) {
+      // Anything after the end of the brotli stream is ignored.
+      return alreadyRead;
+    }
+
+    byte* nextOut = out;
+    size_t availOut = maxBytes;
+    auto result = BrotliDecoderDecompressStream(
+        decoder, &availIn, &nextIn, &availOut, &nextOut, nullptr);
+    if (result == BROTLI_DECODER_RESULT_ERROR) {
+      KJ_FAIL_REQUIRE("brotli decompression failed",
+          BrotliDecoderErrorString(BrotliDecoderGetErrorCode(decoder)));
+    }
+    finished = result == BROTLI_DECODER_RESULT_SUCCESS;
+
+    // The decoder only stops for more output once `out` is full, which covers `minBytes`.
+    size_t n = maxBytes - availOut;
+    if (n >= minBytes || finished) {
+      return n + alreadyRead;
+    }
+
+    KJ_ASSERT(result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT);
+    return inner.tryRead(buffer, 1, sizeof(buffer))
+        .then([this, out = out + n, minBytes = minBytes - n, maxBytes = maxBytes - n,
+               alreadyRead = alreadyRead + n](size_t amount) -> kj::Promise<size_t> {
+      if (amount == 0) {
+        return KJ_EXCEPTION(DISCONNECTED, "brotli compressed stream ended prematurely");
+      }
+      nextIn = buffer;
+      availIn = amount;
+      return readImpl(out, minBytes, maxBytes, alreadyRead);
+    });
+  }
+};
+
+// A compressing stream, which must be ended to write out the end of the compressed data.
+class EncodingOutputStream: public kj::AsyncOutputStream {
+public:
+  explicit EncodingOutputStream(kj::AsyncOutputStream& inner): inner(inner) {}
+
+  virtual kj::Promise<void> end() = 0;
+
+  kj::Promise<void> write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) override {
+    if (pieces.size() == 0) return kj::READY_NOW;
+    return write(pieces[0].begin(), pieces[0].size()).then([this, pieces]() {
+      return write(pieces.slice(1, pieces.size()));
+    });
+  }
+  using kj::AsyncOutputStream::write;
+
+  kj::Promise<void> whenWriteDisconnected() override {
+    return inner.whenWriteDisconnected();
+  }
+
+protected:
+  kj::AsyncOutputStream& inner;
+  byte buffer[ENCODING_BUFFER_SIZE];
+};
+
+class GzipEncodingStream final: public EncodingOutputStream {
+public:
+  GzipEncodingStream(kj::AsyncOutputStream& inner, RequestObserver& metrics)
+      : EncodingOutputStream(inner),
+        stream(ZlibStreamPool::forThread().get(ZlibStream::Key {
+          .mode = CompressionMode::COMPRESS,
+          .windowBits = GZIP_WINDOW_BITS,
+          .level = Z_DEFAULT_COMPRESSION,
+        }, metrics)),
+        ctx(stream->ctx) {}
+
+  ~GzipEncodingStream() noexcept(false) {
+    ZlibStreamPool::forThread().release(kj::mv(stream));
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(GzipEncodingStream);
+
+  kj::Promise<void> write(const void* in, size_t size) override {
+    ctx.next_in = const_cast<byte*>(reinterpret_cast<const byte*>(in));
+    ctx.avail_in = size;
+    return pump(Z_NO_FLUSH);
+  }
+  using EncodingOutputStream::write;
+
+  kj::Promise<void> end() override {
+    return pump(Z_FINISH);
+  }
+
+private:
+  kj::Own<ZlibStream> stream;
+  z_stream& ctx;
+
+  kj::Promise<void> pump(int flush) {
+    ctx.next_out = buffer;
+    ctx.avail_out = sizeof(buffer);
+
+    auto result = deflate(&ctx, flush);
+    if (result != Z_OK && result != Z_BUF_ERROR && result != Z_STREAM_END) {
+      KJ_FAIL_REQUIRE("gzip compression failed", result);
+    }
+
+    // deflate() stops early only when it runs out of output space.
+    bool more = ctx.avail_out == 0;
+    size_t n = sizeof(buffer) - ctx.avail_out;
+    if (n == 0) return kj::READY_NOW;
+    auto promise = inner.write(buffer, n);
+    if (more) {
+      promise = promise.then([this, flush]() { return pump(flush); });
+    }
+    return promise;
+  }
+};
+
+class BrotliEncodingStream final: public EncodingOutputStream {
+public:
+  explicit BrotliEncodingStream(kj::AsyncOutputStream& inner)
+      : EncodingOutputStream(inner),
+        encoder(BrotliEncoderCreateInstance(
+            &BrotliMemoryPool::alloc, &BrotliMemoryPool::free, nullptr)) {
+    KJ_REQUIRE(encoder != nullptr, "brotli state allocation failed");
+    KJ_DEFER(if (!initialized) BrotliEncoderDestroyInstance(encoder));
+    KJ_REQUIRE(BrotliEncoderSetParameter(encoder, BROTLI_PARAM_QUALITY, BROTLI_DEFAULT_QUALITY),
+        "invalid brotli compression level");
+    KJ_REQUIRE(BrotliEncoderSetParameter(encoder, BROTLI_PARAM_LGWIN, BROTLI_DEFAULT_WINDOW),
+        "invalid brotli window size");
+    initialized = true;
+  }
+
+  ~BrotliEncodingStream() noexcept(false) {
+    BrotliEncoderDestroyInstance(encoder);
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(BrotliEncodingStream);
+
+  kj::Promise<void> write(const void* in, size_t size) override {
+    nextIn = reinterpret_cast<const byte*>(in);
+    availIn = size;
+    return pump(BROTLI_OPERATION_PROCESS);
+  }
+  using EncodingOutputStream::write;
+
+  kj::Promise<void> end() override {
+    return pump(BROTLI_OPERATION_FINISH);
+  }
+
+private:
+  BrotliEncoderState* encoder;
+  bool initialized = false;
+  const byte* nextIn = nullptr;
+  size_t availIn = 0;
+
+  kj::Promise<void> pump(BrotliEncoderOperation op) {
+    for (;;) {
+      byte* nextOut = buffer;
+      size_t availOut = sizeof(buffer);
+      KJ_REQUIRE(BrotliEncoderCompressStream(
+          encoder, op, &availIn, &nextIn, &availOut, &nextOut, nullptr),
+          "brotli compression failed");
+
+      bool more = availIn > 0 || BrotliEncoderHasMoreOutput(encoder) ||
+          (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(encoder));
+      size_t n = sizeof(buffer) - availOut;
+      if (n == 0) {
+        // The encoder may take input without producing any output yet.
+        if (more) continue;
+        return kj::READY_NOW;
+      }
+      auto promise = inner.write(buffer, n);
+      if (more) {
+        promise = promise.then([this, op]() { return pump(op); });
+      }
+      return promise;
+    }
+  }
+};
+
+// =======================================================================================
+// EncodedAsyncInputStream
 
 // A wrapper around a native `kj::AsyncInputStream` which knows the underlying encoding of the
 // stream and whether or not it requires pending event registration.
@@ -108,7 +397,10 @@ kj::Maybe<ReadableStreamSource::Tee> EncodedAsyncInputStream::tryTee(uint64_t li
   // Additionally, we should propagate the fact that this stream is a native stream to the branches
   // of the tee, so that branches which fall behind their siblings (and thus are reading from the
   // tee buffer) still register pending events correctly.
-  auto tee = kj::newTee(kj::mv(inner), limit);
+  auto tee = newSharedTee(kj::mv(inner), {
+    .lagLimits = { limit, limit },
+    .spillDirectory = ioContext.getTeeSpillDirectory(),
+  });
 
   Tee result;
   result.branches[0] = newSystemStream(newTeeErrorAdapter(kj::mv(tee.branches[0])), encoding);
@@ -119,10 +411,10 @@ kj::Maybe<ReadableStreamSource::Tee> EncodedAsyncInputStream::tryTee(uint64_t li
 void EncodedAsyncInputStream::ensureIdentityEncoding() {
   // Decompression gets added to the stream here if needed based on the content encoding.
   if (encoding == StreamEncoding::GZIP) {
-    inner = kj::heap<kj::GzipAsyncInputStream>(*inner).attach(kj::mv(inner));
+    inner = kj::heap<GzipDecodingStream>(*inner, ioContext.getMetrics()).attach(kj::mv(inner));
     encoding = StreamEncoding::IDENTITY;
   } else if (encoding == StreamEncoding::BROTLI) {
-    inner = kj::heap<kj::BrotliAsyncInputStream>(*inner).attach(kj::mv(inner));
+    inner = kj::heap<BrotliDecodingStream>(*inner).attach(kj::mv(inner));
     encoding = StreamEncoding::IDENTITY;
   } else {
     // We currently support gzip and brotli as non-identity content encodings.
@@ -172,8 +464,7 @@ private:
   // I use a OneOf here rather than probing with downcasts because end() must be called for
   // correctness rather than for optimization. I "know" this code will never be compiled w/o RTTI,
   // but I'm paranoid.
-  kj::OneOf<kj::Own<kj::AsyncOutputStream>, kj::Own<kj::GzipAsyncOutputStream>,
-            kj::Own<kj::BrotliAsyncOutputStream>, Ended> inner;
+  kj::OneOf<kj::Own<kj::AsyncOutputStream>, kj::Own<EncodingOutputStream>, Ended> inner;
 
   StreamEncoding encoding;
 
@@ -232,11 +523,8 @@ kj::Maybe<kj::Promise<DeferredProxy<void>>> EncodedAsyncOutputStream::tryPumpFro
 
     auto promise = nativeInput.inner->pumpTo(getInner()).ignoreResult();
     if (end) {
-      KJ_IF_SOME(gz, inner.tryGet<kj::Own<kj::GzipAsyncOutputStream>>()) {
-        promise = promise.then([&gz = gz]() { return gz->end(); });
-      }
-      KJ_IF_SOME(br, inner.tryGet<kj::Own<kj::BrotliAsyncOutputStream>>()) {
-        promise = promise.then([&br = br]() { return br->end(); });
+      KJ_IF_SOME(encoder, inner.tryGet<kj::Own<EncodingOutputStream>>()) {
+        promise = promise.then([&encoder = encoder]() { return encoder->end(); });
       }
     }
 
@@ -253,11 +541,8 @@ kj::Promise<void> EncodedAsyncOutputStream::end() {
 
   kj::Promise<void> promise = kj::READY_NOW;
 
-  KJ_IF_SOME(gz, inner.tryGet<kj::Own<kj::GzipAsyncOutputStream>>()) {
-    promise = gz->end().attach(kj::mv(gz));
-  }
-  KJ_IF_SOME(br, inner.tryGet<kj::Own<kj::BrotliAsyncOutputStream>>()) {
-    promise = br->end().attach(kj::mv(br));
+  KJ_IF_SOME(encoder, inner.tryGet<kj::Own<EncodingOutputStream>>()) {
+    promise = encoder->end().attach(kj::mv(encoder));
   }
 
   KJ_IF_SOME(stream, inner.tryGet<kj::Own<kj::AsyncOutputStream>>()) {
@@ -283,12 +568,14 @@ void EncodedAsyncOutputStream::ensureIdentityEncoding() {
     // This is safe because only a kj::AsyncOutputStream can have non-identity encoding.
     auto& stream = inner.get<kj::Own<kj::AsyncOutputStream>>();
 
-    inner = kj::heap<kj::GzipAsyncOutputStream>(*stream).attach(kj::mv(stream));
+    inner = kj::Own<EncodingOutputStream>(
+        kj::heap<GzipEncodingStream>(*stream, ioContext.getMetrics()).attach(kj::mv(stream)));
     encoding = StreamEncoding::IDENTITY;
   } else if (encoding == StreamEncoding::BROTLI) {
     auto& stream = inner.get<kj::Own<kj::AsyncOutputStream>>();
 
-    inner = kj::heap<kj::BrotliAsyncOutputStream>(*stream).attach(kj::mv(stream));
+    inner = kj::Own<EncodingOutputStream>(
+        kj::heap<BrotliEncodingStream>(*stream).attach(kj::mv(stream)));
     encoding = StreamEncoding::IDENTITY;
   } else {
     // We currently support gzip and brotli as non-identity content encodings.
@@ -301,11 +588,8 @@ kj::AsyncOutputStream& EncodedAsyncOutputStream::getInner() {
     KJ_CASE_ONEOF(stream, kj::Own<kj::AsyncOutputStream>) {
       return *stream;
     }
-    KJ_CASE_ONEOF(gz, kj::Own<kj::GzipAsyncOutputStream>) {
-      return *gz;
-    }
-    KJ_CASE_ONEOF(br, kj::Own<kj::BrotliAsyncOutputStream>) {
-      return *br;
+    KJ_CASE_ONEOF(encoder, kj::Own<EncodingOutputStream>) {
+      return *encoder;
     }
     KJ_CASE_ONEOF(ended, Ended) {
       KJ_FAIL_ASSERT("the EncodedAsyncOutputStream has been ended or aborted.");
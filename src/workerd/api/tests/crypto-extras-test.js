@@ -1,6 +1,7 @@
 import {
   strictEqual,
   ok,
+  rejects,
   throws
 } from 'node:assert';
 
@@ -137,3 +138,131 @@ export const cryptoZeroLength = {
   }
 };
 
+
+export const largeInputs = {
+  async test() {
+    // Inputs this large are processed on a background thread. Check that the results match what
+    // the same operations produce on the isolate's thread, and that modifying the input right
+    // after the call has no effect.
+    const data = new Uint8Array(1024 * 1024);
+    for (let n = 0; n < data.length; n++) data[n] = n % 251;
+
+    const digestStream = new crypto.DigestStream('SHA-256');
+    const writer = digestStream.getWriter();
+    for (let n = 0; n < data.length; n += 1024) {
+      await writer.write(data.slice(n, n + 1024));
+    }
+    await writer.close();
+    const expectedDigest = new Uint8Array(await digestStream.digest);
+
+    const digestPromise = crypto.subtle.digest('SHA-256', data);
+    data[0] ^= 1;
+    const digest = new Uint8Array(await digestPromise);
+    data[0] ^= 1;
+    strictEqual(digest.join(), expectedDigest.join());
+
+    const aesKey = await crypto.subtle.generateKey({
+      name: 'AES-GCM',
+      length: 256
+    }, false, ['encrypt', 'decrypt']);
+    const iv = crypto.getRandomValues(new Uint8Array(12));
+    const cipherText = await crypto.subtle.encrypt({ name: 'AES-GCM', iv }, aesKey, data);
+    const plainText = new Uint8Array(
+        await crypto.subtle.decrypt({ name: 'AES-GCM', iv }, aesKey, cipherText));
+    strictEqual(plainText.length, data.length);
+    ok(plainText.every((value, n) => value === data[n]));
+
+    const hmacKey = await crypto.subtle.generateKey({
+      name: 'HMAC',
+      hash: 'SHA-256'
+    }, false, ['sign', 'verify']);
+    const signature = await crypto.subtle.sign('HMAC', hmacKey, data);
+    ok(await crypto.subtle.verify('HMAC', hmacKey, signature, data));
+    data[0] ^= 1;
+    ok(!await crypto.subtle.verify('HMAC', hmacKey, signature, data));
+  }
+};
+
+export const offloadThreshold = {
+  async test() {
+    // Returns whether a digest of `size` bytes settles while only microtasks run. Below the
+    // threshold the digest is computed right away; at or above it, the work goes to the thread
+    // pool and its result comes back through the event loop.
+    const settlesInline = async (size) => {
+      let settled = false;
+      const promise = crypto.subtle.digest('SHA-256', new Uint8Array(size))
+          .then(() => { settled = true; });
+      for (let n = 0; n < 10; n++) await null;
+      const result = settled;
+      await promise;
+      return result;
+    };
+    ok(await settlesInline(64 * 1024 - 1));
+    ok(!await settlesInline(64 * 1024));
+
+    // The isolate isn't held up while a large digest runs: work started after it finishes first.
+    const order = [];
+    await Promise.all([
+      crypto.subtle.digest('SHA-256', new Uint8Array(16 * 1024 * 1024))
+          .then(() => order.push('large')),
+      crypto.subtle.digest('SHA-256', new Uint8Array(16)).then(() => order.push('small')),
+    ]);
+    strictEqual(order.join(), 'small,large');
+  }
+};
+
+export const backgroundKeyOperations = {
+  async test() {
+    // RSA key generation, PBKDF2 and HKDF run on a background thread regardless of input size.
+    const hex = (buffer) => [...new Uint8Array(buffer)]
+        .map((b) => b.toString(16).padStart(2, '0')).join('');
+
+    // RFC 6070, test case 2.
+    const password = await crypto.subtle.importKey(
+        'raw', new TextEncoder().encode('password'), 'PBKDF2', false,
+        ['deriveBits', 'deriveKey']);
+    const pbkdf2 = { name: 'PBKDF2', hash: 'SHA-1', salt: new TextEncoder().encode('salt'),
+                     iterations: 2 };
+    strictEqual(hex(await crypto.subtle.deriveBits(pbkdf2, password, 160)),
+                'ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957');
+    const derived = await crypto.subtle.deriveKey(
+        pbkdf2, password, { name: 'HMAC', hash: 'SHA-1', length: 160 }, true, ['sign']);
+    strictEqual(hex(await crypto.subtle.exportKey('raw', derived)),
+                'ea6c014dc72d6f8ccd1ed92ace1d41f0d8de8957');
+    // Validation still happens before anything is handed off.
+    await rejects(crypto.subtle.deriveBits({ ...pbkdf2, iterations: 0 }, password, 160),
+                  { name: 'OperationError' });
+
+    // RFC 5869, test case 1.
+    const ikm = await crypto.subtle.importKey(
+        'raw', new Uint8Array(22).fill(0x0b), 'HKDF', false, ['deriveBits']);
+    const hkdf = {
+      name: 'HKDF',
+      hash: 'SHA-256',
+      salt: Uint8Array.from({ length: 13 }, (_, n) => n),
+      info: Uint8Array.from({ length: 10 }, (_, n) => 0xf0 + n),
+    };
+    strictEqual(hex(await crypto.subtle.deriveBits(hkdf, ikm, 42 * 8)),
+                '3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c' +
+                '5db02d56ecc4c5bf34007208d5b887185865');
+
+    const rsa = {
+      name: 'RSASSA-PKCS1-v1_5',
+      modulusLength: 2048,
+      publicExponent: new Uint8Array([1, 0, 1]),
+      hash: 'SHA-256',
+    };
+    const pairs = await Promise.all([
+      crypto.subtle.generateKey(rsa, false, ['sign', 'verify']),
+      crypto.subtle.generateKey(rsa, false, ['sign', 'verify']),
+    ]);
+    const data = new TextEncoder().encode('hello');
+    for (const { publicKey, privateKey } of pairs) {
+      strictEqual(publicKey.algorithm.modulusLength, 2048);
+      strictEqual(privateKey.type, 'private');
+      const signature = await crypto.subtle.sign(rsa, privateKey, data);
+      ok(await crypto.subtle.verify(rsa, publicKey, signature, data));
+    }
+    await rejects(crypto.subtle.generateKey(rsa, false, []), { name: 'SyntaxError' });
+  }
+};
@@ -85,3 +85,34 @@ export const digestStreamNoEnd = {
     // stream never ends, should not crash when IoContext is torn down.
   }
 };
+
+export const digestStreamLargeWrites = {
+  async test() {
+    // Writes this large are hashed on a background thread. Mix them with small writes, which are
+    // hashed immediately, and reuse the buffer as soon as each write resolves.
+    const sizes = [10, 256 * 1024, 1, 100 * 1024, 64 * 1024 - 1, 1024 * 1024, 7];
+    const total = sizes.reduce((a, b) => a + b);
+    const expected = new Uint8Array(total);
+    for (let n = 0; n < total; n++) expected[n] = (n * 7) % 256;
+
+    async function hash() {
+      const stream = new crypto.DigestStream('SHA-256');
+      const writer = stream.getWriter();
+      const buffer = new Uint8Array(1024 * 1024);
+      let offset = 0;
+      for (const size of sizes) {
+        buffer.set(expected.subarray(offset, offset + size));
+        await writer.write(buffer.subarray(0, size));
+        buffer.fill(0);
+        offset += size;
+      }
+      await writer.close();
+      return new Uint8Array(await stream.digest);
+    }
+
+    const check = new Uint8Array(await crypto.subtle.digest('SHA-256', expected));
+    for (const digest of await Promise.all([hash(), hash(), hash()])) {
+      deepStrictEqual(digest, check);
+    }
+  }
+};
@@ -0,0 +1,69 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+import * as assert from 'node:assert';
+
+const store = new Map([
+  ['a', { value: 'A', metadata: null }],
+  ['b', { value: 'B', metadata: { m: 2 } }],
+  ['c', { value: '{"x":1}', metadata: null }],
+]);
+
+// The reads that reached this service, so that tests can tell which were served from the cache.
+const requests = [];
+
+// Serves the KV binding's reads.
+export default {
+  async fetch(request) {
+    const url = new URL(request.url);
+    if (request.method === 'GET') {
+      const key = decodeURIComponent(url.pathname.slice(1));
+      requests.push(['get', key]);
+      const entry = store.get(key);
+      if (entry === undefined) return new Response(null, { status: 404 });
+      return new Response(entry.value);
+    }
+
+    assert.strictEqual(url.pathname, '/bulk/get');
+    const { keys, type, withMetadata } = await request.json();
+    requests.push(['bulk', keys, type, withMetadata]);
+    const result = Object.create(null);
+    for (const key of keys) {
+      const entry = store.get(key);
+      if (entry === undefined) continue;
+      const value = type === 'json' ? JSON.parse(entry.value) : entry.value;
+      result[key] = withMetadata ? { value, metadata: entry.metadata } : value;
+    }
+    return new Response(JSON.stringify(result), {
+      headers: { 'CF-Cache-Status': 'HIT' },
+    });
+  }
+};
+
+export const bulkGetUsesReadCache = {
+  async test(ctrl, env) {
+    assert.strictEqual(await env.KV.get('a'), 'A');
+
+    // Only the keys that weren't cached are fetched, as text with metadata, so that they can be
+    // cached for any type of read.
+    const first = await env.KV.getWithMetadata(['a', 'b', 'c', 'missing']);
+    assert.deepStrictEqual(first.get('a'), { value: 'A', metadata: null, cacheStatus: null });
+    assert.deepStrictEqual(first.get('b'), { value: 'B', metadata: { m: 2 }, cacheStatus: 'HIT' });
+    assert.deepStrictEqual(first.get('missing'), {
+      value: null, metadata: null, cacheStatus: 'HIT',
+    });
+
+    // Everything is cached now.
+    const text = await env.KV.get(['a', 'b']);
+    assert.deepStrictEqual([...text], [['a', 'A'], ['b', 'B']]);
+    const json = await env.KV.get(['c', 'missing'], 'json');
+    assert.deepStrictEqual([...json], [['c', { x: 1 }], ['missing', null]]);
+    assert.deepStrictEqual((await env.KV.getWithMetadata('b')).metadata, { m: 2 });
+
+    assert.deepStrictEqual(requests, [
+      ['get', 'a'],
+      ['bulk', ['b', 'c', 'missing'], 'text', true],
+    ]);
+  }
+};
@@ -0,0 +1,94 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+import * as assert from 'node:assert';
+
+const store = new Map([
+  ['text', { value: 'hello', metadata: { m: 1 } }],
+  ['json', { value: '{"x":1}', metadata: null }],
+]);
+
+// Serves the KV binding's bulk reads.
+export default {
+  async fetch(request) {
+    const url = new URL(request.url);
+    assert.strictEqual(request.method, 'POST');
+    assert.strictEqual(url.pathname, '/bulk/get');
+    assert.strictEqual(request.headers.get('content-type'), 'application/json');
+
+    const { keys, type, withMetadata } = await request.json();
+    // No prototype, so that "__proto__" is an ordinary key.
+    const result = Object.create(null);
+    for (const key of keys) {
+      let value;
+      if (key === 'ttl') {
+        value = url.searchParams.get('cache_ttl');
+      } else if (key === 'null') {
+        result[key] = null;
+        continue;
+      } else if (store.has(key)) {
+        value = store.get(key).value;
+        if (type === 'json') value = JSON.parse(value);
+      } else {
+        continue;
+      }
+      result[key] = withMetadata ? { value, metadata: store.get(key)?.metadata ?? null } : value;
+    }
+    return new Response(JSON.stringify(result), {
+      headers: { 'CF-Cache-Status': 'HIT' },
+    });
+  }
+};
+
+export const bulkGetText = {
+  async test(ctrl, env) {
+    const result = await env.KV.get(['text', 'null', 'missing', 'toString', '__proto__']);
+    assert.ok(result instanceof Map);
+    assert.deepStrictEqual([...result], [
+      ['text', 'hello'],
+      ['null', null],
+      ['missing', null],
+      ['toString', null],
+      ['__proto__', null],
+    ]);
+  }
+};
+
+export const bulkGetJson = {
+  async test(ctrl, env) {
+    const result = await env.KV.get(['json', 'constructor'], 'json');
+    assert.deepStrictEqual([...result], [['json', { x: 1 }], ['constructor', null]]);
+  }
+};
+
+export const bulkGetWithMetadata = {
+  async test(ctrl, env) {
+    const result = await env.KV.getWithMetadata(['text', 'missing', 'hasOwnProperty']);
+    assert.deepStrictEqual(result.get('text'), {
+      value: 'hello', metadata: { m: 1 }, cacheStatus: 'HIT',
+    });
+    assert.deepStrictEqual(result.get('missing'), {
+      value: null, metadata: null, cacheStatus: 'HIT',
+    });
+    assert.deepStrictEqual(result.get('hasOwnProperty'), {
+      value: null, metadata: null, cacheStatus: 'HIT',
+    });
+  }
+};
+
+export const bulkGetCacheTtl = {
+  async test(ctrl, env) {
+    const result = await env.KV.get(['ttl'], { cacheTtl: 120 });
+    assert.strictEqual(result.get('ttl'), '120');
+  }
+};
+
+export const bulkGetLimits = {
+  async test(ctrl, env) {
+    await assert.rejects(env.KV.get([]), TypeError);
+    const tooMany = Array.from({ length: 101 }, (_, i) => `key${i}`);
+    await assert.rejects(env.KV.get(tooMany), TypeError);
+    await assert.rejects(env.KV.get(['text'], 'arrayBuffer'), TypeError);
+  }
+};
@@ -352,6 +352,9 @@ public:
     return false;
   }
 
+  // True once close() has been called, after which send() throws.
+  bool hasClosedOutgoing() { return closedOutgoingForHib; }
+
   HibernationPackage buildPackageForHibernation() {
     // TODO(cleanup): It would be great if we could limit this so only the HibernationManager
     // (or a derived class) could call it.
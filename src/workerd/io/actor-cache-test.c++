@@ -197,6 +197,8 @@ struct ActorCacheTestOptions {
   size_t maxKeysPerRpc = 128;
   bool noCache = false;
   bool neverFlush = false;
+  uint shardCount = 1;
+  bool secondChance = false;
 };
 
 struct ActorCacheTest: public ActorCacheConvenienceWrappers {
@@ -221,7 +223,7 @@ struct ActorCacheTest: public ActorCacheConvenienceWrappers {
         ws(loop), mockStorage(kj::mv(mockPair.mock)),
         lru({options.softLimit, options.hardLimit,
              options.staleTimeout, options.dirtyListByteLimit, options.maxKeysPerRpc,
-             options.noCache, options.neverFlush}),
+             options.noCache, options.neverFlush, options.shardCount, options.secondChance}),
         cache(kj::mv(mockPair.client), lru, gate),
         gateBrokenPromise(options.monitorOutputGate
             ? eagerlyReportExceptions(gate.onBroken())
@@ -1746,6 +1748,39 @@ KJ_TEST("ActorCache list() with limit") {
       kvs({{"bar", "456"}, {"baz", "789"}, {"foo", "123"}, {"garply", "54321"}}));
 }
 
+KJ_TEST("ActorCache list() with limit and read-ahead") {
+  ActorCacheTest test;
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  {
+    auto promise = expectUncached(test.list("bar", "qux", 2, {.readAhead = 2}));
+
+    // The storage list asks for the two read-ahead keys on top of the limit.
+    mockStorage->expectCall("list", ws)
+        .withParams(CAPNP(start = "bar", end = "qux", limit = 4), "stream"_kj)
+        .useCallback("stream", [&](MockClient stream) {
+      stream.call("values", CAPNP(list = [(key = "bar", value = "456"),
+                                          (key = "baz", value = "789"),
+                                          (key = "foo", value = "123"),
+                                          (key = "garply", value = "54321")]))
+          .expectReturns(CAPNP(), ws);
+      stream.call("end", CAPNP()).expectReturns(CAPNP(), ws);
+    }).expectCanceled();
+
+    // Only the requested page is returned.
+    KJ_ASSERT(promise.wait(ws) == kvs({{"bar", "456"}, {"baz", "789"}}));
+  }
+
+  // The next page is served from cache.
+  KJ_ASSERT(expectCached(test.list("baza", "qux", 2)) ==
+      kvs({{"foo", "123"}, {"garply", "54321"}}));
+  KJ_ASSERT(expectCached(test.get("fooa")) == nullptr);
+
+  // But nothing past the last key read ahead.
+  (void)expectUncached(test.get("garplya"));
+}
+
 KJ_TEST("ActorCache list() with limit around negative entries") {
   // This checks for a bug where the initial scan through cache for list() applies the limit to
   // the total number of entries seen (positive or negative), when it really needs to apply only
@@ -3562,6 +3597,84 @@ KJ_TEST("ActorCache LRU purge ordering") {
   KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("yyy"))) == "bbb");
 }
 
+KJ_TEST("ActorCache LRU purge ordering with second chance") {
+  ActorCacheTest test({.softLimit = 4 * ENTRY_SIZE, .secondChance = true});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  test.put("foo", "123");
+  test.put("bar", "456");
+  test.put("baz", "789");
+  test.put("qux", "555");
+
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+
+  // Touch foo. This only marks it, rather than moving it to the back of the list...
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("foo"))) == "123");
+
+  test.put("xxx", "aaa");
+  test.put("yyy", "bbb");
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+
+  // ...but when it comes up for eviction it gets a second chance, so the outcome is the same as
+  // with exact LRU ordering.
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("foo"))) == "123");
+  (void)expectUncached(test.get("bar"));
+  (void)expectUncached(test.get("baz"));
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("qux"))) == "555");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("xxx"))) == "aaa");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(test.get("yyy"))) == "bbb");
+}
+
+KJ_TEST("ActorCache LRU shards share limits") {
+  ActorCacheTest test({.softLimit = 4 * ENTRY_SIZE, .shardCount = 2});
+  auto& ws = test.ws;
+  auto& mockStorage = test.mockStorage;
+
+  // A second cache using the same LRU lands in the other shard.
+  auto otherMock = MockServer::make<rpc::ActorStorage::Stage>();
+  ActorCache otherCache(kj::mv(otherMock.client), test.lru, test.gate);
+  ActorCacheConvenienceWrappers other(otherCache);
+
+  other.put("foo", "123");
+  otherMock.mock->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+  size_t otherSize = test.lru.currentSize();
+  KJ_EXPECT(otherSize > 0);
+
+  test.put("bar", "456");
+  test.put("baz", "789");
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+
+  // The size is tracked across both shards.
+  KJ_EXPECT(test.lru.currentSize() > otherSize);
+
+  // Each shard stays within half of the soft limit, so going over that evicts this shard's own
+  // clean entries even though the total is within the limit. The new entries are dirty, so they
+  // can't be evicted yet, and the shard stays over its share until they're flushed.
+  test.put("qux", "555");
+  test.put("xxx", "aaa");
+  test.put("yyy", "bbb");
+
+  // The total is now over the soft limit, but the other shard is within its share, so it doesn't
+  // evict anything to make up for this one.
+  other.put("zzz", "ccc");
+
+  otherMock.mock->expectCall("put", ws).thenReturn(CAPNP());
+  mockStorage->expectCall("put", ws).thenReturn(CAPNP());
+  test.gate.wait().wait(ws);
+
+  (void)expectUncached(test.get("bar"));
+  (void)expectUncached(test.get("baz"));
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(other.get("foo"))) == "123");
+  KJ_ASSERT(KJ_ASSERT_NONNULL(expectCached(other.get("zzz"))) == "ccc");
+
+  otherMock.mock->expectNoActivity(ws);
+  otherCache.verifyConsistencyForTest();
+}
+
 KJ_TEST("ActorCache LRU purge larger") {
   ActorCacheTest test({.softLimit = 32 * ENTRY_SIZE});
   auto& ws = test.ws;
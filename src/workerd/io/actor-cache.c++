@@ -26,12 +26,12 @@ ActorCache::Hooks ActorCache::Hooks::DEFAULT;
 
 ActorCache::ActorCache(rpc::ActorStorage::Stage::Client storage, const SharedLru& lru,
                        OutputGate& gate, Hooks& hooks)
-    : storage(kj::mv(storage)), lru(lru), gate(gate), hooks(hooks),
-      currentValues(lru.cleanList.lockExclusive()) {}
+    : storage(kj::mv(storage)), lru(lru), lruShard(lru.chooseShard()), gate(gate), hooks(hooks),
+      currentValues(lruShard.cleanList.lockExclusive()) {}
 
 ActorCache::~ActorCache() noexcept(false) {
   // Need to remove all entries from any lists they might be in.
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   clear(lock);
 }
 
@@ -53,7 +53,7 @@ ActorCache::Entry::Entry(ActorCache& cache, Key key, Value value)
     : maybeCache(cache), key(kj::mv(key)), value(kj::mv(value)),
       valueStatus(EntryValueStatus::PRESENT) {
   KJ_IF_SOME(c, maybeCache) {
-    c.lru.size.fetch_add(size(), std::memory_order_relaxed);
+    c.lruShard.size.fetch_add(size(), std::memory_order_relaxed);
   }
 }
 
@@ -63,7 +63,7 @@ ActorCache::Entry::Entry(ActorCache& cache, Key key, EntryValueStatus valueStatu
     valueStatus != EntryValueStatus::PRESENT,
     "Pass a serialized empty v8 value if you want a present but empty entry!");
   KJ_IF_SOME(c, maybeCache) {
-    c.lru.size.fetch_add(size(), std::memory_order_relaxed);
+    c.lruShard.size.fetch_add(size(), std::memory_order_relaxed);
   }
 }
 
@@ -76,13 +76,13 @@ ActorCache::Entry::~Entry() noexcept(false) {
   KJ_IF_SOME(c, maybeCache) {
     size_t size = this->size();
 
-    size_t before = c.lru.size.fetch_sub(size, std::memory_order_relaxed);
+    size_t before = c.lruShard.size.fetch_sub(size, std::memory_order_relaxed);
 
     if (KJ_UNLIKELY(before < size)) {
       // underflow -- shouldn't happen, but just in case, let's fix
       KJ_LOG(ERROR, "SharedLru size tracking inconsistency detected",
             before, size, kj::getStackTrace());
-      c.lru.size.store(0, std::memory_order_relaxed);
+      c.lruShard.size.store(0, std::memory_order_relaxed);
     }
 
     KJ_REQUIRE(!link.isLinked(),
@@ -90,25 +90,40 @@ ActorCache::Entry::~Entry() noexcept(false) {
   }
 }
 
-ActorCache::SharedLru::SharedLru(Options options): options(options) {}
+ActorCache::SharedLru::SharedLru(Options options)
+    : options(options), shards(kj::heapArray<Shard>(kj::max(options.shardCount, 1u))) {}
 
 ActorCache::SharedLru::~SharedLru() noexcept(false) {
-  KJ_REQUIRE(cleanList.getWithoutLock().empty(),
-      "ActorCache::SharedLru destroyed while an ActorCache still exists?");
-  if (size.load(std::memory_order_relaxed) != 0) {
+  for (auto& shard: shards) {
+    KJ_REQUIRE(shard.cleanList.getWithoutLock().empty(),
+        "ActorCache::SharedLru destroyed while an ActorCache still exists?");
+  }
+  if (currentSize() != 0) {
     KJ_LOG(ERROR, "SharedLru destroyed while cache entries still exist, "
         "this will lead to use-after-free");
   }
 }
 
+size_t ActorCache::SharedLru::currentSize() const {
+  size_t total = 0;
+  for (auto& shard: shards) {
+    total += shard.size.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+const ActorCache::SharedLru::Shard& ActorCache::SharedLru::chooseShard() const {
+  return shards[nextShard.fetch_add(1, std::memory_order_relaxed) % shards.size()];
+}
+
 kj::Maybe<kj::Promise<void>> ActorCache::evictStale(kj::Date now) {
   int64_t nowNs = (now - kj::UNIX_EPOCH) / kj::NANOSECONDS;
-  int64_t oldValue = lru.nextStaleCheckNs.load(std::memory_order_relaxed);
+  int64_t oldValue = lruShard.nextStaleCheckNs.load(std::memory_order_relaxed);
 
   if (nowNs >= oldValue) {
     int64_t newValue = nowNs + lru.options.staleTimeout / kj::NANOSECONDS;
-    if (lru.nextStaleCheckNs.compare_exchange_strong(oldValue, newValue)) {
-      auto lock = lru.cleanList.lockExclusive();
+    if (lruShard.nextStaleCheckNs.compare_exchange_strong(oldValue, newValue)) {
+      auto lock = lruShard.cleanList.lockExclusive();
       for (auto& entry: *lock) {
         if (entry.isStale) {
           auto& cache = KJ_ASSERT_NONNULL(entry.maybeCache);
@@ -207,7 +222,7 @@ void ActorCache::requireNotTerminal() {
 }
 
 void ActorCache::evictOrOomIfNeeded(Lock& lock) {
-  if (lru.evictIfNeeded(lock)) {
+  if (lru.evictIfNeeded(lruShard, lock)) {
     auto exception = KJ_EXCEPTION(OVERLOADED,
         "broken.exceededMemory; jsg.Error: Durable Object's isolate exceeded its memory limit due to overflowing the "
         "storage cache. This could be due to writing too many values to storage without stopping "
@@ -240,21 +255,37 @@ void ActorCache::evictOrOomIfNeeded(Lock& lock) {
   }
 }
 
-bool ActorCache::SharedLru::evictIfNeeded(Lock& lock) const {
+bool ActorCache::SharedLru::evictIfNeeded(const Shard& shard, Lock& lock) const {
+  // We can't lock other shards while holding this one, so each shard keeps itself within its
+  // share of the soft limit. That way a shard never evicts its own entries to make up for other
+  // shards being over, and the total stays within the limit as long as every shard does.
+  size_t softLimit = options.softLimit / shards.size();
+
   for (;;) {
-    size_t current = size.load(std::memory_order_relaxed);
-    if (current <= options.softLimit) {
+    size_t shardSize = shard.size.load(std::memory_order_relaxed);
+    if (shardSize <= softLimit) {
       // All good.
       return false;
     }
 
     // We're over the limit, let's evict stuff.
     if (lock->empty()) {
-      // Nothing to evict.
-      return current > options.hardLimit;
+      // Nothing to evict. Only fail if the LRU as a whole is over the hard limit and this shard is
+      // using more than its share of it. Otherwise, the other shards will have to evict or fail on
+      // their next operation.
+      return currentSize() > options.hardLimit &&
+          shardSize > options.hardLimit / shards.size();
     }
 
     Entry& entry = lock->front();
+    if (entry.recentlyUsed) {
+      // Give it a second chance.
+      entry.recentlyUsed = false;
+      lock->remove(entry);
+      lock->add(entry);
+      continue;
+    }
+
     auto& cache = KJ_ASSERT_NONNULL(entry.maybeCache);
     cache.removeEntry(lock, entry);
     cache.evictEntry(lock, entry);
@@ -265,8 +296,12 @@ void ActorCache::touchEntry(Lock& lock, Entry& entry, const ReadOptions& options
   if (!options.noCache) {
     if (!entry.isDirty()) {
       entry.isStale = false;
-      lock->remove(entry);
-      lock->add(entry);
+      if (lru.options.secondChance) {
+        entry.recentlyUsed = true;
+      } else {
+        lock->remove(entry);
+        lock->add(entry);
+      }
     }
 
     // If this is a dirty entry previously marked no-cache, remove that mark. This results in the
@@ -309,7 +344,7 @@ void ActorCache::evictEntry(Lock& lock, Entry& entry) {
 }
 
 void ActorCache::verifyConsistencyForTest() {
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   currentValues.get(lock).verify();  // verify the table's BTreeIndex
   bool prevGapIsKnownEmpty = false;
   kj::Maybe<kj::StringPtr> prevKey = kj::none;
@@ -352,7 +387,7 @@ kj::OneOf<kj::Maybe<ActorCache::Value>, kj::Promise<kj::Maybe<ActorCache::Value>
   options.noCache = options.noCache || lru.options.noCache;
   requireNotTerminal();
 
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   auto entry = findInCache(lock, kj::mv(key), options);
   switch (entry->valueStatus) {
     case EntryValueStatus::PRESENT:
@@ -379,7 +414,7 @@ auto ActorCache::getImpl(kj::Own<Entry> entry, ReadOptions options)
   if (response.hasValue()) {
     value = response.getValue();
   }
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   auto newEntry = addReadResultToCache(lock, cloneKey(entry->key), value, options);
   evictOrOomIfNeeded(lock);
   co_return newEntry->getValue();
@@ -403,7 +438,7 @@ public:
       return KJ_EXCEPTION(DISCONNECTED, "canceled");
     }
 
-    auto lock = cache.lru.cleanList.lockExclusive();
+    auto lock = cache.lruShard.cleanList.lockExclusive();
     auto params = context.getParams();
     kj::String prevKey;
     for (auto kv: params.getList()) {
@@ -453,7 +488,7 @@ public:
 
     if (nextExpectedKey < keysToFetch.end()) {
       // Some trailing keys weren't seen, better mark them as not present.
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
       while (nextExpectedKey < keysToFetch.end()) {
         cache.addReadResultToCache(lock, kj::mv(*nextExpectedKey++), kj::none, options);
       }
@@ -524,7 +559,7 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
   capnp::MessageSize sizeHint { 4, 1 };
 
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     for (auto& key: keys) {
       auto entry = findInCache(lock, key, options);
       switch(entry->valueStatus) {
@@ -687,6 +722,21 @@ inline auto seekOrEnd(auto& map, kj::Maybe<ActorCache::KeyPtr> key) {
   }
 }
 
+// Extends the limit of a storage list by `options.readAhead`. Returns the number of fetched
+// entries after which results are speculative, or none if there is no read-ahead. Unlimited lists
+// fetch everything anyway, so there is nothing to read ahead.
+kj::Maybe<uint> applyReadAhead(kj::Maybe<uint>& adjustedLimit,
+                               const ActorCache::ReadOptions& options) {
+  if (options.readAhead == 0 || options.noCache) return kj::none;
+
+  KJ_IF_SOME(l, adjustedLimit) {
+    adjustedLimit = l + kj::min(options.readAhead, static_cast<uint>(kj::maxValue) - l);
+    return l;
+  } else {
+    return kj::none;
+  }
+}
+
 }  // namespace
 
 class ActorCache::ForwardListStreamImpl final: public rpc::ActorStorage::ListStream::Server {
@@ -695,11 +745,12 @@ public:
                         kj::Vector<kj::Own<Entry>> cachedEntries,
                         kj::Own<kj::PromiseFulfiller<GetResultList>> fulfiller,
                         kj::Maybe<uint> originalLimit, kj::Maybe<uint> adjustedLimit,
-                        bool beginKeyIsKnown, const ReadOptions& options)
+                        kj::Maybe<uint> readAheadStart, bool beginKeyIsKnown,
+                        const ReadOptions& options)
       : cache(cache), beginKey(kj::mv(beginKey)), endKey(kj::mv(endKey)),
         cachedEntries(kj::mv(cachedEntries)), fulfiller(kj::mv(fulfiller)),
         originalLimit(originalLimit), adjustedLimit(adjustedLimit),
-        beginKeyIsKnown(beginKeyIsKnown), options(options) {}
+        readAheadStart(readAheadStart), beginKeyIsKnown(beginKeyIsKnown), options(options) {}
 
   kj::Promise<void> values(ValuesContext context) override {
     if (!fulfiller->isWaiting()) {
@@ -708,7 +759,7 @@ public:
     }
 
     {
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
       auto list = context.getParams().getList();
 
       bool insertedAny = false;
@@ -734,7 +785,9 @@ public:
         }
 
         KJ_ASSERT(kv.hasValue());  // values that don't exist aren't listed!
-        auto entry = cache.addReadResultToCache(lock, kj::mv(key), kv.getValue(), options);
+        bool speculative = fetchedEntries.size() >= readAheadStart.orDefault(kj::maxValue);
+        auto entry = cache.addReadResultToCache(
+            lock, kj::mv(key), kv.getValue(), options, speculative);
         fetchedEntries.add(kj::mv(entry));
         insertedAny = true;
       }
@@ -766,7 +819,7 @@ public:
 
     // Mark the rest of the range as empty.
     {
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
 
       if (!beginKeyIsKnown) {
         // We received no results at all, so the start of the list is definitely not in storage.
@@ -841,6 +894,10 @@ public:
   // The limit we sent to storage.
   kj::Maybe<uint> adjustedLimit;
 
+  // If `options.readAhead` extended `adjustedLimit`, the number of fetched entries after which
+  // the rest were only read ahead.
+  kj::Maybe<uint> readAheadStart;
+
   // Does `beginKey` point to a key where we already know the associated value? This is
   // especially true when `beginKey` points to the last entry of a previous batch received via
   // a call to `values()`.
@@ -874,7 +931,7 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
   // negative entries in the range, since each of those negative entries could potentially negate a
   // positive entry read from disk.
 
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   auto& map = currentValues.get(lock);
   auto ordered = map.ordered();
 
@@ -985,11 +1042,12 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
   auto adjustedLimit = limit.map([&](uint orig) {
     return orig + limitAdjustment - knownPrefixSize;
   });
+  auto readAheadStart = applyReadAhead(adjustedLimit, options);
 
   auto paf = kj::newPromiseAndFulfiller<GetResultList>();
   auto streamServer = kj::heap<ForwardListStreamImpl>(
       *this, cloneKey(KJ_ASSERT_NONNULL(storageListStart)), kj::mv(endKey),
-      kj::mv(cachedEntries), kj::mv(paf.fulfiller), limit, adjustedLimit,
+      kj::mv(cachedEntries), kj::mv(paf.fulfiller), limit, adjustedLimit, readAheadStart,
       storageListStartIsKnown, options);
   auto& streamServerRef = *streamServer;
 
@@ -1065,10 +1123,11 @@ public:
                         kj::Vector<kj::Own<Entry>> cachedEntries,
                         kj::Own<kj::PromiseFulfiller<GetResultList>> fulfiller,
                         kj::Maybe<uint> originalLimit, kj::Maybe<uint> adjustedLimit,
-                        ReadOptions options)
+                        kj::Maybe<uint> readAheadStart, ReadOptions options)
       : cache(cache), beginKey(kj::mv(beginKey)), endKey(kj::mv(endKey)),
         cachedEntries(kj::mv(cachedEntries)), fulfiller(kj::mv(fulfiller)),
-        originalLimit(originalLimit), adjustedLimit(adjustedLimit), options(options) {}
+        originalLimit(originalLimit), adjustedLimit(adjustedLimit),
+        readAheadStart(readAheadStart), options(options) {}
 
   kj::Promise<void> values(ValuesContext context) override {
     if (!fulfiller->isWaiting()) {
@@ -1077,7 +1136,7 @@ public:
     }
 
     {
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
       auto list = context.getParams().getList();
 
       bool insertedAny = false;
@@ -1093,7 +1152,9 @@ public:
         }
 
         KJ_ASSERT(kv.hasValue());  // values that don't exist aren't listed!
-        auto entry = cache.addReadResultToCache(lock, kj::mv(key), kv.getValue(), options);
+        bool speculative = fetchedEntries.size() >= readAheadStart.orDefault(kj::maxValue);
+        auto entry = cache.addReadResultToCache(
+            lock, kj::mv(key), kv.getValue(), options, speculative);
         fetchedEntries.add(kj::mv(entry));
         insertedAny = true;
       }
@@ -1125,7 +1186,7 @@ public:
 
     // Mark the rest of the range as empty.
     {
-      auto lock = cache.lru.cleanList.lockExclusive();
+      auto lock = cache.lruShard.cleanList.lockExclusive();
 
       if (fetchedEntries.size() < adjustedLimit.orDefault(kj::maxValue)) {
         // We didn't reach the limit, so the rest of the range must be empty.
@@ -1189,6 +1250,10 @@ public:
   // The limit we sent to storage.
   kj::Maybe<uint> adjustedLimit;
 
+  // If `options.readAhead` extended `adjustedLimit`, the number of fetched entries after which
+  // the rest were only read ahead.
+  kj::Maybe<uint> readAheadStart;
+
   ReadOptions options;
 };
 
@@ -1213,7 +1278,7 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
   // negative entries in the range, since each of those negative entries could potentially negate a
   // positive entry read from disk.
 
-  auto lock = lru.cleanList.lockExclusive();
+  auto lock = lruShard.cleanList.lockExclusive();
   auto& map = currentValues.get(lock);
   auto ordered = map.ordered();
 
@@ -1322,11 +1387,13 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
   auto adjustedLimit = limit.map([&](uint orig) {
     return orig + limitAdjustment - knownSuffixSize;
   });
+  auto readAheadStart = applyReadAhead(adjustedLimit, options);
 
   auto paf = kj::newPromiseAndFulfiller<GetResultList>();
   auto streamServer = kj::heap<ReverseListStreamImpl>(
       *this, kj::mv(beginKey), kj::mv(endKey),
-      kj::mv(cachedEntries), kj::mv(paf.fulfiller), limit, adjustedLimit, options);
+      kj::mv(cachedEntries), kj::mv(paf.fulfiller), limit, adjustedLimit, readAheadStart,
+      options);
   auto& streamServerRef = *streamServer;
 
   rpc::ActorStorage::ListStream::Client streamClient = kj::mv(streamServer);
@@ -1410,7 +1477,8 @@ kj::Own<ActorCache::Entry> ActorCache::findInCache(
 }
 
 kj::Own<ActorCache::Entry> ActorCache::addReadResultToCache(
-    Lock& lock, Key key, kj::Maybe<capnp::Data::Reader> maybeReader, const ReadOptions& options) {
+    Lock& lock, Key key, kj::Maybe<capnp::Data::Reader> maybeReader, const ReadOptions& options,
+    bool speculative) {
   if (options.noCache) {
     // We don't actually want to add this to the cache, just return the entry.
     KJ_IF_SOME(reader, maybeReader) {
@@ -1464,7 +1532,11 @@ kj::Own<ActorCache::Entry> ActorCache::addReadResultToCache(
     //
     // Because of this, we know it is correct to leave `gapIsKnownEmpty = false` on our new entry.
     entry->syncStatus = EntrySyncStatus::CLEAN;
-    lock->add(*entry);
+    if (speculative) {
+      lock->addFront(*entry);
+    } else {
+      lock->add(*entry);
+    }
     return kj::atomicAddRef(*entry);
   });
 
@@ -1478,7 +1550,11 @@ kj::Own<ActorCache::Entry> ActorCache::addReadResultToCache(
         removeEntry(lock, *slot);
 
         entry->syncStatus = EntrySyncStatus::CLEAN;
-        lock->add(*entry);
+        if (speculative) {
+          lock->addFront(*entry);
+        } else {
+          lock->add(*entry);
+        }
         slot = kj::atomicAddRef(*entry);
         break;
       }
@@ -1501,7 +1577,11 @@ kj::Own<ActorCache::Entry> ActorCache::addReadResultToCache(
         //   one that coincidentally matches what we pulled off disk. However, the open transaction
         //   is still going to be committed, writing the intermediate value, so we still need to plan
         //   to write this value again in the next transaction.
-        touchEntry(lock, *slot, options);
+        //
+        // A speculative read doesn't count as a use, so it leaves the existing entry where it is.
+        if (!speculative) {
+          touchEntry(lock, *slot, options);
+        }
         break;
       }
     }
@@ -1780,7 +1860,7 @@ kj::Maybe<kj::Promise<void>> ActorCache::put(Key key, Value value, WriteOptions
   options.noCache = options.noCache || lru.options.noCache;
   requireNotTerminal();
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     kj::Maybe<CountedDelete> maybeCountedDelete;
     auto entry = kj::atomicRefcounted<Entry>(*this, kj::mv(key), kj::mv(value));
     putImpl(lock, kj::mv(entry), options, maybeCountedDelete);
@@ -1793,7 +1873,7 @@ kj::Maybe<kj::Promise<void>> ActorCache::put(kj::Array<KeyValuePair> pairs, Writ
   options.noCache = options.noCache || lru.options.noCache;
   requireNotTerminal();
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     for (auto& pair: pairs) {
       kj::Maybe<CountedDelete> maybeCountedDelete;
       auto entry = kj::atomicRefcounted<Entry>(*this, kj::mv(pair.key), kj::mv(pair.value));
@@ -1841,7 +1921,7 @@ kj::OneOf<bool, kj::Promise<bool>> ActorCache::delete_(Key key, WriteOptions opt
 
   auto countedDelete = kj::refcounted<CountedDelete>();
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     auto entry = kj::atomicRefcounted<Entry>(*this, kj::mv(key), EntryValueStatus::ABSENT);
     putImpl(lock, kj::mv(entry), options, *countedDelete);
     evictOrOomIfNeeded(lock);
@@ -1879,7 +1959,7 @@ kj::OneOf<uint, kj::Promise<uint>> ActorCache::delete_(kj::Array<Key> keys, Writ
 
   auto countedDelete = kj::refcounted<CountedDelete>();
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     for (auto& key: keys) {
       auto entry = kj::atomicRefcounted<Entry>(*this, kj::mv(key), EntryValueStatus::ABSENT);
       putImpl(lock, kj::mv(entry), options, *countedDelete);
@@ -1932,7 +2012,7 @@ ActorCache::DeleteAllResults ActorCache::deleteAll(WriteOptions options) {
   kj::Promise<uint> result { (uint)0 };
 
   {
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
     auto& map = currentValues.get(lock);
 
     kj::Vector<kj::Own<Entry>> deletedDirty;
@@ -2246,7 +2326,7 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
   // Perhaps this would be possible to fix by adding more complex logic. But, it doesn't seem
   // like a big deal to require all flushes to be complete flushes.
 
-  // We don't take a lock on `lru.cleanList` here, because we don't need it. We only access
+  // We don't take a lock on `lruShard.cleanList` here, because we don't need it. We only access
   // `dirtyList`, which is only ever accessed within the actor's thread, so it's safe. We know
   // that `SharedLru` will only ever mess with CLEAN entries, which we don't look at here.
 
@@ -2463,7 +2543,7 @@ kj::Promise<void> ActorCache::flushImpl(uint retryCount) {
       return flushImplDeleteAll();
     }
 
-    auto lock = lru.cleanList.lockExclusive();
+    auto lock = lruShard.cleanList.lockExclusive();
 
     KJ_IF_SOME(r, requestedDeleteAll) {
       // It would appear that all dirty entries were moved into `requestedDeleteAll` during the
@@ -2910,7 +2990,7 @@ kj::Promise<void> ActorCache::flushImplDeleteAll(uint retryCount) {
     requestedDeleteAll = kj::none;
 
     {
-      auto lock = lru.cleanList.lockExclusive();
+      auto lock = lruShard.cleanList.lockExclusive();
       evictOrOomIfNeeded(lock);
     }
 
@@ -2950,7 +3030,7 @@ ActorCache::Transaction::~Transaction() noexcept(false) {
 
 kj::Maybe<kj::Promise<void>> ActorCache::Transaction::commit() {
   {
-    auto lock = cache.lru.cleanList.lockExclusive();
+    auto lock = cache.lruShard.cleanList.lockExclusive();
     for (auto& change: entriesToWrite) {
       cache.putImpl(lock, kj::mv(change.entry), change.options, kj::none);
     }
@@ -3101,7 +3181,7 @@ kj::OneOf<ActorCache::GetResultList, kj::Promise<ActorCache::GetResultList>>
 kj::Maybe<kj::Promise<void>> ActorCache::Transaction::put(
     Key key, Value value, WriteOptions options) {
   options.noCache = options.noCache || cache.lru.options.noCache;
-  auto lock = cache.lru.cleanList.lockExclusive();
+  auto lock = cache.lruShard.cleanList.lockExclusive();
   auto entry = kj::atomicRefcounted<Entry>(cache, kj::mv(key), kj::mv(value));
   putImpl(lock, kj::mv(entry), options);
 
@@ -3112,7 +3192,7 @@ kj::Maybe<kj::Promise<void>> ActorCache::Transaction::put(
 kj::Maybe<kj::Promise<void>> ActorCache::Transaction::put(
     kj::Array<KeyValuePair> pairs, WriteOptions options) {
   options.noCache = options.noCache || cache.lru.options.noCache;
-  auto lock = cache.lru.cleanList.lockExclusive();
+  auto lock = cache.lruShard.cleanList.lockExclusive();
 
   for (auto& pair: pairs) {
     auto entry = kj::atomicRefcounted<Entry>(cache, kj::mv(pair.key), kj::mv(pair.value));
@@ -3139,7 +3219,7 @@ kj::OneOf<bool, kj::Promise<bool>> ActorCache::Transaction::delete_(
   kj::Maybe<KeyPtr> keyToCount;
 
   {
-    auto lock = cache.lru.cleanList.lockExclusive();
+    auto lock = cache.lruShard.cleanList.lockExclusive();
     auto entry = kj::atomicRefcounted<Entry>(cache, kj::mv(key), EntryValueStatus::ABSENT);
     keyToCount = putImpl(lock, kj::mv(entry), options, count);
   }
@@ -3178,7 +3258,7 @@ kj::OneOf<uint, kj::Promise<uint>> ActorCache::Transaction::delete_(
   auto currentBatch = startNewBatch();
 
   {
-    auto lock = cache.lru.cleanList.lockExclusive();
+    auto lock = cache.lruShard.cleanList.lockExclusive();
     for (auto& key: keys) {
       auto entry = kj::atomicRefcounted<Entry>(cache, kj::mv(key), EntryValueStatus::ABSENT);
       KJ_IF_SOME(keyToCount, putImpl(lock, kj::mv(entry), options, count)) {
@@ -27,6 +27,13 @@ struct ActorCacheReadOptions {
   // If there is already a matching entry in cache, that value will be returned as normal. Hence,
   // `noCache` does not affect consistency, only performance.
   bool noCache = false;
+
+  // When a limited list() has to go to storage anyway, ask storage for up to this many additional
+  // keys past the limit, and add them to cache as clean entries at the cold end of the LRU. A
+  // caller that pages through a range with successive list() calls can set this to its page size
+  // so that the next page is usually served from cache. Ignored if `noCache` is set, and by
+  // implementations that have no cache.
+  uint readAhead = 0;
 };
 
 struct ActorCacheWriteOptions {
@@ -439,6 +446,10 @@ private:
 
     bool isStale = false;
 
+    // Set when a clean entry is read while the SharedLru is in `secondChance` mode, instead of
+    // moving the entry to the back of the clean list.
+    bool recentlyUsed = false;
+
     // If true, then a past list() operation covered the space between this entry and the following
     // entry, meaning that we know for sure that there are no other keys on disk between them.
     bool gapIsKnownEmpty = false;
@@ -463,7 +474,7 @@ private:
     // to the replacement entry, so that it can be retried.)
     kj::Maybe<kj::Own<CountedDelete>> countedDelete;
 
-    // If CLEAN, the entry will be in the SharedLru's `cleanList`.
+    // If CLEAN, the entry will be in the `cleanList` of the cache's SharedLru shard.
     //
     // If DIRTY or FLUSHING, the entry will be in `dirtyList`.
     kj::ListLink<Entry> link;
@@ -507,8 +518,11 @@ private:
     kj::Maybe<size_t> flushIndex;
   };
 
+  struct LruShard;
+
   rpc::ActorStorage::Stage::Client storage;
   const SharedLru& lru;
+  const LruShard& lruShard;
   OutputGate& gate;
   Hooks& hooks;
 
@@ -543,8 +557,8 @@ private:
 
   // Map of current known values for keys. Searchable by key, including ordered iteration.
   //
-  // This map is protected by the same lock as lru.cleanList. ExternalMutexGuarded helps enforce
-  // this.
+  // This map is protected by the same lock as lruShard.cleanList. ExternalMutexGuarded helps
+  // enforce this.
   kj::ExternalMutexGuarded<kj::Table<kj::Own<Entry>, kj::TreeIndex<EntryTableCallbacks>>>
       currentValues;
 
@@ -643,8 +657,11 @@ private:
   // inserted and will instead immediately have state NOT_IN_CACHE.
   //
   // Either way, a strong reference to the entry is returned.
+  //
+  // If `speculative` is true, the entry was read ahead of what the caller asked for, so a newly
+  // inserted entry goes at the cold end of the LRU instead of the hot end.
   kj::Own<Entry> addReadResultToCache(Lock& lock, Key key, kj::Maybe<capnp::Data::Reader> value,
-                                      const ReadOptions& readOptions);
+                                      const ReadOptions& readOptions, bool speculative = false);
 
 
   // Mark all gaps empty between the begin and end key.
@@ -828,6 +845,37 @@ struct ActorCacheSharedLruOptions {
   // If true, don't actually flush anything. This is used in preview sessions, since they keep
   // state strictly in memory.
   bool neverFlush = false;
+
+  // Number of independently-locked shards to split the LRU into, to reduce lock contention when
+  // caches are used from many threads. Each ActorCache is assigned to one shard and only ever
+  // evicts clean entries from its own shard, keeping the shard within its equal share of
+  // `softLimit`, so the soft limit still applies to the LRU as a whole. Caches are assigned to
+  // shards round-robin, so a shard whose caches hold more than their share will evict sooner
+  // than it would with a single shard. With a single shard, eviction order is exact.
+  uint shardCount = 1;
+
+  // If true, reading a clean entry only marks it as recently used instead of moving it to the back
+  // of the LRU list. When a marked entry reaches the front of the list, it gets a second chance:
+  // it is unmarked and moved to the back rather than evicted (i.e. the CLOCK algorithm). This
+  // approximates LRU order while doing less work under the lock on every read.
+  bool secondChance = false;
+};
+
+// One shard of ActorCache::SharedLru.
+struct ActorCache::LruShard {
+  // List of clean values, across all caches assigned to this shard, ordered from
+  // least-recently-used to most-recently-used.
+  //
+  // This lock also protects the `currentValues` maps of those caches.
+  kj::MutexGuarded<kj::List<Entry, &Entry::link>> cleanList;
+
+  // Total byte size of everything cached in this shard, including dirty values that are not in
+  // `cleanList`.
+  mutable std::atomic<size_t> size = 0;
+
+  // TimePoint when we should next evict stale entries. Represented as an int64_t of nanoseconds
+  // instead of kj::TimePoint to allow for atomic operations.
+  mutable std::atomic<int64_t> nextStaleCheckNs = 0;
 };
 
 class ActorCache::SharedLru {
@@ -839,27 +887,26 @@ public:
   ~SharedLru() noexcept(false);
   KJ_DISALLOW_COPY_AND_MOVE(SharedLru);
 
-  // Mostly for testing.
-  size_t currentSize() const { return size.load(std::memory_order_relaxed); }
+  // Total byte size of everything that is cached, summed across shards. Since shards are updated
+  // concurrently, this is approximate when caches are in use on other threads.
+  size_t currentSize() const;
 
 private:
   Options options;
 
-  // List of clean values, across all caches, ordered from least-recently-used to
-  // most-recently-used.
-  kj::MutexGuarded<kj::List<Entry, &Entry::link>> cleanList;
+  using Shard = LruShard;
+  kj::Array<Shard> shards;
 
-  // Total byte size of everything that is cached, including dirty values that are not in `list`.
-  mutable std::atomic<size_t> size = 0;
+  // Used to assign caches to shards round-robin.
+  mutable std::atomic<uint> nextShard = 0;
 
-  // TimePoint when we should next evict stale entries. Represented as an int64_t of nanoseconds
-  // instead of kj::TimePoint to allow for atomic operations.
-  mutable std::atomic<int64_t> nextStaleCheckNs = 0;
+  const Shard& chooseShard() const;
 
-  // Evict cache entries as needed according to the cache limits. Returns true if the hard limit
-  // is exceeded and nothing can be evicted, in which case the caller should fail out in the
-  // appropriate way for the kind of operation being performed.
-  bool evictIfNeeded(Lock& lock) const KJ_WARN_UNUSED_RESULT;
+  // Evict cache entries from `shard` as needed according to the cache limits. `lock` must be the
+  // lock on `shard.cleanList`. Returns true if the hard limit is exceeded and nothing can be
+  // evicted, in which case the caller should fail out in the appropriate way for the kind of
+  // operation being performed.
+  bool evictIfNeeded(const Shard& shard, Lock& lock) const KJ_WARN_UNUSED_RESULT;
 
   friend class ActorCache;
 };
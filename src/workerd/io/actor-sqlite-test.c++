@@ -0,0 +1,132 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "actor-sqlite.h"
+#include "io-gate.h"
+#include <kj/test.h>
+#include <kj/debug.h>
+#include <kj/filesystem.h>
+
+namespace workerd {
+namespace {
+
+static constexpr kj::Duration WINDOW = 1 * kj::SECONDS;
+static constexpr size_t MAX_BYTES = 100;
+
+struct ActorSqliteTest {
+  kj::EventLoop loop;
+  kj::WaitScope ws { loop };
+  kj::TimerImpl timer { kj::origin<kj::TimePoint>() };
+  OutputGate gate;
+  kj::Own<const kj::Directory> vfsDir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs { *vfsDir };
+  uint commitCount = 0;
+  ActorSqlite actor;
+
+  explicit ActorSqliteTest(bool groupCommit)
+      : actor(kj::heap<SqliteDatabase>(vfs, kj::Path({"foo"}),
+                                       kj::WriteMode::CREATE | kj::WriteMode::MODIFY),
+              gate, [this]() -> kj::Promise<void> { ++commitCount; return kj::READY_NOW; },
+              ActorSqlite::Hooks::DEFAULT,
+              groupCommit
+                  ? kj::Maybe<ActorSqlite::GroupCommitOptions>(ActorSqlite::GroupCommitOptions {
+                      .timer = timer, .window = WINDOW, .maxBytes = MAX_BYTES })
+                  : kj::none) {}
+
+  void put(kj::StringPtr key, kj::StringPtr value) {
+    KJ_ASSERT(actor.put(kj::str(key), kj::heapArray(value.asBytes()), {}) == kj::none);
+  }
+
+  // Lets everything that's ready run, then reports whether the output gate is still locked.
+  bool gateLocked() {
+    return !gate.wait().poll(ws);
+  }
+
+  void advance(kj::Duration delay) {
+    timer.advanceTo(timer.now() + delay);
+    ws.poll();
+  }
+};
+
+KJ_TEST("ActorSqlite commits each turn's writes separately by default") {
+  ActorSqliteTest test(false);
+
+  test.put("foo", "123");
+  test.put("bar", "456");
+  KJ_EXPECT(test.actor.isCommitScheduled());
+  KJ_EXPECT(!test.gateLocked());
+  KJ_EXPECT(test.commitCount == 1);
+  KJ_EXPECT(!test.actor.isCommitScheduled());
+
+  test.put("baz", "789");
+  KJ_EXPECT(!test.gateLocked());
+  KJ_EXPECT(test.commitCount == 2);
+}
+
+KJ_TEST("ActorSqlite group commit batches writes across turns") {
+  ActorSqliteTest test(true);
+
+  test.put("foo", "123");
+  KJ_EXPECT(test.gateLocked());
+  KJ_EXPECT(test.commitCount == 0);
+
+  // A write in a later turn joins the open transaction.
+  test.advance(WINDOW / 2);
+  test.put("bar", "456");
+  KJ_EXPECT(test.gateLocked());
+  KJ_EXPECT(test.commitCount == 0);
+
+  // The window is measured from the first write in the group.
+  test.advance(WINDOW / 2);
+  KJ_EXPECT(!test.gateLocked());
+  KJ_EXPECT(test.commitCount == 1);
+  KJ_EXPECT(!test.actor.isCommitScheduled());
+
+  // The next write starts a new group.
+  test.put("baz", "789");
+  KJ_EXPECT(test.gateLocked());
+  test.advance(WINDOW);
+  KJ_EXPECT(!test.gateLocked());
+  KJ_EXPECT(test.commitCount == 2);
+}
+
+KJ_TEST("ActorSqlite group commit commits early once maxBytes are written") {
+  ActorSqliteTest test(true);
+  auto value = kj::str(kj::repeat('x', MAX_BYTES / 2));
+
+  test.put("a", value);
+  KJ_EXPECT(test.gateLocked());
+  KJ_EXPECT(test.commitCount == 0);
+
+  // Keys count towards the limit too, so this pushes the group over it.
+  test.put("b", value);
+  KJ_EXPECT(!test.gateLocked());
+  KJ_EXPECT(test.commitCount == 1);
+
+  // The byte count starts over in the next group.
+  test.put("c", value);
+  KJ_EXPECT(test.gateLocked());
+  KJ_EXPECT(test.commitCount == 1);
+  test.advance(WINDOW);
+  KJ_EXPECT(!test.gateLocked());
+  KJ_EXPECT(test.commitCount == 2);
+}
+
+KJ_TEST("ActorSqlite group commit window closes when an explicit transaction starts") {
+  ActorSqliteTest test(true);
+
+  test.put("foo", "123");
+  KJ_EXPECT(test.gateLocked());
+
+  {
+    auto txn = test.actor.startTransaction();
+    KJ_EXPECT(!test.gateLocked());
+    KJ_EXPECT(test.commitCount == 1);
+  }
+
+  KJ_EXPECT(!test.actor.isCommitScheduled());
+}
+
+}  // namespace
+}  // namespace workerd
@@ -11,9 +11,9 @@ namespace workerd {
 
 ActorSqlite::ActorSqlite(kj::Own<SqliteDatabase> dbParam, OutputGate& outputGate,
                          kj::Function<kj::Promise<void>()> commitCallback,
-                         Hooks& hooks)
+                         Hooks& hooks, kj::Maybe<GroupCommitOptions> groupCommit)
     : db(kj::mv(dbParam)), outputGate(outputGate), commitCallback(kj::mv(commitCallback)),
-      hooks(hooks), kv(*db), commitTasks(*this) {
+      hooks(hooks), groupCommit(kj::mv(groupCommit)), kv(*db), commitTasks(*this) {
   db->onWrite(KJ_BIND_METHOD(*this, onWrite));
 }
 
@@ -56,6 +56,9 @@ ActorSqlite::ExplicitTxn::ExplicitTxn(ActorSqlite& actorSqlite)
       // completes. Note that this isn't violating any atomicity guarantees because the transaction
       // API is async, and atomicity is only guaranteed over synchronous code.
       implicit->commit();
+
+      // There's no point in holding the output gate for the rest of a group commit window now.
+      actorSqlite.closeCommitWindow();
     }
     KJ_CASE_ONEOF(exp, ExplicitTxn*) {
       KJ_REQUIRE(!exp->hasChild,
@@ -135,7 +138,7 @@ void ActorSqlite::onWrite() {
   if (currentTxn.is<NoTxn>()) {
     auto txn = kj::heap<ImplicitTxn>(*this);
 
-    commitTasks.add(outputGate.lockWhile(kj::evalLater(
+    commitTasks.add(outputGate.lockWhile(waitForCommitWindow().then(
         [this, txn = kj::mv(txn)]() mutable -> kj::Promise<void> {
       // Don't commit if shutdown() has been called.
       requireNotBroken();
@@ -162,6 +165,38 @@ void ActorSqlite::onWrite() {
   }
 }
 
+kj::Promise<void> ActorSqlite::waitForCommitWindow() {
+  KJ_IF_SOME(options, groupCommit) {
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    groupCommitBytes = 0;
+    groupCommitNow = kj::mv(paf.fulfiller);
+    // If the timer wins, `groupCommitNow` is left holding a fulfiller whose promise is gone, which
+    // is harmless; it'll be replaced when the next window opens.
+    return options.timer.afterDelay(options.window).exclusiveJoin(kj::mv(paf.promise));
+  } else {
+    // Commit at the end of this turn.
+    return kj::evalLater([]() {});
+  }
+}
+
+void ActorSqlite::addGroupCommitBytes(size_t bytes) {
+  KJ_IF_SOME(options, groupCommit) {
+    groupCommitBytes += bytes;
+    if (groupCommitBytes >= options.maxBytes) {
+      closeCommitWindow();
+    }
+  }
+}
+
+void ActorSqlite::closeCommitWindow() {
+  KJ_IF_SOME(fulfiller, groupCommitNow) {
+    if (fulfiller->isWaiting()) {
+      fulfiller->fulfill();
+    }
+    groupCommitNow = kj::none;
+  }
+}
+
 void ActorSqlite::taskFailed(kj::Exception&& exception) {
   // The output gate should already have been broken since it wraps all commits tasks. So, we
   // don't have to report anything here, the exception will already propagate elsewhere. We
@@ -196,12 +231,12 @@ kj::OneOf<ActorCacheOps::GetResultList, kj::Promise<ActorCacheOps::GetResultList
     ActorSqlite::get(kj::Array<Key> keys, ReadOptions options) {
   requireNotBroken();
 
-  kj::Vector<KeyValuePair> results;
-  for (auto& key: keys) {
-    kv.get(key, [&](ValuePtr value) {
-      results.add(KeyValuePair { kj::mv(key), kj::heapArray(value) });
-    });
-  }
+  auto keyPtrs = KJ_MAP(key, keys) -> KeyPtr { return key; };
+
+  kj::Vector<KeyValuePair> results(keys.size());
+  kv.getMultiple(keyPtrs, [&](KeyPtr key, ValuePtr value) {
+    results.add(KeyValuePair { kj::str(key), kj::heapArray(value) });
+  });
   std::sort(results.begin(), results.end(),
       [](auto& a, auto& b) { return a.key < b.key; });
   return GetResultList(kj::mv(results));
@@ -245,6 +280,7 @@ kj::Maybe<kj::Promise<void>> ActorSqlite::put(Key key, Value value, WriteOptions
   requireNotBroken();
 
   kv.put(key, value);
+  addGroupCommitBytes(key.size() + value.size());
   return kj::none;
 }
 
@@ -252,9 +288,15 @@ kj::Maybe<kj::Promise<void>> ActorSqlite::put(
     kj::Array<KeyValuePair> pairs, WriteOptions options) {
   requireNotBroken();
 
+  auto pairPtrs = KJ_MAP(pair, pairs) -> SqliteKv::KeyValuePtrPair {
+    return { pair.key, pair.value };
+  };
+  kv.putMultiple(pairPtrs);
+  size_t bytes = 0;
   for (auto& pair: pairs) {
-    kv.put(pair.key, pair.value);
+    bytes += pair.key.size() + pair.value.size();
   }
+  addGroupCommitBytes(bytes);
   return kj::none;
 }
 
@@ -268,11 +310,8 @@ kj::OneOf<uint, kj::Promise<uint>> ActorSqlite::delete_(
     kj::Array<Key> keys, WriteOptions options) {
   requireNotBroken();
 
-  uint count = 0;
-  for (auto& key: keys) {
-    count += kv.delete_(key);
-  }
-  return count;
+  auto keyPtrs = KJ_MAP(key, keys) -> KeyPtr { return key; };
+  return kv.deleteMultiple(keyPtrs);
 }
 
 kj::Maybe<kj::Promise<void>> ActorSqlite::setAlarm(
@@ -6,6 +6,7 @@
 
 #include "actor-cache.h"
 #include <workerd/util/sqlite-kv.h>
+#include <kj/timer.h>
 
 namespace workerd {
 
@@ -30,6 +31,19 @@ public:
     static Hooks DEFAULT;
   };
 
+  // Options for group commit. By default, the implicit transaction started by a write is
+  // committed at the end of the event loop turn. With group commit, it is instead held open for up
+  // to `window`, so that writes made in later turns are committed along with it. This amortizes the
+  // cost of each commit (typically an fsync) over many more writes. The output gate stays locked
+  // until the whole group has committed, so nothing can observe a write before it is durable.
+  struct GroupCommitOptions {
+    kj::Timer& timer;
+    kj::Duration window;
+
+    // Commit early once this many bytes of keys and values have been written in the group.
+    size_t maxBytes;
+  };
+
   // Constructs ActorSqlite, arranging to honor the output gate, that is, any writes to the
   // database which occur without any `await`s in between will automatically be combined into a
   // single atomic write. This is accomplished using transactions. In addition to ensuring
@@ -39,9 +53,13 @@ public:
   // `commitCallback` will be invoked after committing a transaction. The output gate will block on
   // the returned promise. This can be used e.g. when the database needs to be replicated to other
   // machines before being considered durable.
+  //
+  // If `groupCommit` is provided, implicit transactions are coalesced across turns as described
+  // above.
   explicit ActorSqlite(kj::Own<SqliteDatabase> dbParam, OutputGate& outputGate,
                        kj::Function<kj::Promise<void>()> commitCallback,
-                       Hooks& hooks = Hooks::DEFAULT);
+                       Hooks& hooks = Hooks::DEFAULT,
+                       kj::Maybe<GroupCommitOptions> groupCommit = kj::none);
 
   bool isCommitScheduled() { return !currentTxn.is<NoTxn>(); }
 
@@ -78,6 +96,7 @@ private:
   OutputGate& outputGate;
   kj::Function<kj::Promise<void>()> commitCallback;
   Hooks& hooks;
+  kj::Maybe<GroupCommitOptions> groupCommit;
   SqliteKv kv;
 
   SqliteDatabase::Statement beginTxn = db->prepare("BEGIN TRANSACTION");
@@ -151,8 +170,23 @@ private:
 
   kj::TaskSet commitTasks;
 
+  // While a group commit is waiting for its window to close, bytes written so far in the group
+  // and a fulfiller that closes the window early.
+  size_t groupCommitBytes = 0;
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> groupCommitNow;
+
   void onWrite();
 
+  // Returns a promise that resolves when the implicit transaction that was just started should be
+  // committed.
+  kj::Promise<void> waitForCommitWindow();
+
+  // Counts bytes written towards the group commit size limit.
+  void addGroupCommitBytes(size_t bytes);
+
+  // Ends the current group commit window, if any, so that the transaction commits right away.
+  void closeCommitWindow();
+
   void taskFailed(kj::Exception&& exception) override;
 
   void requireNotBroken();
@@ -5,13 +5,16 @@
 #include "io-context.h"
 #include <workerd/io/hibernation-manager.h>
 #include <workerd/util/uuid.h>
+#include <algorithm>
 
 namespace workerd {
 
 HibernationManagerImpl::~HibernationManagerImpl() noexcept(false) {
-  // Note that the HibernatableWebSocket destructor handles removing any references to itself in
-  // `tagToWs`, and even removes the hashmap entry if there are no more entries in the bucket.
-  allWs.clear();
+  // Dropping each websocket also removes it from `tagToWs`, and erases any tag left without
+  // websockets. Dropping from the back of `allWs` doesn't move any other websocket.
+  while (!allWs.empty()) {
+    dropHibernatableWebSocket(*allWs.back());
+  }
   KJ_ASSERT(tagToWs.size() == 0, "tagToWs hashmap wasn't cleared.");
 }
 
@@ -21,13 +24,14 @@ void HibernationManagerImpl::acceptWebSocket(
   // First, we create the HibernatableWebSocket and add it to the collection where it'll stay
   // until it's destroyed.
 
-  JSG_REQUIRE(allWs.size() < ACTIVE_CONNECTION_LIMIT, Error, "only ", ACTIVE_CONNECTION_LIMIT,
+  JSG_REQUIRE(allWs.size() < connectionLimit, Error, "only ", connectionLimit,
       " websockets can be accepted on a single Durable Object instance");
 
-  auto hib = kj::heap<HibernatableWebSocket>(kj::mv(ws), tags, *this);
+  auto hib = kj::heap<HibernatableWebSocket>(kj::mv(ws), tags);
   HibernatableWebSocket& refToHibernatable = *hib.get();
-  allWs.push_front(kj::mv(hib));
-  refToHibernatable.node = allWs.begin();
+  refToHibernatable.allWsIndex = allWs.size();
+  refToHibernatable.acceptOrder = nextAcceptOrder++;
+  allWs.add(kj::mv(hib));
 
   // If the `tags` array is empty (i.e. user did not provide a tag), we skip the population of the
   // `tagToWs` HashMap below and go straight to initiating the readLoop.
@@ -38,28 +42,25 @@ void HibernationManagerImpl::acceptWebSocket(
   //
   // We need to add the HibernatableWebSocket to each bucket in `tagToWs` corresponding to its tags.
   //  1. Create the entry if it doesn't exist
-  //  2. Fill the TagListItem in the HibernatableWebSocket's tagItems array
+  //  2. Append the websocket to the entry's members, and record where in the corresponding
+  //     TagSlot of the HibernatableWebSocket's tagSlots array
   size_t position = 0;
   for (auto tag = tags.begin(); tag < tags.end(); tag++, position++) {
     auto& tagCollection = tagToWs.findOrCreate(*tag, [&tag]() {
-      auto item = kj::heap<TagCollection>(
-          kj::mv(*tag), kj::heap<kj::List<TagListItem, &TagListItem::link>>());
+      auto item = kj::heap<TagCollection>(kj::mv(*tag));
       return decltype(tagToWs)::Entry {
           item->tag,
           kj::mv(item)
       };
     });
-    // This TagListItem sits in the HibernatableWebSocket's tagItems array.
-    auto& tagListItem = refToHibernatable.tagItems[position];
-    tagListItem.hibWS = refToHibernatable;
-    tagListItem.tag = tagCollection->tag.asPtr();
-
-    auto& list = tagCollection->list;
-    list->add(tagListItem);
-    // We also give the TagListItem a reference to the list it was added to so the
-    // HibernatableWebSocket can quickly remove itself from the list without doing a lookup
-    // in `tagToWs`.
-    tagListItem.list = *list.get();
+
+    auto& slot = refToHibernatable.tagSlots[position];
+    slot.collection = *tagCollection;
+    slot.index = tagCollection->members.size();
+    tagCollection->members.add(TagCollection::Member {
+      .hibWS = &refToHibernatable,
+      .slot = position,
+    });
   }
 
   // Finally, we initiate the readloop for this HibernatableWebSocket and
@@ -80,24 +81,119 @@ kj::Promise<void> HibernationManagerImpl::handleReadLoop(HibernatableWebSocket&
 kj::Vector<jsg::Ref<api::WebSocket>> HibernationManagerImpl::getWebSockets(
     jsg::Lock& js,
     kj::Maybe<kj::StringPtr> maybeTag) {
-  kj::Vector<jsg::Ref<api::WebSocket>> matches;
+  kj::Vector<HibernatableWebSocket*> found;
   KJ_IF_SOME(tag, maybeTag) {
     KJ_IF_SOME(item, tagToWs.find(tag)) {
-      auto& list = *((item)->list);
-      for (auto& entry: list) {
-        auto& hibWS = KJ_REQUIRE_NONNULL(entry.hibWS);
-        matches.add(hibWS.getActiveOrUnhibernate(js));
+      found.reserve(item->members.size());
+      for (auto& member: item->members) {
+        found.add(member.hibWS);
       }
     }
+    // Websockets with a tag are returned oldest first.
+    std::sort(found.begin(), found.end(),
+        [](HibernatableWebSocket* a, HibernatableWebSocket* b) {
+      return a->acceptOrder < b->acceptOrder;
+    });
   } else {
-    // Add all websockets!
+    // Add all websockets! These are returned newest first.
+    found.reserve(allWs.size());
     for (auto& hibWS : allWs) {
-      matches.add(hibWS->getActiveOrUnhibernate(js));
+      found.add(hibWS.get());
     }
+    std::sort(found.begin(), found.end(),
+        [](HibernatableWebSocket* a, HibernatableWebSocket* b) {
+      return a->acceptOrder > b->acceptOrder;
+    });
+  }
+
+  kj::Vector<jsg::Ref<api::WebSocket>> matches(found.size());
+  for (auto hibWS: found) {
+    matches.add(hibWS->getActiveOrUnhibernate(js));
   }
   return kj::mv(matches);
 }
 
+size_t HibernationManagerImpl::broadcast(
+    jsg::Lock& js,
+    kj::OneOf<kj::Array<kj::byte>, kj::String> message,
+    kj::Maybe<kj::StringPtr> maybeTag) {
+  auto shared = kj::refcounted<BroadcastMessage>(kj::mv(message));
+
+  // Like api::WebSocket::send(), don't let the message out until any storage writes made before
+  // the broadcast are confirmed.
+  KJ_IF_SOME(outputLock, IoContext::current().waitForOutputLocksIfNecessary()) {
+    shared->outputLock = outputLock.fork();
+  }
+
+  size_t sent = 0;
+  KJ_IF_SOME(tag, maybeTag) {
+    KJ_IF_SOME(item, tagToWs.find(tag)) {
+      for (auto& member: item->members) {
+        sent += sendBroadcast(js, *member.hibWS, *shared);
+      }
+    }
+  } else {
+    for (auto& hibWS : allWs) {
+      sent += sendBroadcast(js, *hibWS, *shared);
+    }
+  }
+  return sent;
+}
+
+bool HibernationManagerImpl::sendBroadcast(
+    jsg::Lock& js, HibernatableWebSocket& hib, BroadcastMessage& message) {
+  KJ_SWITCH_ONEOF(hib.activeOrPackage) {
+    KJ_CASE_ONEOF(active, jsg::Ref<api::WebSocket>) {
+      // The websocket is awake, so send through it in order to preserve ordering with any
+      // messages it has already queued.
+      if (active->hasClosedOutgoing()) {
+        return false;
+      }
+      KJ_SWITCH_ONEOF(message.content) {
+        KJ_CASE_ONEOF(data, kj::Array<kj::byte>) {
+          active->send(js, kj::heapArray(data.asPtr()));
+        }
+        KJ_CASE_ONEOF(text, kj::String) {
+          active->send(js, kj::str(text));
+        }
+      }
+      return true;
+    }
+    KJ_CASE_ONEOF(package, api::WebSocket::HibernationPackage) {
+      if (package.closedOutgoingConnection || hib.ws == kj::none) {
+        return false;
+      }
+      // Write straight to the kj::WebSocket, after any send that is already in progress. We look
+      // `ws` up again when it's our turn, because it goes away once a close or error event takes
+      // ownership of it. `hib` cancels the send if it is dropped first.
+      auto ready = kj::mv(hib.autoResponsePromise);
+      KJ_IF_SOME(outputLock, message.outputLock) {
+        ready = ready.then([branch = outputLock.addBranch()]() mutable { return kj::mv(branch); });
+      }
+      hib.autoResponsePromise = hib.broadcastCanceler.wrap(ready
+          .then([&hib, message = kj::addRef(message)]() -> kj::Promise<void> {
+        KJ_IF_SOME(ws, hib.ws) {
+          KJ_SWITCH_ONEOF(message->content) {
+            KJ_CASE_ONEOF(data, kj::Array<kj::byte>) {
+              return ws->send(data.asPtr());
+            }
+            KJ_CASE_ONEOF(text, kj::String) {
+              return ws->send(text.asArray());
+            }
+          }
+        }
+        return kj::READY_NOW;
+      })).eagerlyEvaluate([](kj::Exception&& e) {
+        // A failed send means the connection is broken, which the read loop will notice and
+        // handle. A canceled one means the websocket is gone. A failed output lock means the
+        // actor is broken, and the message must not go out.
+      });
+      return true;
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
 void HibernationManagerImpl::setWebSocketAutoResponse(
     kj::Maybe<kj::StringPtr> request, kj::Maybe<kj::StringPtr> response) {
   KJ_IF_SOME(req, request) {
@@ -141,12 +237,41 @@ void HibernationManagerImpl::hibernateWebSockets(Worker::Lock& lock) {
 }
 
 void HibernationManagerImpl::dropHibernatableWebSocket(HibernatableWebSocket& hib) {
+  for (auto& slot: hib.tagSlots) {
+    removeFromTag(slot);
+  }
   removeFromAllWs(hib);
 }
 
 inline void HibernationManagerImpl::removeFromAllWs(HibernatableWebSocket& hib) {
-  auto& node = KJ_REQUIRE_NONNULL(hib.node);
-  allWs.erase(node);
+  auto index = hib.allWsIndex;
+  KJ_ASSERT(index < allWs.size() && allWs[index].get() == &hib);
+
+  // Keep `hib` alive until we're done rearranging `allWs`.
+  auto owned = kj::mv(allWs[index]);
+  if (index != allWs.size() - 1) {
+    allWs[index] = kj::mv(allWs.back());
+    allWs[index]->allWsIndex = index;
+  }
+  allWs.removeLast();
+}
+
+void HibernationManagerImpl::removeFromTag(TagSlot& slot) {
+  KJ_IF_SOME(collection, slot.collection) {
+    auto& members = collection.members;
+    if (slot.index != members.size() - 1) {
+      auto& moved = members[slot.index] = members.back();
+      moved.hibWS->tagSlots[moved.slot].index = slot.index;
+    }
+    members.removeLast();
+    slot.collection = kj::none;
+
+    if (members.empty()) {
+      // Remove the bucket in tagToWs if the tag has no more websockets.
+      kj::StringPtr tag = collection.tag;
+      tagToWs.erase(tag);
+    }
+  }
 }
 
 kj::Promise<void> HibernationManagerImpl::handleSocketTermination(
@@ -226,12 +351,16 @@ kj::Promise<void> HibernationManagerImpl::readLoop(HibernatableWebSocket& hib) {
                   // We need to store the autoResponsePromise because we may instantiate an api::websocket
                   // If we do that, we have to provide it with the promise to avoid races. This can
                   // happen if we have a websocket hibernating, that unhibernates and sends a
-                  // message while ws.send() for auto-response is also sending.
-                  auto p = ws.send(
-                      KJ_REQUIRE_NONNULL(autoResponsePair->response).asArray()).fork();
+                  // message while ws.send() for auto-response is also sending. The same goes for
+                  // any broadcast still being written to this websocket, so we send after it.
+                  auto p = hib.autoResponsePromise.then(
+                      [&ws, response = kj::str(KJ_REQUIRE_NONNULL(autoResponsePair->response))]() {
+                    return ws.send(response.asArray());
+                  }).fork();
                   hib.autoResponsePromise = p.addBranch();
+                  // Note that we don't reset `autoResponsePromise` once this completes, since a
+                  // broadcast may have been chained onto it in the meantime.
                   co_await p;
-                  hib.autoResponsePromise = kj::READY_NOW;
                 }
               }
             }
@@ -11,16 +11,16 @@
 #include "v8-isolate.h"
 #include <workerd/jsg/ser.h>
 
-#include <list>
-
 namespace workerd {
 
 // Implements the HibernationManager class.
 class HibernationManagerImpl final : public Worker::Actor::HibernationManager {
 public:
-  HibernationManagerImpl(kj::Own<Worker::Actor::Loopback> loopback, uint16_t hibernationEventType)
+  HibernationManagerImpl(kj::Own<Worker::Actor::Loopback> loopback, uint16_t hibernationEventType,
+                         size_t connectionLimit = DEFAULT_CONNECTION_LIMIT)
       : loopback(kj::mv(loopback)),
         hibernationEventType(hibernationEventType),
+        connectionLimit(connectionLimit),
         onDisconnect(DisconnectHandler{}),
         readLoopTasks(onDisconnect) {}
   ~HibernationManagerImpl() noexcept(false);
@@ -36,6 +36,13 @@ public:
       jsg::Lock& js,
       kj::Maybe<kj::StringPtr> tag) override;
 
+  // Sends `message` to every websocket with the given tag, or to all accepted websockets if no tag
+  // is provided, without waking hibernating websockets. Hibernating websockets share a single copy
+  // of the message, which is written directly to their kj::WebSocket. Returns the number of
+  // websockets the message was sent to; websockets whose outgoing side is closed are skipped.
+  size_t broadcast(jsg::Lock& js, kj::OneOf<kj::Array<kj::byte>, kj::String> message,
+                   kj::Maybe<kj::StringPtr> tag) override;
+
   // Hibernates all the websockets held by the HibernationManager.
   // This converts our activeOrPackage from an api::WebSocket to a HibernationPackage.
   void hibernateWebSockets(Worker::Lock& lock) override;
@@ -52,15 +59,15 @@ private:
 
   kj::Promise<void> handleReadLoop(HibernatableWebSocket& refToHibernatable);
 
-  // Each HibernatableWebSocket can have multiple tags, so we want to store a reference
-  // in our kj::List.
-  struct TagListItem {
-    kj::Maybe<HibernatableWebSocket&> hibWS;
-    kj::ListLink<TagListItem> link;
-    kj::StringPtr tag;
-    // The List that refers to this TagListItem.
-    // If `list` is null, we've already removed this item from the list.
-    kj::Maybe<kj::List<TagListItem, &TagListItem::link>&> list;
+  struct TagCollection;
+
+  // Each HibernatableWebSocket can have multiple tags. For each one, the websocket records where
+  // it sits in the tag's `members` array so it can be removed without searching.
+  struct TagSlot {
+    // The collection this websocket was added to. Null once the websocket has been removed.
+    kj::Maybe<TagCollection&> collection;
+    // Index of this websocket in `collection.members`.
+    size_t index = 0;
   };
 
   // api::WebSockets cannot survive hibernation, but kj::WebSockets do. This class helps us
@@ -73,36 +80,21 @@ private:
   class HibernatableWebSocket {
   public:
     HibernatableWebSocket(jsg::Ref<api::WebSocket> websocket,
-                          kj::ArrayPtr<kj::String> tags,
-                          HibernationManagerImpl& manager)
-        : tagItems(kj::heapArray<TagListItem>(tags.size())),
+                          kj::ArrayPtr<kj::String> tags)
+        : tagSlots(kj::heapArray<TagSlot>(tags.size())),
           activeOrPackage(kj::mv(websocket)),
           // Extract's the kj::Own<kj::WebSocket> from api::WebSocket so the HibernatableWebSocket
           // can own it. The api::WebSocket retains a reference to our ws.
-          ws(activeOrPackage.get<jsg::Ref<api::WebSocket>>()->acceptAsHibernatable()),
-          manager(manager) {}
+          ws(activeOrPackage.get<jsg::Ref<api::WebSocket>>()->acceptAsHibernatable()) {}
 
     ~HibernatableWebSocket() noexcept(false) {
-      // We expect this dtor to be called when we're removing a HibernatableWebSocket
-      // from our `allWs` collection in the HibernationManager.
-
-      // This removal is fast because we have direct access to each kj::List, as well as direct
-      // access to each TagListItem we want to remove.
-      for (auto& item: tagItems) {
-        KJ_IF_SOME(list, item.list) {
-          // The list reference is non-null, so we still have a valid reference to this
-          // TagListItem in the list, which we will now remove.
-          list.remove(item);
-          if (list.empty()) {
-            // Remove the bucket in tagToWs if the tag has no more websockets.
-            manager.tagToWs.erase(kj::mv(item.tag));
-          }
-        }
-        item.hibWS = nullptr;
-        item.list = nullptr;
-      }
+      // Broadcasts that haven't been sent yet refer to us, and `autoResponsePromise` may have been
+      // handed to an api::WebSocket that outlives us, so make sure they never run.
+      broadcastCanceler.cancel("hibernatable websocket was dropped");
     }
 
+    // Note that the HibernationManager removes us from `tagToWs` before dropping us from `allWs`.
+
     // Returns a reference to the active websocket. If the websocket is currently hibernating,
     // we have to unhibernate it first. The process moves values from the HibernatableWebSocket
     // to the api::WebSocket.
@@ -119,13 +111,11 @@ private:
       return activeOrPackage.get<jsg::Ref<api::WebSocket>>().addRef();
     }
 
-    kj::ListLink<HibernatableWebSocket> link;
-
-    // An array of all the items/nodes that refer to this HibernatableWebSocket.
-    // Keeping track of these items allows us to quickly remove every reference from `tagToWs`
-    // once the websocket disconnects -- rather than iterating through each relevant tag in the
-    // hashmap and removing it from each kj::List.
-    kj::Array<TagListItem> tagItems;
+    // One slot per tag, recording where this HibernatableWebSocket sits in each tag's collection.
+    // Keeping track of these allows us to quickly remove every reference from `tagToWs` once the
+    // websocket disconnects -- rather than iterating through each relevant tag in the hashmap and
+    // searching its members.
+    kj::Array<TagSlot> tagSlots;
 
     // If active, we have an api::WebSocket reference, otherwise, we're hibernating, so we retain
     // the websocket's properties in a HibernationPackage until it's time to wake up.
@@ -137,14 +127,13 @@ private:
     // HibernationManager drops the websocket before all queued messages have sent.
     kj::Maybe<kj::Own<kj::WebSocket>> ws;
 
-    HibernationManagerImpl& manager;
-    // TODO(someday): We (currently) only use the HibernationManagerImpl reference to refer to
-    // `tagToWs` when running the dtor for `HibernatableWebSocket`. This feels a bit excessive,
-    // I would rather have the HibernationManager deal with its collections than have the
-    // HibernatableWebSocket do so. Maybe come back to this at some point?
+    // Index of this HibernatableWebSocket in `allWs`, which allows us to do fast deletion on
+    // disconnect.
+    size_t allWsIndex = 0;
 
-    // Reference to the Node in `allWs` that allows us to do fast deletion on disconnect.
-    kj::Maybe<std::list<kj::Own<HibernatableWebSocket>>::iterator> node;
+    // When this websocket was accepted, relative to the others. `allWs` and the tag collections
+    // are unordered, so getWebSockets() sorts by this.
+    uint64_t acceptOrder = 0;
 
     // True once we have dispatched the close event.
     // This prevents us from dispatching it if we have already done so.
@@ -153,10 +142,15 @@ private:
     // Stores the last received autoResponseRequest timestamp.
     kj::Maybe<kj::Date> autoResponseTimestamp;
 
-    // Keeps track of the currently ongoing websocket auto-response send promise. This promise may
-    // be moved to api::websocket if an hibernating websocket unhibernates.
+    // Keeps track of sends made directly to `ws` while hibernating, i.e. auto-responses and
+    // broadcasts. Each new send is chained onto this promise, since a kj::WebSocket allows only
+    // one send at a time. This promise may be moved to api::websocket if an hibernating websocket
+    // unhibernates, so that it doesn't send until these are done.
     kj::Promise<void> autoResponsePromise = kj::READY_NOW;
 
+    // Wraps the broadcast sends chained onto `autoResponsePromise`.
+    kj::Canceler broadcastCanceler;
+
     friend HibernationManagerImpl;
   };
 
@@ -164,9 +158,28 @@ private:
   // Removes a HibernatableWebSocket from the HibernationManager's various collections.
   void dropHibernatableWebSocket(HibernatableWebSocket& hib);
 
-  // Removes the HibernatableWebSocket from `allWs`.
+  // Removes the HibernatableWebSocket from `allWs`, destroying it.
   inline void removeFromAllWs(HibernatableWebSocket& hib);
 
+  // Removes the HibernatableWebSocket from the collection referenced by `slot`, and erases the
+  // collection from `tagToWs` if it becomes empty.
+  void removeFromTag(TagSlot& slot);
+
+  // A message being broadcast, shared by all of the hibernating websockets it is sent to.
+  struct BroadcastMessage: public kj::Refcounted {
+    kj::OneOf<kj::Array<kj::byte>, kj::String> content;
+
+    // Resolves once the storage writes made before the broadcast are confirmed, if any were
+    // pending.
+    kj::Maybe<kj::ForkedPromise<void>> outputLock;
+
+    explicit BroadcastMessage(kj::OneOf<kj::Array<kj::byte>, kj::String> content)
+        : content(kj::mv(content)) {}
+  };
+
+  // Sends a broadcast message to one websocket. Returns false if the websocket can't send.
+  bool sendBroadcast(jsg::Lock& js, HibernatableWebSocket& hib, BroadcastMessage& message);
+
   // Handles the termination of the websocket. If termination was not clean, we might try to
   // dispatch a close event (if we haven't already), or an error event.
   // We will also remove the HibernatableWebSocket from the HibernationManager's collections.
@@ -180,11 +193,18 @@ private:
   // This struct is held by the `tagToWs` hashmap. The key is a StringPtr to tag, and the value
   // is this struct itself.
   struct TagCollection {
+    struct Member {
+      HibernatableWebSocket* hibWS;
+      // Index of the corresponding TagSlot in `hibWS->tagSlots`.
+      size_t slot;
+    };
+
     kj::String tag;
-    kj::Own<kj::List<TagListItem, &TagListItem::link>> list;
+    // The websockets with this tag, in no particular order. Removal moves the last member into the
+    // vacated position, so that the array stays dense.
+    kj::Vector<Member> members;
 
-    TagCollection(kj::String tag, decltype(list) list): tag(kj::mv(tag)), list(kj::mv(list)) {}
-    TagCollection(TagCollection&& other) = default;
+    explicit TagCollection(kj::String tag): tag(kj::mv(tag)) {}
   };
 
   // This structure will hold the request and corresponding response for hibernatable websockets
@@ -197,13 +217,16 @@ private:
   };
 
   // A hashmap of tags to HibernatableWebSockets associated with the tag.
-  // We use a kj::List so we can quickly remove websockets that have disconnected.
   // Also note that we box the keys and values such that in the event of a hashmap resizing we don't
   // move the underlying data (thereby keeping any references intact).
   kj::HashMap<kj::StringPtr, kj::Own<TagCollection>> tagToWs;
 
-  // We store all of our HibernatableWebSockets in a doubly linked-list.
-  std::list<kj::Own<HibernatableWebSocket>> allWs;
+  // We store all of our HibernatableWebSockets in a dense array, in no particular order. Removal
+  // moves the last websocket into the vacated position.
+  kj::Vector<kj::Own<HibernatableWebSocket>> allWs;
+
+  // The `acceptOrder` to give the next websocket we accept.
+  uint64_t nextAcceptOrder = 0;
 
   // Used to obtain the worker so we can dispatch Hibernatable websocket events.
   kj::Own<Worker::Actor::Loopback> loopback;
@@ -222,7 +245,7 @@ private:
 
   // The maximum number of Hibernatable WebSocket connections a single HibernationManagerImpl
   // instance can manage.
-  const size_t ACTIVE_CONNECTION_LIMIT = 1024 * 32;
+  const size_t connectionLimit;
 
   class DisconnectHandler: public kj::TaskSet::ErrorHandler {
   public:
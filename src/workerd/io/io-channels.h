@@ -12,6 +12,7 @@ namespace kj { class HttpClient; }
 namespace workerd {
 
 class WorkerInterface;
+class SqliteKvNamespace;
 
 // Interface for talking to the Cache API. Needs to be declared here so that IoContext can
 // contain it.
@@ -148,6 +149,11 @@ public:
 
   virtual kj::Own<WorkerInterface> startSubrequest(uint channel, SubrequestMetadata metadata) = 0;
 
+  // If the given subrequest channel leads to a KV namespace stored in this process, returns it,
+  // so that KV bindings can skip serializing their requests as HTTP. Otherwise, KV requests go
+  // through startSubrequest().
+  virtual kj::Maybe<SqliteKvNamespace&> getLocalKvNamespace(uint channel) { return kj::none; }
+
   // Get a Cap'n Proto RPC capability. Various binding types are backed by capabilities.
   //
   // Note that some other channel types, like actor channels, may actually be wrappers around
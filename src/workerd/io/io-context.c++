@@ -140,13 +140,15 @@ ThreadContext::HeaderIdBundle::HeaderIdBundle(kj::HttpHeaderTable::Builder& buil
 
 ThreadContext::ThreadContext(
     kj::Timer& timer, kj::EntropySource& entropySource,
-    HeaderIdBundle headerIds, capnp::HttpOverCapnpFactory& httpOverCapnpFactory, capnp::ByteStreamFactory& byteStreamFactory, bool fiddle)
+    HeaderIdBundle headerIds, capnp::HttpOverCapnpFactory& httpOverCapnpFactory, capnp::ByteStreamFactory& byteStreamFactory, bool fiddle,
+    kj::Maybe<const kj::Directory&> teeSpillDirectory)
     : timer(timer),
       entropySource(entropySource),
       headerIds(headerIds),
       httpOverCapnpFactory(httpOverCapnpFactory),
       byteStreamFactory(byteStreamFactory),
-      fiddle(fiddle) {}
+      fiddle(fiddle),
+      teeSpillDirectory(teeSpillDirectory) {}
 
 IoContext::IoContext(ThreadContext& thread,
                                kj::Own<const Worker> workerParam,
@@ -8,6 +8,7 @@
 #include <kj/compat/http.h>
 #include <kj/mutex.h>
 #include <kj/function.h>
+#include <kj/filesystem.h>
 
 #include <workerd/io/trace.h>
 #include <workerd/io/worker.h>
@@ -66,7 +67,8 @@ public:
   ThreadContext(
       kj::Timer& timer, kj::EntropySource& entropySource,
       HeaderIdBundle headerIds, capnp::HttpOverCapnpFactory& httpOverCapnpFactory,
-          capnp::ByteStreamFactory& byteStreamFactory, bool isFiddle);
+          capnp::ByteStreamFactory& byteStreamFactory, bool isFiddle,
+      kj::Maybe<const kj::Directory&> teeSpillDirectory = kj::none);
 
   // This should only be used to costruct TimerChannel. Everything else should use TimerChannel.
   kj::Timer& getUnsafeTimer() { return timer; }
@@ -78,6 +80,10 @@ public:
   capnp::ByteStreamFactory& getByteStreamFactory() { return byteStreamFactory; }
   bool isFiddle() { return fiddle; }
 
+  // Directory in which ReadableStream.tee() may create temporary files to hold data for a branch
+  // that has fallen too far behind its sibling.
+  kj::Maybe<const kj::Directory&> getTeeSpillDirectory() { return teeSpillDirectory; }
+
 private:
   // NOTE: This timer only updates when entering the event loop!
   kj::Timer& timer;
@@ -86,6 +92,7 @@ private:
   capnp::HttpOverCapnpFactory& httpOverCapnpFactory;
   capnp::ByteStreamFactory& byteStreamFactory;
   bool fiddle;
+  kj::Maybe<const kj::Directory&> teeSpillDirectory;
 };
 
 // A TimeoutId is a positive non-zero integer value that explicitly identifies a timeout set on an
@@ -756,6 +763,7 @@ public:
   }
 
   const kj::HttpHeaderTable& getHeaderTable() { return thread.getHeaderTable(); }
+  kj::Maybe<const kj::Directory&> getTeeSpillDirectory() { return thread.getTeeSpillDirectory(); }
   const ThreadContext::HeaderIdBundle& getHeaderIds() { return thread.getHeaderIds(); }
 
   // Subrequest channel numbers for the two special channels.
@@ -836,6 +844,10 @@ public:
     return getIoChannelFactory().getCapability(channel);
   }
 
+  kj::Maybe<SqliteKvNamespace&> getLocalKvNamespace(uint channel) {
+    return getIoChannelFactory().getLocalKvNamespace(channel);
+  }
+
   kj::Own<IoChannelFactory::ActorChannel> getGlobalActorChannel(
       uint channel, const ActorIdFactory::ActorId& id, kj::Maybe<kj::String> locationHint,
       ActorGetMode mode, SpanParent parentSpan) {
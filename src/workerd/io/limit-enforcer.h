@@ -107,6 +107,12 @@ public:
   // data in C++ memory, such as reading an entire HTTP response into an `ArrayBuffer`.
   virtual size_t getBufferingLimit() = 0;
 
+  // Called when CPU-bound work done on the request's behalf on a background thread, such as a
+  // large WebCrypto operation, has finished. An enforcer that limits CPU time should count `time`
+  // against the limit as if it had been spent running JavaScript. By default it's ignored, which
+  // suits enforcers that don't limit CPU time at all.
+  virtual void chargeBackgroundCpu(kj::Duration time) {}
+
   // If a limit has been exceeded which prevents further JavaScript execution, such as the CPU or
   // memory limit, returns a request status code indicating which one. Returns null if no limits
   // are exceeded.
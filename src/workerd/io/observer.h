@@ -70,6 +70,18 @@ public:
   virtual void finishedWaitUntilTask() {}
 
   virtual void setFailedOpen(bool value) {}
+
+  // Called when a CompressionStream, a DecompressionStream or a gzip Content-Encoding stream
+  // takes its zlib state from the per-thread pool (hit), or has to allocate a new one because none
+  // was available (miss).
+  virtual void compressionPoolHit() {}
+  virtual void compressionPoolMiss() {}
+
+  // Called when a KV read is served from the Worker's KV read cache (hit), or has to go to the KV
+  // service because the key wasn't cached or its entry was too old for the read's `cacheTtl`
+  // (miss). Reads that can't use the cache are not reported.
+  virtual void kvReadCacheHit() {}
+  virtual void kvReadCacheMiss() {}
 };
 
 class IsolateObserver: public kj::AtomicRefcounted, public jsg::IsolateObserver {
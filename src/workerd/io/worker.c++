@@ -2908,6 +2908,7 @@ struct Worker::Actor::Impl {
   // in each CustomEvent.
   kj::Maybe<kj::Own<HibernationManager>> hibernationManager;
   kj::Maybe<uint16_t> hibernationEventType;
+  size_t hibernatableWebSocketLimit;
   kj::PromiseFulfillerPair<void> constructorFailedPaf = kj::newPromiseAndFulfiller<void>();
 
   struct ScheduledAlarm {
@@ -2948,6 +2949,7 @@ struct Worker::Actor::Impl {
        MakeStorageFunc makeStorage, kj::Own<Loopback> loopback,
        TimerChannel& timerChannel, kj::Own<ActorObserver> metricsParam,
        kj::Maybe<kj::Own<HibernationManager>> manager, kj::Maybe<uint16_t>& hibernationEventType,
+       size_t hibernatableWebSocketLimit,
        kj::PromiseFulfillerPair<void> paf = kj::newPromiseAndFulfiller<void>())
       : actorId(kj::mv(actorId)), makeStorage(kj::mv(makeStorage)),
         metrics(kj::mv(metricsParam)),
@@ -2958,7 +2960,8 @@ struct Worker::Actor::Impl {
         shutdownPromise(paf.promise.fork()),
         shutdownFulfiller(kj::mv(paf.fulfiller)),
         hibernationManager(kj::mv(manager)),
-        hibernationEventType(kj::mv(hibernationEventType)) {
+        hibernationEventType(kj::mv(hibernationEventType)),
+        hibernatableWebSocketLimit(hibernatableWebSocketLimit) {
     jsg::Lock& js = lock;
     js.withinHandleScope([&] {
       auto contextScope = js.enterContextScope(lock.getContext());
@@ -2999,13 +3002,14 @@ Worker::Actor::Actor(const Worker& worker, kj::Maybe<RequestTracker&> tracker, A
     bool hasTransient, MakeActorCacheFunc makeActorCache,
     kj::Maybe<kj::StringPtr> className, MakeStorageFunc makeStorage, Worker::Lock& lock,
     kj::Own<Loopback> loopback, TimerChannel& timerChannel, kj::Own<ActorObserver> metrics,
-    kj::Maybe<kj::Own<HibernationManager>> manager, kj::Maybe<uint16_t> hibernationEventType)
+    kj::Maybe<kj::Own<HibernationManager>> manager, kj::Maybe<uint16_t> hibernationEventType,
+    size_t hibernatableWebSocketLimit)
     : worker(kj::atomicAddRef(worker)), tracker(tracker.map([](RequestTracker& tracker){
       return tracker.addRef();
     })) {
   impl = kj::heap<Impl>(*this, lock, kj::mv(actorId), hasTransient, kj::mv(makeActorCache),
                         kj::mv(makeStorage), kj::mv(loopback), timerChannel, kj::mv(metrics),
-                        kj::mv(manager), hibernationEventType);
+                        kj::mv(manager), hibernationEventType, hibernatableWebSocketLimit);
 
   KJ_IF_SOME(c, className) {
     KJ_IF_SOME(cls, lock.getWorker().impl->actorClasses.find(c)) {
@@ -3382,6 +3386,10 @@ kj::Maybe<uint16_t> Worker::Actor::getHibernationEventType() {
   return impl->hibernationEventType;
 }
 
+size_t Worker::Actor::getHibernatableWebSocketLimit() {
+  return impl->hibernatableWebSocketLimit;
+}
+
 // =======================================================================================
 
 uint Worker::Isolate::getCurrentLoad() const {
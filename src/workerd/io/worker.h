@@ -702,10 +702,15 @@ public:
   // removing WebSockets from its collection when they disconnect.
   class HibernationManager : public kj::Refcounted {
   public:
+    // Default maximum number of websockets a HibernationManager accepts.
+    static constexpr size_t DEFAULT_CONNECTION_LIMIT = 1024 * 32;
+
     virtual void acceptWebSocket(jsg::Ref<api::WebSocket> ws, kj::ArrayPtr<kj::String> tags) = 0;
     virtual kj::Vector<jsg::Ref<api::WebSocket>> getWebSockets(
         jsg::Lock& js,
         kj::Maybe<kj::StringPtr> tag) = 0;
+    virtual size_t broadcast(jsg::Lock& js, kj::OneOf<kj::Array<kj::byte>, kj::String> message,
+        kj::Maybe<kj::StringPtr> tag) = 0;
     virtual void hibernateWebSockets(Worker::Lock& lock) = 0;
     virtual void setWebSocketAutoResponse(kj::Maybe<kj::StringPtr> request,
         kj::Maybe<kj::StringPtr> response) = 0;
@@ -719,7 +724,8 @@ public:
         bool hasTransient, MakeActorCacheFunc makeActorCache,
         kj::Maybe<kj::StringPtr> className, MakeStorageFunc makeStorage, Worker::Lock& lock,
         kj::Own<Loopback> loopback, TimerChannel& timerChannel, kj::Own<ActorObserver> metrics,
-        kj::Maybe<kj::Own<HibernationManager>> manager, kj::Maybe<uint16_t> hibernationEventType);
+        kj::Maybe<kj::Own<HibernationManager>> manager, kj::Maybe<uint16_t> hibernationEventType,
+        size_t hibernatableWebSocketLimit = HibernationManager::DEFAULT_CONNECTION_LIMIT);
 
   ~Actor() noexcept(false);
 
@@ -792,6 +798,10 @@ public:
   // Only needs to be called when allocating a HibernationManager!
   kj::Maybe<uint16_t> getHibernationEventType();
 
+  // Gets the maximum number of websockets the actor's HibernationManager should accept. Only
+  // needs to be called when allocating a HibernationManager!
+  size_t getHibernatableWebSocketLimit();
+
   const Worker& getWorker() { return *worker; }
 
   void assertCanSetAlarm();
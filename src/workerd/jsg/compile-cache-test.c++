@@ -0,0 +1,94 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "jsg-test.h"
+#include <kj/filesystem.h>
+
+namespace workerd::jsg::test {
+namespace {
+
+V8System v8System;
+class ContextGlobalObject: public Object, public ContextGlobal {};
+
+struct CacheContext: public ContextGlobalObject {
+  JSG_RESOURCE_TYPE(CacheContext) {}
+};
+JSG_DECLARE_ISOLATE_TYPE(CacheIsolate, CacheContext);
+
+// The disk cache can only be enabled once per process, which is why these tests live in their
+// own binary.
+const kj::Directory& getCacheDirectory() {
+  static const kj::Directory& directory = []() -> const kj::Directory& {
+    auto owned = kj::newInMemoryDirectory(kj::nullClock());
+    auto& result = *owned;
+    setModuleCompileCacheDirectory(kj::mv(owned));
+    return result;
+  }();
+  return directory;
+}
+
+// Returns the name of the one cache entry that's in `after` but not in `before`.
+kj::String newEntry(kj::ArrayPtr<const kj::String> before, kj::ArrayPtr<const kj::String> after) {
+  KJ_ASSERT(after.size() == before.size() + 1);
+  for (auto& name: after) {
+    bool existed = false;
+    for (auto& old: before) {
+      if (old == name) existed = true;
+    }
+    if (!existed) return kj::str(name);
+  }
+  KJ_FAIL_ASSERT("no new cache entry");
+}
+
+KJ_TEST("bundle modules compiled twice hit the disk cache") {
+  auto& dir = getCacheDirectory();
+  Evaluator<CacheContext, CacheIsolate> e(v8System);
+  auto code = "export function run() { return 'first'; }"_kj;
+
+  auto entriesBefore = dir.listNames();
+  auto before = getModuleCompileCacheStats();
+  e.expectEvalModule(code, "string", "first");
+  auto afterFirst = getModuleCompileCacheStats();
+  KJ_EXPECT(afterFirst.misses == before.misses + 1);
+  KJ_EXPECT(afterFirst.hits == before.hits);
+  newEntry(entriesBefore, dir.listNames());
+
+  // Each evaluation uses a new context and so compiles the module again.
+  e.expectEvalModule(code, "string", "first");
+  auto afterSecond = getModuleCompileCacheStats();
+  KJ_EXPECT(afterSecond.hits == afterFirst.hits + 1);
+  KJ_EXPECT(afterSecond.misses == afterFirst.misses);
+  KJ_EXPECT(afterSecond.rejections == afterFirst.rejections);
+}
+
+KJ_TEST("corrupt disk cache entries are rejected and rewritten") {
+  auto& dir = getCacheDirectory();
+  Evaluator<CacheContext, CacheIsolate> e(v8System);
+  auto code = "export function run() { return 'second'; }"_kj;
+
+  auto entriesBefore = dir.listNames();
+  e.expectEvalModule(code, "string", "second");
+  auto path = kj::Path(newEntry(entriesBefore, dir.listNames()));
+
+  {
+    auto replacer = dir.replaceFile(path, kj::WriteMode::MODIFY);
+    replacer->get().writeAll("not a code cache"_kj);
+    replacer->commit();
+  }
+
+  auto before = getModuleCompileCacheStats();
+  e.expectEvalModule(code, "string", "second");
+  auto afterRejected = getModuleCompileCacheStats();
+  KJ_EXPECT(afterRejected.rejections == before.rejections + 1);
+  KJ_EXPECT(afterRejected.hits == before.hits);
+  KJ_EXPECT(dir.openFile(path)->readAllText() != "not a code cache");
+
+  e.expectEvalModule(code, "string", "second");
+  auto afterRewritten = getModuleCompileCacheStats();
+  KJ_EXPECT(afterRewritten.hits == afterRejected.hits + 1);
+  KJ_EXPECT(afterRewritten.rejections == afterRejected.rejections);
+}
+
+}  // namespace
+}  // namespace workerd::jsg::test
@@ -4,7 +4,10 @@
 
 #include "jsg.h"
 #include "promise.h"
+#include <kj/encoding.h>
 #include <kj/mutex.h>
+#include <openssl/sha.h>
+#include <atomic>
 #include <set>
 
 namespace workerd::jsg {
@@ -41,6 +44,100 @@ private:
   kj::MutexGuarded<kj::HashMap<const void*, std::unique_ptr<v8::ScriptCompiler::CachedData>>> cache;
 };
 
+// Optional on-disk cache of compilation data for worker bundle modules, enabled by
+// setModuleCompileCacheDirectory().
+//
+// Entries are keyed by the SHA-256 of the module source and by V8's cached data version tag, which
+// covers the V8 version and the flags that affect code generation. V8 performs its own sanity
+// checks when consuming the data, so a stale or corrupt entry is merely rejected and replaced.
+class DiskCompileCache {
+public:
+  explicit DiskCompileCache(kj::Own<const kj::Directory> directory)
+      : directory(kj::mv(directory)) {}
+
+  kj::Path pathFor(kj::ArrayPtr<const char> content) const {
+    kj::byte digest[SHA256_DIGEST_LENGTH];
+    SHA256(content.asBytes().begin(), content.size(), digest);
+    return kj::Path(kj::str(kj::encodeHex(kj::arrayPtr(digest, sizeof(digest))), '-',
+        kj::hex(v8::ScriptCompiler::CachedDataVersionTag()), ".v8cache"));
+  }
+
+  kj::Maybe<kj::Array<const kj::byte>> tryRead(kj::PathPtr path) const {
+    kj::Maybe<kj::Array<const kj::byte>> result;
+    KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+      KJ_IF_SOME(file, directory->tryOpenFile(path)) {
+        result = file->readAllBytes();
+      }
+    })) {
+      KJ_LOG(WARNING, "failed to read module compile cache entry", path.toString(), exception);
+    }
+    return kj::mv(result);
+  }
+
+  void write(kj::PathPtr path, v8::Local<v8::Module> module) const {
+    auto cachedData = std::unique_ptr<v8::ScriptCompiler::CachedData>(
+        v8::ScriptCompiler::CreateCodeCache(module->GetUnboundModuleScript()));
+    if (cachedData == nullptr) return;
+
+    // Use replaceFile() so that concurrent readers (e.g. other processes sharing the directory)
+    // never observe a partially-written entry.
+    KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+      auto replacer = directory->replaceFile(path,
+          kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+      replacer->get().writeAll(kj::arrayPtr(cachedData->data, cachedData->length));
+      replacer->commit();
+    })) {
+      KJ_LOG(WARNING, "failed to write module compile cache entry", path.toString(), exception);
+    }
+  }
+
+  static kj::Maybe<const DiskCompileCache&> get() {
+    KJ_IF_SOME(i, instance) {
+      return i;
+    }
+    return kj::none;
+  }
+
+  static void set(kj::Own<const kj::Directory> directory) {
+    KJ_REQUIRE(instance == kj::none, "module compile cache directory can only be set once");
+    instance.emplace(kj::mv(directory));
+  }
+
+private:
+  kj::Own<const kj::Directory> directory;
+
+  // Set once at startup, before any isolates exist, and never modified afterwards, so no locking
+  // is needed to read it.
+  static kj::Maybe<DiskCompileCache> instance;
+};
+
+kj::Maybe<DiskCompileCache> DiskCompileCache::instance;
+
+// Compiles a module while consuming previously-generated code cache data. If V8 rejects the data
+// (because it was produced by a different V8 version or with different flags, or doesn't match the
+// source), V8 falls back to a full compile on its own, so the returned module is always usable.
+struct CodeCacheCompileResult {
+  v8::Local<v8::Module> module;
+  CompilationObserver::CompileCacheResult result;
+};
+
+CodeCacheCompileResult compileModuleWithCodeCache(
+    jsg::Lock& js, v8::Local<v8::String> contentStr, const v8::ScriptOrigin& origin,
+    kj::ArrayPtr<const kj::byte> data) {
+  // Note that Source takes ownership of the CachedData object (but, with BufferNotOwned, not of
+  // the underlying bytes), so we must always hand it a fresh wrapper rather than the instance
+  // stored in a cache.
+  v8::ScriptCompiler::Source source(contentStr, origin,
+      new v8::ScriptCompiler::CachedData(data.begin(), data.size(),
+          v8::ScriptCompiler::CachedData::BufferNotOwned));
+  auto module = jsg::check(v8::ScriptCompiler::CompileModule(
+      js.v8Isolate, &source, v8::ScriptCompiler::kConsumeCodeCache));
+  auto result = source.GetCachedData()->rejected
+      ? CompilationObserver::CompileCacheResult::REJECTED
+      : CompilationObserver::CompileCacheResult::HIT;
+  return { module, result };
+}
+
 // Implementation of `v8::Module::ResolveCallback`.
 v8::MaybeLocal<v8::Module> resolveCallback(v8::Local<v8::Context> context,
                                            v8::Local<v8::String> specifier,
@@ -354,6 +451,31 @@ static CompilationObserver::Option convertOption(ModuleInfoCompileOption option)
   KJ_UNREACHABLE;
 }
 
+// Totals reported by getModuleCompileCacheStats().
+std::atomic<uint64_t> compileCacheHits = 0;
+std::atomic<uint64_t> compileCacheMisses = 0;
+std::atomic<uint64_t> compileCacheRejections = 0;
+
+void reportCompileCacheResult(
+    jsg::Lock& js,
+    kj::StringPtr name,
+    ModuleInfoCompileOption option,
+    const CompilationObserver& observer,
+    CompilationObserver::CompileCacheResult result) {
+  switch (result) {
+    case CompilationObserver::CompileCacheResult::HIT:
+      compileCacheHits.fetch_add(1, std::memory_order_relaxed);
+      break;
+    case CompilationObserver::CompileCacheResult::MISS:
+      compileCacheMisses.fetch_add(1, std::memory_order_relaxed);
+      break;
+    case CompilationObserver::CompileCacheResult::REJECTED:
+      compileCacheRejections.fetch_add(1, std::memory_order_relaxed);
+      break;
+  }
+  observer.onCompileCacheResult(js.v8Isolate, name, convertOption(option), result);
+}
+
 v8::Local<v8::Module> compileEsmModule(
     jsg::Lock& js,
     kj::StringPtr name,
@@ -385,30 +507,48 @@ v8::Local<v8::Module> compileEsmModule(
     // may need to revisit that to import built-ins as UTF-16 (two-byte).
     contentStr = jsg::newExternalOneByteString(js, content);
 
-    // TODO(bug): The cache is failing under certain conditions. Disabling this logic
-    // for now until it can be debugged.
-    // const auto& compileCache = CompileCache::get();
-    // KJ_IF_SOME(cached, compileCache.find(content.begin())) {
-    //   v8::ScriptCompiler::Source source(contentStr, origin, &cached);
-    //   v8::ScriptCompiler::CompileOptions options = v8::ScriptCompiler::kConsumeCodeCache;
-    //   KJ_DEFER(if (source.GetCachedData()->rejected) {
-    //     KJ_LOG(ERROR, kj::str("Failed to load module '", name ,"' using compile cache"));
-    //     js.throwException(KJ_EXCEPTION(FAILED, "jsg.Error: Internal error"));
-    //   });
-    //   return jsg::check(v8::ScriptCompiler::CompileModule(js.v8Isolate, &source, options));
-    // }
+    const auto& compileCache = CompileCache::get();
+    KJ_IF_SOME(cached, compileCache.find(content.begin())) {
+      auto [module, result] = compileModuleWithCodeCache(js, contentStr, origin,
+          kj::arrayPtr(cached.data, cached.length));
+      reportCompileCacheResult(js, name, option, observer, result);
+      return module;
+    }
 
     v8::ScriptCompiler::Source source(contentStr, origin);
     auto module = jsg::check(v8::ScriptCompiler::CompileModule(js.v8Isolate, &source));
+    reportCompileCacheResult(js, name, option, observer,
+        CompilationObserver::CompileCacheResult::MISS);
 
     auto cachedData = std::unique_ptr<v8::ScriptCompiler::CachedData>(
         v8::ScriptCompiler::CreateCodeCache(module->GetUnboundModuleScript()));
-    // compileCache.add(content.begin(), kj::mv(cachedData));
+    compileCache.add(content.begin(), kj::mv(cachedData));
     return module;
   }
 
   contentStr = jsg::v8Str(js.v8Isolate, content);
 
+  KJ_IF_SOME(diskCache, DiskCompileCache::get()) {
+    auto path = diskCache.pathFor(content);
+    KJ_IF_SOME(data, diskCache.tryRead(path)) {
+      auto [module, result] = compileModuleWithCodeCache(js, contentStr, origin, data);
+      reportCompileCacheResult(js, name, option, observer, result);
+      if (result == CompilationObserver::CompileCacheResult::REJECTED) {
+        // The entry is stale (e.g. produced with different V8 flags) or corrupt. Overwrite it
+        // with a fresh one so that the next isolate gets a hit.
+        diskCache.write(path, module);
+      }
+      return module;
+    }
+
+    v8::ScriptCompiler::Source source(contentStr, origin);
+    auto module = jsg::check(v8::ScriptCompiler::CompileModule(js.v8Isolate, &source));
+    reportCompileCacheResult(js, name, option, observer,
+        CompilationObserver::CompileCacheResult::MISS);
+    diskCache.write(path, module);
+    return module;
+  }
+
   v8::ScriptCompiler::Source source(contentStr, origin);
   auto module = jsg::check(v8::ScriptCompiler::CompileModule(js.v8Isolate, &source));
 
@@ -668,4 +808,16 @@ void NodeJsModuleObject::setExports(jsg::Value value) {
 
 kj::StringPtr NodeJsModuleObject::getPath() { return path; }
 
+void setModuleCompileCacheDirectory(kj::Own<const kj::Directory> directory) {
+  DiskCompileCache::set(kj::mv(directory));
+}
+
+ModuleCompileCacheStats getModuleCompileCacheStats() {
+  return {
+    .hits = compileCacheHits.load(std::memory_order_relaxed),
+    .misses = compileCacheMisses.load(std::memory_order_relaxed),
+    .rejections = compileCacheRejections.load(std::memory_order_relaxed),
+  };
+}
+
 }  // namespace workerd::jsg
@@ -170,6 +170,26 @@ enum class ModuleInfoCompileOption {
   BUILTIN,
 };
 
+// Enables a persistent, process-wide cache of V8 compilation data for BUNDLE modules, stored in
+// `directory`. Entries are keyed by the module source's SHA-256 and by the V8 version and flags,
+// so the directory can safely be shared across workerd upgrades and config changes. Cache hits,
+// misses, and rejections are reported via CompilationObserver::onCompileCacheResult() and counted
+// in getModuleCompileCacheStats().
+//
+// (BUILTIN modules are always cached in memory and don't need this.)
+//
+// Must be called at most once, before any isolates are created.
+void setModuleCompileCacheDirectory(kj::Own<const kj::Directory> directory);
+
+// Process-wide totals of module compile cache lookups, across all isolates, covering both the
+// in-memory cache of BUILTIN modules and the on-disk cache of BUNDLE modules.
+struct ModuleCompileCacheStats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t rejections;
+};
+ModuleCompileCacheStats getModuleCompileCacheStats();
+
 v8::Local<v8::WasmModuleObject> compileWasmModule(jsg::Lock& js,
     kj::ArrayPtr<const uint8_t> code,
     const CompilationObserver& observer);
@@ -30,6 +30,23 @@ struct CompilationObserver {
   virtual kj::Own<void> onEsmCompilationStart(
       v8::Isolate* isolate, kj::StringPtr name, Option option) const { return kj::Own<void>(); }
 
+  enum class CompileCacheResult {
+    // No cached data was available, so the module was compiled from source (and the result was
+    // added to the cache).
+    MISS,
+    // Cached data was found and consumed.
+    HIT,
+    // Cached data was found but V8 rejected it (e.g. V8 version or flags mismatch), so the module
+    // was compiled from source instead.
+    REJECTED,
+  };
+
+  // Called after compiling an ES module for which a compile cache is in use, i.e. always for
+  // built-in modules, and for bundle modules when a compile cache directory is configured.
+  // It is guaranteed that isolate lock is held during the invocation.
+  virtual void onCompileCacheResult(v8::Isolate* isolate, kj::StringPtr name, Option option,
+                                    CompileCacheResult result) const {}
+
   // Called at the start of wasm compilation.
   // Returned value will be destroyed when module compilation finishes.
   // It is guaranteed that isolate lock is held during both invocations.
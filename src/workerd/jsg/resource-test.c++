@@ -648,6 +648,26 @@ KJ_TEST("bundle installed works") {
   )", "string", "THIS_IS_BUILTIN_FUNCTION");
 }
 
+KJ_TEST("builtin modules hit the in-memory compile cache") {
+  Evaluator<JsBundleContext, JsBundleIsolate> e(v8System);
+  auto code = R"(
+    import * as b from "test:resource-test-builtin";
+    export function run() { return b.builtinFunction(); }
+  )"_kj;
+
+  // Other tests may have compiled the builtin already, so the first evaluation is either a miss
+  // or a hit. Each evaluation uses a new context, so the second one must be a hit.
+  auto before = getModuleCompileCacheStats();
+  e.expectEvalModule(code, "string", "THIS_IS_BUILTIN_FUNCTION");
+  auto afterFirst = getModuleCompileCacheStats();
+  KJ_EXPECT(afterFirst.hits + afterFirst.misses == before.hits + before.misses + 1);
+
+  e.expectEvalModule(code, "string", "THIS_IS_BUILTIN_FUNCTION");
+  auto afterSecond = getModuleCompileCacheStats();
+  KJ_EXPECT(afterSecond.hits == afterFirst.hits + 1);
+  KJ_EXPECT(afterSecond.misses == afterFirst.misses);
+}
+
 // ========================================================================================
 
 struct JsLazyReadonlyPropertyContext: public ContextGlobalObject {
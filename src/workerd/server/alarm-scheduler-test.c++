@@ -0,0 +1,311 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "alarm-scheduler.h"
+#include <kj/filesystem.h>
+#include <kj/map.h>
+#include <kj/test.h>
+#include <kj/vector.h>
+
+namespace workerd::server {
+namespace {
+
+constexpr kj::StringPtr NAMESPACE = "test"_kj;
+
+class FakeClock final: public kj::Clock {
+public:
+  kj::Date now() const override { return time; }
+
+  kj::Date time = kj::UNIX_EPOCH + 1'700'000'000ll * kj::SECONDS;
+};
+
+struct FiredAlarm {
+  kj::String actorId;
+  kj::Date scheduledTime;
+};
+
+// Records each alarm it runs. Alarms of actors listed in `failing` report a retryable error.
+class RecordingWorker final: public WorkerInterface {
+public:
+  RecordingWorker(kj::String actorId, kj::Vector<FiredAlarm>& fired,
+                  kj::HashMap<kj::String, uint>& failing)
+      : actorId(kj::mv(actorId)), fired(fired), failing(failing) {}
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, Response& response) override {
+    KJ_UNIMPLEMENTED("only alarms are supported");
+  }
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+      kj::AsyncIoStream& connection, ConnectResponse& response,
+      kj::HttpConnectSettings settings) override {
+    KJ_UNIMPLEMENTED("only alarms are supported");
+  }
+  void prewarm(kj::StringPtr url) override {}
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    KJ_UNIMPLEMENTED("only alarms are supported");
+  }
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+    fired.add(FiredAlarm { kj::str(actorId), scheduledTime });
+
+    KJ_IF_SOME(remaining, failing.find(actorId)) {
+      if (remaining > 0) {
+        --remaining;
+        return AlarmResult {
+          .retry = true, .retryCountsAgainstLimit = true, .outcome = EventOutcome::EXCEPTION };
+      }
+    }
+    return AlarmResult { .retry = false, .outcome = EventOutcome::OK };
+  }
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    KJ_UNIMPLEMENTED("only alarms are supported");
+  }
+
+private:
+  kj::String actorId;
+  kj::Vector<FiredAlarm>& fired;
+  kj::HashMap<kj::String, uint>& failing;
+};
+
+struct AlarmTester {
+  kj::Own<const kj::Directory> dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs { *dir };
+  kj::EventLoop loop;
+  kj::WaitScope ws { loop };
+  FakeClock clock;
+  kj::TimerImpl timer { kj::origin<kj::TimePoint>() };
+  kj::Vector<FiredAlarm> fired;
+
+  // Number of times each actor's alarm should fail before succeeding.
+  kj::HashMap<kj::String, uint> failing;
+
+  kj::Own<AlarmScheduler> scheduler = makeScheduler();
+
+  kj::Own<AlarmScheduler> makeScheduler() {
+    auto result = kj::heap<AlarmScheduler>(clock, timer, vfs, kj::Path({"alarms.sqlite"}));
+    result->registerNamespace(NAMESPACE, [this](kj::String id) -> kj::Own<WorkerInterface> {
+      return kj::heap<RecordingWorker>(kj::mv(id), fired, failing);
+    });
+    return result;
+  }
+
+  ActorKey actor(kj::StringPtr id) {
+    return { .uniqueKey = NAMESPACE, .actorId = id };
+  }
+
+  kj::Date in(kj::Duration delay) {
+    return clock.time + delay;
+  }
+
+  // Moves time forward in small steps, letting the scheduler run whatever comes due.
+  void advance(kj::Duration delay) {
+    auto end = clock.time + delay;
+    while (clock.time < end) {
+      auto step = kj::min(100 * kj::MILLISECONDS, end - clock.time);
+      clock.time += step;
+      timer.advanceTo(timer.now() + step);
+      ws.poll();
+    }
+  }
+
+  kj::String firedIds() {
+    return kj::strArray(KJ_MAP(f, fired) { return kj::str(f.actorId); }, ",");
+  }
+};
+
+KJ_TEST("AlarmScheduler runs alarms in order of scheduled time") {
+  AlarmTester t;
+
+  auto timeA = t.in(3 * kj::SECONDS);
+  t.scheduler->setAlarm(t.actor("a"), timeA);
+  t.scheduler->setAlarm(t.actor("b"), t.in(1 * kj::SECONDS));
+  t.scheduler->setAlarm(t.actor("c"), t.in(2 * kj::SECONDS));
+  KJ_EXPECT(KJ_ASSERT_NONNULL(t.scheduler->getAlarm(t.actor("a"))) == timeA);
+
+  t.advance(500 * kj::MILLISECONDS);
+  KJ_EXPECT(t.fired.size() == 0);
+
+  t.advance(5 * kj::SECONDS);
+  KJ_EXPECT(t.firedIds() == "b,c,a", t.firedIds());
+  KJ_EXPECT(t.fired[2].scheduledTime == timeA);
+
+  // Alarms that succeed are deleted.
+  KJ_EXPECT(t.scheduler->getAlarm(t.actor("a")) == kj::none);
+  KJ_EXPECT(t.scheduler->inMemoryCount() == 0);
+}
+
+KJ_TEST("AlarmScheduler reschedules alarms") {
+  AlarmTester t;
+
+  // Moving an alarm earlier.
+  auto earlier = t.in(2 * kj::SECONDS);
+  t.scheduler->setAlarm(t.actor("a"), t.in(10 * kj::SECONDS));
+  t.scheduler->setAlarm(t.actor("a"), earlier);
+
+  // Moving an alarm later, including out of the window kept in memory.
+  auto later = t.in(AlarmScheduler::LOAD_WINDOW + 1 * kj::HOURS);
+  t.scheduler->setAlarm(t.actor("b"), t.in(1 * kj::SECONDS));
+  t.scheduler->setAlarm(t.actor("b"), later);
+  KJ_EXPECT(t.scheduler->inMemoryCount() == 1);
+
+  t.advance(3 * kj::SECONDS);
+  KJ_EXPECT(t.firedIds() == "a", t.firedIds());
+  KJ_EXPECT(t.fired[0].scheduledTime == earlier);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(t.scheduler->getAlarm(t.actor("b"))) == later);
+}
+
+KJ_TEST("AlarmScheduler deletes alarms") {
+  AlarmTester t;
+
+  t.scheduler->setAlarm(t.actor("a"), t.in(1 * kj::SECONDS));
+  t.scheduler->setAlarm(t.actor("b"), t.in(AlarmScheduler::LOAD_WINDOW + 1 * kj::HOURS));
+
+  KJ_EXPECT(t.scheduler->deleteAlarm(t.actor("a")));
+  KJ_EXPECT(t.scheduler->deleteAlarm(t.actor("b")));
+  KJ_EXPECT(!t.scheduler->deleteAlarm(t.actor("a")));
+  KJ_EXPECT(!t.scheduler->deleteAlarm(t.actor("c")));
+
+  KJ_EXPECT(t.scheduler->getAlarm(t.actor("a")) == kj::none);
+  KJ_EXPECT(t.scheduler->getAlarm(t.actor("b")) == kj::none);
+  KJ_EXPECT(t.scheduler->inMemoryCount() == 0);
+
+  t.advance(2 * kj::SECONDS);
+  KJ_EXPECT(t.fired.size() == 0);
+
+  // Deleted alarms don't come back when the database is reloaded.
+  t.scheduler = t.makeScheduler();
+  KJ_EXPECT(t.scheduler->getAlarm(t.actor("b")) == kj::none);
+}
+
+KJ_TEST("AlarmScheduler retries failed alarms") {
+  AlarmTester t;
+
+  auto time = t.in(1 * kj::SECONDS);
+  t.failing.insert(kj::str("a"), 2);
+  t.scheduler->setAlarm(t.actor("a"), time);
+
+  t.advance(1 * kj::SECONDS);
+  KJ_EXPECT(t.fired.size() == 1);
+
+  // A failed alarm is still set until it succeeds.
+  KJ_EXPECT(KJ_ASSERT_NONNULL(t.scheduler->getAlarm(t.actor("a"))) == time);
+
+  // The first retry comes after RETRY_START_SECONDS plus up to 25% jitter, and the second after
+  // twice that.
+  auto firstRetry = AlarmScheduler::RETRY_START_SECONDS * kj::SECONDS;
+  t.advance(firstRetry * 5 / 4 + 100 * kj::MILLISECONDS);
+  KJ_EXPECT(t.fired.size() == 2);
+  t.advance(firstRetry * 2 * 5 / 4 + 100 * kj::MILLISECONDS);
+  KJ_EXPECT(t.fired.size() == 3);
+
+  // Every attempt is for the originally scheduled time, and success deletes the alarm.
+  for (auto& f: t.fired) {
+    KJ_EXPECT(f.scheduledTime == time);
+  }
+  KJ_EXPECT(t.scheduler->getAlarm(t.actor("a")) == kj::none);
+
+  // An alarm that keeps failing is given up on after RETRY_MAX_TRIES retries.
+  t.fired.clear();
+  t.failing.insert(kj::str("b"), kj::maxValue);
+  t.scheduler->setAlarm(t.actor("b"), t.in(1 * kj::SECONDS));
+  t.advance(10 * kj::MINUTES);
+  KJ_EXPECT(t.fired.size() == AlarmScheduler::RETRY_MAX_TRIES + 1, t.fired.size());
+  KJ_EXPECT(t.scheduler->getAlarm(t.actor("b")) == kj::none);
+}
+
+KJ_TEST("AlarmScheduler deleting an alarm cancels its retries") {
+  AlarmTester t;
+
+  t.failing.insert(kj::str("a"), kj::maxValue);
+  t.scheduler->setAlarm(t.actor("a"), t.in(1 * kj::SECONDS));
+  t.advance(1 * kj::SECONDS);
+  KJ_EXPECT(t.fired.size() == 1);
+
+  KJ_EXPECT(t.scheduler->deleteAlarm(t.actor("a")));
+  t.advance(1 * kj::MINUTES);
+  KJ_EXPECT(t.fired.size() == 1);
+}
+
+KJ_TEST("AlarmScheduler keeps alarms awaiting retry in memory when evicting") {
+  AlarmTester t;
+
+  // Get an alarm into the retry state. Its retry is later than any of the alarms set below, so
+  // it's the latest alarm in memory.
+  t.failing.insert(kj::str("retry"), 1);
+  t.scheduler->setAlarm(t.actor("retry"), t.in(1 * kj::SECONDS));
+  t.advance(1 * kj::SECONDS);
+  KJ_EXPECT(t.fired.size() == 1);
+
+  // Fill memory past the limit. The latest waiting alarms are dropped from memory rather than the
+  // one awaiting retry.
+  auto ids = KJ_MAP(i, kj::zeroTo(AlarmScheduler::MAX_ALARMS_IN_MEMORY)) {
+    return kj::str("actor", i);
+  };
+  for (auto i: kj::indices(ids)) {
+    t.scheduler->setAlarm(t.actor(ids[i]),
+        t.in(1 * kj::SECONDS + static_cast<int64_t>(i) * kj::MICROSECONDS));
+  }
+  KJ_EXPECT(t.scheduler->inMemoryCount() == AlarmScheduler::MAX_ALARMS_IN_MEMORY,
+            t.scheduler->inMemoryCount());
+
+  // Evicted alarms are still set, and everything runs once the window catches up.
+  KJ_EXPECT(t.scheduler->getAlarm(t.actor(ids.back())) != kj::none);
+  t.advance(10 * kj::SECONDS);
+  KJ_EXPECT(t.fired.size() == ids.size() + 2, t.fired.size());
+  KJ_EXPECT(t.scheduler->inMemoryCount() == 0);
+}
+
+KJ_TEST("AlarmScheduler pages in alarms that share a scheduled time") {
+  AlarmTester t;
+
+  // More alarms than fit in one page, all due at the same moment.
+  auto time = t.in(1 * kj::MINUTES);
+  auto count = AlarmScheduler::LOAD_PAGE_SIZE + 10;
+  for (auto i: kj::zeroTo(count)) {
+    t.scheduler->setAlarm(t.actor(kj::str("actor", i)), time);
+  }
+
+  // On restart only the first page is loaded, even though it ends partway through the group.
+  t.scheduler = nullptr;
+  t.scheduler = t.makeScheduler();
+  KJ_EXPECT(t.scheduler->inMemoryCount() == AlarmScheduler::LOAD_PAGE_SIZE,
+            t.scheduler->inMemoryCount());
+  KJ_EXPECT(KJ_ASSERT_NONNULL(t.scheduler->getAlarm(t.actor(kj::str("actor", count - 1)))) ==
+            time);
+
+  // The rest of the group is paged in when it comes due, and every alarm runs exactly once.
+  t.advance(2 * kj::MINUTES);
+  KJ_EXPECT(t.fired.size() == count, t.fired.size());
+  kj::HashSet<kj::String> ids;
+  for (auto& f: t.fired) {
+    KJ_EXPECT(!ids.contains(f.actorId), f.actorId);
+    ids.upsert(kj::str(f.actorId), [](auto&, auto&&) {});
+  }
+  KJ_EXPECT(t.scheduler->inMemoryCount() == 0);
+}
+
+KJ_TEST("AlarmScheduler loads alarms from the database") {
+  AlarmTester t;
+
+  auto later = t.in(AlarmScheduler::LOAD_WINDOW + 1 * kj::MINUTES);
+  t.scheduler->setAlarm(t.actor("b"), t.in(2 * kj::SECONDS));
+  t.scheduler->setAlarm(t.actor("a"), t.in(1 * kj::SECONDS));
+  t.scheduler->setAlarm(t.actor("later"), later);
+
+  // Restart after "a" and "b" should have run, as if the process had been down. They're caught
+  // up on in order.
+  t.scheduler = nullptr;
+  t.clock.time += 3 * kj::SECONDS;
+  t.scheduler = t.makeScheduler();
+
+  t.advance(1 * kj::SECONDS);
+  KJ_EXPECT(t.firedIds() == "a,b", t.firedIds());
+
+  t.advance(AlarmScheduler::LOAD_WINDOW + 1 * kj::MINUTES);
+  KJ_EXPECT(t.firedIds() == "a,b,later", t.firedIds());
+  KJ_EXPECT(t.fired[2].scheduledTime == later);
+}
+
+}  // namespace
+}  // namespace workerd::server
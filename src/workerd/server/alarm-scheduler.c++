@@ -4,6 +4,8 @@
 
 #include "alarm-scheduler.h"
 
+#include <kj/vector.h>
+
 namespace workerd::server {
 
 int AlarmScheduler::maxJitterMsForDelay(kj::Duration delay) {
@@ -22,6 +24,14 @@ std::default_random_engine makeSeededRandomEngine() {
   return engine;
 }
 
+int64_t toNs(kj::Date date) {
+  return (date - kj::UNIX_EPOCH) / kj::NANOSECONDS;
+}
+
+kj::Date fromNs(int64_t ns) {
+  return kj::UNIX_EPOCH + ns * kj::NANOSECONDS;
+}
+
 } // namespace
 
 AlarmScheduler::AlarmScheduler(
@@ -36,8 +46,18 @@ AlarmScheduler::AlarmScheduler(
         ensureInitialized(*db);
         return kj::mv(db);
       }()),
-      tasks(*this) {
-    loadAlarmsFromDb();
+      tasks(*this),
+      timerLoop(nullptr) {
+    // Anything scheduled before now is overdue. Load the alarms that are due soon first, and leave
+    // the overdue ones for the timer loop to catch up on gradually.
+    auto now = clock.now();
+    loadedUntil = LoadPosition { toNs(now) };
+    catchUpUntilNs = toNs(now);
+    nextCatchUp = now;
+    loadAlarmsFromDb(now);
+    timerLoop = runTimerLoop().eagerlyEvaluate([](kj::Exception&& e) {
+      KJ_LOG(ERROR, "alarm scheduler timer loop failed; no further alarms will run", e);
+    });
   }
 
 void AlarmScheduler::ensureInitialized(SqliteDatabase& db) {
@@ -52,28 +72,73 @@ void AlarmScheduler::ensureInitialized(SqliteDatabase& db) {
       PRIMARY KEY (actor_unique_key, actor_id)
     ) WITHOUT ROWID;
   )");
+
+  db.run(R"(
+    CREATE INDEX IF NOT EXISTS _cf_ALARM_scheduled_time
+      ON _cf_ALARM (scheduled_time, actor_unique_key, actor_id);
+  )");
 }
 
-void AlarmScheduler::loadAlarmsFromDb() {
-  auto now = clock.now();
+bool AlarmScheduler::LoadPosition::isAfter(int64_t ns, const ActorKey& key) const {
+  if (ns != timeNs) return ns < timeNs;
+  KJ_IF_SOME(a, actor) {
+    return key < *a;
+  }
+  return false;
+}
 
-  // TODO(someday): don't maintain the entire alarm set in memory -- right now for the usecase of
-  // local development, doing so is sufficent.
-  auto query = db->run(R"(
-    SELECT actor_unique_key, actor_id, scheduled_time FROM _cf_ALARM;
-  )");
+void AlarmScheduler::loadAlarmsFromDb(kj::Date now) {
+  int64_t horizonNs = toNs(now + LOAD_WINDOW);
+  if (horizonNs <= loadedUntil.timeNs) return;
 
-  while (!query.isDone()) {
-    auto date = kj::UNIX_EPOCH + (kj::NANOSECONDS * query.getInt64(2));
+  loadPage(loadedUntil, horizonNs, LOAD_PAGE_SIZE);
+}
 
-    auto ownUniqueKey = kj::str(query.getText(0));
-    auto ownActorId = kj::str(query.getText(1));
-    auto actor = kj::attachVal(ActorKey { .uniqueKey = ownUniqueKey, .actorId = ownActorId },
-        kj::mv(ownUniqueKey), kj::mv(ownActorId));
+void AlarmScheduler::loadOverdueAlarms(kj::Date now) {
+  loadPage(catchUpFrom, catchUpUntilNs, CATCH_UP_BATCH_SIZE);
+  nextCatchUp = now + CATCH_UP_INTERVAL;
+}
 
-    alarms.insert(*actor, scheduleAlarm(now, kj::mv(actor), date));
+void AlarmScheduler::loadPage(LoadPosition& from, int64_t endNs, size_t limit) {
+  size_t count = 0;
+  int64_t lastNs = from.timeNs;
+  kj::Maybe<kj::Own<ActorKey>> lastActor;
+  auto addRows = [&](SqliteDatabase::Query& query) {
+    while (!query.isDone()) {
+      lastNs = query.getInt64(2);
+      ActorKey actor { .uniqueKey = query.getText(0), .actorId = query.getText(1) };
+      if (!ignoreUnregistered || namespaces.find(actor.uniqueKey) != kj::none) {
+        addAlarmInMemory(actor, fromNs(lastNs));
+      }
+      if (++count == limit) {
+        lastActor = actor.clone();
+      }
+      query.nextRow();
+    }
+  };
+
+  KJ_IF_SOME(actor, from.actor) {
+    auto query = stmtLoadPageFromActor.run(from.timeNs, actor->uniqueKey, actor->actorId, endNs,
+                                           static_cast<int64_t>(limit));
+    addRows(query);
+  } else {
+    auto query = stmtLoadPage.run(from.timeNs, endNs, static_cast<int64_t>(limit));
+    addRows(query);
+  }
 
-    query.nextRow();
+  if (count < limit) {
+    from = LoadPosition { endNs };
+  } else {
+    // The page filled up before reaching `endNs`, possibly in the middle of a group of alarms
+    // sharing a scheduled time. The next page starts at the last alarm loaded, which is read
+    // again but is already in memory.
+    from = LoadPosition { lastNs, kj::mv(lastActor) };
+  }
+}
+
+void AlarmScheduler::unloadFrom(int64_t ns, const ActorKey& actor) {
+  if (loadedUntil.isAfter(ns, actor)) {
+    loadedUntil = LoadPosition { ns, actor.clone() };
   }
 }
 
@@ -83,6 +148,37 @@ void AlarmScheduler::registerNamespace(kj::StringPtr uniqueKey, GetActorFn getAc
   });
 }
 
+void AlarmScheduler::ignoreUnregisteredAlarms() {
+  ignoreUnregistered = true;
+
+  {
+    auto query = stmtCountByNamespace.run();
+    while (!query.isDone()) {
+      auto uniqueKey = query.getText(0);
+      if (namespaces.find(uniqueKey) == kj::none) {
+        KJ_LOG(WARNING, "not running alarms of a Durable Object namespace that is no longer "
+               "configured", uniqueKey, query.getInt64(1));
+      }
+      query.nextRow();
+    }
+  }
+
+  // Drop any of them that were already loaded. None should be running yet, as the timer loop
+  // hasn't had a chance to start them, but running alarms can't be removed regardless.
+  kj::Vector<const ActorKey*> staleAlarms;
+  for (auto& entry: alarms) {
+    if (entry.value.status != AlarmStatus::STARTED &&
+        namespaces.find(entry.key.uniqueKey) == kj::none) {
+      staleAlarms.add(entry.value.actor.get());
+    }
+  }
+  for (auto actor: staleAlarms) {
+    auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(*actor));
+    dequeue(entry.value);
+    alarms.erase(entry);
+  }
+}
+
 kj::Maybe<kj::Date> AlarmScheduler::getAlarm(ActorKey actor) {
   KJ_IF_SOME(alarm, alarms.find(actor)) {
     if (alarm.status == AlarmStatus::STARTED) {
@@ -92,37 +188,30 @@ kj::Maybe<kj::Date> AlarmScheduler::getAlarm(ActorKey actor) {
     } else {
       return alarm.scheduledTime;
     }
-  } else {
-    // We currently retain the entire set of queued alarms in memory, no need to hit sqlite
+  }
+
+  // Not in memory, but it may be scheduled beyond the loaded window.
+  auto query = stmtGetAlarm.run(actor.uniqueKey, actor.actorId);
+  if (query.isDone()) {
     return kj::none;
   }
+  return fromNs(query.getInt64(0));
 }
 
 bool AlarmScheduler::setAlarm(ActorKey actor, kj::Date scheduledTime) {
-  int64_t scheduledTimeNs = (scheduledTime - kj::UNIX_EPOCH) / kj::NANOSECONDS;
-  auto query = stmtSetAlarm.run(actor.uniqueKey, actor.actorId, scheduledTimeNs);
+  auto query = stmtSetAlarm.run(actor.uniqueKey, actor.actorId, toNs(scheduledTime));
 
-  bool existing = true;
-  auto& entry = alarms.findOrCreate(actor, [&]() {
-    existing = false;
-
-    auto ownUniqueKey = kj::str(actor.uniqueKey);
-    auto ownActorId = kj::str(actor.actorId);
-    auto ownActor = kj::attachVal(ActorKey { .uniqueKey = ownUniqueKey, .actorId = ownActorId },
-    kj::mv(ownUniqueKey), kj::mv(ownActorId));
-
-    return decltype(alarms)::Entry {
-        *ownActor, scheduleAlarm(clock.now(), kj::mv(ownActor), scheduledTime) };
-  });
-
-  if (existing) {
-    if (entry.status != AlarmStatus::WAITING) {
+  KJ_IF_SOME(entry, alarms.findEntry(actor)) {
+    if (entry.value.status != AlarmStatus::WAITING) {
       // We queue any new alarm after the existing alarm even if the new alarm has the same scheduled
       // time, as receiving a notification directly maps to a write for that time in the actor.
-      entry.queuedAlarm = scheduledTime;
+      entry.value.queuedAlarm = scheduledTime;
     } else {
-      entry = scheduleAlarm(clock.now(), kj::mv(entry.actor), scheduledTime);
+      resetAlarm(entry, scheduledTime, true);
     }
+  } else if (loadedUntil.isAfter(toNs(scheduledTime), actor)) {
+    addAlarmInMemory(actor, scheduledTime);
+    evictLatestAlarms();
   }
 
   return query.changeCount() > 0;
@@ -130,6 +219,7 @@ bool AlarmScheduler::setAlarm(ActorKey actor, kj::Date scheduledTime) {
 
 bool AlarmScheduler::deleteAlarm(ActorKey actor) {
   auto query = stmtDeleteAlarm.run(actor.uniqueKey, actor.actorId);
+  bool deleted = query.changeCount() > 0;
 
   KJ_IF_SOME(entry, alarms.findEntry(actor)) {
     KJ_IF_SOME(queued, entry.value.queuedAlarm) {
@@ -137,17 +227,157 @@ bool AlarmScheduler::deleteAlarm(ActorKey actor) {
         // If we are currently running an alarm, we want to delete the queued instead of current.
         entry.value.queuedAlarm = kj::none;
       } else {
-        entry.value = scheduleAlarm(clock.now(), kj::mv(entry.value.actor), queued);
+        // The queued alarm takes over from the current one. Its row was just deleted along with
+        // the current alarm, so write it back; every waiting alarm must be in the database so
+        // that it can be dropped from memory.
+        stmtSetAlarm.run(actor.uniqueKey, actor.actorId, toNs(queued));
+        resetAlarm(entry, queued, false);
       }
     } else {
       if (entry.value.status != AlarmStatus::STARTED) {
         // We can't remove running alarms.
+        dequeue(entry.value);
         alarms.erase(entry);
       }
     }
   }
 
-  return query.changeCount() > 0;
+  return deleted;
+}
+
+void AlarmScheduler::addAlarmInMemory(ActorKey actor, kj::Date scheduledTime) {
+  bool created = false;
+  auto& alarm = alarms.findOrCreate(actor, [&]() {
+    created = true;
+
+    auto ownActor = actor.clone();
+    auto& actorRef = *ownActor;
+    return decltype(alarms)::Entry {
+        actorRef, ScheduledAlarm { kj::mv(ownActor), scheduledTime } };
+  });
+
+  // If the alarm was already in memory, it is at least as up-to-date as the database.
+  if (created) {
+    enqueue(alarm, scheduledTime);
+  }
+}
+
+void AlarmScheduler::resetAlarm(kj::HashMap<ActorKey, ScheduledAlarm>::Entry& entry,
+                                kj::Date scheduledTime, bool dropIfOutsideWindow) {
+  KJ_REQUIRE(entry.value.status != AlarmStatus::STARTED);
+  dequeue(entry.value);
+
+  if (dropIfOutsideWindow && !loadedUntil.isAfter(toNs(scheduledTime), *entry.value.actor)) {
+    // It will be paged back in from the database when the window catches up.
+    alarms.erase(entry);
+    return;
+  }
+
+  // Creating a new alarm resets `status` to WAITING, `queuedAlarm` to null, and the retry counters.
+  entry.value = ScheduledAlarm { kj::mv(entry.value.actor), scheduledTime };
+  enqueue(entry.value, scheduledTime);
+}
+
+void AlarmScheduler::enqueue(ScheduledAlarm& alarm, kj::Date fireTime) {
+  alarm.fireTime = fireTime;
+  queue.insert(QueueKey { fireTime, alarm.actor.get() });
+
+  KJ_IF_SOME(wake, nextWake) {
+    if (fireTime < wake) {
+      // The timer loop is sleeping past this alarm's time, so wake it up to recompute.
+      KJ_ASSERT_NONNULL(wakeFulfiller)->fulfill();
+      nextWake = kj::none;
+    }
+  }
+}
+
+void AlarmScheduler::dequeue(ScheduledAlarm& alarm) {
+  // STARTED alarms are not in the queue, in which case this does nothing.
+  queue.eraseMatch(QueueKey { alarm.fireTime, alarm.actor.get() });
+}
+
+void AlarmScheduler::evictLatestAlarms() {
+  if (alarms.size() <= MAX_ALARMS_IN_MEMORY) return;
+  size_t excess = alarms.size() - MAX_ALARMS_IN_MEMORY;
+
+  // Walk back from the latest alarm, picking the ones to drop.
+  kj::Vector<QueueKey> evicted;
+  auto ordered = queue.ordered();
+  for (auto iter = ordered.end(); iter != ordered.begin() && evicted.size() < excess;) {
+    --iter;
+
+    // Overdue alarms are about to run anyway, and evicting them would pull the window back over
+    // alarms that are being caught up on. Everything before this one is overdue too.
+    if (toNs(iter->fireTime) < catchUpUntilNs) break;
+
+    // Only WAITING alarms are guaranteed to match what's in the database. Alarms awaiting a retry
+    // have to stay in memory, but earlier alarms can still be dropped.
+    auto& alarm = KJ_ASSERT_NONNULL(alarms.find(*iter->actor));
+    if (alarm.status != AlarmStatus::WAITING) continue;
+
+    evicted.add(*iter);
+  }
+
+  for (auto& key: evicted) {
+    unloadFrom(toNs(key.fireTime), *key.actor);
+    auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(*key.actor));
+    dequeue(entry.value);
+    alarms.erase(entry);
+  }
+}
+
+kj::Date AlarmScheduler::getNextWakeTime() {
+  auto wake = fromNs(loadedUntil.timeNs);
+  auto ordered = queue.ordered();
+  if (ordered.begin() != ordered.end()) {
+    wake = kj::min(wake, ordered.begin()->fireTime);
+  }
+  if (isCatchingUp()) {
+    wake = kj::min(wake, nextCatchUp);
+  }
+  return wake;
+}
+
+kj::Promise<void> AlarmScheduler::runTimerLoop() {
+  for (;;) {
+    auto wakeTime = getNextWakeTime();
+    auto paf = kj::newPromiseAndFulfiller<void>();
+    nextWake = wakeTime;
+    wakeFulfiller = kj::mv(paf.fulfiller);
+
+    // Since we are waiting on the timer, it's possible that timer.now() was behind the real time by
+    // a few ms, leading to premature alarm() execution. startDueAlarms() checks the clock to ensure
+    // we run alarms only on or after their scheduled time, and if none are due yet we'll simply
+    // come back around and wait a while longer.
+    co_await timer.afterDelay(kj::max(wakeTime - clock.now(), 0 * kj::SECONDS))
+        .exclusiveJoin(kj::mv(paf.promise));
+    nextWake = kj::none;
+    wakeFulfiller = kj::none;
+
+    auto now = clock.now();
+    if (toNs(now) >= loadedUntil.timeNs) {
+      loadAlarmsFromDb(now);
+    }
+    if (isCatchingUp() && now >= nextCatchUp) {
+      loadOverdueAlarms(now);
+    }
+    startDueAlarms(now);
+  }
+}
+
+void AlarmScheduler::startDueAlarms(kj::Date now) {
+  kj::Vector<const ActorKey*> due;
+  for (auto& key: queue.ordered()) {
+    if (key.fireTime > now) break;
+    due.add(key.actor);
+  }
+
+  for (auto actor: due) {
+    auto& alarm = KJ_ASSERT_NONNULL(alarms.find(*actor));
+    dequeue(alarm);
+    alarm.status = AlarmStatus::STARTED;
+    tasks.add(runAlarmTask(*alarm.actor, alarm.scheduledTime));
+  }
 }
 
 kj::Promise<AlarmScheduler::RetryInfo> AlarmScheduler::runAlarm(
@@ -164,37 +394,7 @@ kj::Promise<AlarmScheduler::RetryInfo> AlarmScheduler::runAlarm(
   }
 }
 
-AlarmScheduler::ScheduledAlarm AlarmScheduler::scheduleAlarm(
-    kj::Date now, kj::Own<ActorKey> actor, kj::Date scheduledTime) {
-  auto task = makeAlarmTask(scheduledTime - now, *actor, scheduledTime);
-
-  return ScheduledAlarm { kj::mv(actor), scheduledTime, kj::mv(task) };
-}
-
-kj::Promise<void> AlarmScheduler::checkTimestamp(kj::Duration delay, kj::Date scheduledTime) {
-  co_await timer.afterDelay(delay);
-
-  // Since we are waiting on timer.afterDelay, it's possible that timer.now() was behind
-  // the real time by a few ms, leading to premature alarm() execution. This checks it the current
-  // time is >= than scheduledTime to ensure we run alarms only on or after their scheduled time.
-  auto now = clock.now();
-  if (now < scheduledTime) {
-    // If it's not yet time to trigger the alarm, we shall wait a while longer until we can
-    // trigger it. This repeats until it's time for the alarm to run.
-    co_await checkTimestamp(scheduledTime - now, scheduledTime);
-  }
-}
-
-kj::Promise<void> AlarmScheduler::makeAlarmTask(kj::Duration delay,
-                                                const ActorKey& actorRef,
-                                                kj::Date scheduledTime) {
-  co_await checkTimestamp(delay, scheduledTime);
-
-  {
-    auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(actorRef));
-    entry.value.status = AlarmStatus::STARTED;
-  }
-
+kj::Promise<void> AlarmScheduler::runAlarmTask(const ActorKey& actorRef, kj::Date scheduledTime) {
   auto retryInfo = co_await ([&]() -> kj::Promise<RetryInfo> {
     try {
       co_return co_await runAlarm(actorRef, scheduledTime);
@@ -216,27 +416,25 @@ kj::Promise<void> AlarmScheduler::makeAlarmTask(kj::Duration delay,
   try {
     auto& entry = KJ_ASSERT_NONNULL(alarms.findEntry(actorRef));
 
-    // We can't overwrite our entry before moving ourselves out of it, as a promise cannot
-    // delete itself.
-    tasks.add(kj::mv(entry.value.task));
-
     // If an alarm is queued, there's no point in retrying the current one -- proceed
     // to running the queued alarm instead.
     KJ_IF_SOME(a, entry.value.queuedAlarm) {
-      // creating a new alarm and overwriting the old one will reset
-      // `status` to WAITING and `queuedAlarm` to null
-      entry.value = scheduleAlarm(clock.now(), kj::mv(entry.value.actor), a);
+      // Resetting the alarm will set `status` to WAITING and `queuedAlarm` to null. The queued
+      // alarm was written to the database by setAlarm(), so it's fine to drop it from memory if
+      // it's beyond the loaded window.
+      entry.value.status = AlarmStatus::FINISHED;
+      resetAlarm(entry, a, true);
       co_return;
     }
 
     // When we reach this block of code and alarm has either successed or failed and may (or may
     // not) retry. Setting the status of an alarm as FINISHED here, will allow deletion of alarms
-    // between retries. If there's a retry, `makeAlarmTask` is called, setting status as RUNNING
-    // again.
+    // between retries. If there's a retry, the alarm is queued again and its status will be set
+    // to STARTED when it fires.
     entry.value.status = AlarmStatus::FINISHED;
 
     if (retryInfo.retry) {
-      // recreate the task, running after a delay determined using the retry factor
+      // requeue the alarm, running after a delay determined using the retry factor
       if (entry.value.countedRetry >= AlarmScheduler::RETRY_MAX_TRIES) {
         deleteAlarm(*entry.value.actor);
         co_return;
@@ -265,7 +463,7 @@ kj::Promise<void> AlarmScheduler::makeAlarmTask(kj::Duration delay,
       entry.value.backoff++;
       entry.value.retry++;
 
-      entry.value.task = makeAlarmTask(delay, actorRef, scheduledTime);
+      enqueue(entry.value, clock.now() + delay);
     } else {
       KJ_ASSERT(entry.value.queuedAlarm == kj::none);
       deleteAlarm(actorRef);
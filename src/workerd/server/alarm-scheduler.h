@@ -27,6 +27,10 @@ struct ActorKey {
   bool operator==(const ActorKey& other) const {
     return uniqueKey == other.uniqueKey && actorId == other.actorId;
   }
+  bool operator<(const ActorKey& other) const {
+    if (uniqueKey != other.uniqueKey) return uniqueKey < other.uniqueKey;
+    return actorId < other.actorId;
+  }
 
   kj::Own<ActorKey> clone() const {
     auto ownUniqueKey = kj::str(uniqueKey);
@@ -42,6 +46,11 @@ inline uint KJ_HASHCODE(const ActorKey& k) { return kj::hashCode(k.uniqueKey, k.
 
 // Allows scheduling alarm executions at specific times, returning a promise representing
 // the completion of the alarm event.
+//
+// Alarms are stored in SQLite. Only alarms scheduled within a near-horizon window (plus any that
+// are currently running or awaiting retry) are kept in memory, ordered by the time they should
+// next fire, and a single timer wakes the scheduler for the earliest of them. Later alarms are
+// paged in from the database as the window advances.
 class AlarmScheduler final : kj::TaskSet::ErrorHandler {
 public:
   static constexpr auto RETRY_START_SECONDS = WorkerInterface::ALARM_RETRY_START_SECONDS;
@@ -58,6 +67,25 @@ public:
   // some common dependency between a set of failed alarms
   static constexpr auto RETRY_JITTER_FACTOR = 0.25;
 
+  // How far ahead of the current time alarms are loaded into memory.
+  static constexpr kj::Duration LOAD_WINDOW = 10 * kj::MINUTES;
+
+  // Max number of alarms read from the database at once. If more than this many alarms fall
+  // within LOAD_WINDOW, the in-memory window is shortened to end at the last alarm loaded, even if
+  // that splits up alarms scheduled for the same time.
+  static constexpr size_t LOAD_PAGE_SIZE = 1024;
+
+  // When newly-set alarms push the number of alarms in memory past this limit, the latest ones
+  // are dropped from memory (they remain in the database) and the window is shortened.
+  static constexpr size_t MAX_ALARMS_IN_MEMORY = 4 * LOAD_PAGE_SIZE;
+
+  // Alarms that were already overdue when the scheduler was created (e.g. because the server was
+  // down when they were due) are loaded in batches of this size, one batch per CATCH_UP_INTERVAL,
+  // after the alarms due within LOAD_WINDOW. This way a restart with many overdue alarms doesn't
+  // wake all of their actors at once.
+  static constexpr size_t CATCH_UP_BATCH_SIZE = 128;
+  static constexpr kj::Duration CATCH_UP_INTERVAL = 1 * kj::SECONDS;
+
   using GetActorFn = kj::Function<kj::Own<WorkerInterface>(kj::String)>;
 
   AlarmScheduler(
@@ -72,6 +100,15 @@ public:
 
   void registerNamespace(kj::StringPtr uniqueKey, GetActorFn getActor);
 
+  // Stops scheduling the alarms of every namespace that hasn't been registered, e.g. because it
+  // was removed from the config since the alarms were set, and logs a warning for each. The alarms
+  // stay in the database, so they run again if the namespace is added back. Call once all
+  // namespaces have been registered.
+  void ignoreUnregisteredAlarms();
+
+  // Returns the number of alarms currently held in memory. Exposed for tests and benchmarks.
+  size_t inMemoryCount() const { return alarms.size(); }
+
 private:
   enum class AlarmStatus {WAITING, STARTED, FINISHED};
   const kj::Clock& clock;
@@ -83,12 +120,15 @@ private:
   };
   kj::HashMap<kj::StringPtr, Namespace> namespaces;
   kj::Own<SqliteDatabase> db;
-  kj::TaskSet tasks;
 
   struct ScheduledAlarm {
     kj::Own<ActorKey> actor;
     kj::Date scheduledTime;
-    kj::Promise<void> task;
+
+    // When the alarm should next run. This is `scheduledTime` for the first attempt, and is pushed
+    // back for retries. Meaningless while the alarm is STARTED.
+    kj::Date fireTime = scheduledTime;
+
     kj::Maybe<kj::Date> queuedAlarm = kj::none;
     // Once started, an alarm can have a single alarm queued behind it.
     AlarmStatus status = AlarmStatus::WAITING;
@@ -106,22 +146,109 @@ private:
     uint32_t countedRetry = 0;
   };
 
+  // Alarms held in memory. Every alarm in the database ordered before `loadedUntil` is present
+  // here, except for overdue alarms that haven't been caught up on yet (see `catchUpFrom`) and
+  // alarms of unregistered namespaces (see `ignoreUnregisteredAlarms()`); alarms ordered later
+  // may or may not be.
   kj::HashMap<ActorKey, ScheduledAlarm> alarms;
 
+  // Key of an alarm that is waiting to run (i.e. not STARTED), ordered by fire time.
+  struct QueueKey {
+    kj::Date fireTime;
+    const ActorKey* actor;
+
+    bool operator==(const QueueKey& other) const {
+      return fireTime == other.fireTime && *actor == *other.actor;
+    }
+    bool operator<(const QueueKey& other) const {
+      if (fireTime != other.fireTime) return fireTime < other.fireTime;
+      return *actor < *other.actor;
+    }
+  };
+  struct QueueCallbacks {
+    inline const QueueKey& keyForRow(const QueueKey& row) const { return row; }
+    inline bool isBefore(const QueueKey& row, const QueueKey& key) const { return row < key; }
+    inline bool matches(const QueueKey& row, const QueueKey& key) const { return row == key; }
+  };
+  kj::Table<QueueKey, kj::TreeIndex<QueueCallbacks>> queue;
+
+  // A position in the order in which alarms are paged in from the database: by scheduled time (in
+  // nanoseconds since the Unix epoch), then by actor. Alarms sharing a scheduled time may be split
+  // across pages, so the time alone can't say where a page ended.
+  struct LoadPosition {
+    int64_t timeNs;
+
+    // If null, the position is before every alarm scheduled at `timeNs`.
+    kj::Maybe<kj::Own<ActorKey>> actor;
+
+    // Whether an alarm for `key` scheduled at `ns` is ordered before this position.
+    bool isAfter(int64_t ns, const ActorKey& key) const;
+  };
+
+  // End (exclusive) of the window of alarms that has been loaded into memory.
+  LoadPosition loadedUntil { kj::minValue };
+
+  // Range [catchUpFrom, catchUpUntilNs) of alarms that were overdue when the scheduler was
+  // created and have not been loaded into memory yet. Empty once catch-up is done.
+  LoadPosition catchUpFrom { kj::minValue };
+  int64_t catchUpUntilNs = kj::minValue;
+
+  // Set by ignoreUnregisteredAlarms(), after which alarms of unregistered namespaces are left in
+  // the database when paging alarms in.
+  bool ignoreUnregistered = false;
+
+  // When the next batch of overdue alarms should be loaded.
+  kj::Date nextCatchUp = kj::UNIX_EPOCH;
+
+  // While the timer loop is asleep, the time at which it will wake up and a fulfiller to wake it
+  // early.
+  kj::Maybe<kj::Date> nextWake;
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<void>>> wakeFulfiller;
+
   struct RetryInfo {
     bool retry;
     bool retryCountsAgainstLimit;
   };
   kj::Promise<RetryInfo> runAlarm(const ActorKey& actor, kj::Date scheduledTime);
 
-  void setAlarmInMemory(kj::Own<ActorKey> actor, kj::Date scheduledTime);
+  // Inserts a new WAITING alarm into memory, unless the actor already has one.
+  void addAlarmInMemory(ActorKey actor, kj::Date scheduledTime);
+
+  // Replaces the state of a non-STARTED alarm with a fresh alarm for `scheduledTime`. If
+  // `dropIfOutsideWindow` is true and the time falls outside the loaded window, the alarm is
+  // removed from memory instead (it must already be stored in the database).
+  void resetAlarm(kj::HashMap<ActorKey, ScheduledAlarm>::Entry& entry, kj::Date scheduledTime,
+                  bool dropIfOutsideWindow);
+
+  void enqueue(ScheduledAlarm& alarm, kj::Date fireTime);
+  void dequeue(ScheduledAlarm& alarm);
+
+  // Drops the latest waiting alarms from memory while there are too many.
+  void evictLatestAlarms();
 
-  ScheduledAlarm scheduleAlarm(kj::Date now, kj::Own<ActorKey> actor, kj::Date scheduledTime);
+  // Loads the next page of alarms after `loadedUntil` and advances it.
+  void loadAlarmsFromDb(kj::Date now);
 
-  kj::Promise<void> makeAlarmTask(kj::Duration delay, const ActorKey& actor, kj::Date scheduledTime);
+  // Loads the next batch of overdue alarms and schedules the one after.
+  void loadOverdueAlarms(kj::Date now);
+  bool isCatchingUp() const { return catchUpFrom.timeNs < catchUpUntilNs; }
 
-  kj::Promise<void> checkTimestamp(kj::Duration delay, kj::Date scheduledTime);
+  // Loads up to `limit` alarms from `from` up to (not including) those scheduled at `endNs` into
+  // memory, and moves `from` past them.
+  void loadPage(LoadPosition& from, int64_t endNs, size_t limit);
 
+  // Moves the end of the loaded window back to just before the alarm for `actor` at `ns`, if it
+  // is later than that.
+  void unloadFrom(int64_t ns, const ActorKey& actor);
+
+  kj::Promise<void> runTimerLoop();
+  kj::Date getNextWakeTime();
+  void startDueAlarms(kj::Date now);
+  kj::Promise<void> runAlarmTask(const ActorKey& actor, kj::Date scheduledTime);
+
+  SqliteDatabase::Statement stmtGetAlarm = db->prepare(R"(
+    SELECT scheduled_time FROM _cf_ALARM WHERE actor_unique_key = ? AND actor_id = ?
+  )");
   SqliteDatabase::Statement stmtSetAlarm = db->prepare(R"(
     INSERT INTO _cf_ALARM VALUES(?, ?, ?)
       ON CONFLICT DO UPDATE SET scheduled_time = excluded.scheduled_time;
@@ -129,13 +256,29 @@ private:
   SqliteDatabase::Statement stmtDeleteAlarm = db->prepare(R"(
     DELETE FROM _cf_ALARM WHERE actor_unique_key = ? AND actor_id = ?
   )");
+  SqliteDatabase::Statement stmtLoadPage = db->prepare(R"(
+    SELECT actor_unique_key, actor_id, scheduled_time FROM _cf_ALARM
+      WHERE scheduled_time >= ? AND scheduled_time < ?
+      ORDER BY scheduled_time, actor_unique_key, actor_id LIMIT ?
+  )");
+  SqliteDatabase::Statement stmtLoadPageFromActor = db->prepare(R"(
+    SELECT actor_unique_key, actor_id, scheduled_time FROM _cf_ALARM
+      WHERE (scheduled_time, actor_unique_key, actor_id) >= (?, ?, ?) AND scheduled_time < ?
+      ORDER BY scheduled_time, actor_unique_key, actor_id LIMIT ?
+  )");
+  SqliteDatabase::Statement stmtCountByNamespace = db->prepare(R"(
+    SELECT actor_unique_key, COUNT(*) FROM _cf_ALARM GROUP BY actor_unique_key
+  )");
 
   void taskFailed(kj::Exception&& exception) override;
 
   int maxJitterMsForDelay(kj::Duration delay);
 
   static void ensureInitialized(SqliteDatabase& db);
-  void loadAlarmsFromDb();
+
+  // Declared last so that running alarms, which reference `alarms`, are canceled first.
+  kj::TaskSet tasks;
+  kj::Promise<void> timerLoop;
 };
 
 } // namespace workerd::server
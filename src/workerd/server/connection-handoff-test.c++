@@ -0,0 +1,203 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#if !_WIN32
+
+#include "connection-handoff.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+#include <sys/socket.h>
+
+namespace workerd::server {
+namespace {
+
+// Stands in for the primary's listening socket, handing out connections queued by the test.
+class FakeListener final: public kj::ConnectionReceiver {
+public:
+  kj::Promise<kj::Own<kj::AsyncIoStream>> accept() override {
+    KJ_REQUIRE(!streams.empty(), "no connection queued");
+    auto result = kj::mv(streams.front());
+    streams.pop_front();
+    return kj::mv(result);
+  }
+
+  uint getPort() override { return 0; }
+
+  std::deque<kj::Own<kj::AsyncIoStream>> streams;
+};
+
+kj::Promise<void> serveConnections(kj::ConnectionReceiver& receiver, kj::StringPtr reply) {
+  for (;;) {
+    auto stream = co_await receiver.accept();
+    co_await stream->write(reply.begin(), reply.size());
+  }
+}
+
+// Starts secondary thread `index`, which answers each connection handed to it with its thread
+// number until the group drains. It accepts on two loops at once, like a Server with two
+// HttpServers on the same socket would.
+void startSecondary(ThreadGroup& group, uint index, kj::MutexGuarded<uint>& ready) {
+  group.threads.add(kj::heap<kj::Thread>([&group, index, &ready]() {
+    auto io = kj::setupAsyncIo();
+    HandoffConnectionReceiver receiver(*io.lowLevelProvider, io.provider->getNetwork());
+    kj::HashMap<kj::String, HandoffConnectionReceiver*> receivers;
+    receivers.insert(kj::str("main"), &receiver);
+
+    group.registerThread(index, kj::mv(receivers));
+    KJ_DEFER(group.unregisterThread(index));
+    ++*ready.lockExclusive();
+
+    auto reply = kj::str(index + 1);
+    group.drainList.addWaiter()
+        .exclusiveJoin(serveConnections(receiver, reply))
+        .exclusiveJoin(serveConnections(receiver, reply))
+        .wait(io.waitScope);
+  }));
+}
+
+void waitUntilReady(kj::MutexGuarded<uint>& ready, uint count) {
+  ready.when([count](uint n) { return n == count; }, [](uint) {});
+}
+
+struct HandoffTester {
+  kj::AsyncIoContext io = kj::setupAsyncIo();
+  kj::Own<FakeListener> listener = kj::heap<FakeListener>();
+  kj::Vector<kj::Own<kj::AsyncIoStream>> clients;
+
+  // Queues `count` connections on the fake listener.
+  void connect(uint count) {
+    for (auto i KJ_UNUSED: kj::zeroTo(count)) {
+      auto pipe = io.provider->newTwoWayPipe();
+      listener->streams.push_back(kj::mv(pipe.ends[0]));
+      clients.add(kj::mv(pipe.ends[1]));
+    }
+  }
+
+  // Accepts `count` connections on the primary, answering each with "0".
+  void acceptOnPrimary(kj::ConnectionReceiver& receiver, uint count) {
+    for (auto i KJ_UNUSED: kj::zeroTo(count)) {
+      auto stream = receiver.accept().wait(io.waitScope);
+      stream->write("0", 1).wait(io.waitScope);
+    }
+  }
+
+  // Returns which thread answered each connection, in order.
+  kj::String replies() {
+    return kj::strArray(KJ_MAP(client, clients) {
+      return client->readAllText().wait(io.waitScope);
+    }, ",");
+  }
+};
+
+KJ_TEST("DistributingConnectionReceiver hands connections round-robin to all threads") {
+  HandoffTester t;
+  ThreadGroup group(3);
+  kj::MutexGuarded<uint> ready(0);
+  startSecondary(group, 0, ready);
+  startSecondary(group, 1, ready);
+  waitUntilReady(ready, 2);
+
+  t.connect(7);
+  auto& listener = *t.listener;
+  DistributingConnectionReceiver receiver(kj::mv(t.listener), kj::str("main"), group);
+
+  // Every third connection is the primary's own. The rest are passed on to the secondaries
+  // without being returned from accept().
+  t.acceptOnPrimary(receiver, 3);
+  KJ_EXPECT(listener.streams.empty());
+
+  auto replies = t.replies();
+  KJ_EXPECT(replies == "0,1,2,0,1,2,0", replies);
+}
+
+KJ_TEST("DistributingConnectionReceiver serves connections itself for unregistered threads") {
+  HandoffTester t;
+  ThreadGroup group(3);
+  kj::MutexGuarded<uint> ready(0);
+
+  // The second secondary thread never starts.
+  startSecondary(group, 0, ready);
+  waitUntilReady(ready, 1);
+
+  t.connect(4);
+  auto& listener = *t.listener;
+  DistributingConnectionReceiver receiver(kj::mv(t.listener), kj::str("main"), group);
+
+  t.acceptOnPrimary(receiver, 3);
+  KJ_EXPECT(listener.streams.empty());
+
+  auto replies = t.replies();
+  KJ_EXPECT(replies == "0,1,0,0", replies);
+}
+
+KJ_TEST("ThreadGroup stops handing off connections once drained") {
+  HandoffTester t;
+  ThreadGroup group(2);
+  kj::MutexGuarded<uint> ready(0);
+  startSecondary(group, 0, ready);
+  waitUntilReady(ready, 1);
+
+  // Draining stops the secondary, which unregisters before exiting. Clearing `threads` joins it.
+  group.drainList.fulfill();
+  group.threads.clear();
+
+  t.connect(2);
+  KJ_EXPECT(!group.handOff(0, "main", KJ_ASSERT_NONNULL(t.listener->streams.front()->getFd())));
+
+  auto& listener = *t.listener;
+  DistributingConnectionReceiver receiver(kj::mv(t.listener), kj::str("main"), group);
+  t.acceptOnPrimary(receiver, 2);
+  KJ_EXPECT(listener.streams.empty());
+
+  auto replies = t.replies();
+  KJ_EXPECT(replies == "0,0", replies);
+}
+
+KJ_TEST("HandoffConnectionReceiver serves multiple waiters in order") {
+  auto io = kj::setupAsyncIo();
+  HandoffConnectionReceiver receiver(*io.lowLevelProvider, io.provider->getNetwork());
+
+  // Returns the remote end of a new connection after pushing the local end to the receiver.
+  auto push = [&]() {
+    int fds[2];
+    KJ_SYSCALL(socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, fds));
+    receiver.push(kj::AutoCloseFd(fds[0]));
+    return io.lowLevelProvider->wrapSocketFd(kj::AutoCloseFd(fds[1]),
+        kj::LowLevelAsyncIoProvider::ALREADY_CLOEXEC |
+        kj::LowLevelAsyncIoProvider::ALREADY_NONBLOCK);
+  };
+
+  auto first = receiver.accept();
+  {
+    auto canceled = receiver.accept();
+  }
+  auto third = receiver.accept();
+
+  // Canceled waiters are skipped.
+  auto firstRemote = push();
+  auto thirdRemote = push();
+  KJ_ASSERT(first.poll(io.waitScope));
+  KJ_ASSERT(third.poll(io.waitScope));
+
+  firstRemote->write("a", 1).wait(io.waitScope);
+  thirdRemote->write("b", 1).wait(io.waitScope);
+  char c;
+  first.wait(io.waitScope)->read(&c, 1).wait(io.waitScope);
+  KJ_EXPECT(c == 'a');
+  third.wait(io.waitScope)->read(&c, 1).wait(io.waitScope);
+  KJ_EXPECT(c == 'b');
+
+  // Connections that arrive with no one waiting are queued.
+  auto queuedRemote = push();
+  auto queued = receiver.accept();
+  KJ_ASSERT(queued.poll(io.waitScope));
+  queuedRemote->write("c", 1).wait(io.waitScope);
+  queued.wait(io.waitScope)->read(&c, 1).wait(io.waitScope);
+  KJ_EXPECT(c == 'c');
+}
+
+}  // namespace
+}  // namespace workerd::server
+
+#endif  // !_WIN32
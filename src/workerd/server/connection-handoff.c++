@@ -0,0 +1,150 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "connection-handoff.h"
+
+#if !_WIN32
+
+#include <kj/debug.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+
+namespace workerd::server {
+
+kj::Promise<kj::Own<kj::AsyncIoStream>> HandoffConnectionReceiver::accept() {
+  auto stream = co_await acceptAuthenticated();
+  co_return kj::mv(stream.stream);
+}
+
+kj::Promise<kj::AuthenticatedStream> HandoffConnectionReceiver::acceptAuthenticated() {
+  if (!queue.empty()) {
+    auto result = kj::mv(queue.front());
+    queue.pop_front();
+    return kj::mv(result);
+  }
+
+  auto paf = kj::newPromiseAndFulfiller<kj::AuthenticatedStream>();
+  waiters.push_back(kj::mv(paf.fulfiller));
+  return kj::mv(paf.promise);
+}
+
+void HandoffConnectionReceiver::push(kj::AutoCloseFd fd) {
+  auto peer = getPeerIdentity(fd);
+  auto stream = kj::AuthenticatedStream {
+    .stream = lowLevel.wrapSocketFd(kj::mv(fd),
+        kj::LowLevelAsyncIoProvider::ALREADY_CLOEXEC |
+        kj::LowLevelAsyncIoProvider::ALREADY_NONBLOCK),
+    .peerIdentity = kj::mv(peer),
+  };
+
+  // Give the connection to the longest-waiting caller that's still waiting.
+  while (!waiters.empty()) {
+    auto waiter = kj::mv(waiters.front());
+    waiters.pop_front();
+    if (waiter->isWaiting()) {
+      waiter->fulfill(kj::mv(stream));
+      return;
+    }
+  }
+
+  queue.push_back(kj::mv(stream));
+}
+
+kj::Own<kj::PeerIdentity> HandoffConnectionReceiver::getPeerIdentity(kj::AutoCloseFd& fd) {
+  struct sockaddr_storage addr;
+  socklen_t addrLen = sizeof(addr);
+  if (getpeername(fd, reinterpret_cast<struct sockaddr*>(&addr), &addrLen) == 0 &&
+      (addr.ss_family == AF_INET || addr.ss_family == AF_INET6)) {
+    return kj::NetworkPeerIdentity::newInstance(
+        network.getSockaddr(&addr, addrLen));
+  }
+  return kj::UnknownPeerIdentity::newInstance();
+}
+
+ThreadGroup::ThreadGroup(uint threadCount)
+    : threadCount(threadCount),
+      executors(kj::heapArray<kj::Maybe<kj::Own<const kj::Executor>>>(threadCount - 1)),
+      receivers(kj::heapArray<kj::HashMap<kj::String, HandoffConnectionReceiver*>>(
+          threadCount - 1)) {}
+
+ThreadGroup::~ThreadGroup() noexcept(false) {
+  // Ask the secondary threads to shut down, then join them before the rest of our state goes
+  // away, since they access it while exiting.
+  if (!drainList.isDone()) drainList.fulfill();
+  threads.clear();
+}
+
+void ThreadGroup::registerThread(uint index,
+    kj::HashMap<kj::String, HandoffConnectionReceiver*> threadReceivers) {
+  receivers[index] = kj::mv(threadReceivers);
+  auto lock = executors.lockExclusive();
+  (*lock)[index] = kj::getCurrentThreadExecutor().addRef();
+}
+
+void ThreadGroup::unregisterThread(uint index) {
+  {
+    auto lock = executors.lockExclusive();
+    (*lock)[index] = kj::none;
+  }
+  receivers[index].clear();
+}
+
+bool ThreadGroup::handOff(uint index, kj::StringPtr socketName, int fd) {
+  kj::Own<const kj::Executor> executor;
+  {
+    auto lock = executors.lockShared();
+    KJ_IF_SOME(e, (*lock)[index]) {
+      executor = e->addRef();
+    } else {
+      return false;
+    }
+  }
+
+  int newFd;
+  KJ_SYSCALL(newFd = fcntl(fd, F_DUPFD_CLOEXEC, 0));
+  kj::AutoCloseFd ownFd(newFd);
+
+  // The receiver is looked up on the target thread, since that's where it lives and where it
+  // gets unregistered. If the thread has gone away in the meantime, the fd is simply closed.
+  executor->executeAsync(
+      [this, index, name = kj::str(socketName), fd = kj::mv(ownFd)]() mutable {
+    KJ_IF_SOME(receiver, receivers[index].find(name)) {
+      receiver->push(kj::mv(fd));
+    }
+  }).detach([](kj::Exception&& exception) {
+    KJ_LOG(ERROR, "failed to hand off connection to server thread", exception);
+  });
+  return true;
+}
+
+kj::Promise<kj::Own<kj::AsyncIoStream>> DistributingConnectionReceiver::accept() {
+  for (;;) {
+    auto stream = co_await inner->accept();
+    if (!tryHandOff(*stream)) {
+      co_return kj::mv(stream);
+    }
+  }
+}
+
+kj::Promise<kj::AuthenticatedStream> DistributingConnectionReceiver::acceptAuthenticated() {
+  for (;;) {
+    auto stream = co_await inner->acceptAuthenticated();
+    if (!tryHandOff(*stream.stream)) {
+      co_return kj::mv(stream);
+    }
+  }
+}
+
+bool DistributingConnectionReceiver::tryHandOff(kj::AsyncIoStream& stream) {
+  uint target = nextThread++ % group.threadCount;
+  if (target == 0) return false;  // our turn
+  KJ_IF_SOME(fd, stream.getFd()) {
+    return group.handOff(target - 1, socketName, fd);
+  }
+  return false;
+}
+
+}  // namespace workerd::server
+
+#endif  // !_WIN32
@@ -0,0 +1,130 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+// Used to implement `Config.threads`.
+//
+// When `Config.threads` is greater than 1, the Server constructed by the CLI acts as the primary
+// and starts `threads - 1` secondary threads. Each secondary thread sets up its own event loop and
+// constructs its own Server from the same config, so it gets its own ThreadContext and its own
+// isolates. Only the primary listens on the configured sockets. It hands accepted connections
+// round-robin to all threads (itself included) by passing a duplicate of the raw file descriptor
+// to the target thread's event loop, where the connection shows up on a HandoffConnectionReceiver
+// standing in for the socket. TLS, if configured, is applied by whichever thread serves the
+// connection, since the primary distributes connections before the TLS wrapper.
+
+#if !_WIN32
+
+#include <kj/async-io.h>
+#include <kj/map.h>
+#include <kj/mutex.h>
+#include <kj/thread.h>
+#include <kj/vector.h>
+#include <workerd/util/wait-list.h>
+#include <deque>
+
+namespace workerd::server {
+
+// Stands in for a listening socket on a secondary thread. Connections are pushed to it by the
+// primary thread, via ThreadGroup::handOff().
+class HandoffConnectionReceiver final: public kj::ConnectionReceiver {
+public:
+  HandoffConnectionReceiver(kj::LowLevelAsyncIoProvider& lowLevel, kj::Network& network)
+      : lowLevel(lowLevel), network(network) {}
+
+  kj::Promise<kj::Own<kj::AsyncIoStream>> accept() override;
+  kj::Promise<kj::AuthenticatedStream> acceptAuthenticated() override;
+
+  // The primary thread owns the real port.
+  uint getPort() override { return 0; }
+
+  // Must be called on the thread that owns this receiver.
+  void push(kj::AutoCloseFd fd);
+
+private:
+  kj::LowLevelAsyncIoProvider& lowLevel;
+  kj::Network& network;
+
+  // Connections that arrived while no one was waiting. At most one of `queue` and `waiters` is
+  // non-empty at a time.
+  std::deque<kj::AuthenticatedStream> queue;
+
+  // Callers of accept() waiting for a connection, in the order they called. Any of these may
+  // have been canceled since.
+  std::deque<kj::Own<kj::PromiseFulfiller<kj::AuthenticatedStream>>> waiters;
+
+  // Reconstructs the peer identity, so that the cf blob still gets the client IP.
+  kj::Own<kj::PeerIdentity> getPeerIdentity(kj::AutoCloseFd& fd);
+};
+
+// The threads serving a config, shared between the primary thread and the secondaries.
+class ThreadGroup {
+public:
+  explicit ThreadGroup(uint threadCount);
+  ~ThreadGroup() noexcept(false);
+
+  // Total number of threads, including the primary.
+  const uint threadCount;
+
+  // Fulfilled when the primary is asked to drain. Secondary servers use it as their `drainWhen`.
+  CrossThreadWaitList drainList;
+
+  kj::Vector<kj::Own<kj::Thread>> threads;
+
+  // Called on secondary thread `index` once its receivers exist and its event loop is ready.
+  void registerThread(uint index,
+                      kj::HashMap<kj::String, HandoffConnectionReceiver*> threadReceivers);
+
+  // Called on secondary thread `index` before its Server is destroyed.
+  void unregisterThread(uint index);
+
+  // Called on the primary thread to pass a connection to secondary thread `index`. `fd` is
+  // duplicated, so the caller should drop its own stream afterwards. Returns false if that thread
+  // isn't accepting connections (yet, or anymore), in which case the caller should serve the
+  // connection itself.
+  bool handOff(uint index, kj::StringPtr socketName, int fd);
+
+private:
+  kj::MutexGuarded<kj::Array<kj::Maybe<kj::Own<const kj::Executor>>>> executors;
+
+  // receivers[i] is only accessed from secondary thread i.
+  kj::Array<kj::HashMap<kj::String, HandoffConnectionReceiver*>> receivers;
+};
+
+// Wraps the primary thread's listening socket, handing every `threadCount`th connection to each
+// of the secondary threads and returning the rest to the caller.
+class DistributingConnectionReceiver final: public kj::ConnectionReceiver {
+public:
+  DistributingConnectionReceiver(kj::Own<kj::ConnectionReceiver> inner, kj::String socketName,
+                                 ThreadGroup& group)
+      : inner(kj::mv(inner)), socketName(kj::mv(socketName)), group(group) {}
+
+  kj::Promise<kj::Own<kj::AsyncIoStream>> accept() override;
+  kj::Promise<kj::AuthenticatedStream> acceptAuthenticated() override;
+
+  uint getPort() override { return inner->getPort(); }
+
+  void getsockopt(int level, int option, void* value, uint* length) override {
+    inner->getsockopt(level, option, value, length);
+  }
+  void setsockopt(int level, int option, const void* value, uint length) override {
+    inner->setsockopt(level, option, value, length);
+  }
+  void getsockname(struct sockaddr* addr, uint* length) override {
+    inner->getsockname(addr, length);
+  }
+
+private:
+  kj::Own<kj::ConnectionReceiver> inner;
+  kj::String socketName;
+  ThreadGroup& group;
+  uint nextThread = 0;
+
+  bool tryHandOff(kj::AsyncIoStream& stream);
+};
+
+}  // namespace workerd::server
+
+#endif  // !_WIN32
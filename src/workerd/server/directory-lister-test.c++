@@ -0,0 +1,89 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "directory-lister.h"
+#include <kj/test.h>
+
+namespace workerd::server {
+namespace {
+
+kj::Own<DirectoryLister> newLister(kj::ArrayPtr<const kj::StringPtr> names) {
+  auto entries = KJ_MAP(name, names) {
+    return kj::ReadableDirectory::Entry { kj::FsNode::Type::FILE, kj::str(name) };
+  };
+  return kj::heap<ArrayDirectoryLister>(kj::mv(entries));
+}
+
+// Neither sorted nor reverse-sorted, like readdir() might return them.
+constexpr kj::StringPtr NAMES[] = {
+  "delta"_kj, "alpha"_kj, ".hidden"_kj, "echo"_kj, "charlie"_kj, "bravo"_kj, "foxtrot"_kj,
+};
+
+kj::String namesOf(const DirectoryPage& page) {
+  return kj::strArray(KJ_MAP(entry, page.entries) { return kj::str(entry.name); }, ",");
+}
+
+KJ_TEST("readDirectoryPage returns pages in name order") {
+  auto page = readDirectoryPage(*newLister(NAMES), 2, kj::none, false);
+  KJ_EXPECT(namesOf(page) == "alpha,bravo");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(page.cursor) == "bravo");
+
+  page = readDirectoryPage(*newLister(NAMES), 2, "bravo"_kj, false);
+  KJ_EXPECT(namesOf(page) == "charlie,delta");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(page.cursor) == "delta");
+
+  page = readDirectoryPage(*newLister(NAMES), 2, "delta"_kj, false);
+  KJ_EXPECT(namesOf(page) == "echo,foxtrot");
+  KJ_EXPECT(page.cursor == kj::none);
+}
+
+KJ_TEST("readDirectoryPage handles the last page exactly filling the limit") {
+  auto page = readDirectoryPage(*newLister(NAMES), 6, kj::none, false);
+  KJ_EXPECT(namesOf(page) == "alpha,bravo,charlie,delta,echo,foxtrot");
+  KJ_EXPECT(page.cursor == kj::none);
+
+  page = readDirectoryPage(*newLister(NAMES), 6, "foxtrot"_kj, false);
+  KJ_EXPECT(page.entries.size() == 0);
+  KJ_EXPECT(page.cursor == kj::none);
+}
+
+KJ_TEST("readDirectoryPage includes dotfiles only when asked") {
+  auto page = readDirectoryPage(*newLister(NAMES), 3, kj::none, true);
+  KJ_EXPECT(namesOf(page) == ".hidden,alpha,bravo");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(page.cursor) == "bravo");
+}
+
+KJ_TEST("readDirectoryPage resumes by name after the directory changes") {
+  auto page = readDirectoryPage(*newLister(NAMES), 3, kj::none, false);
+  KJ_EXPECT(namesOf(page) == "alpha,bravo,charlie");
+  auto cursor = kj::mv(KJ_ASSERT_NONNULL(page.cursor));
+
+  // "bravo" was removed and "able" and "dog" were added before the next page was requested.
+  // Entries before the cursor stay skipped and no remaining entry is repeated or missed.
+  constexpr kj::StringPtr CHANGED[] = {
+    "dog"_kj, "delta"_kj, "alpha"_kj, "able"_kj, "echo"_kj, "charlie"_kj, "foxtrot"_kj,
+  };
+  page = readDirectoryPage(*newLister(CHANGED), 3, kj::StringPtr(cursor), false);
+  KJ_EXPECT(namesOf(page) == "delta,dog,echo");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(page.cursor) == "echo");
+}
+
+KJ_TEST("DirectoryLister::open() lists an in-memory directory") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  for (auto name: NAMES) {
+    dir->openFile(kj::Path({name}), kj::WriteMode::CREATE);
+  }
+  dir->openSubdir(kj::Path({"golf"}), kj::WriteMode::CREATE);
+
+  auto page = readDirectoryPage(*DirectoryLister::open(*dir), 10, "echo"_kj, false);
+  KJ_ASSERT(page.entries.size() == 2);
+  KJ_EXPECT(page.entries[0].name == "foxtrot");
+  KJ_EXPECT(page.entries[0].type == kj::FsNode::Type::FILE);
+  KJ_EXPECT(page.entries[1].name == "golf");
+  KJ_EXPECT(page.entries[1].type == kj::FsNode::Type::DIRECTORY);
+  KJ_EXPECT(page.cursor == kj::none);
+}
+
+}  // namespace
+}  // namespace workerd::server
@@ -0,0 +1,140 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "directory-lister.h"
+#include <kj/debug.h>
+#include <kj/vector.h>
+#include <algorithm>
+
+#if !_WIN32
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace workerd::server {
+
+kj::Maybe<kj::ReadableDirectory::Entry> ArrayDirectoryLister::next() {
+  if (index >= entries.size()) return kj::none;
+  return kj::mv(entries[index++]);
+}
+
+namespace {
+
+#if !_WIN32
+class PosixDirectoryLister final: public DirectoryLister {
+public:
+  explicit PosixDirectoryLister(int dirFd) {
+    // Open the directory afresh rather than dup()ing the descriptor, since a dup would share (and
+    // move) the original's read position.
+    int fd;
+    KJ_SYSCALL(fd = openat(dirFd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    handle = fdopendir(fd);
+    if (handle == nullptr) {
+      close(fd);
+      KJ_FAIL_SYSCALL("fdopendir", errno);
+    }
+  }
+  ~PosixDirectoryLister() noexcept(false) {
+    closedir(handle);
+  }
+
+  kj::Maybe<kj::ReadableDirectory::Entry> next() override {
+    for (;;) {
+      errno = 0;
+      struct dirent* entry = readdir(handle);
+      if (entry == nullptr) {
+        int error = errno;
+        if (error != 0) KJ_FAIL_SYSCALL("readdir", error);
+        return kj::none;
+      }
+
+      kj::StringPtr name = entry->d_name;
+      if (name == "." || name == "..") continue;
+
+      return kj::ReadableDirectory::Entry { typeOf(*entry), kj::str(name) };
+    }
+  }
+
+private:
+  DIR* handle;
+
+  kj::FsNode::Type typeOf(const struct dirent& entry) {
+    switch (entry.d_type) {
+      case DT_REG:  return kj::FsNode::Type::FILE;
+      case DT_DIR:  return kj::FsNode::Type::DIRECTORY;
+      case DT_LNK:  return kj::FsNode::Type::SYMLINK;
+      case DT_BLK:  return kj::FsNode::Type::BLOCK_DEVICE;
+      case DT_CHR:  return kj::FsNode::Type::CHARACTER_DEVICE;
+      case DT_FIFO: return kj::FsNode::Type::NAMED_PIPE;
+      case DT_SOCK: return kj::FsNode::Type::SOCKET;
+      case DT_UNKNOWN: {
+        // Some filesystems don't report the type, so we have to stat().
+        struct stat stats;
+        if (fstatat(dirfd(handle), entry.d_name, &stats, AT_SYMLINK_NOFOLLOW) < 0) break;
+        if (S_ISREG(stats.st_mode)) return kj::FsNode::Type::FILE;
+        if (S_ISDIR(stats.st_mode)) return kj::FsNode::Type::DIRECTORY;
+        if (S_ISLNK(stats.st_mode)) return kj::FsNode::Type::SYMLINK;
+        if (S_ISBLK(stats.st_mode)) return kj::FsNode::Type::BLOCK_DEVICE;
+        if (S_ISCHR(stats.st_mode)) return kj::FsNode::Type::CHARACTER_DEVICE;
+        if (S_ISFIFO(stats.st_mode)) return kj::FsNode::Type::NAMED_PIPE;
+        if (S_ISSOCK(stats.st_mode)) return kj::FsNode::Type::SOCKET;
+        break;
+      }
+    }
+    return kj::FsNode::Type::OTHER;
+  }
+};
+#endif  // !_WIN32
+
+}  // namespace
+
+kj::Own<DirectoryLister> DirectoryLister::open(const kj::ReadableDirectory& dir) {
+#if !_WIN32
+  KJ_IF_SOME(fd, dir.getFd()) {
+    return kj::heap<PosixDirectoryLister>(fd);
+  }
+#endif
+  return kj::heap<ArrayDirectoryLister>(dir.listEntries());
+}
+
+DirectoryPage readDirectoryPage(DirectoryLister& lister, size_t limit,
+                                kj::Maybe<kj::StringPtr> cursor, bool includeDotfiles) {
+  KJ_REQUIRE(limit > 0);
+
+  auto byName = [](const kj::ReadableDirectory::Entry& a, const kj::ReadableDirectory::Entry& b) {
+    return a.name < b.name;
+  };
+
+  // A max-heap of the smallest names seen so far. One more than `limit` is kept, to find out
+  // whether the page is the last.
+  kj::Vector<kj::ReadableDirectory::Entry> heap(kj::min(limit + 1, size_t(1024)));
+  for (;;) {
+    auto entry = KJ_UNWRAP_OR(lister.next(), break);
+    if (!includeDotfiles && entry.name.startsWith(".")) continue;
+    KJ_IF_SOME(c, cursor) {
+      if (!(c < entry.name)) continue;
+    }
+    if (heap.size() > limit) {
+      if (!(entry.name < heap.front().name)) continue;
+      std::pop_heap(heap.begin(), heap.end(), byName);
+      heap.removeLast();
+    }
+    heap.add(kj::mv(entry));
+    std::push_heap(heap.begin(), heap.end(), byName);
+  }
+
+  std::sort_heap(heap.begin(), heap.end(), byName);
+
+  DirectoryPage result;
+  if (heap.size() > limit) {
+    heap.removeLast();
+    result.cursor = kj::str(heap.back().name);
+  }
+  result.entries = heap.releaseAsArray();
+  return result;
+}
+
+}  // namespace workerd::server
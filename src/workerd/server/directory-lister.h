@@ -0,0 +1,56 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/filesystem.h>
+
+namespace workerd::server {
+
+// Reads the entries of a directory one at a time, in no particular order, so that scanning a huge
+// directory doesn't require holding all of its entries in memory.
+class DirectoryLister {
+public:
+  virtual ~DirectoryLister() noexcept(false) = default;
+
+  // Returns the next entry, skipping "." and "..", or null once all have been read.
+  virtual kj::Maybe<kj::ReadableDirectory::Entry> next() = 0;
+
+  // Reads with readdir() if `dir` has a file descriptor, otherwise falls back to
+  // ArrayDirectoryLister over dir.listEntries().
+  static kj::Own<DirectoryLister> open(const kj::ReadableDirectory& dir);
+};
+
+// Lists entries that have already been read into memory, such as those of an in-memory directory.
+class ArrayDirectoryLister final: public DirectoryLister {
+public:
+  explicit ArrayDirectoryLister(kj::Array<kj::ReadableDirectory::Entry> entries)
+      : entries(kj::mv(entries)) {}
+
+  kj::Maybe<kj::ReadableDirectory::Entry> next() override;
+
+private:
+  kj::Array<kj::ReadableDirectory::Entry> entries;
+  size_t index = 0;
+};
+
+struct DirectoryPage {
+  // Sorted by name.
+  kj::Array<kj::ReadableDirectory::Entry> entries;
+
+  // The name of the last entry, if more entries follow it. Passing it back to readDirectoryPage()
+  // continues the listing.
+  kj::Maybe<kj::String> cursor;
+};
+
+// Returns the first `limit` entries, in name order, whose names sort after `cursor`. Names
+// starting with "." are skipped unless `includeDotfiles` is true.
+//
+// This reads the whole directory but keeps only `limit` + 1 entries at a time. Because the cursor
+// is a name rather than a position, a listing resumed after entries were added or removed still
+// returns every remaining entry exactly once.
+DirectoryPage readDirectoryPage(DirectoryLister& lister, size_t limit,
+                                kj::Maybe<kj::StringPtr> cursor, bool includeDotfiles);
+
+}  // namespace workerd::server
@@ -0,0 +1,82 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "open-file-cache.h"
+
+namespace workerd::server {
+
+OpenFileCache::Entry::Entry(kj::Own<const kj::ReadableFile> file, kj::FsNode::Metadata meta,
+                            bool loadContent)
+    : file(kj::mv(file)), meta(meta),
+      etag(kj::str('"',
+          kj::hex(static_cast<uint64_t>((meta.lastModified - kj::UNIX_EPOCH) / kj::NANOSECONDS)),
+          '-', kj::hex(meta.size), '"')) {
+  if (loadContent && meta.size <= MAX_CONTENT_SIZE) {
+    auto bytes = kj::heapArray<kj::byte>(meta.size);
+    // If the file shrank since stat(), don't cache a short read.
+    if (this->file->read(0, bytes) == bytes.size()) {
+      content = kj::mv(bytes);
+    }
+  }
+}
+
+OpenFileCache::OpenFileCache(kj::Timer& timer, size_t capacity)
+    : timer(timer), capacity(capacity) {}
+
+OpenFileCache::~OpenFileCache() noexcept(false) {
+  clear();
+}
+
+kj::Maybe<kj::Own<OpenFileCache::Entry>> OpenFileCache::find(kj::PathPtr path) {
+  if (capacity == 0) return kj::none;
+
+  auto key = path.toString();
+  auto& entry = *KJ_UNWRAP_OR(entries.find(key), return kj::none);
+
+  if (timer.now() >= entry.expires) {
+    remove(entry);
+    return kj::none;
+  }
+
+  lru.remove(entry);
+  lru.add(entry);
+  return kj::addRef(entry);
+}
+
+kj::Own<OpenFileCache::Entry> OpenFileCache::insert(
+    kj::PathPtr path, kj::Own<const kj::ReadableFile> file, kj::FsNode::Metadata meta) {
+  auto entry = kj::refcounted<Entry>(kj::mv(file), meta, capacity > 0);
+  if (capacity == 0) return entry;
+
+  entry->key = path.toString();
+  entry->expires = timer.now() + ENTRY_TTL;
+
+  KJ_IF_SOME(existing, entries.find(entry->key)) {
+    remove(*existing);
+  }
+  while (entries.size() >= capacity) {
+    remove(*lru.begin());
+  }
+
+  lru.add(*entry);
+  entries.insert(kj::str(entry->key), kj::addRef(*entry));
+  return entry;
+}
+
+void OpenFileCache::clear() {
+  while (!lru.empty()) {
+    lru.remove(*lru.begin());
+  }
+  entries.clear();
+}
+
+void OpenFileCache::remove(Entry& entry) {
+  lru.remove(entry);
+  // The map holds a reference, so look up by a copy of the key rather than by the entry's own key,
+  // which is freed along with the entry if this was the last reference.
+  auto key = kj::mv(entry.key);
+  KJ_ASSERT(entries.erase(key));
+}
+
+}  // namespace workerd::server
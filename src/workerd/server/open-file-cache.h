@@ -0,0 +1,85 @@
+// Copyright (c) 2017-2022 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/filesystem.h>
+#include <kj/list.h>
+#include <kj/map.h>
+#include <kj/refcount.h>
+#include <kj/timer.h>
+
+namespace workerd::server {
+
+// A bounded LRU of open files, used by disk directory services so that repeated requests for the
+// same file don't each have to open() and stat() it.
+//
+// Entries are trusted for ENTRY_TTL after they are opened. Changes made to the directory by
+// other processes therefore may not be seen until then; writes made through the service itself
+// should call clear().
+class OpenFileCache {
+public:
+  // How long a cached entry is used before the file is opened and stat()ed again.
+  static constexpr kj::Duration ENTRY_TTL = 1 * kj::SECONDS;
+
+  // Files up to this size are read into memory when they are cached, so that serving them
+  // doesn't touch the filesystem at all.
+  static constexpr uint64_t MAX_CONTENT_SIZE = 64 * 1024;
+
+  // An open regular file, with the metadata needed to serve it. Requests hold a reference for as
+  // long as they are using the file, so eviction never invalidates it.
+  class Entry: public kj::Refcounted {
+  public:
+    Entry(kj::Own<const kj::ReadableFile> file, kj::FsNode::Metadata meta, bool loadContent);
+
+    kj::Own<const kj::ReadableFile> file;
+    kj::FsNode::Metadata meta;
+
+    // Strong validator derived from the modification time and size, e.g. `"17d3f2a9c-4d2"`. The
+    // inode number is deliberately left out, so that identical copies of a directory deployed to
+    // several machines produce the same ETags.
+    kj::String etag;
+
+    // The entire file, if it is no larger than MAX_CONTENT_SIZE and this entry is cached.
+    kj::Maybe<kj::Array<const kj::byte>> content;
+
+  private:
+    kj::String key;
+    kj::TimePoint expires = kj::origin<kj::TimePoint>();
+    kj::ListLink<Entry> link;
+
+    friend class OpenFileCache;
+  };
+
+  // `capacity` is the maximum number of files to keep open. With a capacity of zero, nothing is
+  // cached and insert() simply wraps the file it is given.
+  OpenFileCache(kj::Timer& timer, size_t capacity);
+  ~OpenFileCache() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(OpenFileCache);
+
+  // Returns the cached entry for `path`, unless there is none or it has expired.
+  kj::Maybe<kj::Own<Entry>> find(kj::PathPtr path);
+
+  // Creates an entry for a regular file that was just opened and stat()ed, caching it if enabled.
+  kj::Own<Entry> insert(kj::PathPtr path, kj::Own<const kj::ReadableFile> file,
+                        kj::FsNode::Metadata meta);
+
+  // Drops every entry.
+  void clear();
+
+  size_t size() const { return entries.size(); }
+
+private:
+  kj::Timer& timer;
+  size_t capacity;
+
+  kj::HashMap<kj::String, kj::Own<Entry>> entries;
+
+  // Least recently used at the front.
+  kj::List<Entry, &Entry::link> lru;
+
+  void remove(Entry& entry);
+};
+
+}  // namespace workerd::server
@@ -1474,6 +1474,203 @@ KJ_TEST("Server: call queue handler on service binding") {
   conn.httpGet200("/", "queue outcome: ok, ackAll: true");
 }
 
+KJ_TEST("Server: kv service") {
+  TestServer test(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request, env) {
+                `    let [op, key, value] = new URL(request.url).pathname.slice(1).split("/");
+                `    if (op == "put") {
+                `      await env.kv.put(key, value, {metadata: {m: key}});
+                `      return new Response("ok");
+                `    } else if (op == "delete") {
+                `      await env.kv.delete(key);
+                `      return new Response("ok");
+                `    } else if (op == "list") {
+                `      let list = await env.kv.list({limit: 2});
+                `      return new Response(list.keys.map(k => k.name + ":" + k.metadata.m).join(",") +
+                `          " " + list.list_complete);
+                `    } else if (op == "big") {
+                `      let big = "x".repeat(value == "metadata" ? 1025 : 25 * 1024 * 1024 + 1);
+                `      try {
+                `        await env.kv.put(key, value == "metadata" ? "" : big,
+                `                         value == "metadata" ? {metadata: big.slice(2)} : {});
+                `        return new Response("ok");
+                `      } catch (e) {
+                `        return new Response(e.message);
+                `      }
+                `    } else if (op == "bulk") {
+                `      let map = await env.kv.getWithMetadata(key.split(","));
+                `      return new Response([...map].map(([k, v]) =>
+                `          k + ":" + v.value + ":" + JSON.stringify(v.metadata)).join(","));
+                `    } else {
+                `      let {value, metadata} = await env.kv.getWithMetadata(key);
+                `      return new Response(value + " " + JSON.stringify(metadata));
+                `    }
+                `  }
+                `}
+            )
+          ],
+          bindings = [(name = "kv", kvNamespace = "kv")],
+        )
+      ),
+      ( name = "kv", kv = (inMemory = void) ),
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ]
+  ))"_kj);
+
+  test.start();
+  auto conn = test.connect("test-addr");
+  conn.httpGet200("/get/foo", "null null");
+  conn.httpGet200("/put/foo/abc", "ok");
+  conn.httpGet200("/put/bar/def", "ok");
+  conn.httpGet200("/put/baz/ghi", "ok");
+  conn.httpGet200("/get/foo", "abc {\"m\":\"foo\"}");
+  conn.httpGet200("/list", "bar:bar,baz:baz false");
+  conn.httpGet200("/delete/bar", "ok");
+  conn.httpGet200("/get/bar", "null null");
+  conn.httpGet200("/list", "baz:baz,foo:foo true");
+  conn.httpGet200("/bulk/foo,bar,baz",
+      "foo:abc:{\"m\":\"foo\"},bar:null:null,baz:ghi:{\"m\":\"baz\"}");
+  conn.httpGet200("/big/qux/value",
+      "KV PUT failed: 413 Value length of 26214401 exceeds limit of 26214400.");
+  conn.httpGet200("/big/qux/metadata",
+      "KV PUT failed: 413 Metadata length of 1025 exceeds limit of 1024.");
+  conn.httpGet200("/get/qux", "null null");
+}
+
+KJ_TEST("Server: KV bindings to the same namespace share the read cache") {
+  TestServer test(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request, env) {
+                `    let first = await env.kv1.get("foo");
+                `    let second = await env.kv2.get("foo");
+                `    return new Response(`${first}, ${second}`);
+                `  }
+                `}
+            )
+          ],
+          bindings = [
+            (name = "kv1", kvNamespace = "kv-outbound"),
+            (name = "kv2", kvNamespace = "kv-outbound"),
+          ],
+          kvReadCache = (maxBytes = 65536),
+        )
+      ),
+      ( name = "kv-outbound", external = "kv-host" ),
+    ],
+    sockets = [
+      ( name = "main", address = "test-addr", service = "hello" ),
+    ]
+  ))"_kj);
+
+  test.start();
+  auto conn = test.connect("test-addr");
+  conn.sendHttpGet("/");
+
+  // Only the first read goes to KV.
+  auto subreq = test.receiveSubrequest("kv-host");
+  subreq.recv(R"(
+    GET /foo?urlencoded=true HTTP/1.1
+    Host: fake-host
+    CF-KV-FLPROD-405: https://fake-host/foo?urlencoded=true
+
+  )"_blockquote);
+  subreq.send(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 3
+
+    bar
+  )"_blockquote);
+
+  conn.recvHttp200("bar, bar");
+}
+
+KJ_TEST("Server: kv service can only be used through kvNamespace bindings") {
+  TestServer test(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request, env) {
+                `    return env.svc.fetch(request);
+                `  }
+                `}
+            )
+          ],
+          bindings = [
+            (name = "kv", kvNamespace = "kv"),
+            (name = "svc", service = "kv"),
+          ],
+        )
+      ),
+      ( name = "kv", kv = (inMemory = void) ),
+    ],
+    sockets = [
+      ( name = "main", address = "test-addr", service = "kv" ),
+    ]
+  ))"_kj);
+
+  test.expectErrors(
+      "Worker \"hello\"'s binding \"svc\" refers to service \"kv\", but that is a KV "
+          "namespace, which can only be used through a kvNamespace binding.\n"
+      "Socket \"main\" refers to service \"kv\", but that is a KV namespace, which can only be "
+          "used through a kvNamespace binding.\n");
+}
+
+#if !_WIN32
+KJ_TEST("Server: kv service on disk requires a single thread") {
+  TestServer test(R"((
+    services = [
+      ( name = "kv", kv = (localDisk = "nope") ),
+    ],
+    threads = 2,
+  ))"_kj);
+
+  test.expectErrors(
+      "Service \"kv\" is a KV namespace stored on local disk, which is not yet supported when "
+          "`threads` is greater than 1, because every thread would open its own connection to "
+          "the same database.\n"
+      "service kv: kv config refers to a service \"nope\", but no such service is defined.\n");
+}
+
+KJ_TEST("Server: kv service in memory requires a single thread") {
+  TestServer test(R"((
+    services = [
+      ( name = "kv", kv = (inMemory = void) ),
+    ],
+    threads = 2,
+  ))"_kj);
+
+  test.expectErrors(
+      "Service \"kv\" is a KV namespace stored in memory, which is not yet supported when "
+          "`threads` is greater than 1, because every thread would keep its own, separate copy "
+          "of the data.\n");
+}
+#endif
+
 KJ_TEST("Server: Durable Objects (in memory)") {
   TestServer test(R"((
     services = [
@@ -1539,6 +1736,21 @@ KJ_TEST("Server: Durable Objects (in memory)") {
       "02b496f65dd35cbac90e3e72dc5a398ee93926ea4a3821e26677082d2e6f9b79: http://foo/bar 2");
 }
 
+KJ_TEST("Server: Durable Object cache needs at least one shard") {
+  TestServer test(singleWorker(R"((
+    compatibilityDate = "2022-08-17",
+    durableObjectCacheLimits = (shardCount = 0, secondChance = true),
+    serviceWorkerScript =
+        `addEventListener("fetch", event => {
+        `  event.respondWith(new Response("Hello"));
+        `})
+  ))"_kj));
+
+  test.expectErrors(R"(
+    service hello: durableObjectCacheLimits.shardCount must be at least 1.
+  )"_blockquote);
+}
+
 KJ_TEST("Server: Durable Objects (on disk)") {
   kj::StringPtr config = R"((
     services = [
@@ -1663,6 +1875,126 @@ KJ_TEST("Server: Durable Objects (on disk)") {
   }
 }
 
+kj::String alarmsOnDiskConfig(kj::StringPtr uniqueKey) {
+  return kj::str(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2022-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request, env) {
+                `    let actor = env.ns.get(env.ns.idFromName("alarms"))
+                `    return await actor.fetch(request)
+                `  }
+                `}
+                `export class MyActorClass {
+                `  constructor(state, env) {
+                `    this.storage = state.storage;
+                `  }
+                `  async fetch(request) {
+                `    let url = new URL(request.url);
+                `    if (url.pathname == "/set") {
+                `      await this.storage.setAlarm(Date.now() + Number(url.searchParams.get("ms")));
+                `      return new Response("OK");
+                `    }
+                `    let fired = (await this.storage.get("fired")) || 0;
+                `    let alarm = await this.storage.getAlarm();
+                `    return new Response("fired " + fired + ", " +
+                `        (alarm === null ? "no alarm" : "alarm set"));
+                `  }
+                `  async alarm() {
+                `    let fired = (await this.storage.get("fired")) || 0;
+                `    await this.storage.put("fired", fired + 1);
+                `  }
+                `}
+            )
+          ],
+          bindings = [(name = "ns", durableObjectNamespace = "MyActorClass")],
+          durableObjectNamespaces = [
+            ( className = "MyActorClass",
+              uniqueKey = ")", uniqueKey, R"(",
+            )
+          ],
+          durableObjectStorage = (localDisk = "my-disk")
+        )
+      ),
+      ( name = "my-disk",
+        disk = (
+          path = "../../var/do-storage",
+          writable = true,
+        )
+      ),
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ]
+  ))");
+}
+
+KJ_TEST("Server: Durable Object alarms (on disk) persist across restarts") {
+  // Create a directory outside of the test scope which we can use across multiple TestServers.
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  auto linkDir = [&](TestServer& test) {
+    test.root->transfer(
+        kj::Path({"var"_kj, "do-storage"_kj}), kj::WriteMode::CREATE | kj::WriteMode::CREATE_PARENT,
+        *dir, nullptr, kj::TransferMode::LINK);
+  };
+
+  {
+    TestServer test(alarmsOnDiskConfig("mykey"));
+    linkDir(test);
+    test.start();
+    auto conn = test.connect("test-addr");
+    conn.httpGet200("/set?ms=1000", "OK");
+    conn.httpGet200("/", "fired 0, alarm set");
+  }
+
+  // The alarm database lives in its own subdirectory, not next to the namespace directories.
+  KJ_EXPECT(dir->exists(kj::Path({".alarms", "alarms.sqlite"})));
+  KJ_EXPECT(!dir->exists(kj::Path({"alarms.sqlite"})));
+
+  {
+    TestServer test(alarmsOnDiskConfig("mykey"));
+    linkDir(test);
+
+    // Let the alarm come due while the server is down; it should be caught up on after starting.
+    test.wait(2);
+    test.start();
+    test.wait(2);
+
+    auto conn = test.connect("test-addr");
+    conn.httpGet200("/", "fired 1, no alarm");
+
+    // Leave an alarm far in the future behind.
+    conn.httpGet200("/set?ms=3600000", "OK");
+    conn.httpGet200("/", "fired 1, alarm set");
+  }
+
+  {
+    // Starting with the namespace removed from the config doesn't run its alarms.
+    TestServer test(alarmsOnDiskConfig("otherkey"));
+    linkDir(test);
+    test.start();
+    auto conn = test.connect("test-addr");
+    conn.httpGet200("/", "fired 0, no alarm");
+  }
+
+  {
+    // Once the namespace is back, so is its alarm.
+    TestServer test(alarmsOnDiskConfig("mykey"));
+    linkDir(test);
+    test.start();
+    auto conn = test.connect("test-addr");
+    conn.httpGet200("/", "fired 1, alarm set");
+  }
+}
+
 KJ_TEST("Server: Ephemeral Objects") {
   TestServer test(R"((
     services = [
@@ -1890,6 +2222,78 @@ KJ_TEST("Server: Durable Objects (ephemeral) prevent eviction") {
   connTwo.httpGet200("/assertNotEvicted", "OK");
 }
 
+KJ_TEST("Server: Durable Objects adaptive eviction") {
+  // The heap is always over Tight's budget, so its objects are evicted after the minimum timeout.
+  // It is nowhere near Roomy's budget, so its objects are kept for about the maximum.
+  TestServer test(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2023-08-17",
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request, env) {
+                `    let [ns, op] = new URL(request.url).pathname.slice(1).split("/");
+                `    let obj = env[ns].get(env[ns].idFromName("foo"));
+                `    return await obj.fetch("http://example.com/" + op);
+                `  }
+                `}
+                `class Counter {
+                `  constructor(state, env) {
+                `    this.count = 0;
+                `  }
+                `  async fetch(request) {
+                `    return new Response(`${this.count++}`);
+                `  }
+                `}
+                `export class Tight extends Counter {}
+                `export class Roomy extends Counter {}
+            )
+          ],
+          bindings = [
+            (name = "tight", durableObjectNamespace = "Tight"),
+            (name = "roomy", durableObjectNamespace = "Roomy"),
+          ],
+          durableObjectNamespaces = [
+            ( className = "Tight",
+              uniqueKey = "tight",
+              adaptiveEviction = (memoryBudgetBytes = 1, minTimeoutMs = 1000, maxTimeoutMs = 30000),
+            ),
+            ( className = "Roomy",
+              uniqueKey = "roomy",
+              adaptiveEviction = (memoryBudgetBytes = 1099511627776, minTimeoutMs = 1000,
+                                  maxTimeoutMs = 30000),
+            )
+          ],
+          durableObjectStorage = (inMemory = void)
+        )
+      ),
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ]
+  ))"_kj);
+
+  test.start();
+  auto conn = test.connect("test-addr");
+  conn.httpGet200("/tight/", "0");
+  conn.httpGet200("/tight/", "1");
+  conn.httpGet200("/roomy/", "0");
+  conn.httpGet200("/roomy/", "1");
+
+  test.wait(3);
+
+  // Need a second connection because of 5 second HTTP timeout.
+  auto connTwo = test.connect("test-addr");
+  connTwo.httpGet200("/tight/", "0");
+  connTwo.httpGet200("/roomy/", "2");
+}
+
 KJ_TEST("Server: Durable Object evictions when callback scheduled") {
   kj::StringPtr config = R"((
     services = [
@@ -2261,6 +2665,102 @@ KJ_TEST("Server: Durable Objects websocket hibernation") {
   wsConn.send(kj::str("\x81\x1a", confirmEviction));
   wsConn.recvWebSocket(evicted);
 }
+
+KJ_TEST("Server: Durable Objects websocket broadcast") {
+  TestServer test(R"((
+    services = [
+      ( name = "hello",
+        worker = (
+          compatibilityDate = "2023-08-17",
+          compatibilityFlags = ["experimental"],
+          modules = [
+            ( name = "main.js",
+              esModule =
+                `export default {
+                `  async fetch(request, env) {
+                `    let id = env.ns.idFromName("broadcast");
+                `    return await env.ns.get(id).fetch(request);
+                `  }
+                `}
+                `
+                `export class MyActorClass {
+                `  constructor(state) {
+                `    this.state = state;
+                `  }
+                `
+                `  async fetch(request) {
+                `    let path = new URL(request.url).pathname;
+                `    if (path == "/") {
+                `      // The first websocket is tagged "a", the second "b".
+                `      let tag = this.state.getWebSockets().length == 0 ? "a" : "b";
+                `      let pair = new WebSocketPair();
+                `      this.state.acceptWebSocket(pair[1], [tag]);
+                `      pair[1].serializeAttachment(tag);
+                `      return new Response(null, {status: 101, webSocket: pair[0]});
+                `    } else if (path == "/third") {
+                `      try {
+                `        this.state.acceptWebSocket(new WebSocketPair()[1]);
+                `        return new Response("accepted");
+                `      } catch (e) {
+                `        return new Response(e.message);
+                `      }
+                `    } else if (path == "/broadcast/a") {
+                `      return new Response(`${this.state.broadcastWebSocketMessage("to a", "a")}`);
+                `    } else if (path == "/broadcast") {
+                `      return new Response(`${this.state.broadcastWebSocketMessage("to all")}`);
+                `    } else if (path == "/order") {
+                `      return new Response(this.state.getWebSockets()
+                `          .map(ws => ws.deserializeAttachment()).join(","));
+                `    }
+                `    return new Response("Unknown path!", {status: 404});
+                `  }
+                `}
+            )
+          ],
+          bindings = [(name = "ns", durableObjectNamespace = "MyActorClass")],
+          durableObjectNamespaces = [
+            ( className = "MyActorClass",
+              uniqueKey = "mykey",
+              maxHibernatableWebSockets = 2,
+            )
+          ],
+          durableObjectStorage = (inMemory = void)
+        )
+      ),
+    ],
+    sockets = [
+      ( name = "main",
+        address = "test-addr",
+        service = "hello"
+      )
+    ]
+  ))"_kj);
+
+  test.server.allowExperimental();
+  test.start();
+  auto wsA = test.connect("test-addr");
+  wsA.upgradeToWebSocket();
+  auto wsB = test.connect("test-addr");
+  wsB.upgradeToWebSocket();
+
+  // `maxHibernatableWebSockets` is 2.
+  auto conn = test.connect("test-addr");
+  conn.httpGet200("/third",
+      "only 2 websockets can be accepted on a single Durable Object instance");
+
+  // Broadcast to awake websockets, by tag.
+  conn.httpGet200("/broadcast/a", "1");
+  wsA.recvWebSocket("to a");
+
+  // Broadcast to hibernating websockets. They receive the message without being woken up.
+  test.wait(10);
+  conn.httpGet200("/broadcast", "2");
+  wsA.recvWebSocket("to all");
+  wsB.recvWebSocket("to all");
+
+  // Without a tag, getWebSockets() returns the newest websocket first.
+  conn.httpGet200("/order", "b,a");
+}
 // =======================================================================================
 // Test HttpOptions on receive
 
@@ -2821,6 +3321,7 @@ KJ_TEST("Server: disk service") {
     Content-Length: 19
     Content-Type: application/octet-stream
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-13"
 
     hello from foo.txt
   )"_blockquote);
@@ -2831,6 +3332,7 @@ KJ_TEST("Server: disk service") {
     Content-Length: 19
     Content-Type: application/octet-stream
     Last-Modified: Fri, 05 Feb 1971 02:52:09 GMT
+    ETag: "7ad187fd8768c0-13"
 
     hello from bar.txt
   )"_blockquote);
@@ -2841,6 +3343,7 @@ KJ_TEST("Server: disk service") {
     Content-Length: 19
     Content-Type: application/octet-stream
     Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-13"
 
     hello from qux.txt
   )"_blockquote);
@@ -2861,6 +3364,7 @@ KJ_TEST("Server: disk service") {
     Content-Length: 11
     Content-Type: application/octet-stream
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
 
   )"_blockquote);
 
@@ -2877,6 +3381,7 @@ KJ_TEST("Server: disk service") {
     Content-Type: application/octet-stream
     Content-Range: bytes 3-5/11
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
 
     345)"_blockquote);
 
@@ -2892,11 +3397,12 @@ KJ_TEST("Server: disk service") {
     Content-Length: 11
     Content-Type: application/octet-stream
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
 
     0123456789
   )"_blockquote);
 
-  // GET with many ranges returns full content.
+  // GET with many ranges returns multipart content.
   conn.send(R"(
     GET /numbers.txt HTTP/1.1
     Host: foo
@@ -2904,12 +3410,24 @@ KJ_TEST("Server: disk service") {
 
   )"_blockquote);
   conn.recv(R"(
-    HTTP/1.1 200 OK
-    Content-Length: 11
-    Content-Type: application/octet-stream
+    HTTP/1.1 206 Partial Content
+    Content-Length: 243
+    Content-Type: multipart/byteranges; boundary=byteranges-ae88e6257600-b
     Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
 
-    0123456789
+
+    --byteranges-ae88e6257600-b
+    Content-Type: application/octet-stream
+    Content-Range: bytes 1-3/11
+
+    123
+    --byteranges-ae88e6257600-b
+    Content-Type: application/octet-stream
+    Content-Range: bytes 6-8/11
+
+    678
+    --byteranges-ae88e6257600-b--
   )"_blockquote);
 
   // GET with unsatisfiable range.
@@ -2926,6 +3444,69 @@ KJ_TEST("Server: disk service") {
 
     Range Not Satisfiable)"_blockquote);
 
+  // GET with a matching If-None-Match returns not modified.
+  conn.send(R"(
+    GET /numbers.txt HTTP/1.1
+    Host: foo
+    If-None-Match: "abc", W/"ae88e6257600-b"
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 304 Not Modified
+    Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
+
+    )"_blockquote);
+
+  // If-Modified-Since is ignored when If-None-Match doesn't match.
+  conn.send(R"(
+    GET /numbers.txt HTTP/1.1
+    Host: foo
+    If-None-Match: "abc"
+    If-Modified-Since: Sat, 03 Jan 1970 05:18:23 GMT
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 11
+    Content-Type: application/octet-stream
+    Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
+
+    0123456789
+  )"_blockquote);
+
+  // HEAD with If-Modified-Since at the modification time returns not modified.
+  conn.send(R"(
+    HEAD /numbers.txt HTTP/1.1
+    Host: foo
+    If-Modified-Since: Sat, 03 Jan 1970 05:18:23 GMT
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 304 Not Modified
+    Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
+
+    )"_blockquote);
+
+  // GET with an earlier If-Modified-Since returns the content.
+  conn.send(R"(
+    GET /numbers.txt HTTP/1.1
+    Host: foo
+    If-Modified-Since: Sat, 03 Jan 1970 05:18:22 GMT
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 11
+    Content-Type: application/octet-stream
+    Last-Modified: Sat, 03 Jan 1970 05:18:23 GMT
+    ETag: "ae88e6257600-b"
+
+    0123456789
+  )"_blockquote);
+
   // File not found...
   conn.sendHttpGet("/no-such-file.txt");
   conn.recv(R"(
@@ -3182,6 +3763,194 @@ KJ_TEST("Server: disk service writable") {
     Unauthorized)"_blockquote);
 }
 
+KJ_TEST("Server: disk service precompressed") {
+  TestServer test(R"((
+    services = [
+      (name = "hello", disk = (path = "../../frob/blah", precompressed = true))
+    ],
+    sockets = [
+      (name = "main", address = "test-addr", service = "hello")
+    ]
+  ))"_kj);
+
+  auto mode = kj::WriteMode::CREATE | kj::WriteMode::CREATE_PARENT;
+  auto dir = test.root->openSubdir(kj::Path({"frob"_kj, "blah"_kj}), mode);
+  dir->openFile(kj::Path({"app.js"}), mode)->writeAll("plain");
+  dir->openFile(kj::Path({"app.js.br"}), mode)->writeAll("BR");
+  dir->openFile(kj::Path({"app.js.gz"}), mode)->writeAll("GZ");
+  dir->openFile(kj::Path({"only.js"}), mode)->writeAll("only");
+  dir->openFile(kj::Path({"only.js.gz"}), mode)->writeAll("GZ");
+
+  test.start();
+
+  auto conn = test.connect("test-addr");
+
+  // Brotli is preferred when both are accepted.
+  conn.send(R"(
+    GET /app.js HTTP/1.1
+    Host: foo
+    Accept-Encoding: gzip, deflate, br
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 2
+    Content-Type: application/octet-stream
+    Content-Encoding: br
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-2"
+    Vary: Accept-Encoding
+
+    BR)"_blockquote);
+
+  // A zero quality value rules out an encoding.
+  conn.send(R"(
+    GET /app.js HTTP/1.1
+    Host: foo
+    Accept-Encoding: GZIP, br;q=0
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 2
+    Content-Type: application/octet-stream
+    Content-Encoding: gzip
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-2"
+    Vary: Accept-Encoding
+
+    GZ)"_blockquote);
+
+  // Without Accept-Encoding, the file itself is served.
+  conn.sendHttpGet("/app.js");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 5
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-5"
+    Vary: Accept-Encoding
+
+    plain)"_blockquote);
+
+  // Likewise if there is no sibling for an accepted encoding.
+  conn.send(R"(
+    GET /only.js HTTP/1.1
+    Host: foo
+    Accept-Encoding: br
+
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 4
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-4"
+    Vary: Accept-Encoding
+
+    only)"_blockquote);
+}
+
+KJ_TEST("Server: disk service open file cache") {
+  TestServer test(R"((
+    services = [
+      (name = "hello", disk = (path = "../../frob/blah", writable = true, openFileCacheSize = 1))
+    ],
+    sockets = [
+      (name = "main", address = "test-addr", service = "hello")
+    ]
+  ))"_kj);
+
+  auto mode = kj::WriteMode::CREATE | kj::WriteMode::CREATE_PARENT;
+  auto dir = test.root->openSubdir(kj::Path({"frob"_kj, "blah"_kj}), mode);
+  dir->openFile(kj::Path({"foo.txt"}), mode)->writeAll("foo");
+  dir->openFile(kj::Path({"bar.txt"}), mode)->writeAll("bar");
+
+  test.start();
+
+  auto conn = test.connect("test-addr");
+
+  conn.sendHttpGet("/foo.txt");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 3
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-3"
+
+    foo)"_blockquote);
+
+  // Changes made behind the service's back aren't seen while the entry is fresh.
+  dir->openFile(kj::Path({"foo.txt"}), kj::WriteMode::MODIFY)->writeAll("FOO!");
+  conn.sendHttpGet("/foo.txt");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 3
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-3"
+
+    foo)"_blockquote);
+
+  // Requesting another file evicts the first, since the cache only holds one.
+  conn.sendHttpGet("/bar.txt");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 3
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-3"
+
+    bar)"_blockquote);
+
+  conn.sendHttpGet("/foo.txt");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 4
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-4"
+
+    FOO!)"_blockquote);
+
+  // Writes through the service are seen immediately.
+  conn.send(R"(
+    PUT /foo.txt HTTP/1.1
+    Host: foo
+    Content-Length: 6
+
+    corge
+  )"_blockquote);
+  conn.recv(R"(
+    HTTP/1.1 204 No Content
+
+    )"_blockquote);
+
+  conn.sendHttpGet("/foo.txt");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 6
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-6"
+
+    corge
+  )"_blockquote);
+
+  // After the entry expires, the file is opened again.
+  dir->openFile(kj::Path({"foo.txt"}), kj::WriteMode::MODIFY)->writeAll("grault!");
+  test.wait(2);
+  conn.sendHttpGet("/foo.txt");
+  conn.recv(R"(
+    HTTP/1.1 200 OK
+    Content-Length: 7
+    Content-Type: application/octet-stream
+    Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-7"
+
+    grault!)"_blockquote);
+}
+
 KJ_TEST("Server: disk service allow dotfiles") {
   TestServer test(R"((
     services = [
@@ -3222,6 +3991,7 @@ KJ_TEST("Server: disk service allow dotfiles") {
     Content-Length: 6
     Content-Type: application/octet-stream
     Last-Modified: Thu, 01 Jan 1970 00:00:00 GMT
+    ETag: "0-6"
 
     waldo
   )"_blockquote);
@@ -26,8 +26,13 @@
 #include <workerd/util/http-util.h>
 #include <workerd/api/actor-state.h>
 #include <workerd/util/mimetype.h>
+#include <workerd/util/sqlite-kv-namespace.h>
 #include "workerd-api.h"
+#include "directory-lister.h"
+#include "open-file-cache.h"
+#include "connection-handoff.h"
 #include "workerd/io/hibernation-manager.h"
+#include <workerd/util/wait-list.h>
 #include <stdlib.h>
 
 namespace workerd::server {
@@ -86,6 +91,130 @@ static kj::String httpTime(kj::Date date) {
   return kj::heapString(buf, n);
 }
 
+// Parses a date in the format produced by httpTime() (the IMF-fixdate format from RFC 9110). The
+// obsolete RFC 850 and asctime formats are not accepted, which for conditional requests just
+// means the condition is ignored.
+static kj::Maybe<kj::Date> parseHttpTime(kj::StringPtr text) {
+  // e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+  if (text.size() != 29 || text[3] != ',' || text[4] != ' ' || text[7] != ' ' ||
+      text[11] != ' ' || text[16] != ' ' || text[19] != ':' || text[22] != ':' ||
+      !text.endsWith(" GMT")) {
+    return kj::none;
+  }
+
+  auto number = [&](size_t start, size_t size) -> kj::Maybe<int> {
+    int result = 0;
+    for (char c: text.slice(start, start + size)) {
+      if (c < '0' || c > '9') return kj::none;
+      result = result * 10 + (c - '0');
+    }
+    return result;
+  };
+
+  static constexpr kj::StringPtr MONTHS[] = {
+    "Jan"_kj, "Feb"_kj, "Mar"_kj, "Apr"_kj, "May"_kj, "Jun"_kj,
+    "Jul"_kj, "Aug"_kj, "Sep"_kj, "Oct"_kj, "Nov"_kj, "Dec"_kj,
+  };
+  kj::Maybe<int> month;
+  for (auto i: kj::zeroTo(kj::size(MONTHS))) {
+    if (text.slice(8, 11) == MONTHS[i].asArray()) month = static_cast<int>(i) + 1;
+  }
+
+  int y = KJ_UNWRAP_OR(number(12, 4), return kj::none);
+  int m = KJ_UNWRAP_OR(month, return kj::none);
+  int d = KJ_UNWRAP_OR(number(5, 2), return kj::none);
+  int hour = KJ_UNWRAP_OR(number(17, 2), return kj::none);
+  int minute = KJ_UNWRAP_OR(number(20, 2), return kj::none);
+  int second = KJ_UNWRAP_OR(number(23, 2), return kj::none);
+  if (d < 1 || d > 31 || hour > 23 || minute > 59 || second > 60) return kj::none;
+
+  // Days since the epoch for a date in the proleptic Gregorian calendar, as described in
+  // http://howardhinnant.github.io/date_algorithms.html#days_from_civil.
+  y -= m <= 2;
+  int era = (y >= 0 ? y : y - 399) / 400;
+  int yearOfEra = y - era * 400;
+  int dayOfYear = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+  int64_t days = static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+
+  return kj::UNIX_EPOCH + days * kj::DAYS + hour * kj::HOURS + minute * kj::MINUTES +
+      second * kj::SECONDS;
+}
+
+// Strips optional whitespace (spaces and tabs) from both ends of a header value element.
+static kj::ArrayPtr<const char> trimOws(kj::ArrayPtr<const char> text) {
+  while (text.size() > 0 && (text[0] == ' ' || text[0] == '\t')) {
+    text = text.slice(1, text.size());
+  }
+  while (text.size() > 0 && (text.back() == ' ' || text.back() == '\t')) {
+    text = text.first(text.size() - 1);
+  }
+  return text;
+}
+
+// Calls `func` with each trimmed element of a comma-separated header value.
+template <typename Func>
+static void forEachListElement(kj::StringPtr header, Func&& func) {
+  kj::ArrayPtr<const char> rest = header;
+  while (rest.size() > 0) {
+    kj::ArrayPtr<const char> element;
+    KJ_IF_SOME(comma, rest.findFirst(',')) {
+      element = rest.first(comma);
+      rest = rest.slice(comma + 1, rest.size());
+    } else {
+      element = rest;
+      rest = nullptr;
+    }
+    func(trimOws(element));
+  }
+}
+
+// Returns true if an `If-None-Match` header value matches `etag`. This uses the weak comparison
+// RFC 9110 requires for `If-None-Match`, i.e. a `W/` prefix is ignored.
+static bool ifNoneMatchMatches(kj::StringPtr header, kj::StringPtr etag) {
+  bool matched = false;
+  forEachListElement(header, [&](kj::ArrayPtr<const char> tag) {
+    if (tag == "*"_kj.asArray()) matched = true;
+    if (tag.size() >= 2 && tag[0] == 'W' && tag[1] == '/') tag = tag.slice(2, tag.size());
+    if (tag == etag.asArray()) matched = true;
+  });
+  return matched;
+}
+
+// Returns true if an `Accept-Encoding` header value allows `coding` (which must be lower-case),
+// either by name or through `*`, with a nonzero quality value.
+static bool acceptsEncoding(kj::StringPtr header, kj::StringPtr coding) {
+  kj::Maybe<bool> named;
+  bool wildcard = false;
+  forEachListElement(header, [&](kj::ArrayPtr<const char> element) {
+    auto name = element;
+    bool acceptable = true;
+    KJ_IF_SOME(semicolon, element.findFirst(';')) {
+      name = trimOws(element.first(semicolon));
+      auto param = trimOws(element.slice(semicolon + 1, element.size()));
+      if (param.size() >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+        // The quality value is zero if it has no nonzero digits, e.g. "0" or "0.000".
+        acceptable = false;
+        for (char c: param.slice(2, param.size())) {
+          if (c >= '1' && c <= '9') acceptable = true;
+        }
+      }
+    }
+
+    if (name == "*"_kj.asArray()) {
+      wildcard = acceptable;
+    } else if (name.size() == coding.size()) {
+      for (auto i: kj::indices(name)) {
+        char c = name[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        if (c != coding[i]) return;
+      }
+      named = acceptable;
+    }
+  });
+  return named.orDefault(wildcard);
+}
+
 static kj::Vector<char> escapeJsonString(kj::StringPtr text) {
   static const char HEXDIGITS[] = "0123456789abcdef";
   kj::Vector<char> escaped(text.size() + 1);
@@ -115,6 +244,20 @@ static kj::Vector<char> escapeJsonString(kj::StringPtr text) {
   return escaped;
 }
 
+static kj::StringPtr fsNodeTypeName(kj::FsNode::Type type) {
+  switch (type) {
+    case kj::FsNode::Type::FILE:             return "file";
+    case kj::FsNode::Type::DIRECTORY:        return "directory";
+    case kj::FsNode::Type::SYMLINK:          return "symlink";
+    case kj::FsNode::Type::BLOCK_DEVICE:     return "blockDevice";
+    case kj::FsNode::Type::CHARACTER_DEVICE: return "characterDevice";
+    case kj::FsNode::Type::NAMED_PIPE:       return "namedPipe";
+    case kj::FsNode::Type::SOCKET:           return "socket";
+    case kj::FsNode::Type::OTHER:            return "other";
+  }
+  return "other";
+}
+
 }  // namespace
 
 // =======================================================================================
@@ -123,7 +266,11 @@ Server::Server(kj::Filesystem& fs, kj::Timer& timer, kj::Network& network,
                kj::EntropySource& entropySource, Worker::ConsoleMode consoleMode,
                kj::Function<void(kj::String)> reportConfigError)
     : fs(fs), timer(timer), network(network), entropySource(entropySource),
-      reportConfigError(kj::mv(reportConfigError)), consoleMode(consoleMode), tasks(*this) {}
+      reportConfigError([this, report = kj::mv(reportConfigError)](kj::String error) mutable {
+        hadConfigErrors = true;
+        report(kj::mv(error));
+      }),
+      consoleMode(consoleMode), tasks(*this) {}
 
 Server::~Server() noexcept(false) {}
 
@@ -141,7 +288,9 @@ struct Server::GlobalContext {
         threadContext(server.timer, server.entropySource,
             headerTableBuilder, httpOverCapnpFactory,
             byteStreamFactory,
-            false /* isFiddle -- TODO(beta): support */),
+            false /* isFiddle -- TODO(beta): support */,
+            server.teeSpillDirectory.map(
+                [](kj::Own<const kj::Directory>& dir) -> const kj::Directory& { return *dir; })),
         headerTable(headerTableBuilder.getFutureTable()) {}
 };
 
@@ -756,16 +905,34 @@ class Server::DiskDirectoryService final: public Service, private WorkerInterfac
 public:
   DiskDirectoryService(config::DiskDirectory::Reader conf,
                        kj::Own<const kj::Directory> dir,
-                       kj::HttpHeaderTable::Builder& headerTableBuilder)
+                       kj::HttpHeaderTable::Builder& headerTableBuilder,
+                       kj::Timer& timer)
       : writable(*dir), readable(kj::mv(dir)), headerTable(headerTableBuilder.getFutureTable()),
         hLastModified(headerTableBuilder.add("Last-Modified")),
-        allowDotfiles(conf.getAllowDotfiles()) {}
+        hETag(headerTableBuilder.add("ETag")),
+        hIfNoneMatch(headerTableBuilder.add("If-None-Match")),
+        hIfModifiedSince(headerTableBuilder.add("If-Modified-Since")),
+        hAcceptEncoding(headerTableBuilder.add("Accept-Encoding")),
+        hContentEncoding(headerTableBuilder.add("Content-Encoding")),
+        hVary(headerTableBuilder.add("Vary")),
+        allowDotfiles(conf.getAllowDotfiles()),
+        precompressed(conf.getPrecompressed()),
+        openFiles(timer, conf.getOpenFileCacheSize()) {}
   DiskDirectoryService(config::DiskDirectory::Reader conf,
                        kj::Own<const kj::ReadableDirectory> dir,
-                       kj::HttpHeaderTable::Builder& headerTableBuilder)
+                       kj::HttpHeaderTable::Builder& headerTableBuilder,
+                       kj::Timer& timer)
       : readable(kj::mv(dir)), headerTable(headerTableBuilder.getFutureTable()),
         hLastModified(headerTableBuilder.add("Last-Modified")),
-        allowDotfiles(conf.getAllowDotfiles()) {}
+        hETag(headerTableBuilder.add("ETag")),
+        hIfNoneMatch(headerTableBuilder.add("If-None-Match")),
+        hIfModifiedSince(headerTableBuilder.add("If-Modified-Since")),
+        hAcceptEncoding(headerTableBuilder.add("Accept-Encoding")),
+        hContentEncoding(headerTableBuilder.add("Content-Encoding")),
+        hVary(headerTableBuilder.add("Vary")),
+        allowDotfiles(conf.getAllowDotfiles()),
+        precompressed(conf.getPrecompressed()),
+        openFiles(timer, conf.getOpenFileCacheSize()) {}
 
   kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
     return { this, kj::NullDisposer::instance };
@@ -782,7 +949,296 @@ private:
   kj::Own<const kj::ReadableDirectory> readable;
   kj::HttpHeaderTable& headerTable;
   kj::HttpHeaderId hLastModified;
+  kj::HttpHeaderId hETag;
+  kj::HttpHeaderId hIfNoneMatch;
+  kj::HttpHeaderId hIfModifiedSince;
+  kj::HttpHeaderId hAcceptEncoding;
+  kj::HttpHeaderId hContentEncoding;
+  kj::HttpHeaderId hVary;
   bool allowDotfiles;
+  bool precompressed;
+  OpenFileCache openFiles;
+
+  struct Precompressed {
+    kj::StringPtr coding;
+    kj::StringPtr extension;
+  };
+
+  // Content codings that may be served from sibling files when `precompressed` is enabled, in
+  // order of preference.
+  static constexpr Precompressed PRECOMPRESSED_CODINGS[] = {
+    { "br"_kj, ".br"_kj },
+    { "gzip"_kj, ".gz"_kj },
+  };
+
+  // More ranges than this in one request are answered with the whole file, to bound the work a
+  // single request can cause.
+  static constexpr size_t MAX_RANGES = 32;
+
+  // Directory listings are written in chunks of about this size.
+  static constexpr size_t LISTING_CHUNK_SIZE = 16 * 1024;
+
+  // Upper bound on `?limit=` for paginated directory listings.
+  static constexpr uint64_t MAX_LISTING_PAGE_SIZE = 10'000;
+
+  // Upper bound on the size of each read when streaming a file to the client. Two buffers of this
+  // size are allocated per response, or less if the file is smaller.
+  static constexpr size_t FILE_PUMP_BUFFER_SIZE = 512 * 1024;
+
+  // Writes `size` bytes of `file` starting at `offset` to `out`.
+  //
+  // kj::FileInputStream::pumpTo() goes through KJ's generic pump, which copies through a 4 KiB
+  // buffer. File reads are synchronous, so instead we read in large chunks and fill the next
+  // chunk while the previous write is still in flight.
+  static kj::Promise<void> pumpFile(const kj::ReadableFile& file, uint64_t offset, uint64_t size,
+                                    kj::AsyncOutputStream& out) {
+    size_t bufferSize = kj::min(size, FILE_PUMP_BUFFER_SIZE);
+    auto current = kj::heapArray<kj::byte>(bufferSize);
+    auto next = kj::heapArray<kj::byte>(bufferSize);
+    kj::Promise<void> writing = kj::READY_NOW;
+
+    while (size > 0) {
+      auto amount = file.read(offset, current.first(kj::min(size, current.size())));
+      // The file was truncated after we sent Content-Length. Stop here, and let the HTTP layer
+      // report the short body.
+      if (amount == 0) break;
+
+      co_await writing;
+      writing = out.write(current.begin(), amount);
+      kj::swap(current, next);
+      offset += amount;
+      size -= amount;
+    }
+
+    co_await writing;
+  }
+
+  // Writes `size` bytes of the entry's file starting at `offset`, from memory if possible.
+  static kj::Promise<void> writeFileRange(OpenFileCache::Entry& entry, uint64_t offset,
+                                          uint64_t size, kj::AsyncOutputStream& out) {
+    KJ_IF_SOME(content, entry.content) {
+      return out.write(content.begin() + offset, size);
+    }
+    return pumpFile(*entry.file, offset, size, out);
+  }
+
+  // Serves a regular file for a GET or HEAD request, honoring conditional and range headers.
+  // `contentEncoding` is set when the file is a precompressed sibling of the requested path.
+  kj::Promise<void> serveFile(OpenFileCache::Entry& entry, kj::Maybe<kj::StringPtr> contentEncoding,
+                              kj::HttpMethod method, const kj::HttpHeaders& requestHeaders,
+                              kj::HttpService::Response& response) {
+    auto& meta = entry.meta;
+
+    // Per RFC 9110 section 13.2.2, If-Modified-Since is ignored when If-None-Match is present, and
+    // both are evaluated before Range.
+    bool notModified = false;
+    KJ_IF_SOME(header, requestHeaders.get(hIfNoneMatch)) {
+      notModified = ifNoneMatchMatches(header, entry.etag);
+    } else KJ_IF_SOME(header, requestHeaders.get(hIfModifiedSince)) {
+      KJ_IF_SOME(date, parseHttpTime(header)) {
+        // HTTP dates only have one-second resolution.
+        auto lastModified = kj::UNIX_EPOCH +
+            (meta.lastModified - kj::UNIX_EPOCH) / kj::SECONDS * kj::SECONDS;
+        notModified = lastModified <= date;
+      }
+    }
+    if (notModified) {
+      kj::HttpHeaders headers(headerTable);
+      headers.set(hLastModified, httpTime(meta.lastModified));
+      headers.set(hETag, entry.etag);
+      if (precompressed) headers.set(hVary, "Accept-Encoding");
+      response.send(304, "Not Modified", headers);
+      co_return;
+    }
+
+    // If this is a GET request with a Range header, return partial content for the satisfiable
+    // ranges, as multipart/byteranges if there is more than one.
+    kj::Array<kj::HttpByteRange> ranges;
+    if (method == kj::HttpMethod::GET) {
+      KJ_IF_SOME(header, requestHeaders.get(kj::HttpHeaderId::RANGE)) {
+        KJ_SWITCH_ONEOF(kj::tryParseHttpRangeHeader(header.asArray(), meta.size)) {
+          KJ_CASE_ONEOF(parsed, kj::Array<kj::HttpByteRange>) {
+            KJ_ASSERT(parsed.size() > 0);
+            if (parsed.size() <= MAX_RANGES) ranges = kj::mv(parsed);
+          }
+          KJ_CASE_ONEOF(_, kj::HttpEverythingRange) {}
+          KJ_CASE_ONEOF(_, kj::HttpUnsatisfiableRange) {
+            kj::HttpHeaders headers(headerTable);
+            headers.set(kj::HttpHeaderId::CONTENT_RANGE, kj::str("bytes */", meta.size));
+            co_return co_await response.sendError(416, "Range Not Satisfiable", headers);
+          }
+        }
+      }
+    }
+
+    kj::HttpHeaders headers(headerTable);
+    auto contentType = MimeType::OCTET_STREAM.toString();
+    headers.set(kj::HttpHeaderId::CONTENT_TYPE, contentType);
+    headers.set(hLastModified, httpTime(meta.lastModified));
+    headers.set(hETag, entry.etag);
+    KJ_IF_SOME(coding, contentEncoding) {
+      headers.set(hContentEncoding, coding);
+    }
+    if (precompressed) headers.set(hVary, "Accept-Encoding");
+
+    // We explicitly set the Content-Length header because if we don't, and we were called
+    // by a local Worker (without an actual HTTP connection in between), then the Worker
+    // will not see a Content-Length header, but being able to query the content length
+    // (especially with HEAD requests) is quite useful.
+    // TODO(cleanup): Arguably the implementation of `fetch()` should be adjusted so that
+    //   if no `Content-Length` header is returned, but the body size is known via the KJ
+    //   HTTP API, then the header shoud be filled in automatically. Unclear if this is safe
+    //   to change without a compat flag.
+
+    if (method == kj::HttpMethod::HEAD) {
+      headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(meta.size));
+      response.send(200, "OK", headers, meta.size);
+      co_return;
+    } else if (ranges.size() == 1) {
+      auto& r = ranges[0];
+      KJ_ASSERT(r.start <= r.end);
+      auto rangeSize = r.end - r.start + 1;
+      headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(rangeSize));
+      headers.set(kj::HttpHeaderId::CONTENT_RANGE,
+        kj::str("bytes ", r.start, "-", r.end, "/", meta.size));
+      auto out = response.send(206, "Partial Content", headers, rangeSize);
+
+      co_return co_await writeFileRange(entry, r.start, rangeSize, *out);
+    } else if (ranges.size() > 1) {
+      // The ETag is unlikely to appear in the file itself, so it makes a good boundary, and
+      // unlike a random one it keeps responses reproducible.
+      auto boundary = kj::str("byteranges-", entry.etag.slice(1, entry.etag.size() - 1));
+      auto partHeaders = KJ_MAP(r, ranges) {
+        KJ_ASSERT(r.start <= r.end);
+        return kj::str("\r\n--", boundary, "\r\n"
+            "Content-Type: ", contentType, "\r\n"
+            "Content-Range: bytes ", r.start, "-", r.end, "/", meta.size, "\r\n\r\n");
+      };
+      auto trailer = kj::str("\r\n--", boundary, "--\r\n");
+
+      uint64_t length = trailer.size();
+      for (auto i: kj::indices(ranges)) {
+        length += partHeaders[i].size() + (ranges[i].end - ranges[i].start + 1);
+      }
+
+      headers.set(kj::HttpHeaderId::CONTENT_TYPE,
+                  kj::str("multipart/byteranges; boundary=", boundary));
+      headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(length));
+      auto out = response.send(206, "Partial Content", headers, length);
+
+      for (auto i: kj::indices(ranges)) {
+        auto& r = ranges[i];
+        co_await out->write(partHeaders[i].begin(), partHeaders[i].size());
+        co_await writeFileRange(entry, r.start, r.end - r.start + 1, *out);
+      }
+      co_return co_await out->write(trailer.begin(), trailer.size());
+    } else {
+      headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(meta.size));
+      auto out = response.send(200, "OK", headers, meta.size);
+
+      co_return co_await writeFileRange(entry, 0, meta.size, *out);
+    }
+  }
+
+  // Serves a JSON listing of a directory for a GET or HEAD request. A full listing is written in
+  // chunks as entries are read from the directory, in the order the directory returns them, so
+  // memory use doesn't grow with the size of the directory.
+  //
+  // If the query has a `limit` and/or `cursor` parameter, at most `limit` entries are returned,
+  // sorted by name and wrapped as `{"entries":[...],"cursor":"..."}`. `cursor` is present only if
+  // there are more entries, and can be passed back to get the next page. Each page holds only
+  // `limit` entries in memory, but reads the whole directory to find them, so paging through a
+  // directory of n entries takes O(n) time per page.
+  kj::Promise<void> serveDirectory(kj::Own<const kj::ReadableDirectory> dir,
+                                   kj::FsNode::Metadata meta, kj::HttpMethod method,
+                                   kj::ArrayPtr<const kj::Url::QueryParam> query,
+                                   kj::HttpService::Response& response) {
+    bool paginated = false;
+    uint64_t pageSize = MAX_LISTING_PAGE_SIZE;
+    kj::Maybe<kj::StringPtr> cursor;
+    for (auto& param: query) {
+      if (param.name == "limit") {
+        paginated = true;
+        pageSize = KJ_UNWRAP_OR(param.value.tryParseAs<uint64_t>(), {
+          co_return co_await response.sendError(400, "Bad Request", headerTable);
+        });
+        if (pageSize == 0) {
+          co_return co_await response.sendError(400, "Bad Request", headerTable);
+        }
+        pageSize = kj::min(pageSize, MAX_LISTING_PAGE_SIZE);
+      } else if (param.name == "cursor") {
+        paginated = true;
+        cursor = param.value;
+      }
+    }
+
+    kj::HttpHeaders headers(headerTable);
+    headers.set(kj::HttpHeaderId::CONTENT_TYPE, MimeType::JSON.toString());
+    headers.set(hLastModified, httpTime(meta.lastModified));
+
+    // The size isn't known until the whole listing has been written.
+    auto out = response.send(200, "OK", headers);
+
+    if (method == kj::HttpMethod::HEAD) {
+      co_return;
+    }
+
+    kj::Own<DirectoryLister> lister;
+    kj::Maybe<kj::String> nextCursor;
+    if (paginated) {
+      auto page = readDirectoryPage(*DirectoryLister::open(*dir), pageSize, cursor, allowDotfiles);
+      lister = kj::heap<ArrayDirectoryLister>(kj::mv(page.entries));
+      nextCursor = kj::mv(page.cursor);
+    } else {
+      lister = DirectoryLister::open(*dir);
+    }
+
+    kj::Vector<char> buffer(LISTING_CHUNK_SIZE + 256);
+    buffer.addAll(paginated ? "{\"entries\":["_kj : "["_kj);
+
+    bool first = true;
+    for (;;) {
+      auto entry = KJ_UNWRAP_OR(lister->next(), break);
+      if (!allowDotfiles && entry.name.startsWith(".")) {
+        continue;
+      }
+
+      if (!first) buffer.add(',');
+      first = false;
+      buffer.addAll("{\"name\":\""_kj);
+      buffer.addAll(escapeJsonString(entry.name));
+      buffer.addAll("\",\"type\":\""_kj);
+      buffer.addAll(fsNodeTypeName(entry.type));
+      buffer.addAll("\"}"_kj);
+
+      if (buffer.size() >= LISTING_CHUNK_SIZE) {
+        co_await out->write(buffer.begin(), buffer.size());
+        buffer.clear();
+      }
+    }
+
+    buffer.add(']');
+    if (paginated) {
+      KJ_IF_SOME(c, nextCursor) {
+        buffer.addAll(",\"cursor\":\""_kj);
+        buffer.addAll(escapeJsonString(c));
+        buffer.add('"');
+      }
+      buffer.add('}');
+    }
+    co_await out->write(buffer.begin(), buffer.size());
+  }
+
+  // Returns the entry for `path` if it is a regular file, from the cache if possible.
+  kj::Maybe<kj::Own<OpenFileCache::Entry>> tryOpenRegularFile(kj::PathPtr path) {
+    auto cached = openFiles.find(path);
+    if (cached != kj::none) return kj::mv(cached);
+
+    auto file = KJ_UNWRAP_OR(readable->tryOpenFile(path), return kj::none);
+    auto meta = file->stat();
+    if (meta.type != kj::FsNode::Type::FILE) return kj::none;
+    return openFiles.insert(path, kj::mv(file), meta);
+  }
 
   kj::Promise<void> request(
       kj::HttpMethod method, kj::StringPtr urlStr, const kj::HttpHeaders& requestHeaders,
@@ -813,6 +1269,25 @@ private:
         co_return co_await response.sendError(404, "Not Found", headerTable);
       }
 
+      if (precompressed && path.size() > 0) {
+        KJ_IF_SOME(acceptEncoding, requestHeaders.get(hAcceptEncoding)) {
+          for (auto& candidate: PRECOMPRESSED_CODINGS) {
+            if (!acceptsEncoding(acceptEncoding, candidate.coding)) continue;
+            auto sibling = tryOpenRegularFile(
+                path.parent().append(kj::str(path.basename()[0], candidate.extension)));
+            KJ_IF_SOME(entry, sibling) {
+              co_return co_await serveFile(
+                  *entry, candidate.coding, method, requestHeaders, response);
+            }
+          }
+        }
+      }
+
+      auto cached = openFiles.find(path);
+      KJ_IF_SOME(entry, cached) {
+        co_return co_await serveFile(*entry, kj::none, method, requestHeaders, response);
+      }
+
       auto file = KJ_UNWRAP_OR(readable->tryOpenFile(path), {
         co_return co_await response.sendError(404, "Not Found", headerTable);
       });
@@ -821,106 +1296,13 @@ private:
 
       switch (meta.type) {
         case kj::FsNode::Type::FILE: {
-          // If this is a GET request with a Range header, return partial content if a single
-          // satisfiable range is specified.
-          // TODO(someday): consider supporting multiple ranges with multipart/byteranges
-          kj::Maybe<kj::HttpByteRange> range;
-          if (method == kj::HttpMethod::GET) {
-            KJ_IF_SOME(header, requestHeaders.get(kj::HttpHeaderId::RANGE)) {
-              KJ_SWITCH_ONEOF(kj::tryParseHttpRangeHeader(header.asArray(), meta.size)) {
-                KJ_CASE_ONEOF(ranges, kj::Array<kj::HttpByteRange>) {
-                  KJ_ASSERT(ranges.size() > 0);
-                  if (ranges.size() == 1) range = ranges[0];
-                }
-                KJ_CASE_ONEOF(_, kj::HttpEverythingRange) {}
-                KJ_CASE_ONEOF(_, kj::HttpUnsatisfiableRange) {
-                  kj::HttpHeaders headers(headerTable);
-                  headers.set(kj::HttpHeaderId::CONTENT_RANGE, kj::str("bytes */", meta.size));
-                  co_return co_await response.sendError(416, "Range Not Satisfiable", headers);
-                }
-              }
-            }
-          }
-
-          kj::HttpHeaders headers(headerTable);
-          headers.set(kj::HttpHeaderId::CONTENT_TYPE, MimeType::OCTET_STREAM.toString());
-          headers.set(hLastModified, httpTime(meta.lastModified));
-
-          // We explicitly set the Content-Length header because if we don't, and we were called
-          // by a local Worker (without an actual HTTP connection in between), then the Worker
-          // will not see a Content-Length header, but being able to query the content length
-          // (especially with HEAD requests) is quite useful.
-          // TODO(cleanup): Arguably the implementation of `fetch()` should be adjusted so that
-          //   if no `Content-Length` header is returned, but the body size is known via the KJ
-          //   HTTP API, then the header shoud be filled in automatically. Unclear if this is safe
-          //   to change without a compat flag.
-
-          if (method == kj::HttpMethod::HEAD) {
-            headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(meta.size));
-            response.send(200, "OK", headers, meta.size);
-            co_return;
-          } else KJ_IF_SOME(r, range) {
-            KJ_ASSERT(r.start <= r.end);
-            auto rangeSize = r.end - r.start + 1;
-            headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(rangeSize));
-            headers.set(kj::HttpHeaderId::CONTENT_RANGE,
-              kj::str("bytes ", r.start, "-", r.end, "/", meta.size));
-            auto out = response.send(206, "Partial Content", headers, rangeSize);
-
-            auto in = kj::heap<kj::FileInputStream>(*file, r.start);
-            co_return co_await in->pumpTo(*out, rangeSize).ignoreResult();
-          } else {
-            headers.set(kj::HttpHeaderId::CONTENT_LENGTH, kj::str(meta.size));
-            auto out = response.send(200, "OK", headers, meta.size);
-
-            auto in = kj::heap<kj::FileInputStream>(*file);
-            co_return co_await in->pumpTo(*out, meta.size).ignoreResult();
-          }
+          auto entry = openFiles.insert(path, kj::mv(file), meta);
+          co_return co_await serveFile(*entry, kj::none, method, requestHeaders, response);
         }
         case kj::FsNode::Type::DIRECTORY: {
           // Whoooops, we opened a directory. Back up and start over.
-
-          auto dir = readable->openSubdir(path);
-
-          kj::HttpHeaders headers(headerTable);
-          headers.set(kj::HttpHeaderId::CONTENT_TYPE, MimeType::JSON.toString());
-          headers.set(hLastModified, httpTime(meta.lastModified));
-
-          // We intentionally don't provide the expected size here in order to reserve the right
-          // to switch to streaming directory listing in the future.
-          auto out = response.send(200, "OK", headers);
-
-          if (method == kj::HttpMethod::HEAD) {
-            co_return;
-          } else {
-            auto entries = dir->listEntries();
-            kj::Vector<kj::String> jsonEntries(entries.size());
-            for (auto& entry: entries) {
-              if (!allowDotfiles && entry.name.startsWith(".")) {
-                continue;
-              }
-
-              kj::StringPtr type = "other";
-              switch (entry.type) {
-                case kj::FsNode::Type::FILE:             type = "file"           ; break;
-                case kj::FsNode::Type::DIRECTORY:        type = "directory"      ; break;
-                case kj::FsNode::Type::SYMLINK:          type = "symlink"        ; break;
-                case kj::FsNode::Type::BLOCK_DEVICE:     type = "blockDevice"    ; break;
-                case kj::FsNode::Type::CHARACTER_DEVICE: type = "characterDevice"; break;
-                case kj::FsNode::Type::NAMED_PIPE:       type = "namedPipe"      ; break;
-                case kj::FsNode::Type::SOCKET:           type = "socket"         ; break;
-                case kj::FsNode::Type::OTHER:            type = "other"          ; break;
-              }
-
-              jsonEntries.add(kj::str(
-                  "{\"name\":\"", escapeJsonString(entry.name), "\","
-                  "\"type\":\"", type, "\"}"));
-            };
-
-            auto content = kj::str('[', kj::strArray(jsonEntries, ","), ']');
-
-            co_return co_await out->write(content.begin(), content.size());
-          }
+          co_return co_await serveDirectory(
+              readable->openSubdir(path), meta, method, url.query, response);
         }
         default:
           co_return co_await response.sendError(406, "Not Acceptable", headerTable);
@@ -941,6 +1323,8 @@ private:
       co_await requestBody.pumpTo(*stream);
 
       replacer->commit();
+      // Cheaper than working out which cached entries the write affected, and writes are rare.
+      openFiles.clear();
       kj::HttpHeaders headers(headerTable);
       response.send(204, "No Content", headers);
       co_return;
@@ -954,6 +1338,8 @@ private:
       }
 
       auto found = w.tryRemove(path);
+      // The path may have been a directory, so it's not enough to drop just its own entry.
+      openFiles.clear();
 
       kj::HttpHeaders headers(headerTable);
       if (found) {
@@ -1015,7 +1401,7 @@ kj::Own<Server::Service> Server::makeDiskDirectoryService(
       return makeInvalidConfigService();
     });
 
-    return kj::heap<DiskDirectoryService>(conf, kj::mv(openDir), headerTableBuilder);
+    return kj::heap<DiskDirectoryService>(conf, kj::mv(openDir), headerTableBuilder, timer);
   } else {
     auto openDir = KJ_UNWRAP_OR(fs.getRoot().tryOpenSubdir(kj::mv(path)), {
       reportConfigError(kj::str(
@@ -1023,12 +1409,93 @@ kj::Own<Server::Service> Server::makeDiskDirectoryService(
       return makeInvalidConfigService();
     });
 
-    return kj::heap<DiskDirectoryService>(conf, kj::mv(openDir), headerTableBuilder);
+    return kj::heap<DiskDirectoryService>(conf, kj::mv(openDir), headerTableBuilder, timer);
   }
 }
 
 // =======================================================================================
 
+// Service used when the service is configured as a KV namespace. Workers' KV bindings call into
+// the namespace directly (see WorkerService::getLocalKvNamespace()), so there is no HTTP interface.
+class Server::KvStorageService final: public Service {
+public:
+  KvStorageService(Server& server, kj::StringPtr name, config::KvStorage::Reader conf)
+      : server(server), name(kj::str(name)), conf(conf) {}
+
+  void link() override {
+    if (conf.isLocalDisk()) {
+      kj::StringPtr diskName = conf.getLocalDisk();
+      KJ_IF_SOME(svc, server.services.find(diskName)) {
+        auto diskSvc = dynamic_cast<DiskDirectoryService*>(svc.get());
+        if (diskSvc == nullptr) {
+          server.reportConfigError(kj::str("service ", name, ": kv config refers to the "
+              "service \"", diskName, "\", but that service is not a local disk service."));
+        } else KJ_IF_SOME(dir, diskSvc->getWritable()) {
+          open(dir);
+        } else {
+          server.reportConfigError(kj::str("service ", name, ": kv config refers to the disk "
+              "service \"", diskName, "\", but that service is defined read-only."));
+        }
+      } else {
+        server.reportConfigError(kj::str("service ", name, ": kv config refers to a service \"",
+            diskName, "\", but no such service is defined."));
+      }
+    } else {
+      auto& dir = *inMemoryDir.emplace(kj::newInMemoryDirectory(kj::nullClock()));
+      open(dir);
+    }
+  }
+
+  kj::Own<WorkerInterface> startRequest(IoChannelFactory::SubrequestMetadata metadata) override {
+    // lookupService() refuses to link anything but a kvNamespace binding to this service, and
+    // those only fall back to HTTP when the namespace failed to open, which was reported as a
+    // config error.
+    JSG_FAIL_REQUIRE(Error, "KV namespace \"", name, "\" is not available due to a config error.");
+  }
+
+  bool hasHandler(kj::StringPtr handlerName) override {
+    return false;
+  }
+
+  // Null if the config was invalid.
+  kj::Maybe<SqliteKvNamespace&> getNamespace() {
+    return ns.map([](kj::Own<SqliteKvNamespace>& ns) -> SqliteKvNamespace& { return *ns; });
+  }
+
+private:
+  Server& server;
+  kj::String name;
+  config::KvStorage::Reader conf;
+
+  kj::Maybe<kj::Own<const kj::Directory>> inMemoryDir;
+  kj::Maybe<kj::Own<SqliteDatabase::Vfs>> vfs;
+  kj::Maybe<kj::Own<SqliteDatabase>> db;
+  kj::Maybe<kj::Own<SqliteKvNamespace>> ns;
+
+  void open(const kj::Directory& dir) {
+    auto& v = *vfs.emplace(kj::heap<SqliteDatabase::Vfs>(dir));
+    auto& d = *db.emplace(kj::heap<SqliteDatabase>(v, kj::Path({kj::str(name, ".sqlite")}),
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY));
+    ns = kj::heap<SqliteKvNamespace>(d, kj::systemPreciseCalendarClock());
+  }
+};
+
+kj::Own<Server::Service> Server::makeKvStorageService(
+    kj::StringPtr name, config::KvStorage::Reader conf) {
+  switch (conf.which()) {
+    case config::KvStorage::IN_MEMORY:
+    case config::KvStorage::LOCAL_DISK:
+      return kj::heap<KvStorageService>(*this, name, conf);
+  }
+
+  reportConfigError(kj::str(
+      "Encountered unknown kv storage type in service \"", name,
+      "\". Was the config compiled with a newer version of the schema?"));
+  return makeInvalidConfigService();
+}
+
+// =======================================================================================
+
 // This class exists to update the InspectorService's table of isolates when a config
 // has multiple services. The InspectorService exists on the stack of it's own thread and
 // initializes state that is bound to the thread, e.g. a http server and an event loop.
@@ -1477,12 +1944,37 @@ public:
         }
       }
 
+      // Returns how long this actor may stay inactive before it is evicted.
+      kj::Promise<kj::Duration> getEvictionDelay() {
+        const EvictionPolicy* policy = nullptr;
+        KJ_SWITCH_ONEOF(parent.config) {
+          KJ_CASE_ONEOF(c, Durable) {
+            policy = &c.eviction;
+          }
+          KJ_CASE_ONEOF(c, Ephemeral) {
+            policy = &c.eviction;
+          }
+        }
+
+        KJ_IF_SOME(adaptive, policy->adaptive) {
+          // Keep actors around longer while there's plenty of memory, and evict them sooner as
+          // the isolate's heap approaches the budget. Measuring the heap requires the isolate lock.
+          auto worker = kj::atomicAddRef(*parent.service.worker);
+          Worker::AsyncLock asyncLock = co_await worker->takeAsyncLockWithoutRequest(nullptr);
+          Worker::Lock lock(*worker, asyncLock);
+          v8::HeapStatistics stats;
+          lock.getIsolate()->GetHeapStatistics(&stats);
+          co_return adaptive.getTimeout(stats.used_heap_size() + stats.external_memory());
+        }
+
+        co_return policy->timeout;
+      }
+
       // Processes the eviction of the Durable Object and hibernates active websockets.
       kj::Promise<void> handleShutdown() {
-        // After 10 seconds of inactivity, we destroy the Worker::Actor and hibernate any active
-        // JS WebSockets.
-        // TODO(someday): We could make this timeout configurable to make testing less burdensome.
-        co_await timer.afterDelay(10 * kj::SECONDS);
+        // After the configured period of inactivity, we destroy the Worker::Actor and hibernate
+        // any active JS WebSockets.
+        co_await timer.afterDelay(co_await getEvictionDelay());
         KJ_IF_SOME(onBroken, parent.onBrokenTasks.findEntry(getKey())) {
           // Cancel the onBroken promise, since we're about to destroy the actor anyways and don't
           // want to trigger it.
@@ -1746,9 +2238,16 @@ public:
                 auto db = kj::heap<SqliteDatabase>(*as,
                     kj::Path({d.uniqueKey, kj::str(idPtr, ".sqlite")}),
                     kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT);
+                auto groupCommit = d.groupCommit.map([&](const GroupCommit& gc) {
+                  return ActorSqlite::GroupCommitOptions {
+                    .timer = timer,
+                    .window = gc.window,
+                    .maxBytes = gc.maxBytes,
+                  };
+                });
                 return kj::heap<ActorSqlite>(kj::mv(db), outputGate,
                     []() -> kj::Promise<void> { return kj::READY_NOW; },
-                    *sqliteHooks).attach(kj::mv(sqliteHooks));
+                    *sqliteHooks, kj::mv(groupCommit)).attach(kj::mv(sqliteHooks));
               } else {
                 // Create an ActorCache backed by a fake, empty storage. Elsewhere, we configure
                 // ActorCache never to flush, so this effectively creates in-memory storage.
@@ -1773,12 +2272,22 @@ public:
           // work for local development we need to pass an event type.
           static constexpr uint16_t hibernationEventTypeId = 8;
 
+          size_t hibernatableWebSocketLimit = 0;
+          KJ_SWITCH_ONEOF(config) {
+            KJ_CASE_ONEOF(c, Durable) {
+              hibernatableWebSocketLimit = c.hibernatableWebSocketLimit;
+            }
+            KJ_CASE_ONEOF(c, Ephemeral) {
+              hibernatableWebSocketLimit = c.hibernatableWebSocketLimit;
+            }
+          }
+
           actorContainer->actor.emplace(
               kj::refcounted<Worker::Actor>(
                   *service.worker, actorContainer->getTracker(), kj::str(idPtr), true,
                   kj::mv(makeActorCache), className, kj::mv(makeStorage), lock, kj::mv(loopback),
                   timerChannel, kj::refcounted<ActorObserver>(), actorContainer->tryGetManagerRef(),
-                  hibernationEventTypeId));
+                  hibernationEventTypeId, hibernatableWebSocketLimit));
 
           // If the actor becomes broken, remove it from the map, so a new one will be created
           // next time.
@@ -1884,6 +2393,17 @@ private:
     return channels.subrequest[channel]->startRequest(kj::mv(metadata));
   }
 
+  kj::Maybe<SqliteKvNamespace&> getLocalKvNamespace(uint channel) override {
+    auto& channels = KJ_REQUIRE_NONNULL(ioChannels.tryGet<LinkedIoChannels>(),
+        "link() has not been called");
+
+    KJ_REQUIRE(channel < channels.subrequest.size(), "invalid subrequest channel number");
+    if (auto kv = dynamic_cast<KvStorageService*>(channels.subrequest[channel])) {
+      return kv->getNamespace();
+    }
+    return kj::none;
+  }
+
   capnp::Capability::Client getCapability(uint channel) override {
     KJ_FAIL_REQUIRE("no capability channels");
   }
@@ -2061,6 +2581,9 @@ private:
 struct FutureSubrequestChannel {
   config::ServiceDesignator::Reader designator;
   kj::String errorContext;
+
+  // Only kvNamespace bindings may target a `kv` service.
+  bool allowKv = false;
 };
 
 struct FutureActorChannel {
@@ -2268,13 +2791,21 @@ static kj::Maybe<WorkerdApiIsolate::Global> createBinding(
     }
 
     case config::Worker::Binding::KV_NAMESPACE: {
+      auto designator = binding.getKvNamespace();
       uint channel = (uint)subrequestChannels.size() + IoContext::SPECIAL_SUBREQUEST_CHANNEL_COUNT;
       subrequestChannels.add(FutureSubrequestChannel {
-        binding.getKvNamespace(),
-        kj::mv(errorContext)
+        designator,
+        kj::mv(errorContext),
+        true
       });
 
-      return makeGlobal(Global::KvNamespace{.subrequestChannel = channel});
+      return makeGlobal(Global::KvNamespace{
+        .subrequestChannel = channel,
+        .readCacheBytes = conf.getKvReadCache().getMaxBytes(),
+        .readCacheNamespace = designator.hasEntrypoint()
+            ? kj::str(designator.getName(), ':', designator.getEntrypoint())
+            : kj::str(designator.getName()),
+      });
     }
 
     case config::Worker::Binding::R2_BUCKET: {
@@ -2432,20 +2963,29 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
   // IsolateLimitEnforcer that enforces no limits.
   class NullIsolateLimitEnforcer final: public IsolateLimitEnforcer {
   public:
+    explicit NullIsolateLimitEnforcer(config::Worker::DurableObjectCacheLimits::Reader cacheLimits)
+        : cacheSoftLimit(cacheLimits.getSoftLimitBytes()),
+          cacheHardLimit(cacheLimits.getHardLimitBytes()),
+          cacheStaleTimeout(cacheLimits.getStaleTimeoutMs() * kj::MILLISECONDS),
+          cacheShardCount(cacheLimits.getShardCount()),
+          cacheSecondChance(cacheLimits.getSecondChance()) {}
+
     v8::Isolate::CreateParams getCreateParams() override { return {}; }
     void customizeIsolate(v8::Isolate* isolate) override {}
     ActorCacheSharedLruOptions getActorCacheLruOptions() override {
-      // TODO(someday): Make this configurable?
       return {
-        .softLimit = 16 * (1ull << 20), // 16 MiB
-        .hardLimit = 128 * (1ull << 20), // 128 MiB
-        .staleTimeout = 30 * kj::SECONDS,
+        .softLimit = cacheSoftLimit,
+        .hardLimit = cacheHardLimit,
+        .staleTimeout = cacheStaleTimeout,
         .dirtyListByteLimit = 8 * (1ull << 20), // 8 MiB
         .maxKeysPerRpc = 128,
 
         // For now, we use `neverFlush` to implement in-memory-only actors.
         // See WorkerService::getActor().
-        .neverFlush = true
+        .neverFlush = true,
+
+        .shardCount = cacheShardCount,
+        .secondChance = cacheSecondChance
       };
     }
     kj::Own<void> enterStartupJs(
@@ -2467,10 +3007,26 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
     void completedRequest(kj::StringPtr id) const override {}
     bool exitJs(jsg::Lock& lock) const override { return false; }
     void reportMetrics(IsolateObserver& isolateMetrics) const override {}
+
+  private:
+    size_t cacheSoftLimit;
+    size_t cacheHardLimit;
+    kj::Duration cacheStaleTimeout;
+    uint cacheShardCount;
+    bool cacheSecondChance;
   };
 
+  auto cacheLimits = conf.getDurableObjectCacheLimits();
+  if (cacheLimits.getHardLimitBytes() < cacheLimits.getSoftLimitBytes()) {
+    errorReporter.addError(kj::str(
+        "durableObjectCacheLimits.hardLimitBytes must not be less than softLimitBytes."));
+  }
+  if (cacheLimits.getShardCount() == 0) {
+    errorReporter.addError(kj::str("durableObjectCacheLimits.shardCount must be at least 1."));
+  }
+
   auto observer = kj::atomicRefcounted<IsolateObserver>();
-  auto limitEnforcer = kj::heap<NullIsolateLimitEnforcer>();
+  auto limitEnforcer = kj::heap<NullIsolateLimitEnforcer>(cacheLimits);
   auto api = kj::heap<WorkerdApiIsolate>(globalContext->v8System,
       featureFlags.asReader(), *limitEnforcer, kj::atomicAddRef(*observer));
   auto inspectorPolicy = Worker::Isolate::InspectorPolicy::DISALLOW;
@@ -2530,7 +3086,34 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
   auto linkCallback =
       [this, name, conf, subrequestChannels = kj::mv(subrequestChannels),
        actorChannels = kj::mv(actorChannels)](WorkerService& workerService) mutable {
-    WorkerService::LinkedIoChannels result{.alarmScheduler = *alarmScheduler};
+    // Objects with on-disk storage keep their alarms in a database on the same disk, so that the
+    // alarms survive restarts. Others use the in-memory scheduler.
+    AlarmScheduler* scheduler = alarmScheduler.get();
+    kj::Maybe<kj::Own<SqliteDatabase::Vfs>> actorStorage;
+
+    auto actorStorageConf = conf.getDurableObjectStorage();
+    if (actorStorageConf.isLocalDisk()) {
+      kj::StringPtr diskName = actorStorageConf.getLocalDisk();
+      KJ_IF_SOME(svc, this->services.find(actorStorageConf.getLocalDisk())) {
+        auto diskSvc = dynamic_cast<DiskDirectoryService*>(svc.get());
+        if (diskSvc == nullptr) {
+          reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
+              "to the service \"", diskName, "\", but that service is not a local disk service."));
+        } else KJ_IF_SOME(dir, diskSvc->getWritable()) {
+          actorStorage = kj::heap<SqliteDatabase::Vfs>(dir);
+          scheduler = &getDiskAlarmScheduler(diskName, dir);
+        } else {
+          reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
+              "to the disk service \"", diskName, "\", but that service is defined read-only."));
+        }
+      } else {
+        reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
+            "to a service \"", diskName, "\", but no such service is defined."));
+      }
+    }
+
+    WorkerService::LinkedIoChannels result{.alarmScheduler = *scheduler};
+    result.actorStorage = kj::mv(actorStorage);
 
     auto services = kj::heapArrayBuilder<Service*>(subrequestChannels.size() +
               IoContext::SPECIAL_SUBREQUEST_CHANNEL_COUNT);
@@ -2545,7 +3128,8 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
     services.add(&globalService);
 
     for (auto& channel: subrequestChannels) {
-      services.add(&lookupService(channel.designator, kj::mv(channel.errorContext)));
+      services.add(&lookupService(channel.designator, kj::mv(channel.errorContext),
+                                  channel.allowKv));
     }
 
     result.subrequest = services.finish();
@@ -2573,32 +3157,12 @@ kj::Own<Server::Service> Server::makeWorker(kj::StringPtr name, config::Worker::
                                    kj::str("Worker \"", name, "\"'s cacheApiOutbound"));
     }
 
-    auto actorStorageConf = conf.getDurableObjectStorage();
-    if (actorStorageConf.isLocalDisk()) {
-      kj::StringPtr diskName = actorStorageConf.getLocalDisk();
-      KJ_IF_SOME(svc, this->services.find(actorStorageConf.getLocalDisk())) {
-        auto diskSvc = dynamic_cast<DiskDirectoryService*>(svc.get());
-        if (diskSvc == nullptr) {
-          reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
-              "to the service \"", diskName, "\", but that service is not a local disk service."));
-        } else KJ_IF_SOME(dir, diskSvc->getWritable()) {
-          result.actorStorage = kj::heap<SqliteDatabase::Vfs>(dir);
-        } else {
-          reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
-              "to the disk service \"", diskName, "\", but that service is defined read-only."));
-        }
-      } else {
-        reportConfigError(kj::str("service ", name, ": durableObjectStorage config refers "
-            "to a service \"", diskName, "\", but no such service is defined."));
-      }
-    }
-
     kj::HashMap<kj::StringPtr, WorkerService::ActorNamespace&> durableNamespacesByUniqueKey;
     for(auto& [className, ns] : workerService.getActorNamespaces()) {
       KJ_IF_SOME(config, ns->getConfig().tryGet<Server::Durable>()) {
         auto& actorNs = ns; // clangd gets confused trying to use ns directly in the capture below??
 
-        alarmScheduler->registerNamespace(config.uniqueKey,
+        scheduler->registerNamespace(config.uniqueKey,
             [&actorNs](kj::String id) -> kj::Own<WorkerInterface> {
           return actorNs->getActor(kj::mv(id), IoChannelFactory::SubrequestMetadata{});
         });
@@ -2639,6 +3203,9 @@ kj::Own<Server::Service> Server::makeService(
 
     case config::Service::DISK:
       return makeDiskDirectoryService(name, conf.getDisk(), headerTableBuilder);
+
+    case config::Service::KV:
+      return makeKvStorageService(name, conf.getKv());
   }
 
   reportConfigError(kj::str(
@@ -2652,7 +3219,7 @@ void Server::taskFailed(kj::Exception&& exception) {
 }
 
 Server::Service& Server::lookupService(
-    config::ServiceDesignator::Reader designator, kj::String errorContext) {
+    config::ServiceDesignator::Reader designator, kj::String errorContext, bool allowKv) {
   kj::StringPtr targetName = designator.getName();
   Service* service = KJ_UNWRAP_OR(services.find(targetName), {
     reportConfigError(kj::str(
@@ -2661,6 +3228,13 @@ Server::Service& Server::lookupService(
     return *invalidConfigServiceSingleton;
   });
 
+  if (!allowKv && dynamic_cast<KvStorageService*>(service) != nullptr) {
+    reportConfigError(kj::str(
+        errorContext, " refers to service \"", targetName, "\", but that is a KV namespace, "
+        "which can only be used through a kvNamespace binding."));
+    return *invalidConfigServiceSingleton;
+  }
+
   if (designator.hasEntrypoint()) {
     kj::StringPtr entrypointName = designator.getEntrypoint();
     if (WorkerService* worker = dynamic_cast<WorkerService*>(service)) {
@@ -2852,6 +3426,90 @@ kj::Promise<void> Server::listenHttp(
   co_return co_await obj->run();
 }
 
+// =======================================================================================
+// Multi-threaded serving
+//
+// See connection-handoff.h for how connections are distributed across threads.
+
+void Server::maybeStartSecondaryThreads(jsg::V8System& v8System, config::Config::Reader config) {
+  uint threadCount = config.getThreads();
+  if (threadCount <= 1) return;
+
+#if _WIN32
+  reportConfigError(kj::str("Setting `threads` greater than 1 is not supported on Windows."));
+#else
+  for (auto service: config.getServices()) {
+    if (service.isWorker() && service.getWorker().getDurableObjectNamespaces().size() > 0) {
+      reportConfigError(kj::str(
+          "Service \"", service.getName(), "\" defines Durable Object namespaces, which are not "
+          "yet supported when `threads` is greater than 1, because each Durable Object must be "
+          "pinned to a single thread."));
+      return;
+    }
+    if (service.isKv()) {
+      if (service.getKv().isLocalDisk()) {
+        reportConfigError(kj::str(
+            "Service \"", service.getName(), "\" is a KV namespace stored on local disk, which is "
+            "not yet supported when `threads` is greater than 1, because every thread would open "
+            "its own connection to the same database."));
+      } else {
+        reportConfigError(kj::str(
+            "Service \"", service.getName(), "\" is a KV namespace stored in memory, which is "
+            "not yet supported when `threads` is greater than 1, because every thread would keep "
+            "its own, separate copy of the data."));
+      }
+      return;
+    }
+  }
+
+  auto copyOverrides = [](const kj::HashMap<kj::String, kj::String>& map) {
+    kj::HashMap<kj::String, kj::String> result;
+    for (auto& entry: map) {
+      result.insert(kj::str(entry.key), kj::str(entry.value));
+    }
+    return result;
+  };
+
+  auto group = kj::heap<ThreadGroup>(threadCount);
+  for (auto i: kj::zeroTo(threadCount - 1)) {
+    group->threads.add(kj::heap<kj::Thread>(
+        [this, &v8System, config, &group = *group, i,
+         directoryOverrides = copyOverrides(directoryOverrides),
+         externalOverrides = copyOverrides(externalOverrides)]() mutable {
+      kj::AsyncIoContext io = kj::setupAsyncIo();
+      auto& network = io.provider->getNetwork();
+
+      // The primary sees the same config, so it normally reports the same errors first, but some
+      // only show up on this thread, so don't drop them.
+      Server server(fs, io.provider->getTimer(), network, entropySource, consoleMode,
+          [i](kj::String error) {
+        KJ_LOG(ERROR, "config error on server thread", i + 1, error);
+      });
+      server.experimental = experimental;
+      server.directoryOverrides = kj::mv(directoryOverrides);
+      server.externalOverrides = kj::mv(externalOverrides);
+
+      kj::HashMap<kj::String, HandoffConnectionReceiver*> receivers;
+      for (auto sock: config.getSockets()) {
+        auto receiver = kj::heap<HandoffConnectionReceiver>(*io.lowLevelProvider, network);
+        receivers.insert(kj::str(sock.getName()), receiver.get());
+        server.overrideSocket(kj::str(sock.getName()), kj::mv(receiver));
+      }
+
+      group.registerThread(i, kj::mv(receivers));
+      KJ_DEFER(group.unregisterThread(i));
+
+      try {
+        server.run(v8System, config, group.drainList.addWaiter()).wait(io.waitScope);
+      } catch (...) {
+        KJ_LOG(ERROR, "server thread failed", i + 1, kj::getCaughtExceptionAsKj());
+      }
+    }));
+  }
+  threadGroup = kj::mv(group);
+#endif
+}
+
 // =======================================================================================
 // Server::run()
 
@@ -2866,8 +3524,21 @@ kj::Promise<void> Server::handleDrain(kj::Promise<void> drainWhen) {
   co_await kj::joinPromisesFailFast(drainPromises.finish());
 }
 
+void Server::openTeeSpillDirectory(config::Config::Reader config) {
+  if (!config.hasTeeSpillDirectory()) return;
+
+  auto pathStr = config.getTeeSpillDirectory();
+  auto path = fs.getCurrentPath().evalNative(pathStr);
+  KJ_IF_SOME(dir, fs.getRoot().tryOpenSubdir(kj::mv(path), kj::WriteMode::MODIFY)) {
+    teeSpillDirectory = kj::mv(dir);
+  } else {
+    reportConfigError(kj::str("Tee spill directory not found: ", pathStr));
+  }
+}
+
 kj::Promise<void> Server::run(jsg::V8System& v8System, config::Config::Reader config,
                               kj::Promise<void> drainWhen) {
+  openTeeSpillDirectory(config);
   kj::HttpHeaderTable::Builder headerTableBuilder;
   globalContext = kj::heap<GlobalContext>(*this, v8System, headerTableBuilder);
   invalidConfigServiceSingleton = kj::heap<InvalidConfigService>();
@@ -2875,6 +3546,11 @@ kj::Promise<void> Server::run(jsg::V8System& v8System, config::Config::Reader co
   auto [ fatalPromise, fatalFulfiller ] = kj::newPromiseAndFulfiller<void>();
   this->fatalFulfiller = kj::mv(fatalFulfiller);
 
+  maybeStartSecondaryThreads(v8System, config);
+  KJ_IF_SOME(group, threadGroup) {
+    drainWhen = drainWhen.then([&group = *group]() { group.drainList.fulfill(); });
+  }
+
   auto forkedDrainWhen = handleDrain(kj::mv(drainWhen)).fork();
 
   startServices(v8System, config, headerTableBuilder, forkedDrainWhen);
@@ -2894,12 +3570,25 @@ void Server::startAlarmScheduler(config::Config::Reader config) {
   auto dir = kj::newInMemoryDirectory(clock);
   auto vfs = kj::heap<SqliteDatabase::Vfs>(*dir).attach(kj::mv(dir));
 
-  // TODO(someday): support persistent storage for alarms
+  // Durable Objects with on-disk storage get a persistent scheduler instead, see
+  // getDiskAlarmScheduler().
 
   alarmScheduler = kj::heap<AlarmScheduler>(clock, timer, *vfs, kj::Path({"alarms.sqlite"}))
       .attach(kj::mv(vfs));
 }
 
+AlarmScheduler& Server::getDiskAlarmScheduler(kj::StringPtr diskName, const kj::Directory& dir) {
+  auto& scheduler = diskAlarmSchedulers.findOrCreate(diskName, [&]() {
+    // The database gets its own subdirectory, so that it stays out of the way of each
+    // namespace's subdirectory.
+    auto vfs = kj::heap<SqliteDatabase::Vfs>(dir);
+    auto scheduler = kj::heap<AlarmScheduler>(kj::systemPreciseCalendarClock(), timer, *vfs,
+        kj::Path({".alarms", "alarms.sqlite"})).attach(kj::mv(vfs));
+    return decltype(diskAlarmSchedulers)::Entry { kj::str(diskName), kj::mv(scheduler) };
+  });
+  return *scheduler;
+}
+
 // Configure and start the inspector socket, returning the port the socket started on.
 uint startInspector(kj::StringPtr inspectorAddress,
                     Server::InspectorServiceIsolateRegistrar& registrar) {
@@ -2949,6 +3638,37 @@ uint startInspector(kj::StringPtr inspectorAddress,
   );
 }
 
+kj::Duration Server::EvictionPolicy::Adaptive::getTimeout(size_t memoryUsed) const {
+  if (memoryUsed >= memoryBudget) {
+    return minTimeout;
+  }
+  double headroom = 1.0 - static_cast<double>(memoryUsed) / memoryBudget;
+  int64_t range = (maxTimeout - minTimeout) / kj::NANOSECONDS;
+  return minTimeout + static_cast<int64_t>(range * headroom) * kj::NANOSECONDS;
+}
+
+Server::EvictionPolicy Server::parseEvictionPolicy(kj::StringPtr serviceName,
+    config::Worker::DurableObjectNamespace::Reader ns) {
+  EvictionPolicy policy { .timeout = ns.getEvictionTimeoutMs() * kj::MILLISECONDS };
+
+  auto adaptive = ns.getAdaptiveEviction();
+  if (adaptive.getMemoryBudgetBytes() > 0) {
+    if (adaptive.getMinTimeoutMs() > adaptive.getMaxTimeoutMs()) {
+      reportConfigError(kj::str(
+          "Worker service \"", serviceName, "\", class \"", ns.getClassName(), "\": "
+          "adaptiveEviction.minTimeoutMs must not be greater than maxTimeoutMs."));
+    } else {
+      policy.adaptive = EvictionPolicy::Adaptive {
+        .memoryBudget = adaptive.getMemoryBudgetBytes(),
+        .minTimeout = adaptive.getMinTimeoutMs() * kj::MILLISECONDS,
+        .maxTimeout = adaptive.getMaxTimeoutMs() * kj::MILLISECONDS,
+      };
+    }
+  }
+
+  return policy;
+}
+
 void Server::startServices(jsg::V8System& v8System, config::Config::Reader config,
                            kj::HttpHeaderTable::Builder& headerTableBuilder,
                            kj::ForkedPromise<void>& forkedDrainWhen) {
@@ -2963,6 +3683,15 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
     if (serviceConf.isWorker()) {
       auto workerConf = serviceConf.getWorker();
       bool hadDurable = false;
+
+      kj::Maybe<GroupCommit> groupCommit;
+      auto groupCommitConf = workerConf.getDurableObjectGroupCommit();
+      if (groupCommitConf.getWindowMs() > 0) {
+        groupCommit = GroupCommit {
+          .window = groupCommitConf.getWindowMs() * kj::MILLISECONDS,
+          .maxBytes = groupCommitConf.getMaxBytes(),
+        };
+      }
       for (auto ns: workerConf.getDurableObjectNamespaces()) {
         switch (ns.which()) {
           case config::Worker::DurableObjectNamespace::UNIQUE_KEY:
@@ -2970,7 +3699,10 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
             serviceActorConfigs.insert(kj::str(ns.getClassName()),
                 Durable {
                     .uniqueKey = kj::str(ns.getUniqueKey()),
-                    .isEvictable = !ns.getPreventEviction() });
+                    .isEvictable = !ns.getPreventEviction(),
+                    .eviction = parseEvictionPolicy(name, ns),
+                    .hibernatableWebSocketLimit = ns.getMaxHibernatableWebSockets(),
+                    .groupCommit = groupCommit });
             continue;
           case config::Worker::DurableObjectNamespace::EPHEMERAL_LOCAL:
             if (!experimental) {
@@ -2980,7 +3712,10 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
                   "workerd with `--experimental` to use this feature."));
             }
             serviceActorConfigs.insert(kj::str(ns.getClassName()),
-                Ephemeral { .isEvictable = !ns.getPreventEviction() });
+                Ephemeral {
+                    .isEvictable = !ns.getPreventEviction(),
+                    .eviction = parseEvictionPolicy(name, ns),
+                    .hibernatableWebSocketLimit = ns.getMaxHibernatableWebSockets() });
             continue;
         }
         reportConfigError(kj::str(
@@ -3071,6 +3806,16 @@ void Server::startServices(jsg::V8System& v8System, config::Config::Reader confi
   for (auto& service: services) {
     service.value->link();
   }
+
+  // Every Durable Object namespace has now registered with its scheduler, so any alarms left on
+  // disk for other namespaces belong to namespaces that were removed from the config, and would
+  // never run. If there were config errors, some namespaces may have failed to register, so leave
+  // the alarms scheduled.
+  if (!hadConfigErrors) {
+    for (auto& scheduler: diskAlarmSchedulers) {
+      scheduler.value->ignoreUnregisteredAlarms();
+    }
+  }
 }
 
 kj::Promise<void> Server::listenOnSockets(config::Config::Reader config,
@@ -3144,6 +3889,18 @@ kj::Promise<void> Server::listenOnSockets(config::Config::Reader config,
       })(network.parseAddress(addrStr, defaultPort));
     }
 
+#if !_WIN32
+    // Distribute connections across threads before applying TLS, so that each thread does its own
+    // TLS handshakes.
+    KJ_IF_SOME(group, threadGroup) {
+      listener = ([](PromisedReceived promise, kj::String name, ThreadGroup& group)
+          -> PromisedReceived {
+        auto inner = co_await promise;
+        co_return kj::heap<DistributingConnectionReceiver>(kj::mv(inner), kj::mv(name), group);
+      })(kj::mv(listener), kj::str(name), *group);
+    }
+#endif
+
     KJ_IF_SOME(t, tls) {
       listener = ([](kj::Promise<kj::Own<kj::ConnectionReceiver>> promise,
                      kj::Own<kj::TlsContext> tls)
@@ -3309,6 +4066,7 @@ private:
 kj::Promise<bool> Server::test(jsg::V8System& v8System, config::Config::Reader config,
                                kj::StringPtr servicePattern,
                                kj::StringPtr entrypointPattern) {
+  openTeeSpillDirectory(config);
   kj::HttpHeaderTable::Builder headerTableBuilder;
   globalContext = kj::heap<GlobalContext>(*this, v8System, headerTableBuilder);
   invalidConfigServiceSingleton = kj::heap<InvalidConfigService>();
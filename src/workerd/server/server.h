@@ -24,6 +24,8 @@ namespace workerd::jsg {
 
 namespace workerd::server {
 
+class ThreadGroup;
+
 // Implements the single-tenant Workers Runtime server / CLI.
 //
 // The purpose of this class is to implement the core logic independently of the CLI itself,
@@ -71,12 +73,40 @@ public:
                          kj::StringPtr servicePattern = "*"_kj,
                          kj::StringPtr entrypointPattern = "*"_kj);
 
+  // Determines how long an inactive actor stays in memory before it is evicted.
+  struct EvictionPolicy {
+    kj::Duration timeout = 10 * kj::SECONDS;
+
+    // If set, the timeout is instead chosen between `maxTimeout` (nothing in use) and
+    // `minTimeout` (at or over `memoryBudget`) based on the memory used by the isolate's heap.
+    struct Adaptive {
+      size_t memoryBudget;
+      kj::Duration minTimeout;
+      kj::Duration maxTimeout;
+
+      // Returns the timeout to use when the isolate is using `memoryUsed` bytes.
+      kj::Duration getTimeout(size_t memoryUsed) const;
+    };
+    kj::Maybe<Adaptive> adaptive;
+  };
+
+  // Group commit settings for actors stored on local disk. See `ActorSqlite::GroupCommitOptions`.
+  struct GroupCommit {
+    kj::Duration window;
+    size_t maxBytes;
+  };
+
   struct Durable {
     kj::String uniqueKey;
     bool isEvictable;
+    EvictionPolicy eviction;
+    size_t hibernatableWebSocketLimit;
+    kj::Maybe<GroupCommit> groupCommit;
   };
   struct Ephemeral {
     bool isEvictable;
+    EvictionPolicy eviction;
+    size_t hibernatableWebSocketLimit;
   };
   using ActorConfig = kj::OneOf<Durable, Ephemeral>;
 
@@ -90,6 +120,9 @@ private:
   kj::EntropySource& entropySource;
   kj::Function<void(kj::String)> reportConfigError;
 
+  // Set once reportConfigError() has been called.
+  bool hadConfigErrors = false;
+
   bool experimental = false;
 
   Worker::ConsoleMode consoleMode;
@@ -107,6 +140,9 @@ private:
   kj::Maybe<kj::Own<InspectorServiceIsolateRegistrar>> inspectorIsolateRegistrar;
   kj::Maybe<kj::Own<kj::FdOutputStream>> controlOverride;
 
+  // Opened from `Config.teeSpillDirectory`, if set. Referenced by globalContext.
+  kj::Maybe<kj::Own<const kj::Directory>> teeSpillDirectory;
+
   struct GlobalContext;
   // General context needed to construct workers. Initilaized early in run().
   kj::Own<GlobalContext> globalContext;
@@ -114,6 +150,10 @@ private:
   class Service;
   kj::Own<Service> invalidConfigServiceSingleton;
 
+  // Used to implement `Config.threads`. See connection-handoff.h.
+  // Set on the primary server when `threads` > 1.
+  kj::Maybe<kj::Own<ThreadGroup>> threadGroup;
+
   // Information about all known actor namespaces. Maps serviceName -> className -> config.
   // This needs to be populated in advance of constructing any services, in order to be able to
   // correctly construct dependent services.
@@ -123,9 +163,13 @@ private:
 
   kj::Own<kj::PromiseFulfiller<void>> fatalFulfiller;
 
-  // Initialized in startAlarmScheduler().
+  // Initialized in startAlarmScheduler(). Used by Durable Objects that don't have on-disk storage.
   kj::Own<AlarmScheduler> alarmScheduler;
 
+  // Persistent alarm schedulers for Durable Objects stored on disk, keyed by the name of the disk
+  // service. Created by getDiskAlarmScheduler() when Workers are linked.
+  kj::HashMap<kj::String, kj::Own<AlarmScheduler>> diskAlarmSchedulers;
+
   // An HttpServer object maintained in a linked list.
   struct ListedHttpServer {
     Server& owner;
@@ -156,6 +200,8 @@ private:
   // request in flight.
   kj::Promise<void> handleDrain(kj::Promise<void> drainWhen);
 
+  void openTeeSpillDirectory(config::Config::Reader config);
+
   kj::Own<kj::TlsContext> makeTlsContext(config::TlsOptions::Reader conf);
   kj::Promise<kj::Own<kj::NetworkAddress>> makeTlsNetworkAddress(
       config::TlsOptions::Reader conf, kj::StringPtr addrStr,
@@ -171,6 +217,7 @@ private:
   kj::Own<Service> makeDiskDirectoryService(
       kj::StringPtr name, config::DiskDirectory::Reader conf,
       kj::HttpHeaderTable::Builder& headerTableBuilder);
+  kj::Own<Service> makeKvStorageService(kj::StringPtr name, config::KvStorage::Reader conf);
   kj::Own<Service> makeWorker(kj::StringPtr name, config::Worker::Reader conf,
       capnp::List<config::Extension>::Reader extensions);
   kj::Own<Service> makeService(
@@ -179,7 +226,9 @@ private:
       capnp::List<config::Extension>::Reader extensions);
 
   // Can only be called in the link stage.
-  Service& lookupService(config::ServiceDesignator::Reader designator, kj::String errorContext);
+  // Unless `allowKv` is true, a designator naming a `kv` service is reported as a config error.
+  Service& lookupService(config::ServiceDesignator::Reader designator, kj::String errorContext,
+                         bool allowKv = false);
 
   kj::Promise<void> listenHttp(kj::Own<kj::ConnectionReceiver> listener, Service& service,
                                kj::StringPtr physicalProtocol, kj::Own<HttpRewriter> rewriter);
@@ -189,10 +238,14 @@ private:
   class ExternalTcpService;
   class NetworkService;
   class DiskDirectoryService;
+  class KvStorageService;
   class WorkerService;
   class WorkerEntrypointService;
   class HttpListener;
 
+  EvictionPolicy parseEvictionPolicy(kj::StringPtr serviceName,
+      config::Worker::DurableObjectNamespace::Reader ns);
+
   void startServices(jsg::V8System& v8System, config::Config::Reader config,
                      kj::HttpHeaderTable::Builder& headerTableBuilder,
                      kj::ForkedPromise<void>& forkedDrainWhen);
@@ -200,6 +253,14 @@ private:
   // Must be called after startServices!
   void startAlarmScheduler(config::Config::Reader config);
 
+  // Returns the persistent alarm scheduler for the given disk service, creating it on first use.
+  AlarmScheduler& getDiskAlarmScheduler(kj::StringPtr diskName, const kj::Directory& dir);
+
+  // If the config requests more than one thread, validates that the config can be served that way
+  // and starts the secondary threads. Must be called before startServices(), since that consumes
+  // the command-line overrides which the secondary threads need to copy.
+  void maybeStartSecondaryThreads(jsg::V8System& v8System, config::Config::Reader config);
+
   kj::Promise<void> listenOnSockets(config::Config::Reader config,
                                     kj::HttpHeaderTable::Builder& headerTableBuilder,
                                     kj::ForkedPromise<void>& forkedDrainWhen);
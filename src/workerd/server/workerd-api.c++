@@ -496,11 +496,14 @@ private:
   }
 };
 
+// `kvReadCache` is the cache shared by the Worker's KV bindings, created by the first one that
+// needs it.
 static v8::Local<v8::Value> createBindingValue(
     JsgWorkerdIsolate::Lock& lock,
     const WorkerdApiIsolate::Global& global,
     CompatibilityFlags::Reader featureFlags,
-    uint32_t ownerId) {
+    uint32_t ownerId,
+    kj::Maybe<kj::Own<api::KvReadCache>>& kvReadCache) {
   using Global = WorkerdApiIsolate::Global;
   auto context = lock.v8Context();
 
@@ -521,8 +524,19 @@ static v8::Local<v8::Value> createBindingValue(
     }
 
     KJ_CASE_ONEOF(ns, Global::KvNamespace) {
+      kj::Maybe<api::KvNamespace::ReadCache> readCache;
+      if (ns.readCacheBytes > 0) {
+        if (kvReadCache == kj::none) {
+          kvReadCache = kj::refcounted<api::KvReadCache>(ns.readCacheBytes);
+        }
+        readCache = api::KvNamespace::ReadCache {
+          .cache = kj::addRef(*KJ_ASSERT_NONNULL(kvReadCache)),
+          .ns = kj::str(ns.readCacheNamespace),
+        };
+      }
       value = lock.wrap(context, jsg::alloc<api::KvNamespace>(
-          kj::Array<api::KvNamespace::AdditionalHeader>{}, ns.subrequestChannel));
+          kj::Array<api::KvNamespace::AdditionalHeader>{}, ns.subrequestChannel,
+          kj::mv(readCache)));
     }
 
     KJ_CASE_ONEOF(r2, Global::R2Bucket) {
@@ -603,7 +617,7 @@ static v8::Local<v8::Value> createBindingValue(
         auto env = v8::Object::New(lock.v8Isolate);
         for (const auto& innerBinding: wrapped.innerBindings) {
           lock.v8Set(env, innerBinding.name,
-                     createBindingValue(lock, innerBinding, featureFlags, ownerId));
+                     createBindingValue(lock, innerBinding, featureFlags, ownerId, kvReadCache));
         }
 
         // obtain exported function to call
@@ -640,11 +654,12 @@ void WorkerdApiIsolate::compileGlobals(
   auto& lock = kj::downcast<JsgWorkerdIsolate::Lock>(lockParam);
   lockParam.withinHandleScope([&] {
     auto& featureFlags = *impl->features;
+    kj::Maybe<kj::Own<api::KvReadCache>> kvReadCache;
 
     for (auto& global: globals) {
       lockParam.withinHandleScope([&] {
         // Don't use String's usual TypeHandler here because we want to intern the string.
-        auto value = createBindingValue(lock, global, featureFlags, ownerId);
+        auto value = createBindingValue(lock, global, featureFlags, ownerId, kvReadCache);
         KJ_ASSERT(!value.IsEmpty(), "global did not produce v8::Value");
         lockParam.v8Set(target, global.name, value);
       });
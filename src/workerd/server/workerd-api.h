@@ -58,8 +58,19 @@ public:
     struct KvNamespace {
       uint subrequestChannel;
 
+      // Size of the Worker's KV read cache, or zero if it has none.
+      uint64_t readCacheBytes;
+
+      // Identifies the service the binding points at, so that bindings to the same service share
+      // read cache entries.
+      kj::String readCacheNamespace;
+
       KvNamespace clone() const {
-        return *this;
+        return KvNamespace {
+          .subrequestChannel = subrequestChannel,
+          .readCacheBytes = readCacheBytes,
+          .readCacheNamespace = kj::str(readCacheNamespace),
+        };
       }
     };
     struct R2Bucket {
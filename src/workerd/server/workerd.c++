@@ -589,6 +589,10 @@ public:
                           "<addr> instead of the address specified in the config file.")
         .addOptionWithArg({'i', "inspector-addr"}, CLI_METHOD(enableInspector), "<addr>",
                           "Enable the inspector protocol to connect to the address <addr>.")
+        .addOptionWithArg({"compile-cache-dir"}, CLI_METHOD(setCompileCacheDir), "<path>",
+                          "Cache compiled code for worker modules in the directory <path>, so "
+                          "that later startups can skip recompiling unchanged modules. The "
+                          "directory is created if it doesn't exist.")
         .addOption({'w', "watch"}, CLI_METHOD(watch),
                    "Watch configuration files (and server binary) and reload if they change. "
                    "Useful for development, but not recommended in production.")
@@ -768,6 +772,12 @@ public:
     server.enableInspector(kj::str(param));
   }
 
+  void setCompileCacheDir(kj::StringPtr pathStr) {
+    auto path = fs->getCurrentPath().evalNative(pathStr);
+    jsg::setModuleCompileCacheDirectory(fs->getRoot().openSubdir(path,
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY | kj::WriteMode::CREATE_PARENT));
+  }
+
   void enableControl(kj::StringPtr param) {
     int fd = KJ_UNWRAP_OR(param.tryParseAs<uint>(),
         CLI_ERROR("Output value must be a file descriptor (non-negative integer)."));
@@ -0,0 +1,81 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/io/actor-cache.h>
+#include <workerd/io/io-gate.h>
+#include <kj/thread.h>
+
+// Measures contention on ActorCache::SharedLru when caches on several threads share one LRU.
+// Each thread gets its own event loop and ActorCache, warms up a small set of keys, and then
+// reads them repeatedly, so every read is a cache hit that takes the LRU lock.
+//
+// Arguments: number of threads, number of LRU shards, and whether second-chance mode is enabled.
+
+namespace workerd {
+namespace {
+
+constexpr size_t KEYS_PER_CACHE = 64;
+constexpr size_t READS_PER_THREAD = 100'000;
+
+// Storage that holds no values, so that every key read gets cached as absent.
+class EmptyStorage final: public rpc::ActorStorage::Stage::Server {
+public:
+  kj::Promise<void> get(GetContext context) override {
+    return kj::READY_NOW;
+  }
+};
+
+void readFromCache(const ActorCache::SharedLru& lru) {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  OutputGate gate;
+  ActorCache cache(kj::heap<EmptyStorage>(), lru, gate);
+
+  auto keys = KJ_MAP(i, kj::zeroTo(KEYS_PER_CACHE)) { return kj::str("key", i); };
+  for (auto& key: keys) {
+    auto result = cache.get(kj::str(key), {});
+    KJ_IF_SOME(promise, result.tryGet<kj::Promise<kj::Maybe<ActorCache::Value>>>()) {
+      promise.wait(ws);
+    }
+  }
+
+  for (auto i: kj::zeroTo(READS_PER_THREAD)) {
+    auto result = cache.get(kj::str(keys[i % KEYS_PER_CACHE]), {});
+    KJ_ASSERT(result.is<kj::Maybe<ActorCache::Value>>(), "expected a cache hit");
+  }
+}
+
+void sharedLruContention(benchmark::State& state) {
+  size_t threadCount = state.range(0);
+  ActorCache::SharedLru lru({
+    .softLimit = 16 * (1ull << 20),
+    .hardLimit = 128 * (1ull << 20),
+    .staleTimeout = 30 * kj::SECONDS,
+    .dirtyListByteLimit = 8 * (1ull << 20),
+    .maxKeysPerRpc = 128,
+    .shardCount = static_cast<uint>(state.range(1)),
+    .secondChance = state.range(2) != 0,
+  });
+
+  for (auto _ : state) {
+    kj::Vector<kj::Own<kj::Thread>> threads(threadCount);
+    for (auto i KJ_UNUSED: kj::zeroTo(threadCount)) {
+      threads.add(kj::heap<kj::Thread>([&lru]() { readFromCache(lru); }));
+    }
+    // kj::Thread's destructor joins.
+    threads.clear();
+  }
+
+  state.SetItemsProcessed(state.iterations() * threadCount * READS_PER_THREAD);
+}
+
+BENCHMARK(sharedLruContention)
+    ->ArgNames({"threads", "shards", "secondChance"})
+    ->ArgsProduct({{1, 4, 8}, {1, 8}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace workerd
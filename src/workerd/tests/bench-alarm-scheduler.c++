@@ -0,0 +1,195 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/server/alarm-scheduler.h>
+#include <kj/filesystem.h>
+
+// Measures AlarmScheduler throughput with a million alarms already scheduled. The alarms are
+// spread out over the coming weeks, so nearly all of them are outside the window the scheduler
+// keeps in memory.
+
+namespace workerd::server {
+namespace {
+
+constexpr size_t ALARM_COUNT = 1'000'000;
+constexpr kj::StringPtr NAMESPACE = "bench"_kj;
+
+class FakeClock final: public kj::Clock {
+public:
+  kj::Date now() const override { return time; }
+
+  kj::Date time = kj::UNIX_EPOCH + 1'700'000'000ll * kj::SECONDS;
+};
+
+// Handles alarms by counting them and reporting success.
+class AlarmCountingWorker final: public WorkerInterface {
+public:
+  explicit AlarmCountingWorker(size_t& fired): fired(fired) {}
+
+  kj::Promise<void> request(
+      kj::HttpMethod method, kj::StringPtr url, const kj::HttpHeaders& headers,
+      kj::AsyncInputStream& requestBody, Response& response) override {
+    KJ_UNIMPLEMENTED("only alarms are supported");
+  }
+  kj::Promise<void> connect(kj::StringPtr host, const kj::HttpHeaders& headers,
+      kj::AsyncIoStream& connection, ConnectResponse& response,
+      kj::HttpConnectSettings settings) override {
+    KJ_UNIMPLEMENTED("only alarms are supported");
+  }
+  void prewarm(kj::StringPtr url) override {}
+  kj::Promise<ScheduledResult> runScheduled(kj::Date scheduledTime, kj::StringPtr cron) override {
+    KJ_UNIMPLEMENTED("only alarms are supported");
+  }
+  kj::Promise<AlarmResult> runAlarm(kj::Date scheduledTime) override {
+    ++fired;
+    return AlarmResult { .retry = false, .outcome = EventOutcome::OK };
+  }
+  kj::Promise<CustomEvent::Result> customEvent(kj::Own<CustomEvent> event) override {
+    KJ_UNIMPLEMENTED("only alarms are supported");
+  }
+
+private:
+  size_t& fired;
+};
+
+struct AlarmSchedulerBench: public benchmark::Fixture {
+  virtual ~AlarmSchedulerBench() noexcept(true) {}
+
+  void SetUp(benchmark::State& state) noexcept(true) override {
+    dir = kj::newInMemoryDirectory(kj::nullClock());
+    vfs = kj::heap<SqliteDatabase::Vfs>(*dir);
+    loop = kj::heap<kj::EventLoop>();
+    waitScope = kj::heap<kj::WaitScope>(*loop);
+    timer = kj::heap<kj::TimerImpl>(kj::origin<kj::TimePoint>());
+    fired = 0;
+
+    actorIds = KJ_MAP(i, kj::zeroTo(ALARM_COUNT)) { return kj::str("actor", i); };
+
+    // Populate the database directly, in one statement, rather than through a million setAlarm()
+    // calls. The schema must match AlarmScheduler::ensureInitialized().
+    SqliteDatabase db(*vfs, kj::Path({"alarms.sqlite"}),
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+    db.run(R"(
+      CREATE TABLE _cf_ALARM (
+        actor_unique_key TEXT,
+        actor_id TEXT,
+        scheduled_time INTEGER,
+        PRIMARY KEY (actor_unique_key, actor_id)
+      ) WITHOUT ROWID;
+    )");
+    db.run(R"(
+      WITH RECURSIVE seq(i) AS (SELECT 0 UNION ALL SELECT i + 1 FROM seq WHERE i + 1 < ?)
+      INSERT INTO _cf_ALARM SELECT ?, 'actor' || i, ? + i * ? FROM seq;
+    )", static_cast<int64_t>(ALARM_COUNT), NAMESPACE, toNs(clock.time + 1 * kj::DAYS),
+        static_cast<int64_t>(1 * kj::SECONDS / kj::NANOSECONDS));
+  }
+
+  void TearDown(benchmark::State& state) noexcept(true) override {
+    timer = nullptr;
+    waitScope = nullptr;
+    loop = nullptr;
+    vfs = nullptr;
+    dir = nullptr;
+  }
+
+  kj::Own<AlarmScheduler> makeScheduler() {
+    auto scheduler = kj::heap<AlarmScheduler>(clock, *timer, *vfs, kj::Path({"alarms.sqlite"}));
+    scheduler->registerNamespace(NAMESPACE, [this](kj::String) -> kj::Own<WorkerInterface> {
+      return kj::heap<AlarmCountingWorker>(fired);
+    });
+    return scheduler;
+  }
+
+  ActorKey actor(size_t i) {
+    return { .uniqueKey = NAMESPACE, .actorId = actorIds[i % ALARM_COUNT] };
+  }
+
+  static int64_t toNs(kj::Date date) {
+    return (date - kj::UNIX_EPOCH) / kj::NANOSECONDS;
+  }
+
+  FakeClock clock;
+  kj::Own<const kj::Directory> dir;
+  kj::Own<SqliteDatabase::Vfs> vfs;
+  kj::Own<kj::EventLoop> loop;
+  kj::Own<kj::WaitScope> waitScope;
+  kj::Own<kj::TimerImpl> timer;
+  size_t fired = 0;
+
+  kj::Array<kj::String> actorIds;
+};
+
+BENCHMARK_DEFINE_F(AlarmSchedulerBench, Startup)(benchmark::State& state) {
+  size_t inMemory = 0;
+  for (auto _ : state) {
+    auto scheduler = makeScheduler();
+    inMemory = scheduler->inMemoryCount();
+  }
+  state.counters["in_memory"] = inMemory;
+}
+
+BENCHMARK_DEFINE_F(AlarmSchedulerBench, SetAlarmOutsideWindow)(benchmark::State& state) {
+  auto scheduler = makeScheduler();
+  size_t i = 0;
+  for (auto _ : state) {
+    auto time = clock.time + 2 * kj::DAYS + static_cast<int64_t>(i) * kj::MILLISECONDS;
+    scheduler->setAlarm(actor(i), time);
+    ++i;
+  }
+  state.SetItemsProcessed(i);
+  state.counters["in_memory"] = scheduler->inMemoryCount();
+}
+
+BENCHMARK_DEFINE_F(AlarmSchedulerBench, SetAlarmInWindow)(benchmark::State& state) {
+  auto scheduler = makeScheduler();
+  size_t i = 0;
+  for (auto _ : state) {
+    auto time = clock.time + 1 * kj::MINUTES + static_cast<int64_t>(i) * kj::MICROSECONDS;
+    scheduler->setAlarm(actor(i), time);
+    ++i;
+  }
+  state.SetItemsProcessed(i);
+  state.counters["in_memory"] = scheduler->inMemoryCount();
+}
+
+BENCHMARK_DEFINE_F(AlarmSchedulerBench, DeleteAlarm)(benchmark::State& state) {
+  auto scheduler = makeScheduler();
+  size_t i = 0;
+  for (auto _ : state) {
+    scheduler->deleteAlarm(actor(i));
+    ++i;
+  }
+  state.SetItemsProcessed(i);
+}
+
+BENCHMARK_DEFINE_F(AlarmSchedulerBench, FireAlarms)(benchmark::State& state) {
+  // Each iteration moves a batch of alarms to the current time and runs the event loop until all
+  // of them have fired. Alarms that succeed are deleted, so each batch uses new actors.
+  constexpr size_t BATCH_SIZE = 1000;
+
+  auto scheduler = makeScheduler();
+  size_t next = 0;
+  for (auto _ : state) {
+    for (auto i KJ_UNUSED: kj::zeroTo(BATCH_SIZE)) {
+      scheduler->setAlarm(actor(next++), clock.time);
+    }
+    size_t target = fired + BATCH_SIZE;
+    while (fired < target) {
+      waitScope->poll();
+    }
+  }
+  state.SetItemsProcessed(fired);
+}
+
+BENCHMARK_REGISTER_F(AlarmSchedulerBench, Startup)->Unit(benchmark::kMillisecond);
+BENCHMARK_REGISTER_F(AlarmSchedulerBench, SetAlarmOutsideWindow);
+BENCHMARK_REGISTER_F(AlarmSchedulerBench, SetAlarmInWindow);
+// Each iteration deletes a different alarm, so cap the iterations well below ALARM_COUNT.
+BENCHMARK_REGISTER_F(AlarmSchedulerBench, DeleteAlarm)->Iterations(100'000);
+BENCHMARK_REGISTER_F(AlarmSchedulerBench, FireAlarms)->Iterations(100)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace workerd::server
@@ -57,5 +57,71 @@ BENCHMARK_F(ApiHeaders, constructor)(benchmark::State& state) {
   });
 }
 
+// Converting back to kj::HttpHeaders, as happens whenever a request or response is sent.
+BENCHMARK_F(ApiHeaders, shallowCopyTo)(benchmark::State& state) {
+  fixture->runInIoContext([&](const TestFixture::Environment& env) {
+    auto jsHeaders = jsg::alloc<api::Headers>(*kjHeaders, api::Headers::Guard::REQUEST);
+    for (auto _ : state) {
+      kj::HttpHeaders out(*table);
+      jsHeaders->shallowCopyTo(out);
+      benchmark::DoNotOptimize(out);
+    }
+  });
+}
+
+// A request passing through a worker unmodified: kj::HttpHeaders -> api::Headers -> back.
+BENCHMARK_F(ApiHeaders, roundTrip)(benchmark::State& state) {
+  fixture->runInIoContext([&](const TestFixture::Environment& env) {
+    for (auto _ : state) {
+      auto jsHeaders = jsg::alloc<api::Headers>(*kjHeaders, api::Headers::Guard::REQUEST);
+      kj::HttpHeaders out(*table);
+      jsHeaders->shallowCopyTo(out);
+      benchmark::DoNotOptimize(out);
+    }
+  });
+}
+
+// Copies share the header map until one of them is modified.
+BENCHMARK_F(ApiHeaders, clone)(benchmark::State& state) {
+  fixture->runInIoContext([&](const TestFixture::Environment& env) {
+    auto jsHeaders = jsg::alloc<api::Headers>(*kjHeaders, api::Headers::Guard::REQUEST);
+    for (auto _ : state) {
+      auto copy = jsHeaders->clone();
+      benchmark::DoNotOptimize(copy);
+    }
+  });
+}
+
+BENCHMARK_F(ApiHeaders, cloneAndModify)(benchmark::State& state) {
+  fixture->runInIoContext([&](const TestFixture::Environment& env) {
+    auto jsHeaders = jsg::alloc<api::Headers>(*kjHeaders, api::Headers::Guard::NONE);
+    for (auto _ : state) {
+      auto copy = jsg::alloc<api::Headers>(*jsHeaders);
+      copy->set(jsg::ByteString(kj::str("X-Bench")), jsg::ByteString(kj::str("1")));
+    }
+  });
+}
+
+// Iterators hold a snapshot of the header map rather than a copy of every entry.
+BENCHMARK_F(ApiHeaders, entries)(benchmark::State& state) {
+  fixture->runInIoContext([&](const TestFixture::Environment& env) {
+    auto jsHeaders = jsg::alloc<api::Headers>(*kjHeaders, api::Headers::Guard::REQUEST);
+    for (auto _ : state) {
+      auto iter = jsHeaders->entries(env.js);
+      while (!iter->next(env.js).done) {}
+    }
+  });
+}
+
+BENCHMARK_F(ApiHeaders, entriesFirstOnly)(benchmark::State& state) {
+  fixture->runInIoContext([&](const TestFixture::Environment& env) {
+    auto jsHeaders = jsg::alloc<api::Headers>(*kjHeaders, api::Headers::Guard::REQUEST);
+    for (auto _ : state) {
+      auto iter = jsHeaders->entries(env.js);
+      benchmark::DoNotOptimize(iter->next(env.js));
+    }
+  });
+}
+
 } // namespace
 } // namespace workerd
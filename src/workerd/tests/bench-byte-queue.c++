@@ -0,0 +1,103 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/tests/test-fixture.h>
+#include <workerd/api/streams/queue.h>
+
+// Measures ByteQueue throughput for streams that are written in tiny chunks, as when a worker
+// streams JSON by encoding one token at a time. Each iteration pushes a batch of writes while
+// nothing is reading, then drains the consumer with reads of the given size.
+//
+// Arguments: size of each write, and size of each read.
+
+namespace workerd {
+namespace {
+
+constexpr size_t WRITES_PER_ITERATION = 4096;
+
+struct ByteQueueBench: public benchmark::Fixture {
+  virtual ~ByteQueueBench() noexcept(true) {}
+
+  void SetUp(benchmark::State& state) noexcept(true) override {
+    fixture = kj::heap<TestFixture>();
+  }
+
+  void TearDown(benchmark::State& state) noexcept(true) override {
+    fixture = nullptr;
+  }
+
+  kj::Own<TestFixture> fixture;
+};
+
+void push(jsg::Lock& js, api::ByteQueue& queue, size_t size) {
+  auto store = jsg::BackingStore::alloc(js, size);
+  memset(store.asArrayPtr().begin(), 'a', size);
+  queue.push(js, kj::refcounted<api::ByteQueue::Entry>(kj::mv(store)));
+}
+
+void read(jsg::Lock& js, api::ByteQueue::Consumer& consumer, size_t size,
+    api::ByteQueue::ReadRequest::Type type) {
+  auto prp = js.newPromiseAndResolver<api::ReadResult>();
+  consumer.read(js, api::ByteQueue::ReadRequest(kj::mv(prp.resolver), {
+    .store = jsg::BackingStore::alloc(js, size),
+    .type = type,
+  }));
+}
+
+BENCHMARK_DEFINE_F(ByteQueueBench, WriteThenRead)(benchmark::State& state) {
+  size_t writeSize = state.range(0);
+  size_t readSize = state.range(1);
+
+  fixture->runInIoContext([&](const TestFixture::Environment& env) {
+    auto& js = env.js;
+    api::ByteQueue queue(WRITES_PER_ITERATION * writeSize);
+    api::ByteQueue::Consumer consumer(queue);
+
+    for (auto _ : state) {
+      for (auto i KJ_UNUSED: kj::zeroTo(WRITES_PER_ITERATION)) {
+        push(js, queue, writeSize);
+      }
+      while (!consumer.empty()) {
+        read(js, consumer, readSize, api::ByteQueue::ReadRequest::Type::BYOB);
+      }
+      js.runMicrotasks();
+    }
+  });
+
+  state.SetBytesProcessed(state.iterations() * WRITES_PER_ITERATION * writeSize);
+}
+
+// Each write is read as soon as it is pushed, so nothing is buffered long enough to coalesce.
+// Default reads are used because a pending BYOB read would also queue a ByobRequest.
+BENCHMARK_DEFINE_F(ByteQueueBench, ReadPending)(benchmark::State& state) {
+  size_t writeSize = state.range(0);
+
+  fixture->runInIoContext([&](const TestFixture::Environment& env) {
+    auto& js = env.js;
+    api::ByteQueue queue(writeSize);
+    api::ByteQueue::Consumer consumer(queue);
+
+    for (auto _ : state) {
+      for (auto i KJ_UNUSED: kj::zeroTo(WRITES_PER_ITERATION)) {
+        read(js, consumer, writeSize, api::ByteQueue::ReadRequest::Type::DEFAULT);
+        push(js, queue, writeSize);
+      }
+      js.runMicrotasks();
+    }
+  });
+
+  state.SetBytesProcessed(state.iterations() * WRITES_PER_ITERATION * writeSize);
+}
+
+BENCHMARK_REGISTER_F(ByteQueueBench, WriteThenRead)
+    ->ArgNames({"writeSize", "readSize"})
+    ->ArgsProduct({{1, 16}, {4096, 65536}});
+BENCHMARK_REGISTER_F(ByteQueueBench, ReadPending)
+    ->ArgNames({"writeSize"})
+    ->Args({1})
+    ->Args({16});
+
+}  // namespace
+}  // namespace workerd
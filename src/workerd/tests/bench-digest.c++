@@ -0,0 +1,95 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/tests/test-fixture.h>
+
+// Compares SHA-256 throughput of crypto.subtle.digest() and crypto.DigestStream on buffers of a
+// few MiB. The input is generated once per size and kept by the worker, so each iteration only
+// hashes; bytes_per_second is the hashing throughput.
+//
+// Arguments: input size in MiB, and how the input is hashed:
+//   0: crypto.subtle.digest() on the whole buffer.
+//   1: a DigestStream, written the whole buffer at once.
+//   2: a DigestStream, written in 64 KiB chunks.
+
+namespace workerd {
+namespace {
+
+struct DigestBenchmark: public benchmark::Fixture {
+  virtual ~DigestBenchmark() noexcept(true) {}
+
+  void SetUp(benchmark::State& state) noexcept(true) override {
+    TestFixture::SetupParams params = {
+      .mainModuleSource = R"(
+        const inputs = new Map();
+        function getInput(size) {
+          let input = inputs.get(size);
+          if (input === undefined) {
+            input = new Uint8Array(size);
+            for (let i = 0; i < size; i += 65536) {
+              crypto.getRandomValues(input.subarray(i, i + 65536));
+            }
+            inputs.set(size, input);
+          }
+          return input;
+        }
+
+        export default {
+          async fetch(request) {
+            const params = new URL(request.url).searchParams;
+            const input = getInput(Number(params.get("mib")) * 1024 * 1024);
+            const mode = Number(params.get("mode"));
+
+            let digest;
+            if (mode == 0) {
+              digest = await crypto.subtle.digest("SHA-256", input);
+            } else {
+              const stream = new crypto.DigestStream("SHA-256");
+              const writer = stream.getWriter();
+              const chunkSize = mode == 1 ? input.length : 65536;
+              for (let i = 0; i < input.length; i += chunkSize) {
+                await writer.write(input.subarray(i, i + chunkSize));
+              }
+              await writer.close();
+              digest = await stream.digest;
+            }
+            return new Response(digest);
+          },
+        };
+      )"_kj};
+    fixture = kj::heap<TestFixture>(kj::mv(params));
+    url = kj::str("http://www.example.com/?mib=", state.range(0), "&mode=", state.range(1));
+    size = state.range(0) * 1024 * 1024;
+
+    // Generate the input outside of the timed loop.
+    auto result = fixture->runRequest(kj::HttpMethod::GET, url, ""_kj);
+    KJ_EXPECT(result.statusCode == 200);
+  }
+
+  void TearDown(benchmark::State& state) noexcept(true) override {
+    fixture = nullptr;
+  }
+
+  kj::Own<TestFixture> fixture;
+  kj::String url;
+  size_t size;
+};
+
+BENCHMARK_DEFINE_F(DigestBenchmark, sha256)(benchmark::State& state) {
+  for (auto _ : state) {
+    auto result = fixture->runRequest(kj::HttpMethod::GET, url, ""_kj);
+    KJ_EXPECT(result.statusCode == 200);
+    KJ_EXPECT(result.body.size() == 32);
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+
+BENCHMARK_REGISTER_F(DigestBenchmark, sha256)
+    ->ArgNames({"MiB", "mode"})
+    ->ArgsProduct({{1, 16, 64}, {0, 1, 2}})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace workerd
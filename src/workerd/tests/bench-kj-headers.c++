@@ -42,5 +42,31 @@ BENCHMARK_F(KjHeaders, Parse)(benchmark::State& state) {
   }
 }
 
+// Setting headers by id is an index into an array, while adding them by name requires a
+// case-insensitive lookup in the table. api::Headers uses ids for headers that have builtin ones.
+BENCHMARK_F(KjHeaders, SetById)(benchmark::State& state) {
+  for (auto _ : state) {
+    kj::HttpHeaders headers(*table);
+    headers.set(kj::HttpHeaderId::HOST, "example.com"_kj);
+    headers.set(kj::HttpHeaderId::CONTENT_TYPE, "text/html; charset=utf-8"_kj);
+    headers.set(kj::HttpHeaderId::CONTENT_LENGTH, "1234"_kj);
+    headers.set(kj::HttpHeaderId::DATE, "Tue, 15 Nov 1994 08:12:31 GMT"_kj);
+    headers.set(kj::HttpHeaderId::LOCATION, "https://example.com/"_kj);
+    benchmark::DoNotOptimize(headers);
+  }
+}
+
+BENCHMARK_F(KjHeaders, AddByName)(benchmark::State& state) {
+  for (auto _ : state) {
+    kj::HttpHeaders headers(*table);
+    headers.add("host"_kj, "example.com"_kj);
+    headers.add("content-type"_kj, "text/html; charset=utf-8"_kj);
+    headers.add("content-length"_kj, "1234"_kj);
+    headers.add("date"_kj, "Tue, 15 Nov 1994 08:12:31 GMT"_kj);
+    headers.add("location"_kj, "https://example.com/"_kj);
+    benchmark::DoNotOptimize(headers);
+  }
+}
+
 } // namespace
 } // namespace workerd
@@ -0,0 +1,71 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/server/open-file-cache.h>
+#include <kj/filesystem.h>
+#include <stdlib.h>
+
+// Measures the cost of looking up the same file 100k times, as a disk directory service does
+// when a browser keeps revalidating a static asset: once by opening and stat()ing the file each
+// time, and once through OpenFileCache.
+
+namespace workerd::server {
+namespace {
+
+constexpr size_t LOOKUPS = 100'000;
+
+struct OpenFileCacheBench: public benchmark::Fixture {
+  virtual ~OpenFileCacheBench() noexcept(true) {}
+
+  void SetUp(benchmark::State& state) noexcept(true) override {
+    char tmpl[] = "/tmp/bench-open-file-cache.XXXXXX";
+    KJ_ASSERT(mkdtemp(tmpl) != nullptr);
+    fs = kj::newDiskFilesystem();
+    tmpPath = kj::Path::parse(tmpl + 1);
+    dir = fs->getRoot().openSubdir(tmpPath.clone(), kj::WriteMode::MODIFY);
+    dir->openFile(kj::Path({"asset.js"}), kj::WriteMode::CREATE)
+        ->writeAll(kj::str(kj::repeat('x', 16 * 1024)));
+  }
+
+  void TearDown(benchmark::State& state) noexcept(true) override {
+    dir = nullptr;
+    fs->getRoot().remove(tmpPath);
+  }
+
+  kj::Own<kj::Filesystem> fs;
+  kj::Path tmpPath = nullptr;
+  kj::Own<const kj::Directory> dir;
+  kj::Path asset = kj::Path({"asset.js"});
+  kj::TimerImpl timer = kj::TimerImpl(kj::origin<kj::TimePoint>());
+};
+
+BENCHMARK_F(OpenFileCacheBench, OpenAndStat)(benchmark::State& state) {
+  for (auto _ : state) {
+    for (auto i KJ_UNUSED: kj::zeroTo(LOOKUPS)) {
+      auto file = dir->openFile(asset);
+      benchmark::DoNotOptimize(file->stat());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * LOOKUPS);
+}
+
+BENCHMARK_F(OpenFileCacheBench, CacheHit)(benchmark::State& state) {
+  OpenFileCache cache(timer, 1024);
+  for (auto _ : state) {
+    for (auto i KJ_UNUSED: kj::zeroTo(LOOKUPS)) {
+      auto cached = cache.find(asset);
+      if (cached == kj::none) {
+        auto file = dir->openFile(asset);
+        auto meta = file->stat();
+        cached = cache.insert(asset, kj::mv(file), meta);
+      }
+      benchmark::DoNotOptimize(cached);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * LOOKUPS);
+}
+
+} // namespace
+} // namespace workerd::server
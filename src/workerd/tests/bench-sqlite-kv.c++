@@ -0,0 +1,112 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/util/sqlite-kv.h>
+
+// Compares SqliteKv's batched multi-key operations against looping over the single-key ones.
+// The argument to each benchmark is the number of keys per operation.
+
+namespace workerd {
+namespace {
+
+struct SqliteKvBench: public benchmark::Fixture {
+  virtual ~SqliteKvBench() noexcept(true) {}
+
+  void SetUp(benchmark::State& state) noexcept(true) override {
+    dir = kj::newInMemoryDirectory(kj::nullClock());
+    vfs = kj::heap<SqliteDatabase::Vfs>(*dir);
+    db = kj::heap<SqliteDatabase>(*vfs, kj::Path({"bench"}),
+        kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+    kv = kj::heap<SqliteKv>(*db);
+
+    size_t count = state.range(0);
+    keys = KJ_MAP(i, kj::zeroTo(count)) { return kj::str("key", i); };
+    value = kj::heapArray<byte>(128);
+    memset(value.begin(), 'x', value.size());
+    keyPtrs = KJ_MAP(key, keys) -> SqliteKv::KeyPtr { return key; };
+    pairs = KJ_MAP(key, keys) -> SqliteKv::KeyValuePtrPair { return { key, value }; };
+
+    kv->putMultiple(pairs);
+  }
+
+  void TearDown(benchmark::State& state) noexcept(true) override {
+    kv = nullptr;
+    db = nullptr;
+    vfs = nullptr;
+    dir = nullptr;
+  }
+
+  kj::Own<const kj::Directory> dir;
+  kj::Own<SqliteDatabase::Vfs> vfs;
+  kj::Own<SqliteDatabase> db;
+  kj::Own<SqliteKv> kv;
+
+  kj::Array<kj::String> keys;
+  kj::Array<byte> value;
+  kj::Array<SqliteKv::KeyPtr> keyPtrs;
+  kj::Array<SqliteKv::KeyValuePtrPair> pairs;
+};
+
+BENCHMARK_DEFINE_F(SqliteKvBench, GetPerKey)(benchmark::State& state) {
+  for (auto _ : state) {
+    size_t total = 0;
+    for (auto& key: keyPtrs) {
+      kv->get(key, [&](SqliteKv::ValuePtr v) { total += v.size(); });
+    }
+    benchmark::DoNotOptimize(total);
+  }
+}
+
+BENCHMARK_DEFINE_F(SqliteKvBench, GetBatched)(benchmark::State& state) {
+  for (auto _ : state) {
+    size_t total = 0;
+    kv->getMultiple(keyPtrs, [&](SqliteKv::KeyPtr, SqliteKv::ValuePtr v) { total += v.size(); });
+    benchmark::DoNotOptimize(total);
+  }
+}
+
+BENCHMARK_DEFINE_F(SqliteKvBench, PutPerKey)(benchmark::State& state) {
+  for (auto _ : state) {
+    for (auto& pair: pairs) {
+      kv->put(pair.key, pair.value);
+    }
+  }
+}
+
+BENCHMARK_DEFINE_F(SqliteKvBench, PutBatched)(benchmark::State& state) {
+  for (auto _ : state) {
+    kv->putMultiple(pairs);
+  }
+}
+
+// Deletes are measured together with the puts needed to restore the rows, since otherwise every
+// iteration after the first would be deleting nothing.
+BENCHMARK_DEFINE_F(SqliteKvBench, PutDeletePerKey)(benchmark::State& state) {
+  for (auto _ : state) {
+    for (auto& key: keyPtrs) {
+      kv->delete_(key);
+    }
+    for (auto& pair: pairs) {
+      kv->put(pair.key, pair.value);
+    }
+  }
+}
+
+BENCHMARK_DEFINE_F(SqliteKvBench, PutDeleteBatched)(benchmark::State& state) {
+  for (auto _ : state) {
+    kv->deleteMultiple(keyPtrs);
+    kv->putMultiple(pairs);
+  }
+}
+
+BENCHMARK_REGISTER_F(SqliteKvBench, GetPerKey)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK_REGISTER_F(SqliteKvBench, GetBatched)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK_REGISTER_F(SqliteKvBench, PutPerKey)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK_REGISTER_F(SqliteKvBench, PutBatched)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK_REGISTER_F(SqliteKvBench, PutDeletePerKey)->Arg(10)->Arg(100)->Arg(1000);
+BENCHMARK_REGISTER_F(SqliteKvBench, PutDeleteBatched)->Arg(10)->Arg(100)->Arg(1000);
+
+}  // namespace
+}  // namespace workerd
@@ -0,0 +1,63 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include <workerd/tests/bench-tools.h>
+#include <workerd/tests/test-fixture.h>
+
+// Measures streaming throughput of a fetch() handler that passes the request body through to the
+// response. The "direct" variant returns the request body as-is, which lets the system streams
+// pump natively. The "transform" variant routes the body through an IdentityTransformStream,
+// which exercises the generic ReadableStreamSource pump.
+//
+// Arguments: body size in KiB, and whether to pass the body through a transform.
+
+namespace workerd {
+namespace {
+
+struct StreamPumpBenchmark: public benchmark::Fixture {
+  virtual ~StreamPumpBenchmark() noexcept(true) {}
+
+  void SetUp(benchmark::State& state) noexcept(true) override {
+    TestFixture::SetupParams params = {
+      .mainModuleSource = R"(
+        export default {
+          async fetch(request) {
+            if (new URL(request.url).pathname == "/transform") {
+              return new Response(request.body.pipeThrough(new IdentityTransformStream()));
+            }
+            return new Response(request.body);
+          },
+        };
+      )"_kj};
+    fixture = kj::heap<TestFixture>(kj::mv(params));
+    body = kj::heapString(state.range(0) * 1024);
+    memset(body.begin(), 'x', body.size());
+  }
+
+  void TearDown(benchmark::State& state) noexcept(true) override {
+    fixture = nullptr;
+  }
+
+  kj::Own<TestFixture> fixture;
+  kj::String body;
+};
+
+BENCHMARK_DEFINE_F(StreamPumpBenchmark, passthrough)(benchmark::State& state) {
+  auto url = state.range(1) ? "http://www.example.com/transform"_kj
+                            : "http://www.example.com/direct"_kj;
+  for (auto _ : state) {
+    auto result = fixture->runRequest(kj::HttpMethod::POST, url, body);
+    KJ_EXPECT(result.statusCode == 200);
+    KJ_EXPECT(result.body.size() == body.size());
+  }
+  state.SetBytesProcessed(state.iterations() * body.size());
+}
+
+BENCHMARK_REGISTER_F(StreamPumpBenchmark, passthrough)
+    ->ArgNames({"KiB", "transform"})
+    ->ArgsProduct({{64, 1024, 16 * 1024}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+} // namespace
+} // namespace workerd
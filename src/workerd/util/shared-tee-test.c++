@@ -0,0 +1,118 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "shared-tee.h"
+#include "stream-utils.h"
+#include <kj/test.h>
+
+namespace workerd {
+namespace {
+
+kj::Array<kj::byte> makeData(size_t size) {
+  auto data = kj::heapArray<kj::byte>(size);
+  for (auto i: kj::indices(data)) {
+    data[i] = i % 251;
+  }
+  return data;
+}
+
+void expectReadAll(kj::AsyncInputStream& input, kj::ArrayPtr<const kj::byte> expected,
+    kj::WaitScope& ws) {
+  auto actual = input.readAllBytes().wait(ws);
+  KJ_EXPECT(actual.asPtr() == expected);
+}
+
+KJ_TEST("shared tee: both branches see all data") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  auto data = makeData(100'000);
+  auto tee = newSharedTee(newMemoryInputStream(data));
+
+  // Read one branch to completion first, so that the other branch has to buffer everything.
+  expectReadAll(*tee.branches[0], data, ws);
+  expectReadAll(*tee.branches[1], data, ws);
+}
+
+KJ_TEST("shared tee: branches read in parallel") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  auto data = makeData(100'000);
+  auto tee = newSharedTee(newMemoryInputStream(data));
+
+  auto promise0 = tee.branches[0]->readAllBytes();
+  auto promise1 = tee.branches[1]->readAllBytes();
+  KJ_EXPECT(promise0.wait(ws).asPtr() == data.asPtr());
+  KJ_EXPECT(promise1.wait(ws).asPtr() == data.asPtr());
+}
+
+KJ_TEST("shared tee: exceeding the lag limit fails without a spill directory") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  auto data = makeData(100'000);
+  auto tee = newSharedTee(newMemoryInputStream(data), { .lagLimits = { 1000, 1000 } });
+
+  KJ_EXPECT_THROW_MESSAGE("tee buffer size limit exceeded",
+      tee.branches[0]->readAllBytes().wait(ws));
+  KJ_EXPECT_THROW_MESSAGE("tee buffer size limit exceeded",
+      tee.branches[1]->readAllBytes().wait(ws));
+}
+
+KJ_TEST("shared tee: lag limits apply per branch") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  auto data = makeData(100'000);
+
+  {
+    // Branch 1 may fall arbitrarily far behind.
+    auto tee = newSharedTee(newMemoryInputStream(data), { .lagLimits = { 1000, kj::maxValue } });
+    expectReadAll(*tee.branches[0], data, ws);
+    expectReadAll(*tee.branches[1], data, ws);
+  }
+
+  {
+    // Branch 0 may not.
+    auto tee = newSharedTee(newMemoryInputStream(data), { .lagLimits = { 1000, kj::maxValue } });
+    KJ_EXPECT_THROW_MESSAGE("tee buffer size limit exceeded",
+        tee.branches[1]->readAllBytes().wait(ws));
+  }
+}
+
+KJ_TEST("shared tee: lagging branch spills to disk") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  auto data = makeData(100'000);
+  auto tee = newSharedTee(newMemoryInputStream(data), {
+    .lagLimits = { 1000, 1000 },
+    .spillDirectory = *dir,
+  });
+
+  // Read a little from the slow branch first, so that its backlog starts partway into a chunk.
+  kj::byte head[10];
+  KJ_EXPECT(tee.branches[1]->tryRead(head, sizeof(head), sizeof(head)).wait(ws) == sizeof(head));
+  KJ_EXPECT(kj::arrayPtr(head, sizeof(head)) == data.first(sizeof(head)));
+
+  expectReadAll(*tee.branches[0], data, ws);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(tee.branches[1]->tryGetLength()) == data.size() - sizeof(head));
+  expectReadAll(*tee.branches[1], data.slice(sizeof(head), data.size()), ws);
+}
+
+KJ_TEST("shared tee: dropped branch does not buffer") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  auto data = makeData(100'000);
+  auto tee = newSharedTee(newMemoryInputStream(data), { .lagLimits = { 1000, 1000 } });
+
+  tee.branches[1] = nullptr;
+  expectReadAll(*tee.branches[0], data, ws);
+}
+
+}  // namespace
+}  // namespace workerd
@@ -0,0 +1,324 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "shared-tee.h"
+#include <kj/debug.h>
+#include <deque>
+
+namespace workerd {
+
+namespace {
+
+// Reads from the input are at least this large, even if the read that triggered them is smaller,
+// so that a branch reading a few bytes at a time does not cause many tiny chunks.
+constexpr size_t MIN_CHUNK_SIZE = 16 * 1024;
+
+// Data read from the input, shared by every branch that has not yet consumed all of it.
+struct Chunk: public kj::Refcounted {
+  kj::Array<kj::byte> buffer;
+};
+
+// The part of a chunk that one branch has yet to read.
+struct ChunkSlice {
+  kj::Own<Chunk> chunk;
+  kj::ArrayPtr<const kj::byte> remaining;
+};
+
+// A branch's backlog beyond the lag limit, held in a temporary file.
+struct Spill {
+  kj::Own<const kj::File> file;
+  uint64_t readOffset = 0;
+  uint64_t writeOffset = 0;
+};
+
+struct PendingRead {
+  kj::ArrayPtr<kj::byte> buffer;
+  size_t minBytes;
+  size_t filled;
+  kj::Own<kj::PromiseFulfiller<size_t>> fulfiller;
+};
+
+struct BranchState {
+  // Data not yet read by this branch. Anything in `buffered` precedes anything in `spill`.
+  std::deque<ChunkSlice> buffered;
+  uint64_t bufferedBytes = 0;
+  kj::Maybe<Spill> spill;
+
+  // A read that could not be satisfied from the backlog. Whenever this is set, the backlog is
+  // empty.
+  kj::Maybe<PendingRead> pending;
+
+  bool detached = false;
+
+  // From SharedTeeOptions::lagLimits.
+  uint64_t lagLimit = kj::maxValue;
+
+  uint64_t backlogSize() const {
+    uint64_t result = bufferedBytes;
+    KJ_IF_SOME(s, spill) {
+      result += s.writeOffset - s.readOffset;
+    }
+    return result;
+  }
+};
+
+class SharedTee final: public kj::Refcounted {
+public:
+  SharedTee(kj::Own<kj::AsyncInputStream> input, SharedTeeOptions options)
+      : input(kj::mv(input)), options(options) {
+    branches[0].lagLimit = options.lagLimits[0];
+    branches[1].lagLimit = options.lagLimits[1];
+  }
+
+  kj::Promise<size_t> read(uint branch, void* buffer, size_t minBytes, size_t maxBytes) {
+    auto& state = branches[branch];
+    KJ_IF_SOME(p, state.pending) {
+      KJ_REQUIRE(!p.fulfiller->isWaiting(), "tee branch already has a read in progress");
+      state.pending = kj::none;
+    }
+
+    auto bytes = kj::arrayPtr(reinterpret_cast<kj::byte*>(buffer), maxBytes);
+    size_t filled = readBacklog(state, bytes);
+    if (filled >= minBytes) {
+      return filled;
+    }
+    KJ_IF_SOME(e, error) {
+      return kj::cp(e);
+    }
+    if (ended) {
+      return filled;
+    }
+
+    auto paf = kj::newPromiseAndFulfiller<size_t>();
+    state.pending = PendingRead {
+      .buffer = bytes,
+      .minBytes = minBytes,
+      .filled = filled,
+      .fulfiller = kj::mv(paf.fulfiller),
+    };
+    if (!pulling) {
+      pulling = true;
+      pullTask = pull().eagerlyEvaluate(nullptr);
+    }
+    return kj::mv(paf.promise);
+  }
+
+  kj::Maybe<uint64_t> tryGetLength(uint branch) {
+    if (error != kj::none) {
+      return kj::none;
+    }
+    uint64_t backlog = branches[branch].backlogSize();
+    if (ended) {
+      return backlog;
+    }
+    KJ_IF_SOME(length, input->tryGetLength()) {
+      return length + backlog;
+    }
+    return kj::none;
+  }
+
+  void detach(uint branch) {
+    auto& state = branches[branch];
+    state.detached = true;
+    state.buffered.clear();
+    state.bufferedBytes = 0;
+    state.spill = kj::none;
+    state.pending = kj::none;
+  }
+
+private:
+  kj::Own<kj::AsyncInputStream> input;
+  SharedTeeOptions options;
+  BranchState branches[2];
+
+  bool ended = false;
+  kj::Maybe<kj::Exception> error;
+
+  bool pulling = false;
+  kj::Promise<void> pullTask = nullptr;
+
+  // Copies as much of the branch's backlog into `bytes` as fits, returning the number of bytes
+  // copied.
+  static size_t readBacklog(BranchState& state, kj::ArrayPtr<kj::byte> bytes) {
+    size_t filled = 0;
+    while (filled < bytes.size() && !state.buffered.empty()) {
+      auto& front = state.buffered.front();
+      size_t n = kj::min(front.remaining.size(), bytes.size() - filled);
+      memcpy(bytes.begin() + filled, front.remaining.begin(), n);
+      front.remaining = front.remaining.slice(n, front.remaining.size());
+      filled += n;
+      state.bufferedBytes -= n;
+      if (front.remaining.size() == 0) {
+        state.buffered.pop_front();
+      }
+    }
+
+    if (filled < bytes.size()) {
+      KJ_IF_SOME(s, state.spill) {
+        size_t n = s.file->read(s.readOffset, bytes.slice(filled, bytes.size()));
+        s.readOffset += n;
+        filled += n;
+        if (s.readOffset == s.writeOffset) {
+          // Caught up; go back to buffering in memory.
+          state.spill = kj::none;
+        }
+      }
+    }
+
+    return filled;
+  }
+
+  // Returns how many more bytes the largest outstanding read wants, or zero if no branch has a
+  // read outstanding.
+  size_t wanted() {
+    size_t result = 0;
+    for (auto& state: branches) {
+      KJ_IF_SOME(p, state.pending) {
+        if (p.fulfiller->isWaiting()) {
+          result = kj::max(result, p.buffer.size() - p.filled);
+        } else {
+          // The read was canceled.
+          state.pending = kj::none;
+        }
+      }
+    }
+    return result;
+  }
+
+  kj::Promise<void> pull() {
+    for (;;) {
+      size_t size = wanted();
+      if (size == 0) {
+        break;
+      }
+
+      auto chunk = kj::refcounted<Chunk>();
+      chunk->buffer = kj::heapArray<kj::byte>(kj::max(size, MIN_CHUNK_SIZE));
+      size_t n;
+      try {
+        n = co_await input->tryRead(chunk->buffer.begin(), 1, chunk->buffer.size());
+      } catch (...) {
+        fail(kj::getCaughtExceptionAsKj());
+        break;
+      }
+      if (n == 0) {
+        end();
+        break;
+      }
+      if (n < chunk->buffer.size() / 4) {
+        // Don't let a short read pin a mostly-empty buffer in some branch's backlog.
+        chunk->buffer = kj::heapArray<kj::byte>(chunk->buffer.first(n));
+      }
+
+      KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+        distribute(*chunk, chunk->buffer.first(n));
+      })) {
+        fail(kj::mv(exception));
+        break;
+      }
+    }
+    pulling = false;
+  }
+
+  // Hands `bytes`, which point into `chunk`, to each branch: first to its pending read, if any,
+  // and whatever is left over to its backlog.
+  void distribute(Chunk& chunk, kj::ArrayPtr<const kj::byte> data) {
+    for (auto& state: branches) {
+      if (state.detached) continue;
+
+      auto bytes = data;
+      KJ_IF_SOME(p, state.pending) {
+        if (p.fulfiller->isWaiting()) {
+          size_t n = kj::min(bytes.size(), p.buffer.size() - p.filled);
+          memcpy(p.buffer.begin() + p.filled, bytes.begin(), n);
+          p.filled += n;
+          bytes = bytes.slice(n, bytes.size());
+          if (p.filled >= p.minBytes) {
+            p.fulfiller->fulfill(kj::cp(p.filled));
+            state.pending = kj::none;
+          }
+        } else {
+          state.pending = kj::none;
+        }
+      }
+
+      if (bytes.size() > 0) {
+        addToBacklog(state, chunk, bytes);
+      }
+    }
+  }
+
+  void addToBacklog(BranchState& state, Chunk& chunk, kj::ArrayPtr<const kj::byte> bytes) {
+    KJ_IF_SOME(s, state.spill) {
+      s.file->write(s.writeOffset, bytes);
+      s.writeOffset += bytes.size();
+      return;
+    }
+
+    if (state.bufferedBytes + bytes.size() > state.lagLimit) {
+      auto& dir = KJ_UNWRAP_OR(options.spillDirectory, {
+        KJ_FAIL_REQUIRE("tee buffer size limit exceeded");
+      });
+      auto& s = state.spill.emplace(Spill { .file = dir.createTemporary() });
+      s.file->write(0, bytes);
+      s.writeOffset = bytes.size();
+      return;
+    }
+
+    state.buffered.push_back(ChunkSlice { .chunk = kj::addRef(chunk), .remaining = bytes });
+    state.bufferedBytes += bytes.size();
+  }
+
+  void end() {
+    ended = true;
+    for (auto& state: branches) {
+      KJ_IF_SOME(p, state.pending) {
+        // A short read signals EOF.
+        p.fulfiller->fulfill(kj::cp(p.filled));
+        state.pending = kj::none;
+      }
+    }
+  }
+
+  void fail(kj::Exception exception) {
+    for (auto& state: branches) {
+      KJ_IF_SOME(p, state.pending) {
+        p.fulfiller->reject(kj::cp(exception));
+        state.pending = kj::none;
+      }
+    }
+    error = kj::mv(exception);
+  }
+};
+
+class SharedTeeBranch final: public kj::AsyncInputStream {
+public:
+  SharedTeeBranch(kj::Own<SharedTee> tee, uint index): tee(kj::mv(tee)), index(index) {}
+  ~SharedTeeBranch() noexcept(false) {
+    tee->detach(index);
+  }
+
+  kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+    return tee->read(index, buffer, minBytes, maxBytes);
+  }
+
+  kj::Maybe<uint64_t> tryGetLength() override {
+    return tee->tryGetLength(index);
+  }
+
+private:
+  kj::Own<SharedTee> tee;
+  uint index;
+};
+
+}  // namespace
+
+kj::Tee newSharedTee(kj::Own<kj::AsyncInputStream> input, SharedTeeOptions options) {
+  auto tee = kj::refcounted<SharedTee>(kj::mv(input), options);
+  auto branch0 = kj::heap<SharedTeeBranch>(kj::addRef(*tee), 0);
+  auto branch1 = kj::heap<SharedTeeBranch>(kj::mv(tee), 1);
+  return { { kj::mv(branch0), kj::mv(branch1) } };
+}
+
+}  // namespace workerd
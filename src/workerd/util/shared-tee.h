@@ -0,0 +1,32 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/async-io.h>
+#include <kj/filesystem.h>
+
+namespace workerd {
+
+struct SharedTeeOptions {
+  // Maximum number of bytes that may be held in memory for each branch when it falls behind its
+  // sibling, indexed like kj::Tee::branches.
+  uint64_t lagLimits[2] = { kj::maxValue, kj::maxValue };
+
+  // If set, data for a branch that would exceed its lag limit is written to an unnamed temporary file
+  // in this directory instead, and read back from there once the branch catches up. If not set,
+  // exceeding the limit fails both branches with "tee buffer size limit exceeded", like
+  // kj::newTee() does.
+  kj::Maybe<const kj::Directory&> spillDirectory;
+};
+
+// Splits `input` into two streams that each produce all of its data, like kj::newTee().
+//
+// Each chunk read from `input` is held exactly once, in a refcounted buffer that both branches
+// point into until they have each consumed it, rather than being copied into a separate buffer
+// for whichever branch is behind. Reads are only issued on `input` when some branch has a read
+// outstanding that its backlog cannot satisfy, so the faster branch drives the tee.
+kj::Tee newSharedTee(kj::Own<kj::AsyncInputStream> input, SharedTeeOptions options = {});
+
+}  // namespace workerd
@@ -0,0 +1,109 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "sqlite-kv-namespace.h"
+#include <kj/test.h>
+
+namespace workerd {
+namespace {
+
+class FakeClock final: public kj::Clock {
+public:
+  kj::Date now() const override { return time; }
+
+  kj::Date time = kj::UNIX_EPOCH + 1'700'000'000ll * kj::SECONDS;
+};
+
+struct KvTester {
+  kj::Own<const kj::Directory> dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs { *dir };
+  SqliteDatabase db { vfs, kj::Path({"kv.sqlite"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY };
+  FakeClock clock;
+  SqliteKvNamespace kv { db, clock };
+
+  kj::String listNames(kj::StringPtr prefix, uint limit, kj::Maybe<kj::StringPtr> cursor,
+      kj::Maybe<kj::String>& nextCursor) {
+    auto result = kv.list(prefix, limit, cursor);
+    nextCursor = kj::mv(result.cursor);
+    return kj::strArray(KJ_MAP(k, result.keys) { return kj::str(k.name); }, ",");
+  }
+};
+
+KJ_TEST("SqliteKvNamespace get/put/delete") {
+  KvTester t;
+
+  KJ_EXPECT(t.kv.get("foo") == kj::none);
+
+  t.kv.put("foo", "bar"_kj.asBytes(), kj::none, kj::none);
+  {
+    auto entry = KJ_ASSERT_NONNULL(t.kv.get("foo"));
+    KJ_EXPECT(entry.value.asChars() == "bar"_kj);
+    KJ_EXPECT(entry.metadata == kj::none);
+    KJ_EXPECT(entry.expiration == kj::none);
+  }
+
+  t.kv.put("foo", "baz"_kj.asBytes(), "{\"a\":1}"_kj, 1'800'000'000);
+  {
+    auto entry = KJ_ASSERT_NONNULL(t.kv.get("foo"));
+    KJ_EXPECT(entry.value.asChars() == "baz"_kj);
+    KJ_EXPECT(KJ_ASSERT_NONNULL(entry.metadata) == "{\"a\":1}");
+    KJ_EXPECT(KJ_ASSERT_NONNULL(entry.expiration) == 1'800'000'000);
+  }
+
+  // Empty values are distinct from missing ones.
+  t.kv.put("empty", nullptr, kj::none, kj::none);
+  KJ_EXPECT(KJ_ASSERT_NONNULL(t.kv.get("empty")).value.size() == 0);
+
+  t.kv.delete_("foo");
+  KJ_EXPECT(t.kv.get("foo") == kj::none);
+  t.kv.delete_("foo");
+}
+
+KJ_TEST("SqliteKvNamespace expiration") {
+  KvTester t;
+  auto nowSeconds = (t.clock.time - kj::UNIX_EPOCH) / kj::SECONDS;
+
+  t.kv.put("a", "1"_kj.asBytes(), kj::none, nowSeconds + 60);
+  t.kv.put("b", "2"_kj.asBytes(), kj::none, nowSeconds + 120);
+  t.kv.put("c", "3"_kj.asBytes(), kj::none, kj::none);
+
+  kj::Maybe<kj::String> cursor;
+  KJ_EXPECT(t.listNames("", 10, kj::none, cursor) == "a,b,c");
+
+  t.clock.time += 90 * kj::SECONDS;
+  KJ_EXPECT(t.kv.get("a") == kj::none);
+  KJ_EXPECT(t.kv.get("b") != kj::none);
+  KJ_EXPECT(t.listNames("", 10, kj::none, cursor) == "b,c");
+
+  // An expired entry doesn't count towards the limit.
+  t.kv.put("a", "1"_kj.asBytes(), kj::none, nowSeconds + 60);
+  KJ_EXPECT(t.listNames("", 1, kj::none, cursor) == "b");
+  KJ_EXPECT(KJ_ASSERT_NONNULL(cursor) == "b");
+}
+
+KJ_TEST("SqliteKvNamespace list with prefix and cursor") {
+  KvTester t;
+
+  for (auto key: {"a", "ab", "abc", "abd", "ac", "b", "ab\xff", "ab\xff\xff"}) {
+    t.kv.put(key, "x"_kj.asBytes(), kj::none, kj::none);
+  }
+
+  kj::Maybe<kj::String> cursor;
+  KJ_EXPECT(t.listNames("ab", 10, kj::none, cursor) == "ab,abc,abd,ab\xff,ab\xff\xff");
+  KJ_EXPECT(cursor == kj::none);
+
+  KJ_EXPECT(t.listNames("ab\xff", 10, kj::none, cursor) == "ab\xff,ab\xff\xff");
+
+  KJ_EXPECT(t.listNames("ab", 2, kj::none, cursor) == "ab,abc");
+  auto c1 = kj::str(KJ_ASSERT_NONNULL(cursor));
+  KJ_EXPECT(t.listNames("ab", 2, c1, cursor) == "abd,ab\xff");
+  auto c2 = kj::str(KJ_ASSERT_NONNULL(cursor));
+  KJ_EXPECT(t.listNames("ab", 2, c2, cursor) == "ab\xff\xff");
+  KJ_EXPECT(cursor == kj::none);
+
+  KJ_EXPECT(t.listNames("", 100, kj::none, cursor) == "a,ab,abc,abd,ab\xff,ab\xff\xff,ac,b");
+}
+
+}  // namespace
+}  // namespace workerd
@@ -0,0 +1,193 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "sqlite-kv-namespace.h"
+#include <kj/debug.h>
+
+namespace workerd {
+
+namespace {
+
+// Stored values start with a flags byte, followed by the expiration as a little-endian int64 if
+// HAS_EXPIRATION is set, then the metadata's length as a little-endian uint32 and the metadata
+// itself if HAS_METADATA is set. The rest is the value.
+constexpr kj::byte HAS_EXPIRATION = 1;
+constexpr kj::byte HAS_METADATA = 2;
+
+template <typename T>
+T readLittleEndian(kj::ArrayPtr<const kj::byte>& bytes) {
+  KJ_REQUIRE(bytes.size() >= sizeof(T), "corrupt KV entry");
+  T result = 0;
+  for (auto i: kj::zeroTo(sizeof(T))) {
+    result |= static_cast<T>(bytes[i]) << (i * 8);
+  }
+  bytes = bytes.slice(sizeof(T), bytes.size());
+  return result;
+}
+
+template <typename T>
+kj::byte* writeLittleEndian(kj::byte* pos, T value) {
+  for (auto i: kj::zeroTo(sizeof(T))) {
+    *pos++ = static_cast<kj::byte>(static_cast<uint64_t>(value) >> (i * 8));
+  }
+  return pos;
+}
+
+}  // namespace
+
+SqliteKvNamespace::Record SqliteKvNamespace::decode(kj::ArrayPtr<const kj::byte> stored) {
+  KJ_REQUIRE(stored.size() > 0, "corrupt KV entry");
+  kj::byte flags = stored[0];
+  auto rest = stored.slice(1, stored.size());
+
+  Record record;
+  if (flags & HAS_EXPIRATION) {
+    record.expiration = readLittleEndian<int64_t>(rest);
+  }
+  if (flags & HAS_METADATA) {
+    auto size = readLittleEndian<uint32_t>(rest);
+    KJ_REQUIRE(rest.size() >= size, "corrupt KV entry");
+    record.metadata = rest.first(size).asChars();
+    rest = rest.slice(size, rest.size());
+  }
+  record.value = rest;
+  return record;
+}
+
+kj::Array<kj::byte> SqliteKvNamespace::encode(kj::ArrayPtr<const kj::byte> value,
+    kj::Maybe<kj::StringPtr> metadata, kj::Maybe<int64_t> expiration) {
+  kj::byte flags = 0;
+  size_t size = 1 + value.size();
+  if (expiration != kj::none) {
+    flags |= HAS_EXPIRATION;
+    size += sizeof(int64_t);
+  }
+  KJ_IF_SOME(m, metadata) {
+    flags |= HAS_METADATA;
+    size += sizeof(uint32_t) + m.size();
+  }
+
+  auto result = kj::heapArray<kj::byte>(size);
+  auto pos = result.begin();
+  *pos++ = flags;
+  KJ_IF_SOME(e, expiration) {
+    pos = writeLittleEndian(pos, e);
+  }
+  KJ_IF_SOME(m, metadata) {
+    pos = writeLittleEndian(pos, static_cast<uint32_t>(m.size()));
+    memcpy(pos, m.begin(), m.size());
+    pos += m.size();
+  }
+  memcpy(pos, value.begin(), value.size());
+  return result;
+}
+
+bool SqliteKvNamespace::isExpired(const Record& record, kj::Date now) {
+  KJ_IF_SOME(e, record.expiration) {
+    return kj::UNIX_EPOCH + e * kj::SECONDS <= now;
+  }
+  return false;
+}
+
+kj::Maybe<SqliteKvNamespace::Entry> SqliteKvNamespace::get(kj::StringPtr key) {
+  kj::Maybe<Entry> result;
+  bool expired = false;
+  kv.get(key, [&](kj::ArrayPtr<const kj::byte> stored) {
+    auto record = decode(stored);
+    if (isExpired(record, clock.now())) {
+      expired = true;
+      return;
+    }
+    result = Entry {
+      .value = kj::heapArray(record.value),
+      .metadata = record.metadata.map([](kj::ArrayPtr<const char> m) { return kj::heapString(m); }),
+      .expiration = record.expiration,
+    };
+  });
+
+  if (expired) {
+    kv.delete_(key);
+  }
+  return kj::mv(result);
+}
+
+void SqliteKvNamespace::put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> value,
+    kj::Maybe<kj::StringPtr> metadata, kj::Maybe<int64_t> expiration) {
+  kv.put(key, encode(value, metadata, expiration));
+}
+
+void SqliteKvNamespace::delete_(kj::StringPtr key) {
+  kv.delete_(key);
+}
+
+SqliteKvNamespace::ListResult SqliteKvNamespace::list(
+    kj::StringPtr prefix, uint limit, kj::Maybe<kj::StringPtr> cursor) {
+  // Keys compare bytewise, so the keys starting with `prefix` are those in [prefix, end), where
+  // `end` is `prefix` with its last byte that isn't 0xff incremented and anything after it dropped.
+  kj::Maybe<kj::String> end;
+  for (size_t i = prefix.size(); i > 0; --i) {
+    if (static_cast<kj::byte>(prefix[i - 1]) != 0xff) {
+      auto e = kj::heapString(prefix.begin(), i);
+      e[i - 1] = static_cast<char>(static_cast<kj::byte>(e[i - 1]) + 1);
+      end = kj::mv(e);
+      break;
+    }
+  }
+
+  // The cursor is the last key returned by the previous call. Appending a NUL gives the smallest
+  // key that sorts after it.
+  kj::String begin = kj::str(prefix);
+  KJ_IF_SOME(c, cursor) {
+    auto next = kj::str(c, '\0');
+    if (begin < next) {
+      begin = kj::mv(next);
+    }
+  }
+
+  auto endPtr = end.map([](kj::String& e) -> kj::StringPtr { return e; });
+  auto now = clock.now();
+  kj::Vector<ListedKey> keys(limit);
+  bool more = false;
+
+  // Ask for one more key than we need, to find out whether there are any more. Skipped expired
+  // entries may mean we have to come back for another batch.
+  for (;;) {
+    uint batchSize = limit - keys.size() + 1;
+    uint seen = 0;
+    kj::String last;
+    kv.list(begin, endPtr, batchSize, SqliteKv::FORWARD,
+        [&](kj::StringPtr key, kj::ArrayPtr<const kj::byte> stored) {
+      ++seen;
+      last = kj::str(key);
+      if (more) return;
+
+      auto record = decode(stored);
+      if (isExpired(record, now)) return;
+
+      if (keys.size() == limit) {
+        more = true;
+        return;
+      }
+      keys.add(ListedKey {
+        .name = kj::str(key),
+        .metadata = record.metadata.map([](kj::ArrayPtr<const char> m) {
+          return kj::heapString(m);
+        }),
+        .expiration = record.expiration,
+      });
+    });
+
+    if (more || seen < batchSize) break;
+    begin = kj::str(last, '\0');
+  }
+
+  ListResult result;
+  if (more && keys.size() > 0) {
+    result.cursor = kj::str(keys.back().name);
+  }
+  result.keys = keys.releaseAsArray();
+  return result;
+}
+
+}  // namespace workerd
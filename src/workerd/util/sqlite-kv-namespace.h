@@ -0,0 +1,76 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include "sqlite-kv.h"
+#include <kj/time.h>
+
+namespace workerd {
+
+// Storage for a Workers KV namespace, kept in a SQLite database. This backs workerd's `kv`
+// services, which KvNamespace bindings call directly rather than through HTTP.
+//
+// Entries are stored with SqliteKv. Since KV attaches an optional expiration time and JSON
+// metadata to every value, each stored value starts with a small header holding those.
+//
+// Expired entries are treated as absent. They are deleted when a get() runs into them, and
+// otherwise simply skipped.
+class SqliteKvNamespace {
+public:
+  // `clock` decides when entries expire.
+  SqliteKvNamespace(SqliteDatabase& db, const kj::Clock& clock): kv(db), clock(clock) {}
+
+  struct Entry {
+    kj::Array<kj::byte> value;
+
+    // JSON-encoded metadata, if any was given to put().
+    kj::Maybe<kj::String> metadata;
+
+    // Seconds since the Unix epoch, as in the KV API.
+    kj::Maybe<int64_t> expiration;
+  };
+
+  kj::Maybe<Entry> get(kj::StringPtr key);
+
+  void put(kj::StringPtr key, kj::ArrayPtr<const kj::byte> value,
+           kj::Maybe<kj::StringPtr> metadata, kj::Maybe<int64_t> expiration);
+
+  void delete_(kj::StringPtr key);
+
+  struct ListedKey {
+    kj::String name;
+    kj::Maybe<kj::String> metadata;
+    kj::Maybe<int64_t> expiration;
+  };
+
+  struct ListResult {
+    kj::Array<ListedKey> keys;
+
+    // Set when there may be more keys to list. Pass this back as `cursor` to continue.
+    kj::Maybe<kj::String> cursor;
+  };
+
+  // Lists up to `limit` keys starting with `prefix`, in order.
+  ListResult list(kj::StringPtr prefix, uint limit, kj::Maybe<kj::StringPtr> cursor);
+
+private:
+  SqliteKv kv;
+  const kj::Clock& clock;
+
+  // An entry as stored in the database. The pointers point into the stored value.
+  struct Record {
+    kj::ArrayPtr<const kj::byte> value;
+    kj::Maybe<kj::ArrayPtr<const char>> metadata;
+    kj::Maybe<int64_t> expiration;
+  };
+
+  static Record decode(kj::ArrayPtr<const kj::byte> stored);
+  static kj::Array<kj::byte> encode(kj::ArrayPtr<const kj::byte> value,
+      kj::Maybe<kj::StringPtr> metadata, kj::Maybe<int64_t> expiration);
+
+  bool isExpired(const Record& record, kj::Date now);
+};
+
+}  // namespace workerd
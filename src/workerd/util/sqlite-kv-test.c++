@@ -3,6 +3,7 @@
 //     https://opensource.org/licenses/Apache-2.0
 
 #include "sqlite-kv.h"
+#include <kj/map.h>
 #include <kj/test.h>
 
 namespace workerd {
@@ -91,5 +92,96 @@ KJ_TEST("SQLite-KV") {
   KJ_EXPECT(list(nullptr, kj::none, kj::none, F) == "");
 }
 
+KJ_TEST("SQLite-KV batched operations") {
+  auto dir = kj::newInMemoryDirectory(kj::nullClock());
+  SqliteDatabase::Vfs vfs(*dir);
+  SqliteDatabase db(vfs, kj::Path({"foo"}), kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+  SqliteKv kv(db);
+
+  // Use a count that isn't a power of two and exceeds MAX_BATCH_SIZE, so that the input is split
+  // into several differently-sized chunks.
+  constexpr uint COUNT = SqliteKv::MAX_BATCH_SIZE * 2 + 7;
+
+  auto keys = KJ_MAP(i, kj::zeroTo(COUNT)) { return kj::str("key", i); };
+  auto values = KJ_MAP(i, kj::zeroTo(COUNT)) { return kj::str("value", i); };
+
+  {
+    auto pairs = KJ_MAP(i, kj::zeroTo(COUNT)) -> SqliteKv::KeyValuePtrPair {
+      return { keys[i], values[i].asBytes() };
+    };
+    kv.putMultiple(pairs);
+  }
+
+  {
+    uint seen = 0;
+    uint n = kv.list(nullptr, kj::none, kj::none, SqliteKv::FORWARD,
+        [&](kj::StringPtr key, kj::ArrayPtr<const byte> value) { ++seen; });
+    KJ_EXPECT(n == COUNT);
+    KJ_EXPECT(seen == COUNT);
+  }
+
+  {
+    // Look up every other key, plus some that don't exist.
+    kj::Vector<kj::StringPtr> lookup;
+    for (auto i: kj::zeroTo(COUNT)) {
+      if (i % 2 == 0) lookup.add(keys[i]);
+    }
+    lookup.add("nope");
+    lookup.add("key");
+
+    kj::HashMap<kj::String, kj::String> results;
+    uint n = kv.getMultiple(lookup.asPtr(), [&](kj::StringPtr key, kj::ArrayPtr<const byte> value) {
+      results.insert(kj::str(key), kj::str(value.asChars()));
+    });
+    KJ_EXPECT(n == (COUNT + 1) / 2);
+    KJ_EXPECT(results.size() == (COUNT + 1) / 2);
+    for (auto i: kj::zeroTo(COUNT)) {
+      if (i % 2 == 0) {
+        KJ_EXPECT(KJ_ASSERT_NONNULL(results.find(keys[i])) == values[i]);
+      } else {
+        KJ_EXPECT(results.find(keys[i]) == kj::none);
+      }
+    }
+  }
+
+  {
+    // Later duplicates win.
+    SqliteKv::KeyValuePtrPair pairs[] = {
+      { "key0"_kj, "first"_kj.asBytes() },
+      { "key1"_kj, "other"_kj.asBytes() },
+      { "key0"_kj, "second"_kj.asBytes() },
+    };
+    kv.putMultiple(pairs);
+
+    bool called = false;
+    KJ_EXPECT(kv.get("key0", [&](kj::ArrayPtr<const byte> value) {
+      KJ_EXPECT(kj::str(value.asChars()) == "second");
+      called = true;
+    }));
+    KJ_EXPECT(called);
+  }
+
+  {
+    kj::Vector<kj::StringPtr> toDelete;
+    for (auto i: kj::zeroTo(COUNT)) {
+      if (i % 3 == 0) toDelete.add(keys[i]);
+    }
+    toDelete.add("nope");
+    KJ_EXPECT(kv.deleteMultiple(toDelete.asPtr()) == (COUNT + 2) / 3);
+    KJ_EXPECT(kv.deleteMultiple(toDelete.asPtr()) == 0);
+
+    uint n = kv.list(nullptr, kj::none, kj::none, SqliteKv::FORWARD,
+        [&](kj::StringPtr key, kj::ArrayPtr<const byte> value) {});
+    KJ_EXPECT(n == COUNT - (COUNT + 2) / 3);
+  }
+
+  // Empty inputs are no-ops.
+  KJ_EXPECT(kv.getMultiple(nullptr, [&](kj::StringPtr, kj::ArrayPtr<const byte>) {
+    KJ_FAIL_EXPECT("should not call callback for empty input");
+  }) == 0);
+  kv.putMultiple(nullptr);
+  KJ_EXPECT(kv.deleteMultiple(nullptr) == 0);
+}
+
 }  // namespace
 }  // namespace workerd
@@ -36,4 +36,93 @@ uint SqliteKv::deleteAll() {
   return query.changeCount();
 }
 
+void SqliteKv::putMultiple(kj::ArrayPtr<const KeyValuePtrPair> pairs) {
+  SqliteDatabase::Query::ValuePtr bindings[MAX_BATCH_SIZE * 2];
+  while (pairs.size() > 0) {
+    uint sizeClass = batchSizeClass(pairs.size());
+    size_t chunkSize = size_t(1) << sizeClass;
+    for (auto i: kj::zeroTo(chunkSize)) {
+      bindings[i * 2] = pairs[i].key;
+      bindings[i * 2 + 1] = pairs[i].value;
+    }
+
+    putMultipleStatement(sizeClass).run(
+        kj::ArrayPtr<const SqliteDatabase::Query::ValuePtr>(bindings, chunkSize * 2));
+
+    pairs = pairs.slice(chunkSize, pairs.size());
+  }
+}
+
+uint SqliteKv::deleteMultiple(kj::ArrayPtr<const KeyPtr> keys) {
+  uint count = 0;
+  SqliteDatabase::Query::ValuePtr bindings[MAX_BATCH_SIZE];
+  while (keys.size() > 0) {
+    uint sizeClass = batchSizeClass(keys.size());
+    size_t chunkSize = size_t(1) << sizeClass;
+    for (auto i: kj::zeroTo(chunkSize)) {
+      bindings[i] = keys[i];
+    }
+
+    auto query = deleteMultipleStatement(sizeClass).run(
+        kj::ArrayPtr<const SqliteDatabase::Query::ValuePtr>(bindings, chunkSize));
+    count += query.changeCount();
+
+    keys = keys.slice(chunkSize, keys.size());
+  }
+  return count;
+}
+
+uint SqliteKv::batchSizeClass(size_t remaining) {
+  KJ_DASSERT(remaining > 0);
+  uint sizeClass = 0;
+  while (sizeClass + 1 < BATCH_SIZE_CLASSES && (size_t(2) << sizeClass) <= remaining) {
+    ++sizeClass;
+  }
+  return sizeClass;
+}
+
+namespace {
+
+// Produces `count` copies of `group`, separated by commas, for use in a VALUES or IN clause.
+kj::String repeatPlaceholders(uint count, kj::StringPtr group) {
+  auto parts = kj::heapArray<kj::StringPtr>(count);
+  for (auto& part: parts) {
+    part = group;
+  }
+  return kj::strArray(parts, ", ");
+}
+
+}  // namespace
+
+SqliteDatabase::Statement& SqliteKv::getMultipleStatement(uint sizeClass) {
+  auto& slot = stmtGetMultiple[sizeClass];
+  KJ_IF_SOME(stmt, slot) {
+    return stmt;
+  }
+  return slot.emplace(db.prepare(SqliteDatabase::TRUSTED, kj::str(
+      "SELECT key, value FROM _cf_KV WHERE key IN (",
+      repeatPlaceholders(1u << sizeClass, "?"), ")")));
+}
+
+SqliteDatabase::Statement& SqliteKv::putMultipleStatement(uint sizeClass) {
+  auto& slot = stmtPutMultiple[sizeClass];
+  KJ_IF_SOME(stmt, slot) {
+    return stmt;
+  }
+  // Rows in a multi-row VALUES clause are inserted in order, so a later duplicate key takes the
+  // ON CONFLICT path and overwrites the earlier one, matching a sequence of single puts.
+  return slot.emplace(db.prepare(SqliteDatabase::TRUSTED, kj::str(
+      "INSERT INTO _cf_KV VALUES ", repeatPlaceholders(1u << sizeClass, "(?, ?)"),
+      " ON CONFLICT DO UPDATE SET value = excluded.value")));
+}
+
+SqliteDatabase::Statement& SqliteKv::deleteMultipleStatement(uint sizeClass) {
+  auto& slot = stmtDeleteMultiple[sizeClass];
+  KJ_IF_SOME(stmt, slot) {
+    return stmt;
+  }
+  return slot.emplace(db.prepare(SqliteDatabase::TRUSTED, kj::str(
+      "DELETE FROM _cf_KV WHERE key IN (", repeatPlaceholders(1u << sizeClass, "?"), ")")));
+}
+
 }  // namespace workerd
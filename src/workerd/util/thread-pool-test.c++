@@ -0,0 +1,65 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "thread-pool.h"
+#include <kj/test.h>
+#include <thread>
+
+namespace workerd {
+namespace {
+
+KJ_TEST("ThreadPool runs jobs off the calling thread") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  ThreadPool pool(2);
+
+  auto caller = std::this_thread::get_id();
+  auto promises = KJ_MAP(i, kj::zeroTo(10)) {
+    return pool.run([i, caller]() {
+      KJ_EXPECT(std::this_thread::get_id() != caller);
+      return i * i;
+    });
+  };
+  for (auto i: kj::indices(promises)) {
+    KJ_EXPECT(promises[i].wait(ws) == i * i);
+  }
+}
+
+KJ_TEST("ThreadPool propagates exceptions") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  ThreadPool pool(1);
+
+  KJ_EXPECT_THROW_MESSAGE("job failed", pool.run([]() -> int {
+    kj::throwFatalException(KJ_EXCEPTION(FAILED, "job failed"));
+  }).wait(ws));
+
+  pool.run([]() {}).wait(ws);
+}
+
+KJ_TEST("ThreadPool skips jobs whose promise was dropped") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+  ThreadPool pool(1);
+
+  // Keep the only thread busy until we've dropped the second job's promise.
+  kj::MutexGuarded<bool> release(false);
+  auto blocker = pool.run([&]() {
+    release.lockExclusive().wait([](bool r) { return r; });
+  });
+
+  bool ran = false;
+  {
+    auto dropped = pool.run([&]() { ran = true; });
+  }
+  *release.lockExclusive() = true;
+  blocker.wait(ws);
+
+  // Jobs run in order, so once this one finishes the dropped job has been skipped.
+  pool.run([]() {}).wait(ws);
+  KJ_EXPECT(!ran);
+}
+
+}  // namespace
+}  // namespace workerd
@@ -0,0 +1,61 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#include "thread-pool.h"
+#include <kj/debug.h>
+#include <thread>
+
+namespace workerd {
+
+namespace {
+
+constexpr uint MAX_DEFAULT_THREADS = 4;
+
+}  // namespace
+
+ThreadPool::ThreadPool(uint threadCount) {
+  KJ_REQUIRE(threadCount > 0, "a thread pool needs at least one thread");
+  threads.reserve(threadCount);
+  for (auto i KJ_UNUSED: kj::zeroTo(threadCount)) {
+    threads.add(kj::heap<kj::Thread>([this]() { runJobs(); }));
+  }
+}
+
+ThreadPool::~ThreadPool() noexcept(false) {
+  state.lockExclusive()->shuttingDown = true;
+  // kj::Thread's destructor joins.
+  threads.clear();
+}
+
+const ThreadPool& ThreadPool::getDefault() {
+  // Intentionally leaked, so that exiting the process doesn't wait on jobs that are still running.
+  static const ThreadPool* pool = new ThreadPool(
+      kj::min(kj::max(std::thread::hardware_concurrency(), 1u), MAX_DEFAULT_THREADS));
+  return *pool;
+}
+
+void ThreadPool::enqueue(kj::Own<Job> job) const {
+  auto lock = state.lockExclusive();
+  KJ_REQUIRE(!lock->shuttingDown, "thread pool is shutting down");
+  lock->queue.push_back(kj::mv(job));
+}
+
+void ThreadPool::runJobs() const {
+  for (;;) {
+    kj::Own<Job> job;
+    {
+      auto lock = state.lockExclusive();
+      lock.wait([](const State& s) { return !s.queue.empty() || s.shuttingDown; });
+      if (lock->queue.empty()) {
+        return;
+      }
+      job = kj::mv(lock->queue.front());
+      lock->queue.pop_front();
+    }
+
+    job->run();
+  }
+}
+
+}  // namespace workerd
@@ -0,0 +1,97 @@
+// Copyright (c) 2023 Cloudflare, Inc.
+// Licensed under the Apache 2.0 license found in the LICENSE file or at:
+//     https://opensource.org/licenses/Apache-2.0
+
+#pragma once
+
+#include <kj/async.h>
+#include <kj/mutex.h>
+#include <kj/thread.h>
+#include <kj/vector.h>
+#include <deque>
+
+namespace workerd {
+
+// A fixed set of background threads that run CPU-bound work which does not need an event loop or
+// an isolate lock, such as hashing or encrypting a large buffer.
+//
+// Jobs run in the order they were submitted. A job whose promise has been dropped by the time a
+// thread picks it up is skipped, but a job that has already started runs to completion.
+class ThreadPool {
+public:
+  explicit ThreadPool(uint threadCount);
+
+  // Waits for queued jobs to finish, then joins the threads.
+  ~ThreadPool() noexcept(false);
+
+  KJ_DISALLOW_COPY_AND_MOVE(ThreadPool);
+
+  // Runs `func` on one of the pool's threads and returns a promise for its result, which must be
+  // waited on from a thread with a kj event loop. `func` is destroyed on the pool thread, so
+  // anything it captures must be safe to destroy there.
+  template <typename Func>
+  kj::Promise<kj::_::ReturnType<Func, void>> run(Func&& func) const;
+
+  // A pool shared by the whole process, with one thread per core, up to four.
+  static const ThreadPool& getDefault();
+
+private:
+  class Job {
+  public:
+    virtual ~Job() noexcept(false) = default;
+    virtual void run() = 0;
+  };
+
+  template <typename T, typename Func>
+  class JobImpl;
+
+  struct State {
+    std::deque<kj::Own<Job>> queue;
+    bool shuttingDown = false;
+  };
+
+  kj::MutexGuarded<State> state;
+  kj::Vector<kj::Own<kj::Thread>> threads;
+
+  void enqueue(kj::Own<Job> job) const;
+  void runJobs() const;
+};
+
+template <typename T, typename Func>
+class ThreadPool::JobImpl final: public ThreadPool::Job {
+public:
+  JobImpl(Func&& func, kj::Own<kj::CrossThreadPromiseFulfiller<T>> fulfiller)
+      : func(kj::fwd<Func>(func)), fulfiller(kj::mv(fulfiller)) {}
+
+  void run() override {
+    if (!fulfiller->isWaiting()) {
+      // The caller is no longer interested in the result.
+      return;
+    }
+
+    KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+      if constexpr (kj::isSameType<T, void>()) {
+        func();
+        fulfiller->fulfill();
+      } else {
+        fulfiller->fulfill(func());
+      }
+    })) {
+      fulfiller->reject(kj::mv(exception));
+    }
+  }
+
+private:
+  kj::Decay<Func> func;
+  kj::Own<kj::CrossThreadPromiseFulfiller<T>> fulfiller;
+};
+
+template <typename Func>
+kj::Promise<kj::_::ReturnType<Func, void>> ThreadPool::run(Func&& func) const {
+  using T = kj::_::ReturnType<Func, void>;
+  auto paf = kj::newPromiseAndCrossThreadFulfiller<T>();
+  enqueue(kj::heap<JobImpl<T, Func>>(kj::fwd<Func>(func), kj::mv(paf.fulfiller)));
+  return kj::mv(paf.promise);
+}
+
+}  // namespace workerd